@@ -0,0 +1,652 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+//
+// Benchmarks for CRAVA.
+//
+//   cravabench micro [nx ny nz [nThreads]]
+//
+//       Times the inner kernels on synthetic data: the 3D grid transforms, the batched
+//       per-frequency posterior update, SEG-Y ingest, disk storage of grids and 2D kriging.
+//
+//   cravabench case <directory> [nx ny nz [nWells [nThreads]]]
+//
+//       Writes a synthetic model (two angle stacks, wells with facies logs and a model
+//       file) to <directory>. Running cravarun on model.xml in that directory does
+//       inversion, simulation, facies probabilities and background estimation from the
+//       wells, and writes the timing report timings.json/timings.csv to the output directory.
+//
+// Results from different versions are comparable as long as the sizes and number of threads
+// are the same. Use "make bench" to build and run both on a default size.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "fftw.h"
+#include "lib/random.h"
+#include "lib/lib_matrbatch.h"
+
+#include "nrlib/iotools/fileio.hpp"
+#include "nrlib/iotools/logkit.hpp"
+#include "nrlib/iotools/stringtools.hpp"
+#include "nrlib/segy/segy.hpp"
+
+#include "src/definitions.h"
+#include "src/fftgrid.h"
+#include "src/fftfilegrid.h"
+#include "src/io.h"
+#include "src/simbox.h"
+#include "src/vario.h"
+#include "src/covgrid2d.h"
+#include "src/krigingdata2d.h"
+#include "src/kriging2d.h"
+
+namespace
+{
+  const double dxy       = 25.0;    // Lateral cell size
+  const double dt        = 4.0;     // Sample interval (ms)
+  const double topTime   = 1200.0;  // Top of inversion interval (ms)
+  const double margin    = 160.0;   // SEG-Y data above and below the interval (ms)
+  const double x0        = 400000.0;
+  const double y0        = 6000000.0;
+  const float  guardZone = 50.0f;
+
+  //-----------------------------------------------------------------------
+  void
+  printHeader(void)
+  {
+    printf("\n%-34s %-16s %8s %14s %14s\n", "Benchmark", "Size", "Repeats", "Time/call (s)", "Rate");
+    printf("-----------------------------------------------------------------------------------------------\n");
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  printResult(const std::string & name,
+              const std::string & size,
+              int                 nRepeats,
+              double              seconds,
+              double              work,
+              const std::string & unit)
+  {
+    double perCall = seconds/nRepeats;
+    double rate    = (seconds > 0.0 ? work*nRepeats/seconds : 0.0);
+    printf("%-34s %-16s %8d %14.5f %10.1f %s\n", name.c_str(), size.c_str(), nRepeats, perCall, rate, unit.c_str());
+    fflush(stdout);
+  }
+
+  //-----------------------------------------------------------------------
+  std::string
+  sizeString(int nx, int ny, int nz)
+  {
+    return(NRLib::ToString(nx) + "x" + NRLib::ToString(ny) + "x" + NRLib::ToString(nz));
+  }
+
+  //-----------------------------------------------------------------------
+  Simbox *
+  makeSimbox(int nx, int ny, int nz)
+  {
+    double lx = nx*dxy;
+    double ly = ny*dxy;
+    Surface top(x0, y0, lx, ly, 2, 2, topTime);
+    return(new Simbox(x0, y0, top, lx, ly, nz*dt, 0.0, dxy, dxy, dt));
+  }
+
+  //-----------------------------------------------------------------------
+  double
+  ricker(double t, double f)
+  {
+    double a = (M_PI*f*t/1000.0)*(M_PI*f*t/1000.0);
+    return((1.0 - 2.0*a)*exp(-a));
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  writeSeismic(const std::string & fileName,
+               int                 nx,
+               int                 ny,
+               int                 nz,
+               float               scale,
+               unsigned int        seed)
+  {
+    //
+    // Random reflectivity convolved with a 30Hz Ricker wavelet, covering the inversion
+    // interval with a margin above and below.
+    //
+    RandomGen rng(seed);
+    int   ns     = nz + 2*static_cast<int>(margin/dt);
+    float z0     = static_cast<float>(topTime - margin);
+    int   nw     = 15;
+
+    std::vector<float> w(2*nw+1);
+    for (int m = -nw ; m <= nw ; m++)
+      w[m+nw] = static_cast<float>(ricker(m*dt, 30.0));
+
+    SegY segy(fileName, z0, ns, static_cast<float>(dt), TextualHeader::standardHeader());
+    SegyGeometry geometry(x0, y0, dxy, dxy, nx, ny, 0.0);
+    segy.SetGeometry(&geometry);
+
+    std::vector<float> refl(ns);
+    std::vector<float> trace(ns);
+    for (int j = 0 ; j < ny ; j++) {
+      for (int i = 0 ; i < nx ; i++) {
+        for (int k = 0 ; k < ns ; k++)
+          refl[k] = static_cast<float>(0.05*rng.rnorm01());
+        for (int k = 0 ; k < ns ; k++) {
+          float sum = 0.0f;
+          for (int m = -nw ; m <= nw ; m++) {
+            if (k-m >= 0 && k-m < ns)
+              sum += w[m+nw]*refl[k-m];
+          }
+          trace[k] = scale*sum;
+        }
+        float x = static_cast<float>(x0 + (i + 0.5)*dxy);
+        float y = static_cast<float>(y0 + (j + 0.5)*dxy);
+        segy.StoreTrace(x, y, trace, NULL);
+      }
+    }
+    segy.WriteAllTracesToFile();
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  fillRandom(FFTGrid * grid, unsigned int seed)
+  {
+    RandomGen rng(seed);
+    grid->setType(FFTGrid::PARAMETER);
+    grid->createRealGrid();
+    grid->setAccessMode(FFTGrid::WRITE);
+    for (int k = 0 ; k < grid->getNzp() ; k++) {
+      for (int j = 0 ; j < grid->getNyp() ; j++) {
+        for (int i = 0 ; i < grid->getRNxp() ; i++)
+          grid->setNextReal(static_cast<float>(rng.rnorm01()));
+      }
+    }
+    grid->endAccess();
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  benchFFT(int nx, int ny, int nz, int nRepeats)
+  {
+    int nxp = FFTGrid::findClosestFactorableNumber(nx + nx/10);
+    int nyp = FFTGrid::findClosestFactorableNumber(ny + ny/10);
+    int nzp = FFTGrid::findClosestFactorableNumber(nz + nz/5);
+
+    FFTGrid grid(nx, ny, nz, nxp, nyp, nzp);
+    fillRandom(&grid, 1);
+    grid.fftInPlace();       // Plans are made in the first call, and are not timed.
+    grid.invFFTInPlace();
+
+    double start = omp_get_wtime();
+    for (int r = 0 ; r < nRepeats ; r++) {
+      grid.fftInPlace();
+      grid.invFFTInPlace();
+    }
+    double seconds = omp_get_wtime() - start;
+
+    double mCells = static_cast<double>(nxp)*nyp*nzp/1.0e6;
+    printResult("FFTGrid::fftInPlace+invFFTInPlace", sizeString(nxp, nyp, nzp), nRepeats, seconds, 2.0*mCells, "Mcells/s");
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  benchLateralCorrelation(int nx, int ny, int nz, int nRepeats)
+  {
+    //
+    // Lateral correlation estimated from seismic, as in ModelGeneral::estimateCorrXYFromSeismic.
+    //
+    int nxp = FFTGrid::findClosestFactorableNumber(nx + nx/10);
+    int nyp = FFTGrid::findClosestFactorableNumber(ny + ny/10);
+    int nzp = FFTGrid::findClosestFactorableNumber(nz + nz/5);
+
+    FFTGrid grid(nx, ny, nz, nxp, nyp, nzp);
+    fillRandom(&grid, 5);
+    std::vector<float> corrXY(nxp*nyp, 0.0f);
+
+    double start = omp_get_wtime();
+    for (int r = 0 ; r < nRepeats ; r++) {
+      grid.setAccessMode(FFTGrid::READ);
+      grid.addLateralAutoCorrelation(&corrXY[0]);
+      grid.endAccess();
+    }
+    double seconds = omp_get_wtime() - start;
+
+    double mCells = static_cast<double>(nxp)*nyp*nzp/1.0e6;
+    printResult("FFTGrid::addLateralAutoCorrelation", sizeString(nxp, nyp, nzp), nRepeats, seconds, mCells, "Mcells/s");
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  benchPosterior(int nx, int ny, int nz, int nThreads, int nRepeats)
+  {
+    //
+    // The per-frequency posterior update in Crava::computePostMeanResidAndFFTCov, for two
+    // angle stacks and the same number of cells as a padded grid of the given size.
+    //
+    const int ntheta = 2;
+    int cnxp = FFTGrid::findClosestFactorableNumber(nx + nx/10)/2 + 1;
+    int nyp  = FFTGrid::findClosestFactorableNumber(ny + ny/10);
+    int nzp  = FFTGrid::findClosestFactorableNumber(nz + nz/5);
+
+    const double priorCov[3][3] = {{0.0014, 0.0010, 0.0003},
+                                   {0.0010, 0.0040, 0.0002},
+                                   {0.0003, 0.0002, 0.0005}};
+    const double A[ntheta][3]   = {{0.52, -0.05, 0.49},
+                                   {0.58, -0.40, 0.42}};
+
+    double start = omp_get_wtime();
+    for (int r = 0 ; r < nRepeats ; r++) {
+      #pragma omp parallel for num_threads(nThreads) schedule(dynamic, 1)
+      for (int k = 0 ; k < nzp ; k++) {
+        PosteriorBatch batch(ntheta);
+
+        fftw_complex ** K      = new fftw_complex * [ntheta];
+        fftw_complex ** errVar = new fftw_complex * [ntheta];
+        fftw_complex ** parVar = new fftw_complex * [3];
+        for (int l = 0 ; l < ntheta ; l++) {
+          K[l]      = new fftw_complex[3];
+          errVar[l] = new fftw_complex[ntheta];
+        }
+        for (int l = 0 ; l < 3 ; l++)
+          parVar[l] = new fftw_complex[3];
+        fftw_complex mean[3];
+        fftw_complex data[ntheta];
+        fftw_complex res[ntheta];
+
+        float scale = static_cast<float>(1.0 + 0.5*sin(0.1*k));
+        for (int l = 0 ; l < ntheta ; l++) {
+          for (int m = 0 ; m < 3 ; m++) {
+            K[l][m].re = static_cast<float>(scale*A[l][m]);
+            K[l][m].im = static_cast<float>(0.1*scale*A[l][m]);
+          }
+        }
+        batch.setForwardOperator(K);
+
+        for (int j = 0 ; j < nyp ; j++) {
+          for (int i0 = 0 ; i0 < cnxp ; i0 += PosteriorBatch::BATCH_SIZE) {
+            int nCells = std::min(static_cast<int>(PosteriorBatch::BATCH_SIZE), cnxp - i0);
+            for (int c = 0 ; c < nCells ; c++) {
+              float f = static_cast<float>(1.0 + 0.001*(i0 + c + j));
+              for (int l = 0 ; l < 3 ; l++) {
+                for (int m = 0 ; m < 3 ; m++) {
+                  parVar[l][m].re = static_cast<float>(f*priorCov[l][m]);
+                  parVar[l][m].im = 0.0f;
+                }
+                mean[l].re = 0.01f*f;
+                mean[l].im = 0.0f;
+              }
+              for (int l = 0 ; l < ntheta ; l++) {
+                for (int m = 0 ; m < ntheta ; m++) {
+                  errVar[l][m].re = (l == m ? 2.0e-4f : 0.5e-4f);
+                  errVar[l][m].im = 0.0f;
+                }
+                data[l].re = 0.02f*f;
+                data[l].im = -0.01f*f;
+              }
+              batch.setCell(c, parVar, errVar, mean, data);
+            }
+            batch.computePosterior(nCells);
+            for (int c = 0 ; c < nCells ; c++)
+              batch.getCell(c, parVar, mean, res);
+          }
+        }
+
+        for (int l = 0 ; l < ntheta ; l++) {
+          delete [] K[l];
+          delete [] errVar[l];
+        }
+        for (int l = 0 ; l < 3 ; l++)
+          delete [] parVar[l];
+        delete [] K;
+        delete [] errVar;
+        delete [] parVar;
+      }
+    }
+    double seconds = omp_get_wtime() - start;
+
+    double mCells = static_cast<double>(cnxp)*nyp*nzp/1.0e6;
+    printResult("PosteriorBatch::computePosterior", sizeString(cnxp, nyp, nzp), nRepeats, seconds, mCells, "Mcells/s");
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  benchSegY(int nx, int ny, int nz, int nThreads, int nRepeats)
+  {
+    //
+    // Reading a SEG-Y cube and resampling it into a padded grid, as in
+    // ModelGeneral::readSegyFile.
+    //
+    std::string fileName = "cravabench_seismic.segy";
+    writeSeismic(fileName, nx, ny, nz, 1.0f, 1);
+
+    Simbox * simbox = makeSimbox(nx, ny, nz);
+    int nxp = FFTGrid::findClosestFactorableNumber(nx + nx/10);
+    int nyp = FFTGrid::findClosestFactorableNumber(ny + ny/10);
+    int nzp = FFTGrid::findClosestFactorableNumber(nz + nz/5);
+
+    double readTime     = 0.0;
+    double resampleTime = 0.0;
+    for (int r = 0 ; r < nRepeats ; r++) {
+      double start = omp_get_wtime();
+      SegY segy(fileName, static_cast<float>(topTime - margin));
+      segy.ReadAllTraces(simbox, 2*guardZone, true, false, nThreads);
+      segy.CreateRegularGrid();
+      readTime += omp_get_wtime() - start;
+
+      start = omp_get_wtime();
+      FFTGrid grid(nx, ny, nz, nxp, nyp, nzp);
+      grid.setType(FFTGrid::DATA);
+      int missingTracesSimbox  = 0;
+      int missingTracesPadding = 0;
+      int deadTracesSimbox     = 0;
+      std::string errTxt       = "";
+      grid.fillInSeismicDataFromSegY(&segy, simbox, simbox, guardZone,
+                                     missingTracesSimbox, missingTracesPadding, deadTracesSimbox, errTxt);
+      resampleTime += omp_get_wtime() - start;
+      if (errTxt != "")
+        std::cout << errTxt;
+    }
+    printf("\n"); // After the progress bar of fillInSeismicDataFromSegY
+
+    double mBytes = static_cast<double>(NRLib::FindFileSize(fileName))/(1024.0*1024.0);
+    printResult("SegY::ReadAllTraces", sizeString(nx, ny, nz + static_cast<int>(2*margin/dt)), nRepeats, readTime, mBytes, "MB/s");
+    printResult("FFTGrid::fillInSeismicDataFromSegY", sizeString(nxp, nyp, nzp), nRepeats, resampleTime,
+                static_cast<double>(nx)*ny/1.0e3, "ktraces/s");
+
+    delete simbox;
+    NRLib::RemoveFile(fileName);
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  benchSegYWrite(int nx, int ny, int nz, int nRepeats)
+  {
+    //
+    // Writing a parameter grid as SEG-Y, as for the <segy> grid output format.
+    //
+    std::string fileName = "cravabench_output";
+    Simbox * simbox = makeSimbox(nx, ny, nz);
+    int nxp = FFTGrid::findClosestFactorableNumber(nx + nx/10);
+    int nyp = FFTGrid::findClosestFactorableNumber(ny + ny/10);
+    int nzp = FFTGrid::findClosestFactorableNumber(nz + nz/5);
+
+    FFTGrid grid(nx, ny, nz, nxp, nyp, nzp);
+    fillRandom(&grid, 4);
+
+    double start = omp_get_wtime();
+    for (int r = 0 ; r < nRepeats ; r++)
+      grid.writeSegyFile(fileName, simbox, static_cast<float>(topTime));
+    double seconds = omp_get_wtime() - start;
+
+    std::string segyName = fileName + IO::SuffixSegy();
+    double mBytes = static_cast<double>(NRLib::FindFileSize(segyName))/(1024.0*1024.0);
+    printResult("FFTGrid::writeSegyFile", sizeString(nx, ny, nz), nRepeats, seconds, mBytes, "MB/s");
+
+    delete simbox;
+    NRLib::RemoveFile(segyName);
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  benchFileGrid(int nx, int ny, int nz, int nRepeats)
+  {
+    //
+    // Loading and saving of a whole grid (random access), and streaming through the grid
+    // as the posterior computation does, with the current disk storage settings.
+    //
+    int nxp = FFTGrid::findClosestFactorableNumber(nx + nx/10);
+    int nyp = FFTGrid::findClosestFactorableNumber(ny + ny/10);
+    int nzp = FFTGrid::findClosestFactorableNumber(nz + nz/5);
+
+    FFTFileGrid grid(nx, ny, nz, nxp, nyp, nzp);
+    fillRandom(&grid, 2);
+
+    double loadSaveTime = 0.0;
+    double streamTime   = 0.0;
+    for (int r = 0 ; r < nRepeats ; r++) {
+      double start = omp_get_wtime();
+      grid.setAccessMode(FFTGrid::RANDOMACCESS);                       // load
+      grid.setRealValue(0, 0, 0, grid.getRealValue(0, 0, 0) + 1.0f);  // Mark as modified
+      grid.endAccess();                                                // save
+      loadSaveTime += omp_get_wtime() - start;
+
+      start = omp_get_wtime();
+      grid.setAccessMode(FFTGrid::READANDWRITE);
+      for (int k = 0 ; k < nzp ; k++) {
+        for (int j = 0 ; j < nyp ; j++) {
+          for (int i = 0 ; i < grid.getRNxp() ; i++)
+            grid.setNextReal(0.5f*grid.getNextReal());
+        }
+      }
+      grid.endAccess();
+      streamTime += omp_get_wtime() - start;
+    }
+
+    double mBytes = static_cast<double>(grid.getRNxp())*nyp*nzp*sizeof(float)/(1024.0*1024.0);
+    printResult("FFTFileGrid load+save", sizeString(nxp, nyp, nzp), nRepeats, loadSaveTime, 2.0*mBytes, "MB/s");
+    printResult("FFTFileGrid read-and-write stream", sizeString(nxp, nyp, nzp), nRepeats, streamTime, 2.0*mBytes, "MB/s");
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  benchKriging(int nx, int ny, int nRepeats)
+  {
+    //
+    // Kriging of a surface to 50 data points, as for each layer of the background model.
+    //
+    const int nData = 50;
+    RandomGen rng(3);
+    KrigingData2D data(nData);
+    for (int d = 0 ; d < nData ; d++) {
+      int i = static_cast<int>(rng.unif01()*nx) % nx;
+      int j = static_cast<int>(rng.unif01()*ny) % ny;
+      data.addData(i, j, static_cast<float>(3000.0 + 100.0*rng.rnorm01()));
+    }
+    data.findMeanValues();
+
+    GenExpVario vario(1.5f, static_cast<float>(20*dxy), static_cast<float>(20*dxy));
+    CovGrid2D   cov(&vario, nx, ny, dxy, dxy);
+
+    double start = omp_get_wtime();
+    for (int r = 0 ; r < nRepeats ; r++) {
+      Grid2D trend(nx, ny, 3000.0);
+      Kriging2D::krigSurface(trend, data, cov);
+    }
+    double seconds = omp_get_wtime() - start;
+
+    std::string size = NRLib::ToString(nx) + "x" + NRLib::ToString(ny) + ", " + NRLib::ToString(data.getNumberOfData()) + " data";
+    printResult("Kriging2D::krigSurface", size, nRepeats, seconds,
+                static_cast<double>(nx)*ny/1.0e6, "Mnodes/s");
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  runMicro(int nx, int ny, int nz, int nThreads)
+  {
+    FFTGrid::setNumberOfThreads(nThreads);
+
+    printf("\nMicrobenchmarks, grid %s, %d thread%s", sizeString(nx, ny, nz).c_str(), nThreads, (nThreads > 1 ? "s" : ""));
+    printHeader();
+    benchFFT(nx, ny, nz, 5);
+    benchLateralCorrelation(nx, ny, nz, 3);
+    benchPosterior(nx, ny, nz, nThreads, 3);
+    benchSegY(nx, ny, nz, nThreads, 3);
+    benchSegYWrite(nx, ny, nz, 3);
+    benchFileGrid(nx, ny, nz, 3);
+    benchKriging(nx, ny, 5);
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  writeWell(const std::string & fileName,
+            const std::string & name,
+            double              x,
+            double              y,
+            int                 nz,
+            unsigned int        seed)
+  {
+    RandomGen rng(seed);
+    std::ofstream file;
+    NRLib::OpenWrite(file, fileName);
+    file << "1.0\nUnknown\n" << name << " " << NRLib::ToString(x, 1) << " " << NRLib::ToString(y, 1) << "\n"
+         << "5\nTWT UNK lin\nVP UNK lin\nVS UNK lin\nRHO UNK lin\nFACIES DISC 0 shale 1 sand\n";
+
+    int    facies = 0;
+    double t0     = topTime - 50.0;
+    int    n      = static_cast<int>((nz*dt + 100.0)/2.0);
+    for (int k = 0 ; k < n ; k++) {
+      double t = t0 + 2.0*k;
+      if (rng.unif01() < 0.1)
+        facies = 1 - facies;
+      double vp  = (3100.0 - 300.0*facies)*exp(0.04*rng.rnorm01());
+      double vs  = (1650.0 - 100.0*facies)*exp(0.05*rng.rnorm01());
+      double rho = (2.35   - 0.10*facies)*exp(0.02*rng.rnorm01());
+      file << NRLib::ToString(x, 1) << " " << NRLib::ToString(y, 1) << " " << NRLib::ToString(1500.0 + 1.5*t, 1) << " "
+           << NRLib::ToString(t, 2) << " " << NRLib::ToString(vp, 2) << " " << NRLib::ToString(vs, 2) << " "
+           << NRLib::ToString(rho, 4) << " " << facies << "\n";
+    }
+    file.close();
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  writeCase(const std::string & directory,
+            int                 nx,
+            int                 ny,
+            int                 nz,
+            int                 nWells,
+            int                 nThreads)
+  {
+    std::string path = directory + "/";
+    NRLib::CreateDirIfNotExists(path + "output/");
+
+    printf("\nWriting synthetic case to %s: grid %s, %d wells\n", path.c_str(), sizeString(nx, ny, nz).c_str(), nWells);
+
+    writeSeismic(path + "seismic_10.segy", nx, ny, nz, 1.0f, 11);
+    writeSeismic(path + "seismic_30.segy", nx, ny, nz, 0.8f, 12);
+
+    std::string wells = "";
+    for (int w = 0 ; w < nWells ; w++) {
+      int    i    = 2 + (w*17) % std::max(1, nx - 4);
+      int    j    = 2 + (w*11) % std::max(1, ny - 4);
+      double x    = x0 + (i + 0.5)*dxy + 3.0;
+      double y    = y0 + (j + 0.5)*dxy + 4.0;
+      std::string name = "well_" + NRLib::ToString(w) + ".rms";
+      writeWell(path + name, "W" + NRLib::ToString(w), x, y, nz, 100 + w);
+      wells += "   <well><file-name>" + name + "</file-name></well>\n";
+    }
+
+    std::ofstream file;
+    NRLib::OpenWrite(file, path + "model.xml");
+    file << "<crava>\n"
+         << " <actions>\n"
+         << "  <mode>inversion</mode>\n"
+         << "  <inversion-settings>\n"
+         << "   <prediction>yes</prediction>\n"
+         << "   <simulation><number-of-simulations>2</number-of-simulations></simulation>\n"
+         << "   <facies-probabilities>yes</facies-probabilities>\n"
+         << "  </inversion-settings>\n"
+         << " </actions>\n"
+         << " <well-data>\n"
+         << "  <log-names><time>TWT</time><vp>VP</vp><vs>VS</vs><density>RHO</density><facies>FACIES</facies></log-names>\n"
+         << wells
+         << " </well-data>\n"
+         << " <survey>\n"
+         << "  <segy-start-time>" << topTime - margin << "</segy-start-time>\n";
+    const char * angles[2] = {"10", "30"};
+    for (int a = 0 ; a < 2 ; a++) {
+      file << "  <angle-gather>\n"
+           << "   <offset-angle>" << angles[a] << "</offset-angle>\n"
+           << "   <seismic-data><file-name>seismic_" << angles[a] << ".segy</file-name></seismic-data>\n"
+           << "   <wavelet><ricker>30</ricker></wavelet>\n"
+           << "   <signal-to-noise-ratio>5</signal-to-noise-ratio>\n"
+           << "  </angle-gather>\n";
+    }
+    file << " </survey>\n"
+         << " <prior-model>\n"
+         << "  <lateral-correlation><variogram-type>genexp</variogram-type><angle>0</angle><range>500</range>"
+         << "<subrange>500</subrange><power>1.5</power></lateral-correlation>\n"
+         << "  <temporal-correlation-range>40</temporal-correlation-range>\n"
+         << "  <facies-probabilities><prior-probabilities>\n"
+         << "   <facies><name>shale</name><probability>0.6</probability></facies>\n"
+         << "   <facies><name>sand</name><probability>0.4</probability></facies>\n"
+         << "  </prior-probabilities></facies-probabilities>\n"
+         << " </prior-model>\n"
+         << " <project-settings>\n"
+         << "  <output-volume>\n"
+         << "   <interval-two-surfaces>\n"
+         << "    <top-surface><time-value>" << topTime << "</time-value></top-surface>\n"
+         << "    <base-surface><time-value>" << topTime + nz*dt << "</time-value></base-surface>\n"
+         << "    <number-of-layers>" << nz << "</number-of-layers>\n"
+         << "   </interval-two-surfaces>\n"
+         << "  </output-volume>\n"
+         << "  <io-settings>\n"
+         << "   <output-directory>output</output-directory>\n"
+         << "   <other-output><timings>yes</timings></other-output>\n"
+         << "  </io-settings>\n"
+         << "  <advanced-settings><number-of-threads>" << nThreads << "</number-of-threads></advanced-settings>\n"
+         << " </project-settings>\n"
+         << "</crava>\n";
+    file.close();
+  }
+
+  //-----------------------------------------------------------------------
+  void
+  readSize(int argc, char ** argv, int first, int & nx, int & ny, int & nz)
+  {
+    if (argc > first + 2) {
+      nx = atoi(argv[first]);
+      ny = atoi(argv[first + 1]);
+      nz = atoi(argv[first + 2]);
+    }
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  LogKit::SetScreenLog(LogKit::L_Error);
+
+  int nx = 100;
+  int ny = 100;
+  int nz = 100;
+
+  std::string mode = (argc > 1 ? argv[1] : "");
+
+  if (mode == "micro") {
+    readSize(argc, argv, 2, nx, ny, nz);
+    int nThreads = (argc > 5 ? atoi(argv[5]) : omp_get_max_threads());
+    if (nx < 10 || ny < 10 || nz < 10 || nThreads < 1) {
+      std::cout << "The grid must be at least 10x10x10, and there must be at least one thread.\n";
+      return(1);
+    }
+    runMicro(nx, ny, nz, nThreads);
+  }
+  else if (mode == "case" && argc > 2) {
+    readSize(argc, argv, 3, nx, ny, nz);
+    int nWells   = (argc > 6 ? atoi(argv[6]) : 6);
+    int nThreads = (argc > 7 ? atoi(argv[7]) : omp_get_max_threads());
+    if (nx < 10 || ny < 10 || nz < 10 || nWells < 1 || nThreads < 1) {
+      std::cout << "The grid must be at least 10x10x10, and there must be at least one well and one thread.\n";
+      return(1);
+    }
+    writeCase(argv[2], nx, ny, nz, nWells, nThreads);
+  }
+  else {
+    std::cout << "Usage: cravabench micro [nx ny nz [nThreads]]\n"
+              << "       cravabench case <directory> [nx ny nz [nWells [nThreads]]]\n";
+    return(1);
+  }
+
+  LogKit::EndLog();
+  return(0);
+}
@@ -151,7 +151,7 @@ fftw_time fftw_gettimeofday_get_time(void)
      /*-Nils-Henrik (Roxar) This wouldn't link on Windows
       *-commenting it out for now     
       */
-#if 0
+#if !defined(_WIN32)
      gettimeofday(&tv, 0);
 #endif
      return tv;
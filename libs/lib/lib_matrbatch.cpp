@@ -0,0 +1,566 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <math.h>
+
+#include "lib/lib_matrbatch.h"
+#include "lib/lib_matr.h"
+
+namespace
+{
+  const int    B   = PosteriorBatch::BATCH_SIZE;
+  const double TOL = 1e-20; // Same tolerance as in lib_matrCholCpx
+
+  //-----------------------------------------------------------------------
+  template <int N>
+  void
+  batchCholCpx(float re[N][N][B],
+               float im[N][N][B],
+               int   ok[B])
+  {
+    //
+    // Batched lib_matrCholCpx. The lower triangle of each cell is replaced by its
+    // Cholesky factor, and ok is set to 0 for cells where lib_matrCholCpx fails.
+    //
+    float factor[B];
+    for (int c = 0 ; c < B ; c++) {
+      factor[c] = re[0][0][c];
+      ok[c]     = !(factor[c] <= 0);
+    }
+    for (int i = 0 ; i < N ; i++) {
+      for (int j = 0 ; j < N ; j++) {
+        for (int c = 0 ; c < B ; c++) {
+          re[i][j][c] = re[i][j][c]/factor[c];
+          im[i][j][c] = im[i][j][c]/factor[c];
+        }
+      }
+    }
+
+    for (int i = 0 ; i < N ; i++) {
+      for (int c = 0 ; c < B ; c++)
+        ok[c] &= !(re[i][i][c] <= TOL);
+
+      for (int j = 0 ; j < i ; j++) {
+        for (int c = 0 ; c < B ; c++) {
+          float lRe = 0.0f;
+          float lIm = 0.0f;
+          for (int k = 0 ; k < j ; k++) {
+            lRe +=  (re[i][k][c]*re[j][k][c]) + (im[i][k][c]*im[j][k][c]);
+            lIm += -(re[i][k][c]*im[j][k][c]) + (im[i][k][c]*re[j][k][c]);
+          }
+          float help  = re[j][j][c]*re[j][j][c] + im[j][j][c]*im[j][j][c];
+          re[i][j][c] = ((re[i][j][c] - lRe)*re[j][j][c] + (im[i][j][c] - lIm)*im[j][j][c])/help;
+          im[i][j][c] = ((im[i][j][c] - lIm)*re[j][j][c] - (re[i][j][c] - lRe)*im[j][j][c])/help;
+        }
+      }
+      for (int c = 0 ; c < B ; c++) {
+        float lRe = 0.0f;
+        for (int k = 0 ; k < i ; k++)
+          lRe += (re[i][k][c]*re[i][k][c]) + (im[i][k][c]*im[i][k][c]);
+        lRe = re[i][i][c] - lRe;
+        ok[c] &= !(lRe <= TOL);
+        re[i][i][c] = static_cast<float>(sqrt(static_cast<double>(lRe)));
+        im[i][i][c] = 0.0f;
+      }
+    }
+
+    for (int c = 0 ; c < B ; c++)
+      factor[c] = static_cast<float>(sqrt(static_cast<double>(factor[c])));
+    for (int i = 0 ; i < N ; i++) {
+      for (int j = 0 ; j <= i ; j++) {
+        for (int c = 0 ; c < B ; c++) {
+          re[i][j][c] *= factor[c];
+          im[i][j][c] *= factor[c];
+        }
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------
+PosteriorBatch::PosteriorBatch(int ntheta)
+  : ntheta_(ntheta),
+    KRe_(ntheta*3, 0.0f),
+    KIm_(ntheta*3, 0.0f),
+    SRe_(3*3*BATCH_SIZE, 0.0f),
+    SIm_(3*3*BATCH_SIZE, 0.0f),
+    ERe_(ntheta*ntheta*BATCH_SIZE, 0.0f),
+    EIm_(ntheta*ntheta*BATCH_SIZE, 0.0f),
+    mRe_(3*BATCH_SIZE, 0.0f),
+    mIm_(3*BATCH_SIZE, 0.0f),
+    dRe_(ntheta*BATCH_SIZE, 0.0f),
+    dIm_(ntheta*BATCH_SIZE, 0.0f)
+{
+}
+
+//-----------------------------------------------------------------------
+void
+PosteriorBatch::setForwardOperator(fftw_complex ** K)
+{
+  for (int l = 0 ; l < ntheta_ ; l++) {
+    for (int q = 0 ; q < 3 ; q++) {
+      KRe_[l*3 + q] = K[l][q].re;
+      KIm_[l*3 + q] = K[l][q].im;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------
+void
+PosteriorBatch::setCell(int                  c,
+                        fftw_complex      ** parVar,
+                        fftw_complex      ** errVar,
+                        const fftw_complex * mean,
+                        const fftw_complex * data)
+{
+  for (int i = 0 ; i < 3 ; i++) {
+    for (int j = 0 ; j < 3 ; j++) {
+      SRe_[idx(i, j, 3, c)] = parVar[i][j].re;
+      SIm_[idx(i, j, 3, c)] = parVar[i][j].im;
+    }
+    mRe_[i*BATCH_SIZE + c] = mean[i].re;
+    mIm_[i*BATCH_SIZE + c] = mean[i].im;
+  }
+  for (int l = 0 ; l < ntheta_ ; l++) {
+    for (int m = 0 ; m < ntheta_ ; m++) {
+      ERe_[idx(l, m, ntheta_, c)] = errVar[l][m].re;
+      EIm_[idx(l, m, ntheta_, c)] = errVar[l][m].im;
+    }
+    dRe_[l*BATCH_SIZE + c] = data[l].re;
+    dIm_[l*BATCH_SIZE + c] = data[l].im;
+  }
+}
+
+//-----------------------------------------------------------------------
+void
+PosteriorBatch::getCell(int             c,
+                        fftw_complex ** parVar,
+                        fftw_complex  * mean,
+                        fftw_complex  * res) const
+{
+  for (int i = 0 ; i < 3 ; i++) {
+    for (int j = 0 ; j < 3 ; j++) {
+      parVar[i][j].re = SRe_[idx(i, j, 3, c)];
+      parVar[i][j].im = SIm_[idx(i, j, 3, c)];
+    }
+    mean[i].re = mRe_[i*BATCH_SIZE + c];
+    mean[i].im = mIm_[i*BATCH_SIZE + c];
+  }
+  for (int l = 0 ; l < ntheta_ ; l++) {
+    res[l].re = dRe_[l*BATCH_SIZE + c];
+    res[l].im = dIm_[l*BATCH_SIZE + c];
+  }
+}
+
+//-----------------------------------------------------------------------
+void
+PosteriorBatch::computePosterior(int nCells)
+{
+  switch (ntheta_) {
+  case 1: computePosteriorFixedSize<1>(nCells); break;
+  case 2: computePosteriorFixedSize<2>(nCells); break;
+  case 3: computePosteriorFixedSize<3>(nCells); break;
+  case 4: computePosteriorFixedSize<4>(nCells); break;
+  case 5: computePosteriorFixedSize<5>(nCells); break;
+  case 6: computePosteriorFixedSize<6>(nCells); break;
+  case 7: computePosteriorFixedSize<7>(nCells); break;
+  case 8: computePosteriorFixedSize<8>(nCells); break;
+  default: computePosteriorGeneral(nCells);
+  }
+}
+
+//-----------------------------------------------------------------------
+template <int NT>
+void
+PosteriorBatch::computePosteriorFixedSize(int /*nCells*/)
+{
+  //
+  // Same steps as the lib_matr sequence in the posterior computation, with S = parVar,
+  // E = errVar and K the forward operator:
+  //
+  //   M    = K S K' + E,  L = chol(M)
+  //   S   <- S - (KS)' M^-1 (KS)
+  //   mean = mean + (M^-1 KS)' (data - K mean)
+  //   res  = data - K mean
+  //
+  // All BATCH_SIZE cells are computed, as this vectorises better. Unused cells are never read.
+  //
+  float K[NT][3][2];
+  for (int l = 0 ; l < NT ; l++) {
+    for (int q = 0 ; q < 3 ; q++) {
+      K[l][q][0] = KRe_[l*3 + q];
+      K[l][q][1] = KIm_[l*3 + q];
+    }
+  }
+
+  float SRe[3][3][B], SIm[3][3][B];
+  for (int i = 0 ; i < 3 ; i++) {
+    for (int j = 0 ; j < 3 ; j++) {
+      for (int c = 0 ; c < B ; c++) {
+        SRe[i][j][c] = SRe_[idx(i, j, 3, c)];
+        SIm[i][j][c] = SIm_[idx(i, j, 3, c)];
+      }
+    }
+  }
+
+  // KS = K*S
+  float KSRe[NT][3][B], KSIm[NT][3][B];
+  for (int l = 0 ; l < NT ; l++) {
+    for (int m = 0 ; m < 3 ; m++) {
+      for (int c = 0 ; c < B ; c++) {
+        float xRe = 0.0f;
+        float xIm = 0.0f;
+        for (int q = 0 ; q < 3 ; q++) {
+          xRe += K[l][q][0]*SRe[q][m][c] - K[l][q][1]*SIm[q][m][c];
+          xIm += K[l][q][1]*SRe[q][m][c] + K[l][q][0]*SIm[q][m][c];
+        }
+        KSRe[l][m][c] = xRe;
+        KSIm[l][m][c] = xIm;
+      }
+    }
+  }
+
+  // M = KS*K' + E
+  float MRe[NT][NT][B], MIm[NT][NT][B];
+  for (int l = 0 ; l < NT ; l++) {
+    for (int m = 0 ; m < NT ; m++) {
+      for (int c = 0 ; c < B ; c++) {
+        float xRe = 0.0f;
+        float xIm = 0.0f;
+        for (int q = 0 ; q < 3 ; q++) {
+          xRe += KSRe[l][q][c]*K[m][q][0] + KSIm[l][q][c]*K[m][q][1];
+          xIm += KSIm[l][q][c]*K[m][q][0] - KSRe[l][q][c]*K[m][q][1];
+        }
+        MRe[l][m][c] = xRe + ERe_[idx(l, m, NT, c)];
+        MIm[l][m][c] = xIm + EIm_[idx(l, m, NT, c)];
+      }
+    }
+  }
+
+  int ok[B];
+  batchCholCpx<NT>(MRe, MIm, ok);
+
+  // X = M^-1 KS, column by column (forward and backward substitution)
+  float XRe[NT][3][B], XIm[NT][3][B];
+  for (int l = 0 ; l < NT ; l++) {
+    for (int m = 0 ; m < 3 ; m++) {
+      for (int c = 0 ; c < B ; c++) {
+        XRe[l][m][c] = KSRe[l][m][c];
+        XIm[l][m][c] = KSIm[l][m][c];
+      }
+    }
+  }
+  for (int m = 0 ; m < 3 ; m++) {
+    for (int i = 0 ; i < NT ; i++) {
+      for (int c = 0 ; c < B ; c++) {
+        float xRe = XRe[i][m][c];
+        float xIm = XIm[i][m][c];
+        for (int j = 0 ; j < i ; j++) {
+          xRe -= (XRe[j][m][c]*MRe[i][j][c] - XIm[j][m][c]*MIm[i][j][c]);
+          xIm -= (XIm[j][m][c]*MRe[i][j][c] + XRe[j][m][c]*MIm[i][j][c]);
+        }
+        float help   = MRe[i][i][c]*MRe[i][i][c] + MIm[i][i][c]*MIm[i][i][c];
+        XRe[i][m][c] = (xRe*MRe[i][i][c] + xIm*MIm[i][i][c])/help;
+        XIm[i][m][c] = (xIm*MRe[i][i][c] - xRe*MIm[i][i][c])/help;
+      }
+    }
+    for (int i = NT - 1 ; i >= 0 ; i--) {
+      for (int c = 0 ; c < B ; c++) {
+        float xRe = XRe[i][m][c];
+        float xIm = XIm[i][m][c];
+        for (int j = NT - 1 ; j > i ; j--) {
+          xRe = xRe - (XRe[j][m][c]*MRe[j][i][c] + XIm[j][m][c]*MIm[j][i][c]);
+          xIm = xIm - (-XRe[j][m][c]*MIm[j][i][c] + XIm[j][m][c]*MRe[j][i][c]);
+        }
+        float help   = MRe[i][i][c]*MRe[i][i][c] + MIm[i][i][c]*MIm[i][i][c];
+        XRe[i][m][c] = (xRe*MRe[i][i][c] - xIm*MIm[i][i][c])/help;
+        XIm[i][m][c] = (xIm*MRe[i][i][c] + xRe*MIm[i][i][c])/help;
+      }
+    }
+  }
+
+  // S = S - (KS)'X
+  for (int i = 0 ; i < 3 ; i++) {
+    for (int j = 0 ; j < 3 ; j++) {
+      for (int c = 0 ; c < B ; c++) {
+        float xRe = 0.0f;
+        float xIm = 0.0f;
+        for (int k = 0 ; k < NT ; k++) {
+          xRe +=  KSRe[k][i][c]*XRe[k][j][c] + KSIm[k][i][c]*XIm[k][j][c];
+          xIm += -KSIm[k][i][c]*XRe[k][j][c] + KSRe[k][i][c]*XIm[k][j][c];
+        }
+        if (ok[c]) {
+          SRe_[idx(i, j, 3, c)] = SRe[i][j][c] - xRe;
+          SIm_[idx(i, j, 3, c)] = SIm[i][j][c] - xIm;
+        }
+      }
+    }
+  }
+
+  // dataMean = K*mean, data = data - dataMean
+  float dRe[NT][B], dIm[NT][B];
+  for (int l = 0 ; l < NT ; l++) {
+    for (int c = 0 ; c < B ; c++) {
+      float xRe = 0.0f;
+      float xIm = 0.0f;
+      for (int q = 0 ; q < 3 ; q++) {
+        xRe += K[l][q][0]*mRe_[q*B + c] - K[l][q][1]*mIm_[q*B + c];
+        xIm += K[l][q][1]*mRe_[q*B + c] + K[l][q][0]*mIm_[q*B + c];
+      }
+      dRe[l][c] = dRe_[l*B + c] - xRe;
+      dIm[l][c] = dIm_[l*B + c] - xIm;
+    }
+  }
+
+  // mean = mean + X'*data
+  float mRe[3][B], mIm[3][B];
+  for (int i = 0 ; i < 3 ; i++) {
+    for (int c = 0 ; c < B ; c++) {
+      float xRe = 0.0f;
+      float xIm = 0.0f;
+      for (int j = 0 ; j < NT ; j++) {
+        xRe +=  XRe[j][i][c]*dRe[j][c] + XIm[j][i][c]*dIm[j][c];
+        xIm += -XIm[j][i][c]*dRe[j][c] + XRe[j][i][c]*dIm[j][c];
+      }
+      mRe[i][c] = mRe_[i*B + c] + xRe;
+      mIm[i][c] = mIm_[i*B + c] + xIm;
+    }
+  }
+
+  // res = data - K*mean
+  for (int l = 0 ; l < NT ; l++) {
+    for (int c = 0 ; c < B ; c++) {
+      float xRe = 0.0f;
+      float xIm = 0.0f;
+      for (int q = 0 ; q < 3 ; q++) {
+        xRe += K[l][q][0]*mRe[q][c] - K[l][q][1]*mIm[q][c];
+        xIm += K[l][q][1]*mRe[q][c] + K[l][q][0]*mIm[q][c];
+      }
+      if (ok[c]) {
+        dRe_[l*B + c] = dRe_[l*B + c] - xRe;
+        dIm_[l*B + c] = dIm_[l*B + c] - xIm;
+      }
+    }
+  }
+
+  for (int i = 0 ; i < 3 ; i++) {
+    for (int c = 0 ; c < B ; c++) {
+      if (ok[c]) {
+        mRe_[i*B + c] = mRe[i][c];
+        mIm_[i*B + c] = mIm[i][c];
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------
+void
+PosteriorBatch::computePosteriorGeneral(int nCells)
+{
+  //
+  // Cell by cell with lib_matr, for more angles than the fixed-size kernels handle.
+  //
+  int i, l;
+  fftw_complex ** K         = new fftw_complex * [ntheta_];
+  fftw_complex ** KS        = new fftw_complex * [ntheta_];
+  fftw_complex ** KScc      = new fftw_complex * [3];
+  fftw_complex ** parVar    = new fftw_complex * [3];
+  fftw_complex ** margVar   = new fftw_complex * [ntheta_];
+  fftw_complex ** errVar    = new fftw_complex * [ntheta_];
+  fftw_complex ** reduceVar = new fftw_complex * [3];
+  for (l = 0 ; l < ntheta_ ; l++) {
+    K[l]       = new fftw_complex[3];
+    KS[l]      = new fftw_complex[3];
+    margVar[l] = new fftw_complex[ntheta_];
+    errVar[l]  = new fftw_complex[ntheta_];
+  }
+  for (i = 0 ; i < 3 ; i++) {
+    KScc[i]      = new fftw_complex[ntheta_];
+    parVar[i]    = new fftw_complex[3];
+    reduceVar[i] = new fftw_complex[3];
+  }
+  fftw_complex * mean     = new fftw_complex[3];
+  fftw_complex * ans      = new fftw_complex[3];
+  fftw_complex * data     = new fftw_complex[ntheta_];
+  fftw_complex * dataMean = new fftw_complex[ntheta_];
+  fftw_complex * res      = new fftw_complex[ntheta_];
+
+  for (l = 0 ; l < ntheta_ ; l++) {
+    for (int q = 0 ; q < 3 ; q++) {
+      K[l][q].re = KRe_[l*3 + q];
+      K[l][q].im = KIm_[l*3 + q];
+    }
+  }
+
+  for (int c = 0 ; c < nCells ; c++) {
+    for (i = 0 ; i < 3 ; i++) {
+      for (int j = 0 ; j < 3 ; j++) {
+        parVar[i][j].re = SRe_[idx(i, j, 3, c)];
+        parVar[i][j].im = SIm_[idx(i, j, 3, c)];
+      }
+      mean[i].re = mRe_[i*BATCH_SIZE + c];
+      mean[i].im = mIm_[i*BATCH_SIZE + c];
+    }
+    for (l = 0 ; l < ntheta_ ; l++) {
+      for (int m = 0 ; m < ntheta_ ; m++) {
+        errVar[l][m].re = ERe_[idx(l, m, ntheta_, c)];
+        errVar[l][m].im = EIm_[idx(l, m, ntheta_, c)];
+      }
+      data[l].re = dRe_[l*BATCH_SIZE + c];
+      data[l].im = dIm_[l*BATCH_SIZE + c];
+      res[l]     = data[l];
+    }
+
+    lib_matrProdCpx(K, parVar, ntheta_, 3, 3, KS);
+    lib_matrProdAdjointCpx(KS, K, ntheta_, 3, ntheta_, margVar);
+    lib_matrAddMatCpx(errVar, ntheta_, ntheta_, margVar);
+
+    if (lib_matrCholCpx(ntheta_, margVar) == 0) {
+      lib_matrAdjoint(KS, ntheta_, 3, KScc);
+      lib_matrAXeqBMatCpx(ntheta_, margVar, KS, 3);
+      lib_matrProdCpx(KScc, KS, 3, ntheta_, 3, reduceVar);
+      lib_matrSubtMatCpx(reduceVar, 3, 3, parVar);
+
+      lib_matrProdMatVecCpx(K, mean, ntheta_, 3, dataMean);
+      lib_matrSubtVecCpx(dataMean, ntheta_, data);
+      lib_matrProdAdjointMatVecCpx(KS, data, 3, ntheta_, ans);
+      lib_matrAddVecCpx(ans, 3, mean);
+      lib_matrProdMatVecCpx(K, mean, ntheta_, 3, data);
+      lib_matrSubtVecCpx(data, ntheta_, res);
+
+      for (i = 0 ; i < 3 ; i++) {
+        for (int j = 0 ; j < 3 ; j++) {
+          SRe_[idx(i, j, 3, c)] = parVar[i][j].re;
+          SIm_[idx(i, j, 3, c)] = parVar[i][j].im;
+        }
+        mRe_[i*BATCH_SIZE + c] = mean[i].re;
+        mIm_[i*BATCH_SIZE + c] = mean[i].im;
+      }
+      for (l = 0 ; l < ntheta_ ; l++) {
+        dRe_[l*BATCH_SIZE + c] = res[l].re;
+        dIm_[l*BATCH_SIZE + c] = res[l].im;
+      }
+    }
+  }
+
+  for (l = 0 ; l < ntheta_ ; l++) {
+    delete [] K[l];
+    delete [] KS[l];
+    delete [] margVar[l];
+    delete [] errVar[l];
+  }
+  for (i = 0 ; i < 3 ; i++) {
+    delete [] KScc[i];
+    delete [] parVar[i];
+    delete [] reduceVar[i];
+  }
+  delete [] K;
+  delete [] KS;
+  delete [] KScc;
+  delete [] parVar;
+  delete [] margVar;
+  delete [] errVar;
+  delete [] reduceVar;
+  delete [] mean;
+  delete [] ans;
+  delete [] data;
+  delete [] dataMean;
+  delete [] res;
+}
+
+//-----------------------------------------------------------------------
+CholeskyVecBatch::CholeskyVecBatch()
+{
+  for (int i = 0 ; i < 3 ; i++) {
+    for (int c = 0 ; c < BATCH_SIZE ; c++) {
+      for (int j = 0 ; j < 3 ; j++) {
+        matRe_[i][j][c] = 0.0f;
+        matIm_[i][j][c] = 0.0f;
+      }
+      vecRe_[i][c] = 0.0f;
+      vecIm_[i][c] = 0.0f;
+    }
+  }
+  for (int c = 0 ; c < BATCH_SIZE ; c++)
+    ok_[c] = 0;
+}
+
+//-----------------------------------------------------------------------
+void
+CholeskyVecBatch::setCell(int                  c,
+                          fftw_complex      ** mat,
+                          const fftw_complex  * vec)
+{
+  for (int i = 0 ; i < 3 ; i++) {
+    for (int j = 0 ; j < 3 ; j++) {
+      matRe_[i][j][c] = mat[i][j].re;
+      matIm_[i][j][c] = mat[i][j].im;
+    }
+    vecRe_[i][c] = vec[i].re;
+    vecIm_[i][c] = vec[i].im;
+  }
+}
+
+//-----------------------------------------------------------------------
+void
+CholeskyVecBatch::computeProduct(int nCells)
+{
+  //
+  // Batched lib_matrCholCpx followed by lib_matrProdCholVec.
+  //
+  factorize(nCells);
+  multiplyFactor(nCells);
+}
+
+//-----------------------------------------------------------------------
+void
+CholeskyVecBatch::factorize(int /*nCells*/)
+{
+  batchCholCpx<3>(matRe_, matIm_, ok_);
+}
+
+//-----------------------------------------------------------------------
+void
+CholeskyVecBatch::setVector(int                  c,
+                            const fftw_complex  * vec)
+{
+  for (int i = 0 ; i < 3 ; i++) {
+    vecRe_[i][c] = vec[i].re;
+    vecIm_[i][c] = vec[i].im;
+  }
+}
+
+//-----------------------------------------------------------------------
+void
+CholeskyVecBatch::multiplyFactor(int /*nCells*/)
+{
+  float xRe[3][B], xIm[3][B];
+  for (int i = 0 ; i < 3 ; i++) {
+    for (int c = 0 ; c < B ; c++) {
+      xRe[i][c] = 0.0f;
+      xIm[i][c] = 0.0f;
+      for (int j = 0 ; j < i + 1 ; j++) {
+        xRe[i][c] += matRe_[i][j][c]*vecRe_[j][c] - matIm_[i][j][c]*vecIm_[j][c];
+        xIm[i][c] += matRe_[i][j][c]*vecIm_[j][c] + matIm_[i][j][c]*vecRe_[j][c];
+      }
+    }
+  }
+  for (int i = 0 ; i < 3 ; i++) {
+    for (int c = 0 ; c < B ; c++) {
+      vecRe_[i][c] = ok_[c] ? xRe[i][c] : 0.0f;
+      vecIm_[i][c] = ok_[c] ? xIm[i][c] : 0.0f;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------
+void
+CholeskyVecBatch::getCell(int            c,
+                          fftw_complex * vec) const
+{
+  for (int i = 0 ; i < 3 ; i++) {
+    vec[i].re = vecRe_[i][c];
+    vec[i].im = vecIm_[i][c];
+  }
+}
@@ -0,0 +1,98 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef LIB_MATRBATCH_H
+#define LIB_MATRBATCH_H
+
+#include <vector>
+
+#include "fftw.h"
+
+// Batched versions of the small complex matrix operations done per frequency cell in the
+// posterior computation and in the simulation. A batch holds up to BATCH_SIZE cells stored
+// as structure-of-arrays, so the innermost loops run over cells and are vectorised by the
+// compiler. Each cell is computed with the same operations, in the same order, as the
+// corresponding lib_matr functions.
+
+class PosteriorBatch
+{
+public:
+  enum { BATCH_SIZE = 8, MAX_THETA = 8 };
+
+  PosteriorBatch(int ntheta);
+
+  // Forward operator K (ntheta x 3), common for all cells in the batch.
+  void             setForwardOperator(fftw_complex ** K);
+
+  // Prior covariance (3x3), error covariance (ntheta x ntheta), prior mean (3) and data (ntheta).
+  void             setCell(int              c,
+                           fftw_complex  ** parVar,
+                           fftw_complex  ** errVar,
+                           const fftw_complex * mean,
+                           const fftw_complex * data);
+
+  // Posterior covariance, mean and residual. Where K S K' + E is not positive
+  // definite, the prior covariance and mean are returned, and the residual is the data.
+  void             computePosterior(int nCells);
+
+  void             getCell(int              c,
+                           fftw_complex  ** parVar,
+                           fftw_complex   * mean,
+                           fftw_complex   * res) const;
+
+private:
+  template <int NT>
+  void             computePosteriorFixedSize(int nCells);
+  void             computePosteriorGeneral(int nCells);
+
+  int              idx(int i, int j, int n, int c) const { return((i*n + j)*BATCH_SIZE + c) ;}
+
+  int                ntheta_;
+
+  std::vector<float> KRe_;    // ntheta x 3
+  std::vector<float> KIm_;
+  std::vector<float> SRe_;    // 3 x 3 x BATCH_SIZE
+  std::vector<float> SIm_;
+  std::vector<float> ERe_;    // ntheta x ntheta x BATCH_SIZE
+  std::vector<float> EIm_;
+  std::vector<float> mRe_;    // 3 x BATCH_SIZE
+  std::vector<float> mIm_;
+  std::vector<float> dRe_;    // ntheta x BATCH_SIZE, data on input, residual on output
+  std::vector<float> dIm_;
+};
+
+class CholeskyVecBatch
+{
+public:
+  enum { BATCH_SIZE = 8 };
+
+  CholeskyVecBatch();
+
+  // Hermitian 3x3 matrix and 3-vector.
+  void             setCell(int                  c,
+                           fftw_complex      ** mat,
+                           const fftw_complex  * vec);
+
+  // vec = L*vec where L is the Cholesky factor of mat, or vec = 0 where mat is not positive definite.
+  void             computeProduct(int nCells);
+
+  // computeProduct split in two, so that the factors are found once and applied to
+  // several vectors. Vectors are set with setVector after factorize.
+  void             factorize(int nCells);
+  void             setVector(int                  c,
+                             const fftw_complex  * vec);
+  void             multiplyFactor(int nCells);
+
+  void             getCell(int            c,
+                           fftw_complex * vec) const;
+
+private:
+  float            matRe_[3][3][BATCH_SIZE];
+  float            matIm_[3][3][BATCH_SIZE];
+  float            vecRe_[3][BATCH_SIZE];
+  float            vecIm_[3][BATCH_SIZE];
+  int              ok_[BATCH_SIZE];
+};
+
+#endif
@@ -4,25 +4,39 @@
 
 #include <iostream>
 
+#if !defined(_WIN32)
+#include <sys/time.h>
+#endif
+
 #include "lib/timekit.hpp"
 
 void
 TimeKit::getTime(double& wall, double& cpu)
 {
-  time_t  tmpwall = time(NULL);
+#if !defined(_WIN32)
+  // Wall time with sub-second resolution, so short tasks can be timed too.
+  struct timeval tv;
+  double  tmpwall = -1.0;
+  if (gettimeofday(&tv, NULL) == 0)
+    tmpwall = static_cast<double>(tv.tv_sec) + 1.0e-6*static_cast<double>(tv.tv_usec);
+  if (tmpwall < 0.0)                       std::cerr << "Unable to get gettimeofday()\n";
+#else
+  time_t  tmpt    = time(NULL);
+  double  tmpwall = static_cast<double>(tmpt);
+  if (tmpt    == static_cast<time_t>(-1))  std::cerr << "Unable to get time()\n";
+#endif
   clock_t tmpcpu  = clock();
 
-  if (tmpwall == static_cast<time_t>(-1))  std::cerr << "Unable to get time()\n";
   if (tmpcpu  == static_cast<clock_t>(-1)) std::cerr << "Unable to get clock()\n";
 
   if (wall==0 && cpu==0)
   {
-    wall = static_cast<double>(tmpwall);
+    wall = tmpwall;
     cpu  = static_cast<double>(tmpcpu);
   }
   else
   {
-    wall = static_cast<double>(tmpwall) - wall;
+    wall = tmpwall - wall;
     cpu  = (static_cast<double>(tmpcpu)  - cpu)/CLOCKS_PER_SEC;
   }
 }
@@ -76,6 +76,39 @@ void NRLib::CholeskySolve(const SymmetricMatrix & A,
   }
 }
 
+//--------------------------------------------------
+void NRLib::CholeskyFactorize(SymmetricMatrix & A)
+//--------------------------------------------------
+{
+  int info = flens::potrf(A.upLo(), A.dim(), A.data(), A.leadingDimension());
+  if (info != 0) {
+    std::ostringstream oss;
+    if (info < 0) {
+      oss << "Internal FLENS/Lapack error: Error in argument " << -info
+          << " of potrf call.";
+    }
+    else {  // info > 0
+      oss << "Error in Cholesky: The leading minor of order " << info
+          << " is not positive definite.";
+    }
+    throw Exception(oss.str());
+  }
+}
+
+//--------------------------------------------------
+void NRLib::CholeskySolveFactorized(SymmetricMatrix & L,
+                                    Matrix          & B) // This is also where the solution is stored
+//--------------------------------------------------
+{
+  int info = flens::potrs(L, B);
+  if (info != 0) {
+    std::ostringstream oss;
+    oss << "Internal FLENS/Lapack error: Error in argument " << -info
+        << " of potrs call.";
+    throw Exception(oss.str());
+  }
+}
+
 //---------------------------------------------------------
 void NRLib::CholeskySolveComplex(ComplexMatrix & A,
                                  ComplexMatrix & B) // This is also where the solution is stored
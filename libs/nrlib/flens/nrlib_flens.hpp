@@ -84,6 +84,15 @@ namespace NRLib {
   void CholeskySolve(const SymmetricMatrix & A,
                      Matrix                & B); // This is also where the solution is stored
 
+  /// \brief CholeskySolve in two steps, for solving several systems with the same A.
+  ///        A is replaced by its Cholesky factor, which is then given to
+  ///        CholeskySolveFactorized. The result is the same as from CholeskySolve.
+  /// \throw Exception if A is not positive definite.
+  void CholeskyFactorize(SymmetricMatrix & A);
+
+  void CholeskySolveFactorized(SymmetricMatrix & L,
+                               Matrix          & B); // This is also where the solution is stored
+
   void CholeskySolveComplex(ComplexMatrix & A,
                             ComplexMatrix & B); // This is also where the solution is stored
 
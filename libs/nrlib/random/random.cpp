@@ -20,6 +20,7 @@
 // EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "random.hpp"
+#include "randomgenerator.hpp"
 #include "../exception/exception.hpp"
 
 #include <ctime>
@@ -33,6 +34,28 @@ unsigned long Random::start_seed_     = 0;
 bool          Random::use_seed_file_  = false;
 std::string   Random::seed_file_      = "";
 
+static RandomGenerator * thread_generator = NULL;
+#pragma omp threadprivate(thread_generator)
+
+double Random::Unif01()
+{
+  if (thread_generator != NULL)
+    return thread_generator->Unif01();
+  return dsfmt_gv_genrand_close_open();
+}
+
+unsigned long Random::DrawUint32()
+{
+  if (thread_generator != NULL)
+    return thread_generator->DrawUint32();
+  return dsfmt_gv_genrand_uint32();
+}
+
+void Random::SetThreadGenerator(RandomGenerator * generator)
+{
+  thread_generator = generator;
+}
+
 void Random::Initialize() {
   unsigned long seed = static_cast<unsigned long>(time(0));
   InitializeMT(seed);
@@ -28,6 +28,8 @@
 
 namespace NRLib {
 
+class RandomGenerator;
+
 /// Random generator class based on the Mersenne-Twister random
 /// number generator.
 /// Always initialize before use!
@@ -41,10 +43,15 @@ public:
   static void Initialize(const std::string& seed_file_);
 
   /// \return uniform number in [0,1)
-  static double Unif01()             { return dsfmt_gv_genrand_close_open(); }
+  static double Unif01();
 
   /// \return unsigned 32-bit integer betwen 0 and 0xFFFFFFFF
-  static unsigned long DrawUint32()  { return dsfmt_gv_genrand_uint32(); }
+  static unsigned long DrawUint32();
+
+  /// While a generator is set, the calling thread draws from it instead of from the
+  /// global stream, so that parallel tasks can have their own reproducible streams.
+  /// Set to NULL to return to the global stream.
+  static void SetThreadGenerator(RandomGenerator * generator);
 
   /// Marsaglia-Bray's method, see Ripley, p. 84.
   static double Norm01();
@@ -327,6 +327,8 @@ SegY::~SegY()
     for (size_t i = 0; i < n_traces_; i++)
       delete traces_[i];
   }
+  for (size_t i = 0; i < sample_blocks_.size(); i++)
+    delete [] sample_blocks_[i];
   file_.close();
 }
 
@@ -518,7 +520,8 @@ void
 SegY::ReadAllTraces(const Volume * volume,
                     double         zPad,
                     bool           onlyVolume,
-                    bool           relative_padding)
+                    bool           relative_padding,
+                    int            n_threads)
 {
   single_trace_ = false;
   traces_.resize(n_traces_);
@@ -553,7 +556,29 @@ SegY::ReadAllTraces(const Volume * volume,
   size_t traceSize = datasize_ * nz_ + 240;
   size_t fSize = 3600 + n_traces_ * traceSize;
   long long bytesRead = 3600+traceSize;
-  for (unsigned int i=1 ; i < static_cast<unsigned int>(n_traces_) ; i++)
+
+  // When all traces have the same size, trace positions are known, and the traces
+  // are read in large blocks and decoded in parallel. ReadTraceBlocks stops if it
+  // meets a duplicate header, and the remaining traces are read one by one.
+  size_t first = 1;
+  if (duplicateHeader == false && dz_ != 0 &&
+      FindFileSize(file_name_) == static_cast<unsigned long long>(fSize))
+  {
+    first = ReadTraceBlocks(first,
+                            volume,
+                            zPad,
+                            onlyVolume,
+                            relative_padding,
+                            outsideSurface,
+                            outsideTopMax,
+                            outsideBotMax,
+                            n_threads,
+                            bytesRead,
+                            nextWrite,
+                            writeInterval);
+  }
+
+  for (size_t i=first ; i < n_traces_ ; i++)
   {
     double percentDone = bytesRead/static_cast<double>(fSize);
     if (percentDone > nextWrite)
@@ -613,6 +638,133 @@ SegY::ReadAllTraces(const Volume * volume,
   }
 }
 
+size_t
+SegY::ReadTraceBlocks(size_t         first,
+                      const Volume * volume,
+                      double         zPad,
+                      bool           onlyVolume,
+                      bool           relative_padding,
+                      bool         & outsideSurface,
+                      double       * outsideTopMax,
+                      double       * outsideBotMax,
+                      int            n_threads,
+                      long long    & bytesRead,
+                      double       & nextWrite,
+                      double         writeInterval)
+{
+  size_t traceSize  = datasize_ * nz_ + 240;
+  size_t fSize      = 3600 + n_traces_ * traceSize;
+  size_t blockSize  = std::max(static_cast<size_t>(1), static_cast<size_t>(64*1024*1024)/traceSize);
+  int    format     = binary_header_->GetFormat();
+
+  std::vector<char>        buffer;
+  std::vector<TraceHeader> headers;
+  std::vector<int>         status;
+  std::vector<size_t>      j0(blockSize);
+  std::vector<size_t>      j1(blockSize);
+  std::vector<size_t>      offset(blockSize);
+  std::vector<double>      outsideTopBot(6*blockSize);
+  std::vector<std::string> errors(blockSize);
+
+  size_t start = first;
+  while (start < n_traces_) {
+    size_t n = std::min(blockSize, n_traces_ - start);
+    buffer.resize(n*traceSize);
+    file_.seekg(static_cast<std::streamoff>(3600 + start*traceSize), std::ios_base::beg);
+    if (!file_.read(&buffer[0], static_cast<std::streamsize>(n*traceSize)))
+      throw Exception("Failed to read from SEGY-file or unexpected end of file.");
+
+    headers.assign(n, TraceHeader(trace_header_format_));
+    status.assign(n, 0);
+    std::fill(outsideTopBot.begin(), outsideTopBot.end(), 0.0);
+
+    // Parse headers and find the samples to keep. Exceptions can not leave the
+    // parallel region, so error messages are collected and the first one thrown.
+    bool outside = false;
+    int  nn      = static_cast<int>(n);
+#pragma omp parallel for num_threads(n_threads) reduction(||:outside)
+    for (int i = 0; i < nn; i++) {
+      try {
+        headers[i].Parse(&buffer[i*traceSize], binary_header_->GetLino());
+        if (headers[i].GetStatus() == -1) {
+          status[i] = -1;
+        }
+        else if (headers[i].GetDt()/1000 != dz_ && headers[i].GetDt() > 0) {
+          std::string error = "Different sampling densities given.";
+          error += "Initial sampling density of "+ToString(dz_)+" ms changed to " +
+            ToString(headers[i].GetDt()/1000.0) + " in trace with XL " +
+            ToString(headers[i].GetCrossline()) + " and inline " +
+            ToString(headers[i].GetInline()) + ".\n";
+          throw(Exception(error));
+        }
+        else {
+          bool outsideThis = false;
+          if (FindTraceInterval(headers[i], volume, zPad, onlyVolume, relative_padding,
+                                outsideThis, &outsideTopBot[6*i], j0[i], j1[i]))
+            status[i] = 1;
+          outside = outside || outsideThis;
+        }
+      }
+      catch (NRLib::Exception & e) {
+        errors[i] = e.what();
+        status[i] = -2;
+      }
+    }
+    if (outside)
+      outsideSurface = true;
+
+    // Stop at a duplicate header, since the trace positions change there.
+    size_t nOK = 0;
+    while (nOK < n && status[nOK] != -1)
+      nOK++;
+
+    size_t nData = 0;
+    for (size_t i = 0; i < nOK; i++) {
+      if (status[i] == -2)
+        throw Exception(errors[i]);
+      double * tb = &outsideTopBot[6*i];
+      if (tb[0] > outsideTopMax[0])
+        for (int k=0;k<6;k++)
+          outsideTopMax[k] = tb[k];
+      if (tb[1] > outsideBotMax[1])
+        for (int k=0;k<6;k++)
+          outsideBotMax[k] = tb[k];
+      offset[i] = nData;
+      if (status[i] == 1)
+        nData += j1[i] - j0[i] + 1;
+    }
+
+    // The samples of all traces in the block are kept in one contiguous array.
+    float * data = NULL;
+    if (nData > 0) {
+      data = new float[nData];
+      sample_blocks_.push_back(data);
+    }
+
+    int nnOK = static_cast<int>(nOK);
+#pragma omp parallel for num_threads(n_threads)
+    for (int i = 0; i < nnOK; i++) {
+      if (status[i] == 1)
+        traces_[start+i] = new SegYTrace(&buffer[i*traceSize + 240], j0[i], j1[i], format,
+                                         &headers[i], data + offset[i]);
+    }
+
+    bytesRead += nOK*traceSize;
+    while (bytesRead/static_cast<double>(fSize) > nextWrite) {
+      LogKit::LogMessage(LogKit::Low,"^");
+      nextWrite += writeInterval;
+    }
+
+    if (nOK < n) {
+      start += nOK;
+      file_.seekg(static_cast<std::streamoff>(3600 + start*traceSize), std::ios_base::beg);
+      return(start);
+    }
+    start += n;
+  }
+  return(start);
+}
+
 void
 SegY::CheckTopBotError(const double * tE, const double * bE)
 {
@@ -651,6 +803,36 @@ SegY::ReadTrace(const Volume * volume,
   if (writevalues == 1)
     traceHeader.WriteValues();
 
+  size_t j0, j1;
+  if (FindTraceInterval(traceHeader, volume, zPad, onlyVolume, relative_padding,
+                        outsideSurface, outsideTopBot, j0, j1) == false)
+  {
+    ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
+    return(NULL);
+  }
+
+  SegYTrace * trace = NULL;
+  if (file_.eof() == false)
+  {
+    // Copy elements from j0 til j1.
+    trace = new SegYTrace(file_, j0, j1,
+                          binary_header_->GetFormat(), nz_,
+                          &traceHeader);
+  }
+  return trace;
+}
+
+bool
+SegY::FindTraceInterval(const TraceHeader & traceHeader,
+                        const Volume      * volume,
+                        double              zPad,
+                        bool                onlyVolume,
+                        bool                relative_padding,
+                        bool              & outsideSurface,
+                        double            * outsideTopBot,
+                        size_t            & j0,
+                        size_t            & j1) const
+{
   if (outsideTopBot != NULL) {
     outsideTopBot[0] = 0; // > 0 indicates top error
     outsideTopBot[1] = 0; // > 0 indicates bot error
@@ -669,15 +851,14 @@ SegY::ReadTrace(const Volume * volume,
                    +ToString(trace_header_format_.GetCoordSys())+")");
   }
 
-  size_t j0 = 0;
-  size_t j1 = nz_-1;
+  j0 = 0;
+  j1 = nz_-1;
   float zTop, zBot;
   if (volume != NULL)
   {
     if (onlyVolume && !volume->IsInside(x,y))
     {
-      ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
-      return(NULL);
+      return(false);
     }
 
     try {
@@ -685,8 +866,7 @@ SegY::ReadTrace(const Volume * volume,
     }
     catch (NRLib::Exception & ) {
       outsideSurface = true;
-      ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
-      return(NULL);
+      return(false);
     }
 
     try {
@@ -694,14 +874,12 @@ SegY::ReadTrace(const Volume * volume,
     }
     catch (NRLib::Exception & ) {
       outsideSurface = true;
-      ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
-      return(NULL);
+      return(false);
     }
 
     if (volume->GetTopSurface().IsMissing(zTop) || volume->GetBotSurface().IsMissing(zBot))
     {
-      ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
-      return(NULL);
+      return(false);
     }
   }
   else {
@@ -743,8 +921,7 @@ SegY::ReadTrace(const Volume * volume,
     }
   }
   if (outsideTopBot != NULL && (outsideTopBot[0] > 0.0 || outsideTopBot[1] > 0.0)) {
-    ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
-    return(NULL);
+    return(false);
   }
 
   float pad;
@@ -766,15 +943,7 @@ SegY::ReadTrace(const Volume * volume,
   if (j0 > j1)
     throw Exception(" Lower horizon above SegY region or upper horizon below SegY region");
 
-  SegYTrace * trace = NULL;
-  if (file_.eof() == false)
-  {
-    // Copy elements from j0 til j1.
-    trace = new SegYTrace(file_, j0, j1,
-                          binary_header_->GetFormat(), nz_,
-                          &traceHeader);
-  }
-  return trace;
+  return(true);
 }
 
 bool
@@ -875,7 +1044,7 @@ SegY::GetNearestTrace(std::vector<float> & trace_data,
   size_t i = geometry_->FindIndex(x, y);
 
   if (traces_[i] != NULL) {
-    trace_data = traces_[i]->GetTrace();
+    traces_[i]->GetTrace(trace_data);
     // NBNB: The 0.5f below is a shift we have introduced when reading
     // in seismic data to get data values in centre of grid cells rather
     // than on their borders. This choice and its implications need to
@@ -1275,6 +1444,86 @@ SegY::WriteAllTracesToFile()
   }
 }
 
+//Sorting function for FindTraceOrder, giving the same order as SortILXL.
+struct SegYTracePosition
+{
+  int    IL;
+  int    XL;
+  size_t index;
+  size_t trace;
+};
+
+bool SortPositionILXL(const SegYTracePosition & p1, const SegYTracePosition & p2)
+{
+  if (p1.IL != p2.IL)
+    return(p1.IL < p2.IL);
+  if (p1.XL != p2.XL)
+    return(p1.XL < p2.XL);
+  return(p1.index < p2.index);
+}
+
+void
+SegY::FindTraceOrder(const std::vector<float> & x,
+                     const std::vector<float> & y,
+                     std::vector<size_t>      & order) const
+{
+  assert(geometry_ != 0);
+  std::vector<SegYTracePosition> positions(x.size());
+  for (size_t t = 0; t < x.size(); t++) {
+    if (geometry_->IsInside(x[t], y[t]) == false)
+      throw Exception(" Coordinates are outside grid.");
+    geometry_->FindILXL(x[t], y[t], positions[t].IL, positions[t].XL);
+    size_t i, j;
+    geometry_->FindIndex(x[t], y[t], i, j);
+    positions[t].index = i + geometry_->GetNx() * j;
+    positions[t].trace = t;
+  }
+  std::sort(positions.begin(), positions.end(), SortPositionILXL);
+
+  order.resize(positions.size());
+  for (size_t t = 0; t < positions.size(); t++)
+    order[t] = positions[t].trace;
+}
+
+void
+SegY::WriteTraces(const float * x,
+                  const float * y,
+                  const float * data,
+                  size_t        n,
+                  int           n_threads)
+{
+  assert(file_);
+  assert(geometry_ != 0);
+  if (n == 0)
+    return;
+
+  size_t            traceSize = 240 + 4*nz_;
+  std::vector<char> buffer(n*traceSize);
+
+  int nn = static_cast<int>(n);
+#pragma omp parallel for num_threads(n_threads)
+  for (int t = 0; t < nn; t++) {
+    int IL, XL;
+    geometry_->FindILXL(x[t], y[t], IL, XL);
+    TraceHeader header(trace_header_format_);
+    header.SetNSamples(nz_);
+    header.SetDt(static_cast<unsigned short>(dz_*1000));
+    header.SetUtmx(x[t]);
+    header.SetUtmy(y[t]);
+    header.SetInline(IL);
+    header.SetCrossline(XL);
+
+    char        * trace   = &buffer[t*traceSize];
+    const float * samples = data + t*nz_;
+    header.Encode(trace);
+    for (size_t k = 0; k < nz_; k++)
+      NRLibPrivate::WriteIBMFloatBE(trace + 240 + 4*k, samples[k]);
+  }
+
+  if (!file_.write(&buffer[0], static_cast<std::streamsize>(n*traceSize)))
+    throw Exception("Error writing to SEGY-file.");
+}
+
 size_t
 SegY::FindNumberOfTraces(const std::string       & fileName,
                          const TraceHeaderFormat * traceHeaderFormat)
@@ -82,7 +82,8 @@ public:
   void                      ReadAllTraces(const NRLib::Volume * volume,
                                           double                zPad,
                                           bool                  onlyVolume       = false,
-                                          bool                  relative_padding = true); ///< Read all traces with header
+                                          bool                  relative_padding = true,
+                                          int                   n_threads        = 1);    ///< Read all traces with header
   float                     GetValue(double x,
                                      double y,
                                      double z,
@@ -151,6 +152,20 @@ public:
                                        float                    topVal  = 0.0f,
                                        float                    baseVal = 0.0f);
   void                      WriteAllTracesToFile(); ///< Use only after writeTrace with x and y as input is used for the whole cube
+  /// Find the order in which WriteAllTracesToFile writes traces stored at the given
+  /// positions (by inline, crossline and grid index). Use with WriteTraces.
+  void                      FindTraceOrder(const std::vector<float> & x,
+                                           const std::vector<float> & y,
+                                           std::vector<size_t>      & order) const;
+  /// Write n traces of nz samples directly to file, in the given order. Trace t is at
+  /// (x[t], y[t]) with samples data[t*nz] to data[t*nz+nz-1], and gets the same header
+  /// as in WriteAllTracesToFile. Headers and samples are encoded by n_threads threads,
+  /// and the traces are written in one block.
+  void                      WriteTraces(const float * x,
+                                        const float * y,
+                                        const float * data,
+                                        size_t        n,
+                                        int           n_threads);
   //<<<End write mode
 
 
@@ -185,6 +200,27 @@ private:
                                       bool                  writevalues      = true,
                                       double              * outsideTopBot    = NULL,
                                       bool                  relative_padding = true);  ///< Read single trace from file
+  size_t                    ReadTraceBlocks(size_t                first,
+                                            const NRLib::Volume * volume,
+                                            double                zPad,
+                                            bool                  onlyVolume,
+                                            bool                  relative_padding,
+                                            bool                & outsideSurface,
+                                            double              * outsideTopMax,
+                                            double              * outsideBotMax,
+                                            int                   n_threads,
+                                            long long           & bytesRead,
+                                            double              & nextWrite,
+                                            double                writeInterval);    ///< Read traces from first on in large blocks. Returns index of first unread trace.
+  bool                      FindTraceInterval(const TraceHeader   & traceHeader,
+                                              const NRLib::Volume * volume,
+                                              double                zPad,
+                                              bool                  onlyVolume,
+                                              bool                  relative_padding,
+                                              bool                & outsideSurface,
+                                              double              * outsideTopBot,
+                                              size_t              & j0,
+                                              size_t              & j1) const;   ///< Samples to keep. False if trace is not used.
   //Note: If outsideTopBot == NULL, lack of data on top or bot will throw exception.
   //      Otherwise, outsideTopBot[0] will be top lack, [1] for bottom,
   //      [2] is x-coord, [3] is y-coord. Allocate outside.
@@ -210,6 +246,7 @@ private:
   bool                      check_simbox_;          ///<
 
   std::vector<SegYTrace*>   traces_;               ///< All traces
+  std::vector<float*>       sample_blocks_;        ///< Sample storage for traces read by ReadTraceBlocks
   size_t                    n_traces_;              ///< Holds the number of traces. May be an estimate if not all read.
 
   int                       datasize_;             ///< Bytes per datapoint in file.
@@ -94,6 +94,7 @@ SegYTrace::SegYTrace(std::fstream & file, size_t jStart, size_t jEnd, int format
     }
     else
       throw FileFormatError("Bad format");
+    values_ = &data_[0];
   }
   catch (NRLib::Exception & e)
   {
@@ -141,12 +142,60 @@ SegYTrace::SegYTrace(std::vector<float> indata, size_t jStart, size_t jEnd, floa
   data_.resize(nData);
   for (i = 0; i < nData; i++)
     data_[i] = indata[jStart + i];
+  values_ = &data_[0];
 
   table_index_   = 0;
   file_position_ = 0;
   trace_header_  = NULL;
 }
 
+SegYTrace::SegYTrace(const char * buffer, size_t jStart, size_t jEnd, int format,
+                     const TraceHeader * trace_header, float * data)
+{
+  rmissing_      = segyRMISSING;
+  imissing_      = segyIMISSING;
+  j_start_       = jStart;
+  j_end_         = jEnd;
+  x_             = trace_header->GetUtmx();
+  y_             = trace_header->GetUtmy();
+  in_line_       = trace_header->GetInline();
+  cross_line_    = trace_header->GetCrossline();
+  coord1_        = trace_header->GetCoord1();
+  coord2_        = trace_header->GetCoord2();
+  trace_header_  = new TraceHeader(*trace_header);
+  table_index_   = 0;
+  file_position_ = 0;
+  values_        = data;
+
+  // Only the samples that are kept are decoded.
+  size_t nData = jEnd - jStart + 1;
+  size_t i;
+  if (format == 1) {
+    for (i = 0; i < nData; i++)
+      ParseIBMFloatBE(&buffer[4*(jStart + i)], data[i]);
+  }
+  else if (format == 2) {
+    int tmp;
+    for (i = 0; i < nData; i++) {
+      ParseInt32BE(&buffer[4*(jStart + i)], tmp);
+      data[i] = static_cast<float>(tmp);
+    }
+  }
+  else if (format == 3) {
+    short tmp;
+    for (i = 0; i < nData; i++) {
+      ParseInt16BE(&buffer[2*(jStart + i)], tmp);
+      data[i] = static_cast<float>(tmp);
+    }
+  }
+  else if (format == 5) {
+    for (i = 0; i < nData; i++)
+      ParseIEEEFloatBE(&buffer[4*(jStart + i)], data[i]);
+  }
+  else
+    throw FileFormatError("Bad format");
+}
+
 SegYTrace::SegYTrace(const TraceHeader& trace_header, bool keep_header)
 {
   rmissing_      = segyRMISSING;
@@ -161,6 +210,7 @@ SegYTrace::SegYTrace(const TraceHeader& trace_header, bool keep_header)
   coord2_        = trace_header.GetCoord2();
   table_index_   = 0;
   file_position_ = 0;
+  values_        = NULL;
 
   if(keep_header == true)
     trace_header_ = new TraceHeader(trace_header);
@@ -181,10 +231,27 @@ SegYTrace::GetValue(size_t j)const
   if (j < j_start_ || j > j_end_)
     value = rmissing_;
   else
-    value = data_[j - j_start_];
+    value = values_[j - j_start_];
   return(value);
 }
 
+std::vector<float>
+SegYTrace::GetTrace(void) const
+{
+  if (values_ == NULL)
+    return(std::vector<float>());
+  return(std::vector<float>(values_, values_ + (j_end_ - j_start_ + 1)));
+}
+
+void
+SegYTrace::GetTrace(std::vector<float> & trace) const
+{
+  if (values_ == NULL)
+    trace.clear();
+  else
+    trace.assign(values_, values_ + (j_end_ - j_start_ + 1));
+}
+
 size_t
 SegYTrace::GetLegalIndex(size_t index) const
 {
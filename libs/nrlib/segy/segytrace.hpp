@@ -53,6 +53,14 @@ public:
             size_t              nz,
             const TraceHeader * trace_header = NULL);                                     ///< Standard reading constructor.
 
+  SegYTrace(const char        * buffer,
+            size_t              jStart,
+            size_t              jEnd,
+            int                 format,
+            const TraceHeader * trace_header,
+            float             * data);                                                    ///< Decodes samples jStart to jEnd of a trace read into memory.
+                                                                                          ///< The samples are stored in data, which must outlive the trace.
+
   SegYTrace(std::vector<float> indata,
             size_t             jStart,
             size_t             jEnd,
@@ -68,7 +76,8 @@ public:
 
   void SetTableIndex(size_t index) {table_index_ = index;}                                ///< Set table index
 
-  const std::vector<float> & GetTrace(void)              const { return data_       ;}
+  std::vector<float>         GetTrace(void)              const;                           ///< Copy of the trace values
+  void                       GetTrace(std::vector<float> & trace) const;                  ///< Copy of the trace values, reusing the storage of trace
   float                      GetValue(size_t j)          const;                           ///< get trace value at index j
   size_t                     GetLegalIndex(size_t index) const;
   size_t                     GetStart()                  const { return j_start_    ;}    ///< Get start index
@@ -98,10 +107,14 @@ public:
   }
 
 private:
+  SegYTrace(const SegYTrace &);                                                           ///< Not implemented: values_ may point into data_
+  SegYTrace & operator=(const SegYTrace &);                                               ///< Not implemented
+
   ///(note that this class can live without trace_header, hence duplicates of information
   ///that may also be stored there.)
 
-  std::vector<float> data_;         ///< Data in trace
+  std::vector<float> data_;         ///< Data in trace, unless stored outside the trace
+  const float      * values_;       ///< Data in trace. Points to data_ or to external storage
   size_t             j_start_;      ///< Start index
   size_t             j_end_;        ///< End index
   float              x_;            ///< UTM x coord
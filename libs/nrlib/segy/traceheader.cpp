@@ -384,20 +384,29 @@ TraceHeader::TraceHeader(const TraceHeaderFormat& format)
 
 void TraceHeader::Read(std::istream& inFile, int lineNo)
 {
-  if (!(inFile.read(buffer_,240))) {
+  char buffer[240];
+  if (!(inFile.read(buffer,240))) {
     // end of file
     throw EndOfFile();
   }
 
+  if (Parse(buffer, lineNo) == false) {
+    // Set file pointer at end of EDBDIC header.
+    // fseek(inFile, 2960, SEEK_CUR);
+    inFile.seekg(2960);
+  }
+}
+
+bool TraceHeader::Parse(const char* buffer, int lineNo)
+{
+  memcpy(buffer_, buffer, 240);
+
   if (buffer_[0] == '' && buffer_[1] == '@' && buffer_[2] == ''
       && buffer_[80] == '' && buffer_[160] == '')
   {
     // This is not a trace header, but the start of an EDBDIC-header.
-    // Set file pointer at end of EDBDIC header.
-   // fseek(inFile, 2960, SEEK_CUR);
-    inFile.seekg(2960);
     status_ = -1;
-    return;
+    return false;
   }
 
   std::string buf_string(buffer_,240);
@@ -477,12 +486,27 @@ useBinaryInline = false;
   if (lineNo > 0 && GetInline() == 0 && useBinaryInline==true) {
     SetInline(lineNo);
   }
+  return true;
 }
 
 int TraceHeader::Write(std::ostream& outFile)
 {
   int errCode = 0;
 
+  char buffer[240];
+  Encode(buffer);
+  if (!outFile.write(buffer, 240)) {
+    throw Exception("Error writing to stream.");
+  }
+
+  return errCode;
+}
+
+
+void TraceHeader::Encode(char* buffer) const
+{
+  using namespace NRLibPrivate;
+
  // write on correct locations. What to write between?
   int i = 0;
 
@@ -490,47 +514,46 @@ int TraceHeader::Write(std::ostream& outFile)
   {
     if (i==(format_.GetScalCoLoc()-1))
     {
-      WriteBinaryShort(outFile, scalcoinitial_);
+      WriteUInt16BE(&buffer[i], static_cast<unsigned short>(scalcoinitial_));
       i = i+2;
     }
     else if (i==(format_.GetUtmxLoc()-1))
     {
-      WriteBinaryInt(outFile, static_cast<int>(utmx_));
+      WriteUInt32BE(&buffer[i], static_cast<unsigned int>(static_cast<int>(utmx_)));
       i=i+4;
     }
     else if (i==(format_.GetUtmyLoc()-1))
     {
-      WriteBinaryInt(outFile, static_cast<int>(utmy_));
+      WriteUInt32BE(&buffer[i], static_cast<unsigned int>(static_cast<int>(utmy_)));
       i=i+4;
     }
     else if (i==(NS_LOC-1))
     {
-      WriteBinaryShort(outFile, ns_);
+      WriteUInt16BE(&buffer[i], static_cast<unsigned short>(ns_));
       i=i+2;
     }
     else if (i==(DT_LOC-1))
     {
-      WriteBinaryShort(outFile, dt_);
+      WriteUInt16BE(&buffer[i], static_cast<unsigned short>(dt_));
       i=i+2;
     }
     else if (i==(format_.GetInlineLoc()-1))
     {
-      WriteBinaryInt(outFile, inline_);
+      WriteUInt32BE(&buffer[i], static_cast<unsigned int>(inline_));
       i=i+4;
     }
     else if (i==(format_.GetCrosslineLoc()-1))
     {
-      WriteBinaryInt(outFile, crossline_);
+      WriteUInt32BE(&buffer[i], static_cast<unsigned int>(crossline_));
       i=i+4;
     }
     else
     {
-      outFile.write(&(buffer_[i]), 2);
+      buffer[i]   = buffer_[i];
+      buffer[i+1] = buffer_[i+1];
       i=i+2;
     }
   }
-
-  return errCode;
 }
 
 
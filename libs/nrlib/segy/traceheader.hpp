@@ -168,10 +168,21 @@ public:
   void Read(std::istream& inFile,
             int lineNo = -1);
 
+  /// Parse a header already read into memory.
+  /// \param[in] buffer  the 240 bytes of the header.
+  /// \param[in] lineNo  line number. (from binary header.) -1 if not used.
+  /// \return false, and status -1, if the buffer holds the start of an EBCDIC header.
+  bool Parse(const char* buffer,
+             int lineNo = -1);
+
   /// Write header to file.
   /// \param[in]  outFile output file.
   int Write(std::ostream& outFile);
 
+  /// Encode header as written by Write.
+  /// \param[out] buffer  the 240 bytes of the header.
+  void Encode(char* buffer) const;
+
   /// Dump what is stored in header buffer to file.
   /// May override the number of data. Intended for use when we copy headers
   /// from input to output.
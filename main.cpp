@@ -24,6 +24,7 @@
 #include "lib/timekit.hpp"
 #include "lib/utils.h"
 
+#include "nrlib/exception/exception.hpp"
 #include "nrlib/segy/segy.hpp"
 #include "nrlib/iotools/logkit.hpp"
 #include "nrlib/random/random.hpp"
@@ -35,6 +36,9 @@
 #include "src/wavelet.h"
 #include "src/crava.h"
 #include "src/fftgrid.h"
+#include "src/fftfilegrid.h"
+#include "src/fftplancache.h"
+#include "src/gridwriter.h"
 #include "src/gridmapping.h"
 #include "src/simbox.h"
 #include "src/welldata.h"
@@ -175,6 +179,7 @@ int main(int argc, char** argv)
 
   try
   {
+    GridWriter::StopGuard gridWriterGuard; // Ends the writer threads on every exit from this block
     XmlModelFile modelFile(argv[1]);
     InputFiles     * inputFiles     = modelFile.getInputFiles();
     ModelSettings  * modelSettings  = modelFile.getModelSettings();
@@ -201,12 +206,15 @@ int main(int argc, char** argv)
     Simbox * timeBGSimbox = NULL;
     SeismicParametersHolder seismicParameters;
 
-    setupStaticModels(modelGeneral,
-                      modelAVOstatic,
-                      modelSettings,
-                      inputFiles,
-                      seismicParameters,
-                      timeBGSimbox);
+    {
+      Timings::Region region("Static models");
+      setupStaticModels(modelGeneral,
+                        modelAVOstatic,
+                        modelSettings,
+                        inputFiles,
+                        seismicParameters,
+                        timeBGSimbox);
+    }
 
     if(modelGeneral   == NULL || modelGeneral->getFailed()   ||
        modelAVOstatic == NULL || modelAVOstatic->getFailed())
@@ -313,6 +321,11 @@ int main(int argc, char** argv)
       }
     }
 
+    {
+      Timings::Region region("Grid output");
+      GridWriter::stop();
+    }
+
     if (modelSettings->getDoInversion() && FFTGrid::getMaxAllowedGrids() != FFTGrid::getMaxAllocatedGrids()) {
       LogKit::LogFormatted(LogKit::Warning,"\nWARNING: A memory requirement inconsistency has been detected:");
       LogKit::LogFormatted(LogKit::Warning,"\n            Maximum number of grids requested  :  %2d",FFTGrid::getMaxAllowedGrids());
@@ -320,8 +333,19 @@ int main(int argc, char** argv)
       TaskList::addTask("The memory usage estimate failed. Please send your XML-model file and\nthe logFile.txt to the CRAVA developers.");
     }
 
+    if(FFTPlanCache::getMeasure())
+      FFTPlanCache::exportWisdom(IO::makeFullFileName(IO::PathToTmpFiles(), IO::FileFFTWisdom()+IO::SuffixTextFiles()));
+    Timings::setFFTPlanCounts(FFTPlanCache::getHits(), FFTPlanCache::getMisses());
+    Timings::setTmpGridIO(FFTFileGrid::getTotalBytesRead(), FFTFileGrid::getTotalBytesWritten(), FFTFileGrid::getTotalIOTime());
+    Timings::setTmpGridCompression(FFTFileGrid::getTotalRawBytes(), FFTFileGrid::getTotalStoredBytes(), FFTFileGrid::getTotalCodecTime());
+    Timings::setFFTCounts(FFTGrid::getNumberOfFFTs(), FFTGrid::getNumberOfInvFFTs());
+    Timings::setGridHighWater(FFTGrid::getMaxAllocatedGrids(), FFTGrid::getMaxFFTMemUse());
+    FFTPlanCache::clear();
+
     Timings::setTimeTotal(wall,cpu);
     Timings::reportAll(LogKit::Medium);
+    if (modelSettings->getTimingsFileFlag())
+      Timings::writeReport(IO::makeFullFileName("", IO::FileTimings()));
 
     TaskList::viewAllTasks(modelSettings->getTaskFileFlag());
 
@@ -340,6 +364,12 @@ int main(int argc, char** argv)
     std::string error_message = std::string("Out of memory: ") + ba.what() + "\n";
     LogKit::LogMessage(LogKit::Error, error_message);
   }
+  catch (NRLib::IOError& e)
+  {
+    std::cerr << "Error writing grid: " << e.what() << std::endl;
+    std::string error_message = std::string("Error writing grid: ") + e.what() + "\n";
+    LogKit::LogMessage(LogKit::Error, error_message);
+  }
 
 #if defined(COMPILE_STORM_MODULES_FOR_RMS)
   Feature& feature = FEATURE_INVERSION_EXE;
@@ -152,12 +152,7 @@ BetaDistributionWithTrend::GetQuantileValue(double u, double s1, double s2)
 
   double y;
 
-  if(share_level_ > None && resample_ == false)
-    u = current_u_;
-  else {
-    current_u_ = u;
-    resample_ = false;
-  }
+  u = FindQuantile(u);
 
   if(ni_ == 1 && nj_ == 1)
     y = (*beta_distribution_)(0,0)->Quantile(u);
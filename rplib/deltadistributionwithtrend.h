@@ -27,10 +27,6 @@ class DeltaDistributionWithTrend : public DistributionWithTrend {
    virtual bool                       GetIsDistribution() const               { return(false)                                ;}
    virtual std::vector<bool>          GetUseTrendCube() const                 { return(use_trend_cube_)                      ;}
 
-   //Triggers resampling for share_level_ <= level_. Not necessary for share_level_ = 0/None
-   virtual void                       TriggerNewSample(int level)             {if(share_level_<=level)
-                                                                                 resample_ = true; }
-
    virtual double                     ReSample(double s1, double s2);
    virtual double                     GetQuantileValue(double u, double s1, double s2);
 
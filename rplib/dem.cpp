@@ -8,6 +8,7 @@
 #include <cmath>
 
 static DEM* global_dem;
+#pragma omp threadprivate(global_dem)
 
 static std::vector<double> WrapperGEQDEMYPrime(std::vector<double>&       y,
                                                double                     t) {
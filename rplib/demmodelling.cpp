@@ -69,9 +69,9 @@ DEMTools::CalcCo2Prop(double& bulk_modulus,
   std::vector<double> t(ttmp, ttmp + nt);
   std::vector<double> pmpa(pmpatmp, pmpatmp + np);
 
-  static std::vector< std::vector<double> > co2_bulk(np, std::vector<double>(nt, 0.0));
+  std::vector< std::vector<double> > co2_bulk(np, std::vector<double>(nt, 0.0));
   /*static std::vector< std::vector<double> > co2_velocity(np, std::vector<double>(nt, 0.0));*/ //Velocity interpolation commented out
-  static std::vector< std::vector<double> > co2_density(np, std::vector<double>(nt, 0.0));
+  std::vector< std::vector<double> > co2_density(np, std::vector<double>(nt, 0.0));
 
   //{ // local scope co2 velocity
   //  double tmp0[] = {2.6400000e+002,  2.6800000e+002,  2.7200000e+002,  2.7600000e+002,  2.8000000e+002,  2.8400000e+002,  2.8800000e+002,  2.9100000e+002,  2.9500000e+002,  2.9900000e+002,  3.0200000e+002,  3.0600000e+002};
@@ -4,9 +4,11 @@
 #include "nrlib/surface/regularsurface.hpp"
 #include "nrlib/iotools/logkit.hpp"
 #include "nrlib/grid/grid2d.hpp"
-#include "nrlib/statistics/statistics.hpp"
 #include "nrlib/random/random.hpp"
-#include <nrlib/flens/nrlib_flens.hpp>
+#include "nrlib/random/randomgenerator.hpp"
+#include "nrlib/exception/exception.hpp"
+
+#include <cmath>
 
 //--------------------------------------------------------------//
 Rock * DistributionsRock::GenerateSampleAndReservoirVariables(const std::vector<double> & trend_params, std::vector<double> &resVar )
@@ -35,8 +37,96 @@ Rock * DistributionsRock::GenerateSample(const std::vector<double> & trend_param
   return(result);
 }
 
+//--------------------------------------------------------------//
+void DistributionsRock::GenerateSeismicParams(const std::vector<double> & trend_params,
+                                              double                    & vp,
+                                              double                    & vs,
+                                              double                    & rho)
+{
+  size_t nResVar=reservoir_variables_.size();
+  //Note: If this is not a top level rock, reservoir_variables_ are not set, so the loop is skipped.
+  for(size_t i=0;i<nResVar;i++)
+    reservoir_variables_[i]->TriggerNewSample(resampling_level_);
+  GenerateSeismicParamsPrivate(trend_params, vp, vs, rho);
+}
+
+//--------------------------------------------------------------//
+void DistributionsRock::GenerateSeismicParamsPrivate(const std::vector<double> & trend_params,
+                                                     double                    & vp,
+                                                     double                    & vs,
+                                                     double                    & rho)
+{
+  Rock * rock = GenerateSamplePrivate(trend_params);
+  rock->GetSeismicParams(vp, vs, rho);
+  delete rock;
+}
+
+//--------------------------------------------------------------//
+bool DistributionsRock::GenerateLogSeismicSamples(const std::vector<double> & trend_params,
+                                                  int                         n,
+                                                  std::vector<double>       & log_params,
+                                                  std::string               & errTxt)
+{
+  log_params.resize(3*n);
+
+  double vp;
+  double vs;
+  double rho;
+
+  for (int k = 0 ; k < n ; k++) {
+    GenerateSeismicParams(trend_params, vp, vs, rho);
+
+    if(vp <= 0 || vs < 0 || rho <=0) {
+      errTxt += "\nAt least one sample generated from the rock model obtains negative values.\n";
+      if(vp <= 0)
+        errTxt += "  The variance for Vp might be too large.\n\n";
+      if(vs < 0)
+        errTxt += "  The variance for Vs might be too large.\n\n";
+      if(rho <= 0)
+        errTxt += "  The variance for density might be too large.\n\n";
+
+      return(false);
+    }
 
+    log_params[3*k    ] = std::log(vp);
+    log_params[3*k + 1] = std::log(vs);
+    log_params[3*k + 2] = std::log(rho);
+  }
+  return(true);
+}
 
+//--------------------------------------------------------------//
+void DistributionsRock::FindLogMeanAndCovariance(const std::vector<double> & log_params,
+                                                 int                         n,
+                                                 std::vector<double>       & mean,
+                                                 NRLib::Grid2D<double>     & cov)
+{
+  //
+  // Two passes over the samples, giving the same sums as NRLib::Mean and NRLib::Cov
+  //
+  double sum[3] = {0.0, 0.0, 0.0};
+  for (int k = 0 ; k < n ; k++) {
+    for (int p = 0 ; p < 3 ; p++)
+      sum[p] += log_params[3*k + p];
+  }
+  for (int p = 0 ; p < 3 ; p++)
+    mean[p] = sum[p] / n;
+
+  double sum_prod[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+  for (int k = 0 ; k < n ; k++) {
+    const double * x = &log_params[3*k];
+    for (int p = 0 ; p < 3 ; p++) {
+      for (int q = p ; q < 3 ; q++)
+        sum_prod[p][q] += (x[p] - mean[p]) * (x[q] - mean[q]);
+    }
+  }
+  for (int p = 0 ; p < 3 ; p++) {
+    for (int q = p ; q < 3 ; q++) {
+      cov(p,q) = sum_prod[p][q]/(n - 1);
+      cov(q,p) = cov(p,q);
+    }
+  }
+}
 
 //--------------------------------------------------------------//
 void DistributionsRock::GenerateWellSample(double                 corr,
@@ -93,7 +183,8 @@ Rock * DistributionsRock::EvolveSampleAndReservoirVaribles(double
 
 
 //-----------------------------------------------------------------------------------------------------------
-void  DistributionsRock::SetupExpectationAndCovariances(std::string & errTxt)
+void  DistributionsRock::SetupExpectationAndCovariances(std::string & errTxt,
+                                                        int           n_threads)
 //-----------------------------------------------------------------------------------------------------------
 {
   int n  = 1024; // Number of samples generated for each distribution
@@ -118,78 +209,74 @@ void  DistributionsRock::SetupExpectationAndCovariances(std::string & errTxt)
                  tabulated_s0_,
                  tabulated_s1_);
 
-  NRLib::Grid2D<double> cov(3,3);
-  std::vector<double>   mean(3);
-
   unsigned int seed = NRLib::Random::DrawUint32();
 
-  bool failed = false;
+  //
+  // Every node is sampled from its own generator started from the same seed, so the
+  // result does not depend on the number of threads. Each thread samples a clone of
+  // this rock, and shared reservoir variables keep a sample per thread in a SampleScope.
+  //
+  int n_nodes = mi*mj;
+
+  std::vector<std::string> node_errTxt(n_nodes, "");
+  std::vector<std::string> node_exception(n_nodes, "");
+  std::vector<int>         node_failed(n_nodes, 0);
+
+#pragma omp parallel num_threads(n_threads)
+  {
+    DistributionsRock * rock = Clone();
+    std::vector<double> log_params(3*n); // Reused for all nodes of the trend mesh
 
-  for (int i = 0 ; i < mi ; i++) {
-    for (int j = 0 ; j < mj ; j++) {
+#pragma omp for schedule(dynamic,1)
+    for (int node = 0 ; node < n_nodes ; node++) {
+      int i = node / mj;
+      int j = node % mj;
 
       std::vector<double>   expectation_small(3, 0.0);
       NRLib::Grid2D<double> covariance_small(3, 3, 0.0);
 
-      if(failed == false) {
+      NRLib::RandomGenerator generator;
+      generator.Initialize(seed);
+      NRLib::Random::SetThreadGenerator(&generator);
 
-        NRLib::Random::Initialize(seed);
+      try {
+        DistributionWithTrend::SampleScope scope;
         const std::vector<double> & tp = trend_params(i,j); // trend_params = two-dimensional
 
-        NRLib::Vector log_vp(n);
-        NRLib::Vector log_vs(n);
-        NRLib::Vector log_rho(n);
-
-        double vp;
-        double vs;
-        double rho;
-
-        for (int k = 0 ; k < n ; k++) {
-          Rock * rock = GenerateSample(tp);
-
-          rock->GetSeismicParams(vp, vs, rho);
-
-          log_vp(k) = std::log(vp);
-          log_vs(k) = std::log(vs);
-          log_rho(k) = std::log(rho);
-
-          delete rock;
-
-          if(vp <= 0 || vs < 0 || rho <=0) {
-            errTxt += "\nAt least one sample generated from the rock model obtains negative values.\n";
-            if(vp <= 0)
-              errTxt += "  The variance for Vp might be too large.\n\n";
-            if(vs < 0)
-              errTxt += "  The variance for Vs might be too large.\n\n";
-            if(rho <= 0)
-              errTxt += "  The variance for density might be too large.\n\n";
-
-            failed = true;
-            break;
-          }
-        }
-
-        if(failed == false) {
-
-          std::vector<NRLib::Vector> m(3);
-
-          m[0] = log_vp;
-          m[1] = log_vs;
-          m[2] = log_rho;
-
-          for (int k = 0; k < 3; k++) {
-            expectation_small[k] = NRLib::Mean(m[k]);
-            for (int l = k; l < 3; l++) {
-              covariance_small(k,l) = NRLib::Cov(m[k], m[l]);
-              covariance_small(l,k) = covariance_small(k,l);
-            }
-          }
-        }
+        if(rock->GenerateLogSeismicSamples(tp, n, log_params, node_errTxt[node]) == false)
+          node_failed[node] = 1;
+        else
+          FindLogMeanAndCovariance(log_params, n, expectation_small, covariance_small);
+      }
+      catch (std::exception & e) {
+        node_exception[node] = e.what();
+        node_failed[node]    = 1;
       }
 
+      NRLib::Random::SetThreadGenerator(NULL);
+
       expectation_(i,j) = expectation_small;
       covariance_(i,j) = covariance_small;
     }
+
+    delete rock;
+  }
+
+  //
+  // Report the first failing node, and clear the nodes from there on, as the serial loop did
+  //
+  bool failed = false;
+  for (int node = 0 ; node < n_nodes ; node++) {
+    if (failed == false && node_failed[node] == 1) {
+      if (node_exception[node] != "")
+        throw NRLib::Exception(node_exception[node]);
+      errTxt += node_errTxt[node];
+      failed  = true;
+    }
+    if (failed) {
+      expectation_(node / mj, node % mj).assign(3, 0.0);
+      covariance_(node / mj, node % mj) = NRLib::Grid2D<double>(3, 3, 0.0);
+    }
   }
 
   mean_log_expectation_.resize(3, 0);
@@ -553,9 +640,10 @@ void DistributionsRock::InterpolateCovariance(NRLib::Grid2D<double>
 
 
 void DistributionsRock::CompleteTopLevelObject(std::vector<DistributionWithTrend *>   res_var,
-                                               std::string                          & errTxt)
+                                               std::string                          & errTxt,
+                                               int                                    n_threads)
 {
   reservoir_variables_ = res_var;
   SetResamplingLevel(DistributionWithTrend::Full);
-  SetupExpectationAndCovariances(errTxt);
+  SetupExpectationAndCovariances(errTxt, n_threads);
 }
@@ -21,6 +21,20 @@ public:
   Rock                                * GenerateSample(const std::vector<double> & trend_params);
   Rock                                * GenerateSampleAndReservoirVariables(const std::vector<double> & trend_params, std::vector<double> &resVar );
 
+  // Draws a sample like GenerateSample, but only returns its seismic parameters.
+  void                                  GenerateSeismicParams(const std::vector<double> & trend_params,
+                                                              double                    & vp,
+                                                              double                    & vs,
+                                                              double                    & rho);
+
+  // Draws n samples and stores log(vp), log(vs) and log(density) of sample k in log_params[3*k],
+  // log_params[3*k+1] and log_params[3*k+2]. Stops and returns false at the first sample with
+  // a non-positive parameter, with an explanation added to errTxt.
+  bool                                  GenerateLogSeismicSamples(const std::vector<double> & trend_params,
+                                                                  int                         n,
+                                                                  std::vector<double>       & log_params,
+                                                                  std::string               & errTxt);
+
   void                                  GenerateWellSample(double                 corr,
                                                            std::vector<double> &  vp,
                                                            std::vector<double> &  vs,
@@ -57,7 +71,8 @@ public:
 
   //Top level objects (those accessed from outside the rock physics model) need more parameters set, so call this.
   void                                  CompleteTopLevelObject(std::vector<DistributionWithTrend *>   res_var,
-                                                               std::string                          & errTxt);
+                                                               std::string                          & errTxt,
+                                                               int                                    n_threads);
 
   void                                  SetResamplingLevel(int level) {resampling_level_ = level;}
 
@@ -65,10 +80,23 @@ protected:
   //Since there is a common start of generate sample here, that is the public function.
   //The public function then calls this overloaded function to get the specific object.
   virtual Rock                        * GenerateSamplePrivate(const std::vector<double> & trend_params) = 0;
+
+  // Called by GenerateSeismicParams. Generates a Rock unless overridden.
+  virtual void                          GenerateSeismicParamsPrivate(const std::vector<double> & trend_params,
+                                                                     double                    & vp,
+                                                                     double                    & vs,
+                                                                     double                    & rho);
+
                                         //This function should be called last step in constructor
                                         //for all children classes.
-
-  void                                  SetupExpectationAndCovariances(std::string & errTxt);
+  // The nodes of the trend mesh are sampled in parallel, each thread using its own clone of this rock.
+  void                                  SetupExpectationAndCovariances(std::string & errTxt,
+                                                                       int           n_threads);
+
+  static void                           FindLogMeanAndCovariance(const std::vector<double> & log_params,
+                                                                 int                         n,
+                                                                 std::vector<double>       & mean,
+                                                                 NRLib::Grid2D<double>     & cov);
 
   void                                  FindTabulatedTrendParams(std::vector<double>       & tabulated_s0,
                                                                  std::vector<double>       & tabulated_s1,
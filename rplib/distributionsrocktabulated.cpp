@@ -145,9 +145,41 @@ DistributionsRockTabulated::GenerateSamplePrivate(const std::vector<double> & tr
   return new_rock;
 }
 
+void
+DistributionsRockTabulated::GenerateSeismicParamsPrivate(const std::vector<double> & trend_params,
+                                                         double                    & vp,
+                                                         double                    & vs,
+                                                         double                    & rho)
+{
+  std::vector<double> u(3);
+
+  for(int i=0; i<3; i++)
+    u[i] = NRLib::Random::Unif01();
+
+  GetSeismicParams(u, trend_params, vp, vs, rho);
+}
+
 Rock *
 DistributionsRockTabulated::GetSample(const std::vector<double> & u,
                                       const std::vector<double> & trend_params)
+{
+  double sample_vp;
+  double sample_vs;
+  double sample_density;
+
+  GetSeismicParams(u, trend_params, sample_vp, sample_vs, sample_density);
+
+  Rock * new_rock = new RockTabulatedVelocity(sample_vp, sample_vs, sample_density, u);
+
+  return new_rock;
+}
+
+void
+DistributionsRockTabulated::GetSeismicParams(const std::vector<double> & u,
+                                             const std::vector<double> & trend_params,
+                                             double                    & vp,
+                                             double                    & vs,
+                                             double                    & rho)
 {
   std::vector<double> sample;
 
@@ -155,21 +187,14 @@ DistributionsRockTabulated::GetSample(const std::vector<double> & u,
 
   double sample_elastic1 = sample[0];
   double sample_elastic2 = sample[1];
-  double sample_density  = sample[2];
-
-  double sample_vp;
-  double sample_vs;
+  rho                    = sample[2];
 
   if(tabulated_method_ == DEMTools::Modulus)
-    DEMTools::CalcSeismicParamsFromElasticParams(sample_elastic1, sample_elastic2, sample_density, sample_vp, sample_vs);
+    DEMTools::CalcSeismicParamsFromElasticParams(sample_elastic1, sample_elastic2, rho, vp, vs);
   else {
-    sample_vp = sample_elastic1;
-    sample_vs = sample_elastic2;
+    vp = sample_elastic1;
+    vs = sample_elastic2;
   }
-
-  Rock * new_rock = new RockTabulatedVelocity(sample_vp, sample_vs, sample_density, u);
-
-  return new_rock;
 }
 
 bool
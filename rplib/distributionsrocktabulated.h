@@ -43,8 +43,20 @@ private:
   // Rock is an abstract class, hence pointer must be used here. Allocated memory (using new) MUST be deleted by caller.
   virtual Rock                     * GenerateSamplePrivate(const std::vector<double> & trend_params);
 
+  // Draws the same sample as GenerateSamplePrivate without allocating a Rock.
+  virtual void                       GenerateSeismicParamsPrivate(const std::vector<double> & trend_params,
+                                                                  double                    & vp,
+                                                                  double                    & vs,
+                                                                  double                    & rho);
+
   Rock                             * GetSample(const std::vector<double> & u, const std::vector<double> & trend_params);
 
+  void                               GetSeismicParams(const std::vector<double> & u,
+                                                      const std::vector<double> & trend_params,
+                                                      double                    & vp,
+                                                      double                    & vs,
+                                                      double                    & rho);
+
   DistributionWithTrend       * elastic1_;
   DistributionWithTrend       * elastic2_;
   DistributionWithTrend       * density_;
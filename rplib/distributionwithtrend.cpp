@@ -1,5 +1,10 @@
 #include "rplib/distributionwithtrend.h"
 
+#include <cstddef>
+
+static DistributionWithTrend::SampleScope * sample_scope = NULL;
+#pragma omp threadprivate(sample_scope)
+
 
 DistributionWithTrend::DistributionWithTrend()
 : share_level_(None),
@@ -44,7 +49,66 @@ DistributionWithTrend::FindUseTrendCube(std::vector<bool> & use_trend_cube,
 double
 DistributionWithTrend::GetCurrentSample(const std::vector<double> & trend_params)
 {
+  double * current_u;
+  bool   * resample;
+  GetState(current_u, resample);
+
   double samples;
-  samples=GetQuantileValue(current_u_, trend_params[0], trend_params[1]);
+  samples=GetQuantileValue(*current_u, trend_params[0], trend_params[1]);
   return samples;
 }
+
+void
+DistributionWithTrend::TriggerNewSample(int level)
+{
+  if(share_level_<=level) {
+    double * current_u;
+    bool   * resample;
+    GetState(current_u, resample);
+    *resample = true;
+  }
+}
+
+double
+DistributionWithTrend::FindQuantile(double u)
+{
+  double * current_u;
+  bool   * resample;
+  GetState(current_u, resample);
+
+  if(share_level_ > None && *resample == false)
+    u = *current_u;
+  else {
+    *current_u = u;
+    *resample  = false;
+  }
+  return u;
+}
+
+void
+DistributionWithTrend::GetState(double *& current_u, bool *& resample)
+{
+  if(share_level_ > None && sample_scope != NULL) {
+    std::map<const DistributionWithTrend *, std::pair<double, bool> > & states = sample_scope->states_;
+    std::map<const DistributionWithTrend *, std::pair<double, bool> >::iterator it = states.find(this);
+    if(it == states.end())
+      it = states.insert(std::make_pair(this, std::make_pair(current_u_, resample_))).first;
+    current_u = &it->second.first;
+    resample  = &it->second.second;
+  }
+  else {
+    current_u = &current_u_;
+    resample  = &resample_;
+  }
+}
+
+DistributionWithTrend::SampleScope::SampleScope()
+: outer_(sample_scope)
+{
+  sample_scope = this;
+}
+
+DistributionWithTrend::SampleScope::~SampleScope()
+{
+  sample_scope = outer_;
+}
@@ -1,6 +1,7 @@
 #ifndef RPLIB_DISTRIBUTIONWITHTREND_H
 #define RPLIB_DISTRIBUTIONWITHTREND_H
 
+#include <map>
 #include <vector>
 
 class DistributionWithTrend {
@@ -19,8 +20,7 @@ class DistributionWithTrend {
    virtual std::vector<bool>          GetUseTrendCube()                                   const = 0;
 
    //Triggers resampling for share_level_ <= level_. Not necessary for share_level_ = 0/None
-   void                       TriggerNewSample(int level)             {if(share_level_<=level)
-                                                                                 resample_ = true; }
+   void                               TriggerNewSample(int level);
 
    virtual double                     ReSample(double s1, double s2)                            = 0;
    virtual double                     GetQuantileValue(double u, double s1, double s2)          = 0;
@@ -32,10 +32,36 @@ class DistributionWithTrend {
                                                        int                 reference);
 
    enum                               ShareLevel {None, SingleSample, Full}; //Note: New levels should be inserted between SingleSample and Full.
+
+   // While a SampleScope exists, shared distributions keep the current sample of the calling
+   // thread in the scope, starting from their state when first used in it. Threads sampling
+   // their own clones of a rock model can then share reservoir variables.
+   class SampleScope
+   {
+   public:
+     SampleScope();
+     ~SampleScope();
+
+   private:
+     SampleScope(const SampleScope &);
+     SampleScope & operator=(const SampleScope &);
+
+     friend class DistributionWithTrend;
+
+     std::map<const DistributionWithTrend *, std::pair<double, bool> > states_; // current_u_ and resample_
+     SampleScope                                                     * outer_;
+   };
+
 protected:
+   // Returns the quantile of the next sample: the current one if a shared distribution is not
+   // to be resampled, and else u, which becomes the current one.
+   double                             FindQuantile(double u);
+
   const int                           share_level_;      // Use like in DistributionWithTrendStorage to know if we have a reservoir variable.
   double                              current_u_;        // Quantile of current sample.
   bool                                resample_;         // If false, and share_level_ > 0, reuse current_u_
 
+private:
+  void                                GetState(double *& current_u, bool *& resample);
 };
 #endif
@@ -67,12 +67,7 @@ NormalDistributionWithTrend::GetQuantileValue(double u, double s1, double s2)
 
   double dummy = 0;
 
-  if(share_level_ > None && resample_ == false)
-    u = current_u_;
-  else {
-    current_u_ = u;
-    resample_ = false;
-  }
+  u = FindQuantile(u);
 
   double z = gaussian_->Quantile(u);
 
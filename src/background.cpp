@@ -278,9 +278,12 @@ Background::generateBackgroundModel(FFTGrid                      *& bgAlpha,
                                                          modelSettings->getBackgroundVario(),
                                                          modelSettings->getDebugFlag());
 
-  makeKrigedBackground(krigingDataAlpha, bgAlpha, trendAlpha, simbox, covGrid2D, "Vp" , modelSettings->getFileGrid());
-  makeKrigedBackground(krigingDataBeta , bgBeta , trendBeta , simbox, covGrid2D, "Vs" , modelSettings->getFileGrid());
-  makeKrigedBackground(krigingDataRho  , bgRho  , trendRho  , simbox, covGrid2D, "Rho", modelSettings->getFileGrid());
+  makeKrigedBackground(krigingDataAlpha, krigingDataBeta, krigingDataRho,
+                       bgAlpha, bgBeta, bgRho,
+                       trendAlpha, trendBeta, trendRho,
+                       simbox, covGrid2D,
+                       modelSettings->getFileGrid(),
+                       modelSettings->getNumberOfThreads());
 
   delete &covGrid2D;
 
@@ -360,6 +363,9 @@ Background::generateMultizoneBackgroundModel(FFTGrid                       *& bg
 
   const CovGrid2D & covGrid2D = Kriging2D::makeCovGrid2D(simbox, modelSettings->getBackgroundVario(), modelSettings->getDebugFlag());
 
+  // All zones use the same covariance, so kriging factors may be reused between them
+  Kriging2D::FactorCache krigingCache;
+
   std::string name_vp  = "Vp";
   std::string name_vs  = "Vs";
   std::string name_rho = "Rho";
@@ -480,9 +486,11 @@ Background::generateMultizoneBackgroundModel(FFTGrid                       *& bg
                        vtAlpha,vtBeta,vtRho,
                        ipos,jpos,kpos);
 
-    makeKrigedZone(krigingDataAlpha, trendAlphaZone[i], alpha_zones[i], covGrid2D);
-    makeKrigedZone(krigingDataBeta , trendBetaZone[i] , beta_zones[i],  covGrid2D);
-    makeKrigedZone(krigingDataRho  , trendRhoZone[i]  , rho_zones[i],   covGrid2D);
+    makeKrigedZone(krigingDataAlpha, krigingDataBeta, krigingDataRho,
+                   trendAlphaZone[i], trendBetaZone[i], trendRhoZone[i],
+                   alpha_zones[i], beta_zones[i], rho_zones[i],
+                   covGrid2D, krigingCache,
+                   modelSettings->getNumberOfThreads());
 
     delete [] avgDevAlphaZone;
     delete [] avgDevBetaZone;
@@ -1458,17 +1466,40 @@ Background::setupKrigingData2D(std::vector<KrigingData2D>     & krigingDataAlpha
   }
 }
 
+//---------------------------------------------------------------------------
+int
+Background::getKrigingBlockSize(size_t nx, size_t ny, size_t nz)
+{
+  //
+  // Layers are kriged in blocks, so that layers with the same data locations can
+  // share kriging vectors. The block size limits the memory used by the surfaces.
+  //
+  const size_t maxValues = static_cast<size_t>(1) << 22;
+  size_t nLayers = maxValues/(3*nx*ny);
+  if (nLayers < 1)
+    nLayers = 1;
+  if (nLayers > nz)
+    nLayers = nz;
+  return static_cast<int>(nLayers);
+}
+
 //---------------------------------------------------------------------------
 void
-Background::makeKrigedBackground(const std::vector<KrigingData2D> & krigingData,
-                                 FFTGrid                         *& bgGrid,
-                                 const float                      * trend,
+Background::makeKrigedBackground(const std::vector<KrigingData2D> & krigingDataAlpha,
+                                 const std::vector<KrigingData2D> & krigingDataBeta,
+                                 const std::vector<KrigingData2D> & krigingDataRho,
+                                 FFTGrid                         *& bgAlpha,
+                                 FFTGrid                         *& bgBeta,
+                                 FFTGrid                         *& bgRho,
+                                 const float                      * trendAlpha,
+                                 const float                      * trendBeta,
+                                 const float                      * trendRho,
                                  const Simbox                     * simbox,
                                  const CovGrid2D                  & covGrid2D,
-                                 const std::string                & type,
-                                 bool                               isFile) const
+                                 bool                               isFile,
+                                 int                                nThreads) const
 {
-  std::string text = "\nBuilding "+type+" background:";
+  std::string text = "\nBuilding Vp, Vs and Rho background:";
   LogKit::LogFormatted(LogKit::Low,text);
 
   const int    nx   = simbox->getnx();
@@ -1485,10 +1516,18 @@ Background::makeKrigedBackground(const std::vector<KrigingData2D> & krigingData,
   const double lx   = simbox->getlx();
   const double ly   = simbox->getly();
 
+  const std::vector<KrigingData2D> * krigingData[3] = {&krigingDataAlpha, &krigingDataBeta, &krigingDataRho};
+  const float                      * trend[3]       = {trendAlpha, trendBeta, trendRho};
+  FFTGrid                          * bgGrid[3];
+
+  int blockSize = getKrigingBlockSize(nx, ny, nz);
+
   //
-  // Template surface to be kriged
+  // Template surfaces to be kriged, three for each layer in a block
   //
-  Surface surface(x0, y0, lx, ly, nx, ny, RMISSING);
+  std::vector<Surface *> surface(3*blockSize);
+  for (int s=0 ; s<3*blockSize ; s++)
+    surface[s] = new Surface(x0, y0, lx, ly, nx, ny, RMISSING);
 
   float monitorSize = std::max(1.0f, static_cast<float>(nz)*0.02f);
   float nextMonitor = monitorSize;
@@ -1497,38 +1536,64 @@ Background::makeKrigedBackground(const std::vector<KrigingData2D> & krigingData,
     << "\n  |    |    |    |    |    |    |    |    |    |    |  "
     << "\n  ^";
 
-  bgGrid = ModelGeneral::createFFTGrid(nx, ny, nz, nxp, nyp, nzp, isFile);
-  bgGrid->createRealGrid();
-  bgGrid->setType(FFTGrid::PARAMETER);
-  bgGrid->setAccessMode(FFTGrid::WRITE);
-
-  for (int k=0 ; k<nzp ; k++)
-  {
-    // Set trend for layer
-    surface.Assign(trend[k]);
+  for (int p=0 ; p<3 ; p++) {
+    bgGrid[p] = ModelGeneral::createFFTGrid(nx, ny, nz, nxp, nyp, nzp, isFile);
+    bgGrid[p]->createRealGrid();
+    bgGrid[p]->setType(FFTGrid::PARAMETER);
+    bgGrid[p]->setAccessMode(FFTGrid::WRITE);
+  }
 
-    // Kriging of layer
-    Kriging2D::krigSurface(surface, krigingData[k], covGrid2D);
+  Kriging2D::FactorCache cache;
 
-    // Set layer in background model from surface
-    for(int j=0 ; j<nyp ; j++) {
-      for(int i=0 ; i<rnxp ; i++) {
-        if(i<nxp)
-          bgGrid->setNextReal(float(surface(i,j)));
-        else
-          bgGrid->setNextReal(0);  //dummy in padding (but there is no padding)
+  for (int k0=0 ; k0<nzp ; k0+=blockSize)
+  {
+    int nLayers = std::min(blockSize, nzp - k0);
+
+    // Set trends for layers and krige all parameters of the block together
+    std::vector<Grid2D *>               trends(3*nLayers);
+    std::vector<const KrigingData2D *>  data(3*nLayers);
+    for (int l=0 ; l<nLayers ; l++) {
+      for (int p=0 ; p<3 ; p++) {
+        Surface * s = surface[3*l + p];
+        s->Assign(trend[p][k0 + l]);
+        trends[3*l + p] = s;
+        data[3*l + p]   = &(*krigingData[p])[k0 + l];
       }
     }
+    Kriging2D::krigSurfaces(trends, data, covGrid2D, cache, nThreads);
+
+    for (int l=0 ; l<nLayers ; l++) {
+      // Set layer in background model from surface
+      for (int p=0 ; p<3 ; p++) {
+        const Surface & s = *surface[3*l + p];
+        for(int j=0 ; j<nyp ; j++) {
+          for(int i=0 ; i<rnxp ; i++) {
+            if(i<nxp)
+              bgGrid[p]->setNextReal(float(s(i,j)));
+            else
+              bgGrid[p]->setNextReal(0);  //dummy in padding (but there is no padding)
+          }
+        }
+      }
 
-    // Log progress
-    if (k+1 >= static_cast<int>(nextMonitor))
-    {
-      nextMonitor += monitorSize;
-      std::cout << "^";
-      fflush(stdout);
+      // Log progress
+      if (k0+l+1 >= static_cast<int>(nextMonitor))
+      {
+        nextMonitor += monitorSize;
+        std::cout << "^";
+        fflush(stdout);
+      }
     }
   }
-  bgGrid->endAccess();
+
+  for (int p=0 ; p<3 ; p++)
+    bgGrid[p]->endAccess();
+  for (int s=0 ; s<3*blockSize ; s++)
+    delete surface[s];
+
+  bgAlpha = bgGrid[0];
+  bgBeta  = bgGrid[1];
+  bgRho   = bgGrid[2];
 }
 
 //---------------------------------------------------------------------------
@@ -1563,37 +1628,71 @@ Background::makeTrendZone(const float   * trend,
 
 //---------------------------------------------------------------------------
 void
-Background::makeKrigedZone(const std::vector<KrigingData2D> & krigingData,
-                           const float                      * trend,
-                           StormContGrid                    & kriged_zone,
-                           const CovGrid2D                  & covGrid2D) const
+Background::makeKrigedZone(const std::vector<KrigingData2D> & krigingDataAlpha,
+                           const std::vector<KrigingData2D> & krigingDataBeta,
+                           const std::vector<KrigingData2D> & krigingDataRho,
+                           const float                      * trendAlpha,
+                           const float                      * trendBeta,
+                           const float                      * trendRho,
+                           StormContGrid                    & alpha_zone,
+                           StormContGrid                    & beta_zone,
+                           StormContGrid                    & rho_zone,
+                           const CovGrid2D                  & covGrid2D,
+                           Kriging2D::FactorCache           & cache,
+                           int                                nThreads) const
 {
-  const size_t nx   = kriged_zone.GetNI();
-  const size_t ny   = kriged_zone.GetNJ();
-  const size_t nz   = kriged_zone.GetNK();
-
-  const double x0   = kriged_zone.GetXMin();
-  const double y0   = kriged_zone.GetYMin();
-  const double lx   = kriged_zone.GetLX();
-  const double ly   = kriged_zone.GetLY();
-  //
-  // Template surface to be kriged
-  //
-  Surface surface(x0, y0, lx, ly, nx, ny, RMISSING);
-  for (size_t k=0; k<nz; k++) {
+  const size_t nx   = alpha_zone.GetNI();
+  const size_t ny   = alpha_zone.GetNJ();
+  const size_t nz   = alpha_zone.GetNK();
 
-    // Set trend for layer
-    surface.Assign(trend[k]);
+  const double x0   = alpha_zone.GetXMin();
+  const double y0   = alpha_zone.GetYMin();
+  const double lx   = alpha_zone.GetLX();
+  const double ly   = alpha_zone.GetLY();
 
-    // Kriging of layer
-    Kriging2D::krigSurface(surface, krigingData[k], covGrid2D);
+  const std::vector<KrigingData2D> * krigingData[3] = {&krigingDataAlpha, &krigingDataBeta, &krigingDataRho};
+  const float                      * trend[3]       = {trendAlpha, trendBeta, trendRho};
+  StormContGrid                    * kriged_zone[3] = {&alpha_zone, &beta_zone, &rho_zone};
 
-    // Set layer in background model from surface
-    for(size_t j=0 ; j<ny; j++) {
-      for(size_t i=0 ; i<nx; i++)
-        kriged_zone(i,j,k) = float(surface(i,j));
+  int blockSize = getKrigingBlockSize(nx, ny, nz);
+
+  //
+  // Template surfaces to be kriged, three for each layer in a block
+  //
+  std::vector<Surface *> surface(3*blockSize);
+  for (int s=0 ; s<3*blockSize ; s++)
+    surface[s] = new Surface(x0, y0, lx, ly, nx, ny, RMISSING);
+
+  for (size_t k0=0; k0<nz; k0+=blockSize) {
+    int nLayers = static_cast<int>(std::min(static_cast<size_t>(blockSize), nz - k0));
+
+    // Set trends for layers and krige all parameters of the block together
+    std::vector<Grid2D *>               trends(3*nLayers);
+    std::vector<const KrigingData2D *>  data(3*nLayers);
+    for (int l=0 ; l<nLayers ; l++) {
+      for (int p=0 ; p<3 ; p++) {
+        Surface * s = surface[3*l + p];
+        s->Assign(trend[p][k0 + l]);
+        trends[3*l + p] = s;
+        data[3*l + p]   = &(*krigingData[p])[k0 + l];
+      }
+    }
+    Kriging2D::krigSurfaces(trends, data, covGrid2D, cache, nThreads);
+
+    // Set layers in background model from surfaces
+    for (int l=0 ; l<nLayers ; l++) {
+      for (int p=0 ; p<3 ; p++) {
+        const Surface & s = *surface[3*l + p];
+        for(size_t j=0 ; j<ny; j++) {
+          for(size_t i=0 ; i<nx; i++)
+            (*kriged_zone[p])(i,j,k0+l) = float(s(i,j));
+        }
+      }
     }
   }
+
+  for (int s=0 ; s<3*blockSize ; s++)
+    delete surface[s];
 }
 
 //-------------------------------------------------------------------------------
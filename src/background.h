@@ -9,6 +9,8 @@
 
 #include "nrlib/random/beta.hpp"
 
+#include "src/kriging2d.h"
+
 class Vario;
 class Simbox;
 class FFTGrid;
@@ -186,21 +188,37 @@ private:
                                   const std::vector<const int *>   jpos,
                                   const std::vector<const int *>   kpos) const;
 
-  void         makeKrigedBackground(const std::vector<KrigingData2D> & krigingData,
-                                    FFTGrid                         *& bgGrid,
-                                    const float                      * trend,
+  void         makeKrigedBackground(const std::vector<KrigingData2D> & krigingDataAlpha,
+                                    const std::vector<KrigingData2D> & krigingDataBeta,
+                                    const std::vector<KrigingData2D> & krigingDataRho,
+                                    FFTGrid                         *& bgAlpha,
+                                    FFTGrid                         *& bgBeta,
+                                    FFTGrid                         *& bgRho,
+                                    const float                      * trendAlpha,
+                                    const float                      * trendBeta,
+                                    const float                      * trendRho,
                                     const Simbox                     * simbox,
                                     const CovGrid2D                  & covGrid2D,
-                                    const std::string                & type,
-                                    bool                               isFile) const;
+                                    bool                               isFile,
+                                    int                                nThreads) const;
 
   void         makeTrendZone(const float   * trend,
                              StormContGrid & trend_zone) const;
 
-  void         makeKrigedZone(const std::vector<KrigingData2D> & krigingData,
-                              const float                      * trend,
-                              StormContGrid                    & kriged_zone,
-                              const CovGrid2D                  & covGrid2D) const;
+  void         makeKrigedZone(const std::vector<KrigingData2D> & krigingDataAlpha,
+                              const std::vector<KrigingData2D> & krigingDataBeta,
+                              const std::vector<KrigingData2D> & krigingDataRho,
+                              const float                      * trendAlpha,
+                              const float                      * trendBeta,
+                              const float                      * trendRho,
+                              StormContGrid                    & alpha_zone,
+                              StormContGrid                    & beta_zone,
+                              StormContGrid                    & rho_zone,
+                              const CovGrid2D                  & covGrid2D,
+                              Kriging2D::FactorCache           & cache,
+                              int                                nThreads) const;
+
+  static int   getKrigingBlockSize(size_t nx, size_t ny, size_t nz);
 
   void         MakeMultizoneBackground(FFTGrid                         *& bgAlpha,
                                        FFTGrid                         *& bgBeta,
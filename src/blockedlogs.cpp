@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <math.h>
 
 #include "nrlib/flens/nrlib_flens.hpp"
@@ -23,6 +24,7 @@
 #include "src/simbox.h"
 #include "src/modelsettings.h"
 #include "src/io.h"
+#include "src/fftplancache.h"
 
 BlockedLogs::BlockedLogs(WellData  * well,
                          Simbox    * simbox,
@@ -1569,8 +1571,8 @@ void BlockedLogs::fillInSeismic(float     * seismicData,
 
 }
 
-void BlockedLogs::estimateCor(fftw_complex * var1_c,
-                              fftw_complex * var2_c,
+void BlockedLogs::estimateCor(const fftw_complex * var1_c,
+                              const fftw_complex * var2_c,
                               fftw_complex * ccor_1_2_c,
                               int            cnzp) const
 {
@@ -1625,8 +1627,32 @@ void BlockedLogs::findContiniousPartOfData(const std::vector<bool> & hasData,
 }
 
 
-void BlockedLogs::findOptimalWellLocation(FFTGrid                   ** seisCube,
-                                          Simbox                     * timeSimbox,
+void BlockedLogs::getBlockedGridWindow(const FFTGrid      * grid,
+                                       int                  iMaxOffset,
+                                       int                  jMaxOffset,
+                                       NRLib::Grid<float> & window)
+{
+  int iTotOffset = 2*iMaxOffset+1;
+  int jTotOffset = 2*jMaxOffset+1;
+
+  window.Resize(iTotOffset, jTotOffset, nBlocks_);
+
+  float * seisLog = new float[nBlocks_];
+  for (int k = 0; k < iTotOffset; k++)
+  {
+    for (int l = 0; l < jTotOffset; l++)
+    {
+      getBlockedGrid(grid, seisLog, k-iMaxOffset, l-jMaxOffset);
+      for (int m = 0; m < nBlocks_; m++)
+        window(k, l, m) = seisLog[m];
+    }
+  }
+  delete [] seisLog;
+}
+
+void BlockedLogs::findOptimalWellLocation(const std::vector<NRLib::Grid<float> > & seisWindow,
+                                          const Simbox               * timeSimbox,
+                                          int                          nzp,
                                           float                     ** reflCoef,
                                           int                          nAngles,
                                           const std::vector<float>   & angleWeight,
@@ -1634,72 +1660,33 @@ void BlockedLogs::findOptimalWellLocation(FFTGrid                   ** seisCube,
                                           int                          iMaxOffset,
                                           int                          jMaxOffset,
                                           const std::vector<Surface *> limits,
+                                          bool                         coarseToFine,
+                                          int                          nThreads,
                                           int                        & iMove,
                                           int                        & jMove,
                                           float                      & kMove)
 {
-  int   polarity;
-  int   i,j,k,l,m;
-  int   start,length;
-  float sum;
-  float shiftF;
-  float maxTot;
+  // Each lateral offset is a candidate location, given by k*jTotOffset+l in the seismic
+  // window. Candidates are evaluated in parallel, and the best one is picked in this order,
+  // so the result does not depend on the number of threads. With coarseToFine, only every
+  // step'th offset is tried at first. The search then moves to better neighbours of the best
+  // location, halving the step length when there are none, and stops at step length one.
+  int   i,j;
   float f1,f2,f3;
+  float shiftF;
 
-  int nx            = seisCube[0]->getNx();
-  int ny            = seisCube[0]->getNy();
-  int nzp           = seisCube[0]->getNzp();
-  int cnzp          = nzp/2+1;
-  int rnzp          = 2*cnzp;
+  int nx            = timeSimbox->getnx();
+  int ny            = timeSimbox->getny();
+  int rnzp          = 2*(nzp/2+1);
   int iTotOffset    = 2*iMaxOffset+1;
   int jTotOffset    = 2*jMaxOffset+1;
-  int polarityMax   = 0;
   float shift       = 0.0f;
-  float maxValueTot = 0;
   float totalWeight = 0;
-  float dz          = static_cast<float>(timeSimbox->getdz());
 
-  float  * seisLog   = new float[nBlocks_];
-  float  * seisData  = new float[nLayers_];
   float  * alphaVert = new float[nLayers_];
   float  * betaVert  = new float[nLayers_];
   float  * rhoVert   = new float[nLayers_];
 
-
-  std::vector<int>   iOffset(iTotOffset);
-  std::vector<int>   jOffset(jTotOffset);
-  std::vector<int>   shiftI(nAngles);
-  std::vector<int>   shiftIMax(nAngles);
-  std::vector<float> maxValue(nAngles);
-  std::vector<float> maxValueMax(nAngles);
-
-  fftw_real    ** cpp_r               = new fftw_real*[nAngles];
-  fftw_complex ** cpp_c               = reinterpret_cast<fftw_complex**>(cpp_r);
-
-  fftw_real    ** cor_cpp_r           = new fftw_real*[nAngles];
-  fftw_complex ** cor_cpp_c           = reinterpret_cast<fftw_complex**>(cor_cpp_r);
-
-  fftw_real    ** seis_r              = new fftw_real*[nAngles];
-  fftw_complex ** seis_c              = reinterpret_cast<fftw_complex**>(seis_r);
-
-  fftw_real    ** ccor_seis_cpp_r     = new fftw_real*[nAngles];
-  fftw_complex ** ccor_seis_cpp_c     = reinterpret_cast<fftw_complex**>(ccor_seis_cpp_r);
-
-  fftw_real    ** ccor_seis_cpp_Max_r = new fftw_real*[nAngles];
-
-  for( i=0; i<nAngles; i++ ){
-    maxValueMax[i] = 0.0f;
-    shiftIMax[i]   = 0;
-  }
-
-  // make offset vectors
-  for(i=-iMaxOffset; i<iMaxOffset+1; i++){
-    iOffset[i+iMaxOffset]=i;
-  }
-  for(j=-jMaxOffset; j<jMaxOffset+1; j++){
-    jOffset[j+jMaxOffset]=j;
-  }
-
   getVerticalTrendLimited(alpha_, alphaVert, limits);
   getVerticalTrendLimited(beta_, betaVert, limits);
   getVerticalTrendLimited(rho_, rhoVert, limits);
@@ -1708,128 +1695,101 @@ void BlockedLogs::findOptimalWellLocation(FFTGrid                   ** seisCube,
   for(i = 0 ; i < nLayers_ ; i++) {
     hasData[i] = alphaVert[i] != RMISSING && betaVert[i] != RMISSING && rhoVert[i] != RMISSING;
   }
-  findContiniousPartOfData(hasData,nLayers_,start,length);
 
-  for( j=0; j<nAngles; j++ ){
-    seis_r[j]              = new fftw_real[rnzp];
-    cpp_r[j]               = new fftw_real[rnzp];
-    cor_cpp_r[j]           = new fftw_real[rnzp];
-    ccor_seis_cpp_r[j]     = new fftw_real[rnzp];
-    ccor_seis_cpp_Max_r[j] = new fftw_real[rnzp];
-  }
+  LocationSearch search;
+  search.seisWindow   = &seisWindow;
+  search.timeSimbox   = timeSimbox;
+  search.angleWeight  = &angleWeight;
+  search.planForward  = FFTPlanCache::getPlan1D(nzp, FFTW_REAL_TO_COMPLEX);
+  search.planBackward = FFTPlanCache::getPlan1D(nzp, FFTW_COMPLEX_TO_REAL);
+  search.nAngles      = nAngles;
+  search.nzp          = nzp;
+  search.iMaxOffset   = iMaxOffset;
+  search.jMaxOffset   = jMaxOffset;
+  search.maxShift     = maxShift;
+  findContiniousPartOfData(hasData,nLayers_,search.start,search.length);
 
   // Calculate reflection coefficients
+  search.cpp_r.resize(nAngles, std::vector<fftw_real>(rnzp, 0.0f));
   for( j=0; j<nAngles; j++ ){
-    for(i=0; i<rnzp; i++){
-      cpp_r[j][i] = 0;
-    }
-    fillInCpp(reflCoef[j],start,length,cpp_r[j],nzp);
-    Utils::fft(cpp_r[j],cpp_c[j],nzp);
-    estimateCor(cpp_c[j],cpp_c[j],cor_cpp_c[j],cnzp);
-    Utils::fftInv(cor_cpp_c[j],cor_cpp_r[j],nzp);
+    fillInCpp(reflCoef[j],search.start,search.length,&search.cpp_r[j][0],nzp);
+    rfftwnd_one_real_to_complex(search.planForward,&search.cpp_r[j][0],NULL);
   }
 
-  std::vector<NRLib::Grid<float> > seisCubeSmall(nAngles,NRLib::Grid<float> (iTotOffset,jTotOffset,nBlocks_));
-
-  for (j = 0 ; j < nAngles ; j++)
-  {
-    seisCube[j]->setAccessMode(FFTGrid::RANDOMACCESS);
-    for (k = 0; k < iTotOffset; k++)
-    {
-      for (l = 0; l < jTotOffset; l++)
-      {
-        getBlockedGrid(seisCube[j],seisLog,iOffset[k],jOffset[l]);
-        for (m = 0; m < nBlocks_; m++)
-        {
-          seisCubeSmall[j](k, l, m) = seisLog[m];
-        }
-      }
-    }
-    seisCube[j]->endAccess();
-  }
+  int step = 1;
+  if(coarseToFine)
+    step = std::max(1, std::max(iMaxOffset, jMaxOffset)/3);
 
-  // Loop through possible well locations
-  for(k=0; k<iTotOffset; k++){
-    if(ipos_[0]+iOffset[k]<0 || ipos_[0]+iOffset[k]>nx-1) //Check if position is within seismic range
+  std::vector<int> candidates;
+  for(int k=iMaxOffset%step; k<iTotOffset; k+=step){
+    if(ipos_[0]+k-iMaxOffset<0 || ipos_[0]+k-iMaxOffset>nx-1) //Check if position is within seismic range
       continue;
-
-    for(l=0; l<jTotOffset; l++){
-      if(jpos_[0]+jOffset[l]<0 || jpos_[0]+jOffset[l]>ny-1) //Check if position is within seismic range
+    for(int l=jMaxOffset%step; l<jTotOffset; l+=step){
+      if(jpos_[0]+l-jMaxOffset<0 || jpos_[0]+l-jMaxOffset>ny-1) //Check if position is within seismic range
         continue;
+      candidates.push_back(k*jTotOffset+l);
+    }
+  }
 
-      for( j=0; j<nAngles; j++ ){
-
-        for (m=0; m<nBlocks_; m++)
-          seisLog[m] = seisCubeSmall[j](k,l,m);
+  std::vector<bool>  evaluated(iTotOffset*jTotOffset, false);
+  std::vector<float> value(iTotOffset*jTotOffset, 0.0f);
+  int   best      = -1;
+  float bestValue = 0.0f;
 
-        getVerticalTrend(seisLog, seisData);
-        fillInSeismic(seisData,start,length,seis_r[j],nzp);
+  for(;;) {
+    evaluateWellLocations(search, candidates, nThreads, value);
 
-        Utils::fft(seis_r[j],seis_c[j],nzp);
-        estimateCor(seis_c[j],cpp_c[j],ccor_seis_cpp_c[j],cnzp);
-        Utils::fftInv(ccor_seis_cpp_c[j],ccor_seis_cpp_r[j],nzp);
-      }
-
-      // if the sum from -maxShift to maxShift ms is
-      // positive then polarity is positive
-      dz = static_cast<float>(timeSimbox->getRelThick(ipos_[0]+iOffset[k],jpos_[0]+jOffset[l])*timeSimbox->getdz());
-      sum = 0;
-      for( j=0; j<nAngles; j++ ){
-        if(angleWeight[j] > 0){
-          for(i=0;i<ceil(maxShift/dz);i++)//zero included
-            sum+=ccor_seis_cpp_r[j][i];
-          for(i=0;i<floor(maxShift/dz);i++)
-            sum+=ccor_seis_cpp_r[j][nzp-i-1];
-        }
-      }
-      polarity=-1;
-      if(sum > 0)
-        polarity=1;
-
-      // Find maximum correlation and corresponding shift for each angle
-      maxTot = 0.0;
-      for( j=0; j<nAngles; j++ ){
-        if(angleWeight[j]>0){
-          maxValue[j] = 0.0f;
-          shiftI[j]=0;
-          for(i=0;i<ceil(maxShift/dz);i++){
-            if(ccor_seis_cpp_r[j][i]*polarity > maxValue[j]){
-              maxValue[j] = ccor_seis_cpp_r[j][i]*polarity;
-              shiftI[j] = i;
-            }
-          }
-          for(i=0;i<floor(maxShift/dz);i++){
-            if(ccor_seis_cpp_r[j][nzp-1-i]*polarity > maxValue[j]){
-              maxValue[j] = ccor_seis_cpp_r[j][nzp-1-i]*polarity;
-              shiftI[j] = -1-i;
-            }
-          }
-          maxTot += angleWeight[j]*maxValue[j]; //Find weighted total maximum correlation
-        }
+    bool improved = false;
+    for(size_t c=0; c<candidates.size(); c++){
+      evaluated[candidates[c]] = true;
+      if(value[candidates[c]] > bestValue){
+        bestValue = value[candidates[c]];
+        best      = candidates[c];
+        improved  = true;
       }
+    }
+    if(!improved)
+      step /= 2;
+    if(!coarseToFine || best < 0 || step == 0)
+      break;
 
-      if(maxTot > maxValueTot){
-        maxValueTot = maxTot;
-        polarityMax = polarity;
-        iMove       = iOffset[k];
-        jMove       = jOffset[l];
-        for(m=0; m<nAngles; m++){
-          shiftIMax[m]   = shiftI[m];
-          maxValueMax[m] = maxValue[m];
-          for(i=0;i<rnzp;i++)
-            ccor_seis_cpp_Max_r[m][i] = ccor_seis_cpp_r[m][i];
-        }
+    candidates.clear();
+    int kBest = best/jTotOffset;
+    int lBest = best%jTotOffset;
+    for(int k=kBest-step; k<=kBest+step; k+=step){
+      if(k<0 || k>iTotOffset-1 || ipos_[0]+k-iMaxOffset<0 || ipos_[0]+k-iMaxOffset>nx-1)
+        continue;
+      for(int l=lBest-step; l<=lBest+step; l+=step){
+        if(l<0 || l>jTotOffset-1 || jpos_[0]+l-jMaxOffset<0 || jpos_[0]+l-jMaxOffset>ny-1)
+          continue;
+        if(!evaluated[k*jTotOffset+l])
+          candidates.push_back(k*jTotOffset+l);
       }
     }
   }
 
-  for(i=0; i<nAngles; i++){
-    shiftI[i] = shiftIMax[i];
-    maxValue[i] = maxValueMax[i];
-    for(j=0;j<rnzp;j++)
-      ccor_seis_cpp_r[i][j] = ccor_seis_cpp_Max_r[i][j];
+  delete [] alphaVert;
+  delete [] betaVert;
+  delete [] rhoVert;
+
+  if(best < 0){ // No location with positive correlation
+    iMove = 0;
+    jMove = 0;
+    kMove = 0.0f;
+    return;
   }
-  polarity = polarityMax;
+
+  iMove = best/jTotOffset - iMaxOffset;
+  jMove = best%jTotOffset - jMaxOffset;
+
+  LocationWork work(nAngles, nBlocks_, nLayers_, rnzp);
+  evaluateWellLocation(search, best/jTotOffset, best%jTotOffset, work);
+
+  int                 polarity        = work.polarity;
+  float               dz              = work.dz;
+  std::vector<int>  & shiftI          = work.shiftI;
+  std::vector<float>& maxValue        = work.maxValue;
+  std::vector<std::vector<fftw_real> > & ccor_seis_cpp_r = work.ccor_r;
 
   // Find kMove in optimal location
   for(j=0; j<nAngles; j++){
@@ -1876,25 +1836,107 @@ void BlockedLogs::findOptimalWellLocation(FFTGrid                   ** seisCube,
 
   shift/=totalWeight;
   kMove = shift;
+}
+
+void BlockedLogs::evaluateWellLocations(const LocationSearch   & search,
+                                        const std::vector<int> & candidates,
+                                        int                      nThreads,
+                                        std::vector<float>     & value)
+{
+  int jTotOffset  = 2*search.jMaxOffset+1;
+  int rnzp        = 2*(search.nzp/2+1);
+  int nCandidates = static_cast<int>(candidates.size());
+
+#pragma omp parallel num_threads(nThreads)
+  {
+    LocationWork work(search.nAngles, nBlocks_, nLayers_, rnzp);
+
+#pragma omp for schedule(dynamic,1)
+    for(int c = 0; c < nCandidates; c++)
+      value[candidates[c]] = evaluateWellLocation(search, candidates[c]/jTotOffset, candidates[c]%jTotOffset, work);
+  }
+}
+
+float BlockedLogs::evaluateWellLocation(const LocationSearch & search,
+                                        int                    k,
+                                        int                    l,
+                                        LocationWork         & work)
+{
+  // Returns the weighted maximum correlation between seismic and reflection coefficients for
+  // offset (k-iMaxOffset, l-jMaxOffset), and leaves the correlations and shifts in work.
+  int   i,j;
+  float sum;
+
+  int   nAngles  = search.nAngles;
+  int   nzp      = search.nzp;
+  int   cnzp     = nzp/2+1;
+  float maxShift = search.maxShift;
+  const std::vector<float> & angleWeight = *search.angleWeight;
+
+  std::vector<int>   & shiftI   = work.shiftI;
+  std::vector<float> & maxValue = work.maxValue;
+  fftw_real          * seis_r   = &work.seis_r[0];
+  fftw_complex       * seis_c   = reinterpret_cast<fftw_complex*>(seis_r);
 
   for( j=0; j<nAngles; j++ ){
-    delete [] ccor_seis_cpp_Max_r[j];
-    delete [] ccor_seis_cpp_r[j];
-    delete [] cor_cpp_r[j];
-    delete [] seis_r[j];
-    delete [] cpp_r[j];
+    const NRLib::Grid<float> & window = (*search.seisWindow)[j];
+    for (int m=0; m<nBlocks_; m++)
+      work.seisLog[m] = window(k,l,m);
+
+    getVerticalTrend(&work.seisLog[0], &work.seisData[0]);
+    fillInSeismic(&work.seisData[0],search.start,search.length,seis_r,nzp);
+
+    fftw_real    * ccor_r = &work.ccor_r[j][0];
+    fftw_complex * ccor_c = reinterpret_cast<fftw_complex*>(ccor_r);
+    rfftwnd_one_real_to_complex(search.planForward,seis_r,NULL);
+    estimateCor(seis_c,reinterpret_cast<const fftw_complex*>(&search.cpp_r[j][0]),ccor_c,cnzp);
+    rfftwnd_one_complex_to_real(search.planBackward,ccor_c,NULL);
+    for(i=0;i<nzp;i++)
+      ccor_r[i] *= fftw_real(1.0/double(nzp));
+  }
+  const std::vector<std::vector<fftw_real> > & ccor_seis_cpp_r = work.ccor_r;
+
+  // if the sum from -maxShift to maxShift ms is
+  // positive then polarity is positive
+  float dz = static_cast<float>(search.timeSimbox->getRelThick(ipos_[0]+k-search.iMaxOffset,jpos_[0]+l-search.jMaxOffset)*search.timeSimbox->getdz());
+  sum = 0;
+  for( j=0; j<nAngles; j++ ){
+    if(angleWeight[j] > 0){
+      for(i=0;i<ceil(maxShift/dz);i++)//zero included
+        sum+=ccor_seis_cpp_r[j][i];
+      for(i=0;i<floor(maxShift/dz);i++)
+        sum+=ccor_seis_cpp_r[j][nzp-i-1];
+    }
   }
-  delete [] alphaVert;
-  delete [] betaVert;
-  delete [] rhoVert;
-  delete [] seisLog;
-  delete [] seisData;
+  int polarity=-1;
+  if(sum > 0)
+    polarity=1;
 
-  delete [] ccor_seis_cpp_Max_r;
-  delete [] ccor_seis_cpp_r;
-  delete [] cor_cpp_r;
-  delete [] seis_r;
-  delete [] cpp_r;
+  // Find maximum correlation and corresponding shift for each angle
+  float maxTot = 0.0;
+  for( j=0; j<nAngles; j++ ){
+    if(angleWeight[j]>0){
+      maxValue[j] = 0.0f;
+      shiftI[j]=0;
+      for(i=0;i<ceil(maxShift/dz);i++){
+        if(ccor_seis_cpp_r[j][i]*polarity > maxValue[j]){
+          maxValue[j] = ccor_seis_cpp_r[j][i]*polarity;
+          shiftI[j] = i;
+        }
+      }
+      for(i=0;i<floor(maxShift/dz);i++){
+        if(ccor_seis_cpp_r[j][nzp-1-i]*polarity > maxValue[j]){
+          maxValue[j] = ccor_seis_cpp_r[j][nzp-1-i]*polarity;
+          shiftI[j] = -1-i;
+        }
+      }
+      maxTot += angleWeight[j]*maxValue[j]; //Find weighted total maximum correlation
+    }
+  }
+
+  work.polarity = polarity;
+  work.dz       = dz;
+  return(maxTot);
 }
 
 
@@ -9,7 +9,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include "fftw.h"
+#include "rfftw.h"
 #include "lib/utils.h"
+#include "nrlib/grid/grid.hpp"
 
 class ModelSettings;
 class FFTGrid;
@@ -77,10 +79,15 @@ public:
 
   void                      fillInCpp(const float * coeff,int start,int length,fftw_real* cpp_r,int nzp);
   void                      fillInSeismic(float* seismicData,int start,int length,fftw_real* seis_r,int nzp) const;
-  void                      estimateCor(fftw_complex* var1_c,fftw_complex* var2_c,fftw_complex* ccor_1_2_c,int cnzp) const;
+  void                      estimateCor(const fftw_complex* var1_c,const fftw_complex* var2_c,fftw_complex* ccor_1_2_c,int cnzp) const;
   void                      findContiniousPartOfData(const std::vector<bool> & hasData,int nz,int &start,int &length) const;
-  void                      findOptimalWellLocation(FFTGrid                   ** seisCube,
-                                                    Simbox                     * timeSimbox,
+  void                      getBlockedGridWindow(const FFTGrid      * grid,
+                                                 int                  iMaxOffset,
+                                                 int                  jMaxOffset,
+                                                 NRLib::Grid<float> & window);  // Blocked grid for all offsets, accessmode randomaccess
+  void                      findOptimalWellLocation(const std::vector<NRLib::Grid<float> > & seisWindow,
+                                                    const Simbox               * timeSimbox,
+                                                    int                          nzp,
                                                     float                     ** reflCoef,
                                                     int                          nAngles,
                                                     const std::vector<float>   & angleWeight,
@@ -88,6 +95,8 @@ public:
                                                     int                          iMaxOffset,
                                                     int                          jMaxOffset,
                                                     const std::vector<Surface *> limits,
+                                                    bool                         coarseToFine,
+                                                    int                          nThreads,
                                                     int                        & iMove,
                                                     int                        & jMove,
                                                     float                      & kMove);
@@ -157,6 +166,49 @@ public:
                                              int         nFacies,
                                              int         blockIndex);
 private:
+  struct LocationSearch                     // Input shared by all candidate locations in findOptimalWellLocation
+  {
+    const std::vector<NRLib::Grid<float> > * seisWindow;
+    const Simbox                           * timeSimbox;
+    const std::vector<float>               * angleWeight;
+    std::vector<std::vector<fftw_real> >     cpp_r;        // Transformed reflection coefficients, one per angle
+    rfftwnd_plan                             planForward;
+    rfftwnd_plan                             planBackward;
+    int                                      nAngles;
+    int                                      nzp;
+    int                                      start;
+    int                                      length;
+    int                                      iMaxOffset;
+    int                                      jMaxOffset;
+    float                                    maxShift;
+  };
+
+  struct LocationWork                       // Buffers and result for one candidate location
+  {
+    LocationWork(int nAngles, int nBlocks, int nLayers, int rnzp)
+      : seisLog(nBlocks), seisData(nLayers), seis_r(rnzp),
+        ccor_r(nAngles, std::vector<fftw_real>(rnzp)), shiftI(nAngles), maxValue(nAngles) {}
+
+    std::vector<float>                     seisLog;
+    std::vector<float>                     seisData;
+    std::vector<fftw_real>                 seis_r;
+    std::vector<std::vector<fftw_real> >   ccor_r;     // Cross correlation of seismic and reflection coefficients
+    std::vector<int>                       shiftI;
+    std::vector<float>                     maxValue;
+    int                                    polarity;
+    float                                  dz;
+  };
+
+  float                     evaluateWellLocation(const LocationSearch & search,
+                                                 int                    k,
+                                                 int                    l,
+                                                 LocationWork         & work);
+
+  void                      evaluateWellLocations(const LocationSearch   & search,
+                                                  const std::vector<int> & candidates,
+                                                  int                      nThreads,
+                                                  std::vector<float>     & value);
+
   void                      setLogFromVerticalTrend(float *& log, double * zpos, int nBlocks,
                                                     float * vertical_trend, double z0, double dz, int nz);
 
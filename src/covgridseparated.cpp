@@ -359,6 +359,30 @@ float CovGridSeparated::GetGamma2(int i1, int j1, int k1, int i2, int j2, int k2
   return GetGamma(deltai, deltaj, deltak);
 }
 
+float CovGridSeparated::GetGammaXY2(int i1, int j1, int i2, int j2) const {
+  assert(tabulateCorr_);
+  int deltai = i2 - i1;
+  int deltaj = j2 - j1;
+
+  if (abs(deltai) >= nxp_/2 || abs(deltaj) >= nyp_/2)
+    return 0.0f;
+
+  deltai = (deltai >= 0 ? deltai : nxp_ + deltai);
+  deltaj = (deltaj >= 0 ? deltaj : nyp_ + deltaj);
+  return gammaXY_[Get2DIndex(deltai, deltaj)];
+}
+
+float CovGridSeparated::GetGammaZ2(int k1, int k2) const {
+  assert(tabulateCorr_);
+  int deltak = k2 - k1;
+
+  if (abs(deltak) >= nzp_/2)
+    return 0.0f;
+
+  deltak = (deltak >= 0 ? deltak : nzp_ + deltak);
+  return gammaZ_[deltak];
+}
+
 float
 CovGridSeparated::GetGamma(int i, int j, int k) const {
   if (tabulateCorr_) {
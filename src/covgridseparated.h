@@ -22,6 +22,11 @@ public:
 
   float   GetGamma2(int i1, int j1, int k1, int i2, int j2, int k2) const; // returns RMISSING if it fails
   float   GetGamma(int i, int j, int k) const; // returns RMISSING if outside of simbox
+  bool    IsSeparable(void) const { return tabulateCorr_; }
+  // Lateral and vertical factors of GetGamma2 for separable grids. For valid indexes
+  // GetGamma2(i1,j1,k1,i2,j2,k2) equals GetGammaXY2(i1,j1,i2,j2)*GetGammaZ2(k1,k2).
+  float   GetGammaXY2(int i1, int j1, int i2, int j2) const;
+  float   GetGammaZ2(int k1, int k2) const;
   bool    IsIndexValid(int i, int j, int k) const;
   void    EstimateRanges(int& rangeX, int& rangeY, int& rangeZ) const;
   void    findTaperRanges(float & rangeX, float & rangeY, float & rangeZ) const;
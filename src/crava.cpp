@@ -27,6 +27,7 @@
 #include "src/qualitygrid.h"
 #include "src/io.h"
 #include "src/tasklist.h"
+#include "src/fftplancache.h"
 
 #include "lib/timekit.hpp"
 #include "lib/random.h"
@@ -35,6 +36,7 @@
 #include "nrlib/iotools/logkit.hpp"
 #include "nrlib/stormgrid/stormcontgrid.hpp"
 #include "nrlib/grid/grid2d.hpp"
+#include "nrlib/random/randomgenerator.hpp"
 #include "rplib/distributionsstoragekit.h"
 #include "rplib/distributionsrock.h"
 
@@ -65,134 +67,138 @@ Crava::Crava(ModelSettings           * modelSettings,
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
 
-  modelSettings_     = modelSettings;
-  modelGeneral_      = modelGeneral;
-  modelAVOstatic_    = modelAVOstatic;
-  modelAVOdynamic_   = modelAVOdynamic;
-
-  nx_                = seismicParameters.GetMuAlpha()->getNx();
-  ny_                = seismicParameters.GetMuAlpha()->getNy();
-  nz_                = seismicParameters.GetMuAlpha()->getNz();
-  nxp_               = seismicParameters.GetMuAlpha()->getNxp();
-  nyp_               = seismicParameters.GetMuAlpha()->getNyp();
-  nzp_               = seismicParameters.GetMuAlpha()->getNzp();
-  lowCut_            = modelSettings_->getLowCut();
-  highCut_           = modelSettings_->getHighCut();
-  wnc_               = modelSettings_->getWNC();     // white noise component see crava.h
-  energyTreshold_    = modelSettings_->getEnergyThreshold();
-  ntheta_            = modelAVOdynamic->getNumberOfAngles();
-  doing4DInversion_  = modelSettings->getDo4DInversion();
-  fileGrid_          = modelSettings_->getFileGrid();
-  outputGridsSeismic_= modelSettings_->getOutputGridsSeismic();
-  outputGridsElastic_= modelSettings_->getOutputGridsElastic();
-  writePrediction_   = modelSettings_->getWritePrediction();
-  krigingParameter_  = modelSettings_->getKrigingParameter();
-  nWells_            = modelSettings_->getNumberOfWells();
-  nSim_              = modelSettings_->getNumberOfSimulations();
-  wells_             = modelGeneral_->getWells();
-  simbox_            = modelGeneral_->getTimeSimbox();
-  meanAlpha_         = seismicParameters.GetMuAlpha();
-  meanBeta_          = seismicParameters.GetMuBeta();
-  meanRho_           = seismicParameters.GetMuRho();
-  random_            = modelGeneral_->getRandomGen();
-  seisWavelet_       = modelAVOdynamic_->getWavelets();
-  A_                 = modelAVOdynamic_->getAMatrix();
-  postAlpha_         = meanAlpha_;         // Write over the input to save memory
-  postBeta_          = meanBeta_;          // Write over the input to save memory
-  postRho_           = meanRho_;           // Write over the input to save memory
-  fprob_             = NULL;
-  thetaDeg_          = new float[ntheta_];
-  empSNRatio_        = new float[ntheta_];
-  theoSNRatio_       = new float[ntheta_];
-  modelVariance_     = new float[ntheta_];
-  signalVariance_    = new float[ntheta_];
-  errorVariance_     = new float[ntheta_];
-  dataVariance_      = new float[ntheta_];
-  scaleWarning_      = 0;
-  scaleWarningText_  = "";
-  errThetaCov_       = new double*[ntheta_];
-  sigmamdnew_        = NULL;
-  errCorr_           = NULL;
-
-  for(int i=0;i<ntheta_;i++) {
-    errThetaCov_[i]  = new double[ntheta_];
-    thetaDeg_[i]     = static_cast<float>(modelAVOdynamic_->getAngle(i)*180.0/NRLib::Pi);
-  }
-
   SpatialWellFilter * spatwellfilter = NULL;
 
-  // reality check: all dimensions involved match
-  assert(meanBeta_->consistentSize(nx_,ny_,nz_,nxp_,nyp_,nzp_));
-  assert(meanRho_->consistentSize(nx_,ny_,nz_,nxp_,nyp_,nzp_));
+  {
+    Timings::Region region("Stochastic model");
+
+    modelSettings_     = modelSettings;
+    modelGeneral_      = modelGeneral;
+    modelAVOstatic_    = modelAVOstatic;
+    modelAVOdynamic_   = modelAVOdynamic;
+
+    nx_                = seismicParameters.GetMuAlpha()->getNx();
+    ny_                = seismicParameters.GetMuAlpha()->getNy();
+    nz_                = seismicParameters.GetMuAlpha()->getNz();
+    nxp_               = seismicParameters.GetMuAlpha()->getNxp();
+    nyp_               = seismicParameters.GetMuAlpha()->getNyp();
+    nzp_               = seismicParameters.GetMuAlpha()->getNzp();
+    lowCut_            = modelSettings_->getLowCut();
+    highCut_           = modelSettings_->getHighCut();
+    wnc_               = modelSettings_->getWNC();     // white noise component see crava.h
+    energyTreshold_    = modelSettings_->getEnergyThreshold();
+    ntheta_            = modelAVOdynamic->getNumberOfAngles();
+    doing4DInversion_  = modelSettings->getDo4DInversion();
+    fileGrid_          = modelSettings_->getFileGrid();
+    outputGridsSeismic_= modelSettings_->getOutputGridsSeismic();
+    outputGridsElastic_= modelSettings_->getOutputGridsElastic();
+    writePrediction_   = modelSettings_->getWritePrediction();
+    krigingParameter_  = modelSettings_->getKrigingParameter();
+    nWells_            = modelSettings_->getNumberOfWells();
+    nSim_              = modelSettings_->getNumberOfSimulations();
+    nThreads_          = modelSettings_->getNumberOfThreads();
+    wells_             = modelGeneral_->getWells();
+    simbox_            = modelGeneral_->getTimeSimbox();
+    meanAlpha_         = seismicParameters.GetMuAlpha();
+    meanBeta_          = seismicParameters.GetMuBeta();
+    meanRho_           = seismicParameters.GetMuRho();
+    random_            = modelGeneral_->getRandomGen();
+    seisWavelet_       = modelAVOdynamic_->getWavelets();
+    A_                 = modelAVOdynamic_->getAMatrix();
+    postAlpha_         = meanAlpha_;         // Write over the input to save memory
+    postBeta_          = meanBeta_;          // Write over the input to save memory
+    postRho_           = meanRho_;           // Write over the input to save memory
+    fprob_             = NULL;
+    thetaDeg_          = new float[ntheta_];
+    empSNRatio_        = new float[ntheta_];
+    theoSNRatio_       = new float[ntheta_];
+    modelVariance_     = new float[ntheta_];
+    signalVariance_    = new float[ntheta_];
+    errorVariance_     = new float[ntheta_];
+    dataVariance_      = new float[ntheta_];
+    scaleWarning_      = 0;
+    scaleWarningText_  = "";
+    errThetaCov_       = new double*[ntheta_];
+    sigmamdnew_        = NULL;
+    errCorr_           = NULL;
+
+    for(int i=0;i<ntheta_;i++) {
+      errThetaCov_[i]  = new double[ntheta_];
+      thetaDeg_[i]     = static_cast<float>(modelAVOdynamic_->getAngle(i)*180.0/NRLib::Pi);
+    }
 
-  if(!modelSettings_->getForwardModeling()) {
-    priorVar0_      = seismicParameters.getPriorVar0();
-    seisData_       = modelAVOdynamic_->getSeisCubes();
-    modelAVOdynamic_->releaseGrids();
+    // reality check: all dimensions involved match
+    assert(meanBeta_->consistentSize(nx_,ny_,nz_,nxp_,nyp_,nzp_));
+    assert(meanRho_->consistentSize(nx_,ny_,nz_,nxp_,nyp_,nzp_));
 
-    if (modelSettings->getDoInversion() && spatwellfilter == NULL) {
-      spatwellfilter = new SpatialWellFilter(modelSettings->getNumberOfWells());
+    if(!modelSettings_->getForwardModeling()) {
+      priorVar0_      = seismicParameters.getPriorVar0();
+      seisData_       = modelAVOdynamic_->getSeisCubes();
+      modelAVOdynamic_->releaseGrids();
 
-      FFTGrid * alphaCov = seismicParameters.GetCovAlpha();
-      alphaCov->setAccessMode(FFTGrid::RANDOMACCESS);
+      if (modelSettings->getDoInversion() && spatwellfilter == NULL) {
+        spatwellfilter = new SpatialWellFilter(modelSettings->getNumberOfWells());
 
-      for(int i=0; i<nWells_; i++)
-        spatwellfilter->setPriorSpatialCorr(alphaCov, wells_[i], i);
+        FFTGrid * alphaCov = seismicParameters.GetCovAlpha();
+        alphaCov->setAccessMode(FFTGrid::RANDOMACCESS);
 
-      alphaCov->endAccess();
-    }
+        for(int i=0; i<nWells_; i++)
+          spatwellfilter->setPriorSpatialCorr(alphaCov, wells_[i], i);
 
-    float corrGradI, corrGradJ;
-    modelGeneral_->getCorrGradIJ(corrGradI, corrGradJ);
+        alphaCov->endAccess();
+      }
 
-    fftw_real * corrT = seismicParameters.extractParamCorrFromCovAlpha(nzp_);
+      float corrGradI, corrGradJ;
+      modelGeneral_->getCorrGradIJ(corrGradI, corrGradJ);
 
-    float dt = static_cast<float>(modelGeneral->getTimeSimbox()->getdz());
-    if((modelSettings_->getOtherOutputFlag() & IO::PRIORCORRELATIONS) > 0)
-      seismicParameters.writeFilePriorCorrT(corrT, nzp_, dt);
+      fftw_real * corrT = seismicParameters.extractParamCorrFromCovAlpha(nzp_);
 
-    errCorr_ = createFFTGrid();
-    errCorr_ ->setType(FFTGrid::COVARIANCE);
-    errCorr_ ->createRealGrid();
-    errCorr_->fillInErrCorr(modelGeneral->getPriorCorrXY(), corrGradI, corrGradJ); // errCorr_->fftInPlace();
+      float dt = static_cast<float>(modelGeneral->getTimeSimbox()->getdz());
+      if((modelSettings_->getOtherOutputFlag() & IO::PRIORCORRELATIONS) > 0)
+        seismicParameters.writeFilePriorCorrT(corrT, nzp_, dt);
 
-    for(int i=0 ; i< ntheta_ ; i++)
-      assert(seisData_[i]->consistentSize(nx_,ny_,nz_,nxp_,nyp_,nzp_));
+      errCorr_ = createFFTGrid();
+      errCorr_ ->setType(FFTGrid::COVARIANCE);
+      errCorr_ ->createRealGrid();
+      errCorr_->fillInErrCorr(modelGeneral->getPriorCorrXY(), corrGradI, corrGradJ); // errCorr_->fftInPlace();
 
-    computeVariances(corrT, modelSettings_);
-    scaleWarning_ = checkScale();  // fills in scaleWarningText_ if needed.
-    fftw_free(corrT);
+      for(int i=0 ; i< ntheta_ ; i++)
+        assert(seisData_[i]->consistentSize(nx_,ny_,nz_,nxp_,nyp_,nzp_));
 
-    if((modelSettings->getOtherOutputFlag() & IO::PRIORCORRELATIONS) > 0) {
-      float * corrTFiltered = seismicParameters.getPriorCorrTFiltered(nz_, nzp_);
-      seismicParameters.writeFilePriorCorrT(corrTFiltered, nzp_, dt);     // No zeros in the middle
-      delete [] corrTFiltered;
-    }
+      computeVariances(corrT, modelSettings_);
+      scaleWarning_ = checkScale();  // fills in scaleWarningText_ if needed.
+      fftw_free(corrT);
 
-    if(simbox_->getIsConstantThick() == false)
-      divideDataByScaleWavelet(seismicParameters);
+      if((modelSettings->getOtherOutputFlag() & IO::PRIORCORRELATIONS) > 0) {
+        float * corrTFiltered = seismicParameters.getPriorCorrTFiltered(nz_, nzp_);
+        seismicParameters.writeFilePriorCorrT(corrTFiltered, nzp_, dt);     // No zeros in the middle
+        delete [] corrTFiltered;
+      }
 
-    for(int i = 0 ; i < ntheta_ ; i++){
-      seisData_[i]->setAccessMode(FFTGrid::RANDOMACCESS);
-      seisData_[i]->fftInPlace();
-      seisData_[i]->endAccess();
-    }
+      if(simbox_->getIsConstantThick() == false)
+        divideDataByScaleWavelet(seismicParameters);
 
-    if ((modelSettings_->getEstimateFaciesProb() && modelSettings_->getFaciesProbRelative()) || modelAVOdynamic_->getUseLocalNoise())
-    {
-      meanAlpha2_ = copyFFTGrid(meanAlpha_);
-      meanBeta2_  = copyFFTGrid(meanBeta_);
-      meanRho2_   = copyFFTGrid(meanRho_);
-    }
+      for(int i = 0 ; i < ntheta_ ; i++){
+        seisData_[i]->setAccessMode(FFTGrid::RANDOMACCESS);
+        seisData_[i]->fftInPlace();
+        seisData_[i]->endAccess();
+      }
 
-    meanAlpha_->fftInPlace();
-    meanBeta_ ->fftInPlace();
-    meanRho_  ->fftInPlace();
-  }
-  else{
-    modelAVOdynamic_->releaseGrids();
-  }
+      if ((modelSettings_->getEstimateFaciesProb() && modelSettings_->getFaciesProbRelative()) || modelAVOdynamic_->getUseLocalNoise())
+      {
+        meanAlpha2_ = copyFFTGrid(meanAlpha_);
+        meanBeta2_  = copyFFTGrid(meanBeta_);
+        meanRho2_   = copyFFTGrid(meanRho_);
+      }
 
+      meanAlpha_->fftInPlace();
+      meanBeta_ ->fftInPlace();
+      meanRho_  ->fftInPlace();
+    }
+    else{
+      modelAVOdynamic_->releaseGrids();
+    }
+  }
   Timings::setTimeStochasticModel(wall,cpu);
 
   if(!modelSettings->getForwardModeling()){
@@ -241,7 +247,8 @@ Crava::Crava(ModelSettings           * modelSettings,
                                   activeAngles,
                                   this,
                                   modelAVOdynamic->getLocalNoiseScales(),
-                                  seismicParameters);
+                                  seismicParameters,
+                                  nThreads_);
     if (modelSettings->getEstimateFaciesProb()) {
       bool useFilter = modelSettings->getUseFilterForFaciesProb();
       computeFaciesProb(spatwellfilter, useFilter, seismicParameters);
@@ -591,7 +598,7 @@ Crava::checkScale(void)
 void
 Crava::divideDataByScaleWavelet(const SeismicParametersHolder & seismicParameters)
 {
-  int i,j,k,l,flag;
+  int i,j,k,l;
 
   fftw_real*    rData;
   fftw_real     tmp;
@@ -607,9 +614,8 @@ Crava::divideDataByScaleWavelet(const SeismicParametersHolder & seismicParameter
 
   Wavelet1D* localWavelet ;
 
-  flag   = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan1  = rfftwnd_create_plan(1,&nzp_,FFTW_REAL_TO_COMPLEX,flag);
-  plan2  = rfftwnd_create_plan(1,&nzp_,FFTW_COMPLEX_TO_REAL,flag);
+  plan1  = FFTPlanCache::getPlan1D(nzp_, FFTW_REAL_TO_COMPLEX);
+  plan2  = FFTPlanCache::getPlan1D(nzp_, FFTW_COMPLEX_TO_REAL);
 
   for(l=0 ; l< ntheta_ ; l++ )
   {
@@ -717,8 +723,6 @@ Crava::divideDataByScaleWavelet(const SeismicParametersHolder & seismicParameter
 
   fftw_free(rData);
   fftw_free(adjustmentFactor);
-  fftwnd_destroy_plan(plan1);
-  fftwnd_destroy_plan(plan2);
 }
 
 
@@ -738,8 +742,7 @@ Crava::computeAdjustmentFactor(fftw_complex                  * adjustmentFactor,
 
     // computes the time covariance for reflection coefficients rcCovT can be globaly stored
   fftw_real* rcCovT;
-  int flag   = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  rfftwnd_plan plan1  = rfftwnd_create_plan(1, &nzp_ ,FFTW_REAL_TO_COMPLEX,flag);
+  rfftwnd_plan plan1  = FFTPlanCache::getPlan1D(nzp_, FFTW_REAL_TO_COMPLEX);
   rcCovT = static_cast<fftw_real*>(fftw_malloc(2*(nzp_/2+1)*sizeof(fftw_real)));
   fftw_complex * rcSpecIntens = reinterpret_cast<fftw_complex*>(rcCovT);
 
@@ -812,14 +815,13 @@ Crava::computeAdjustmentFactor(fftw_complex                  * adjustmentFactor,
   delete errorSmooth;
   delete errorSmooth2;
   delete errorSmooth3;
-  fftwnd_destroy_plan(plan1);
   fftw_free(rcCovT);
 }
 
 void
 Crava::multiplyDataByScaleWaveletAndWriteToFile(const std::string & typeName)
 {
-  int i,j,k,l,flag;
+  int i,j,k,l;
 
   fftw_real*    rData;
   fftw_real     tmp;
@@ -830,9 +832,8 @@ Crava::multiplyDataByScaleWaveletAndWriteToFile(const std::string & typeName)
   rData  = static_cast<fftw_real*>(fftw_malloc(2*(nzp_/2+1)*sizeof(fftw_real)));
   cData  = reinterpret_cast<fftw_complex*>(rData);
 
-  flag   = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan1  = rfftwnd_create_plan(1, &nzp_ ,FFTW_REAL_TO_COMPLEX,flag);
-  plan2  = rfftwnd_create_plan(1,&nzp_,FFTW_COMPLEX_TO_REAL,flag);
+  plan1  = FFTPlanCache::getPlan1D(nzp_, FFTW_REAL_TO_COMPLEX);
+  plan2  = FFTPlanCache::getPlan1D(nzp_, FFTW_COMPLEX_TO_REAL);
 
   Wavelet1D* localWavelet;
 
@@ -880,8 +881,6 @@ Crava::multiplyDataByScaleWaveletAndWriteToFile(const std::string & typeName)
   }
 
   fftw_free(rData);
-  fftwnd_destroy_plan(plan1);
-  fftwnd_destroy_plan(plan2);
 }
 
 int
@@ -892,49 +891,9 @@ Crava::computePostMeanResidAndFFTCov(ModelGeneral            * modelGeneral,
 
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
+  Timings::Region region("Inversion");
   int i,j,k,l;
 
-  fftw_complex * kW          = new fftw_complex[ntheta_];
-
-  fftw_complex * errMult1    = new fftw_complex[ntheta_];
-  fftw_complex * errMult2    = new fftw_complex[ntheta_];
-  fftw_complex * errMult3    = new fftw_complex[ntheta_];
-
-  fftw_complex * ijkData     = new fftw_complex[ntheta_];
-  fftw_complex * ijkDataMean = new fftw_complex[ntheta_];
-  fftw_complex * ijkRes      = new fftw_complex[ntheta_];
-  fftw_complex * ijkMean     = new fftw_complex[3];
-  fftw_complex * ijkAns      = new fftw_complex[3];
-  fftw_complex   kD,kD3;
-
-  fftw_complex**  K  = new fftw_complex*[ntheta_];
-  for(i = 0; i < ntheta_; i++)
-    K[i] = new fftw_complex[3];
-
-  fftw_complex**  KS  = new fftw_complex*[ntheta_];
-  for(i = 0; i < ntheta_; i++)
-    KS[i] = new fftw_complex[3];
-
-  fftw_complex**  KScc  = new fftw_complex*[3]; // cc - complex conjugate (and transposed)
-  for(i = 0; i < 3; i++)
-    KScc[i] = new fftw_complex[ntheta_];
-
-  fftw_complex**  parVar = new fftw_complex*[3];
-  for(i = 0; i < 3; i++)
-    parVar[i] = new fftw_complex[3];
-
-  fftw_complex**  margVar = new fftw_complex*[ntheta_];
-  for(i = 0; i < ntheta_; i++)
-    margVar[i] = new fftw_complex[ntheta_];
-
-  fftw_complex**  errVar = new fftw_complex*[ntheta_];
-  for(i = 0; i < ntheta_; i++)
-    errVar[i] = new fftw_complex[ntheta_];
-
-  fftw_complex** reduceVar = new fftw_complex*[3];
-  for(i = 0; i < 3; i++)
-    reduceVar[i]= new fftw_complex[3];
-
   Wavelet1D * diff1Operator = new Wavelet1D(Wavelet::FIRSTORDERFORWARDDIFF,nz_,nzp_);
   Wavelet1D * diff2Operator = new Wavelet1D(diff1Operator,Wavelet::FIRSTORDERBACKWARDDIFF);
   Wavelet1D * diff3Operator = new Wavelet1D(diff2Operator,Wavelet::FIRSTORDERCENTRALDIFF);
@@ -982,6 +941,8 @@ Crava::computePostMeanResidAndFFTCov(ModelGeneral            * modelGeneral,
   meanBeta_ ->setAccessMode(FFTGrid::READANDWRITE);
   meanRho_  ->setAccessMode(FFTGrid::READANDWRITE);
 
+  seismicParameters.createPosteriorCovGrids();
+
   FFTGrid * postCovAlpha       = seismicParameters.GetCovAlpha();
   FFTGrid * postCovBeta        = seismicParameters.GetCovBeta();
   FFTGrid * postCovRho         = seismicParameters.GetCovRho();
@@ -1014,9 +975,6 @@ Crava::computePostMeanResidAndFFTCov(ModelGeneral            * modelGeneral,
 
   // Computes the posterior mean first  below the covariance is computed
   // To avoid to many grids in mind at the same time
-  double priorVarVp,justfactor;
-
-  int cholFlag;
   //   long int timestart, timeend;
   //   time(&timestart);
   float realFrequency;
@@ -1032,133 +990,77 @@ Crava::computePostMeanResidAndFFTCov(ModelGeneral            * modelGeneral,
   }
 
   LogKit::LogFormatted(LogKit::Low,"\nBuilding posterior distribution:");
-  float monitorSize = std::max(1.0f, static_cast<float>(nzp_)*0.02f);
-  float nextMonitor = monitorSize;
-  std::cout
-    << "\n  0%       20%       40%       60%       80%      100%"
-    << "\n  |    |    |    |    |    |    |    |    |    |    |  "
-    << "\n  ^";
 
-  for(k = 0; k < nzp_; k++)
-  {
-    realFrequency = static_cast<float>((nz_*1000.0f)/(simbox_->getlz()*nzp_)*std::min(k,nzp_-k)); // the physical frequency
-    kD = diff1Operator->getCAmp(k);                      // defines content of kD
-    if(simbox_->getIsConstantThick())
-    {
-      // defines content of K=WDA
-      fillkW(k, kW, seisWavelet_);
+  if(nThreads_ > 1 && !fileGrid_) {
+    computePosteriorSlabsParallel(seismicParameters, diff1Operator, diff3Operator, seisWaveletForNorm, errorSmooth3);
+  }
+  else {
+    float monitorSize = std::max(1.0f, static_cast<float>(nzp_)*0.02f);
+    float nextMonitor = monitorSize;
+    std::cout
+      << "\n  0%       20%       40%       60%       80%      100%"
+      << "\n  |    |    |    |    |    |    |    |    |    |    |  "
+      << "\n  ^";
 
-      lib_matrProdScalVecCpx(kD, kW, ntheta_);
-      lib_matrProdDiagCpxR(kW, A_, ntheta_, 3, K); // defines content of (WDA) K
+    PosteriorWorkspace ws(ntheta_);
 
-      // defines error-term multipliers
-      fillkWNorm(k,errMult1,seisWaveletForNorm);         // defines input of  (kWNorm) errMult1
-      fillkWNorm(k,errMult2,errorSmooth3);               // defines input of  (kWD3Norm) errMult2
-      lib_matrFillOnesVecCpx(errMult3,ntheta_);          // defines content of errMult3
-    }
-    else
+    for(k = 0; k < nzp_; k++)
     {
-      kD3 = diff3Operator->getCAmp(k);                   // defines  kD3
-
-      // defines content of K = DA
-      lib_matrFillValueVecCpx(kD, errMult1, ntheta_);    // errMult1 used as dummy
-      lib_matrProdDiagCpxR(errMult1, A_, ntheta_, 3, K); // defines content of ( K = DA )
-
-      // defines error-term multipliers
-      lib_matrFillOnesVecCpx(errMult1,ntheta_);          // defines content of errMult1
-      for(l=0; l < ntheta_; l++)
-      {
-        errMult1[l].re /= seisWavelet_[l]->getNorm();    // defines content of errMult1
-      }
-
-      lib_matrFillValueVecCpx(kD3,errMult2,ntheta_);     // defines content of errMult2
-      for(l=0; l < ntheta_; l++)
-      {
-        //float errorSmoothMult =  1.0f/errorSmooth3[l]->findNormWithinFrequencyBand(lowCut_,highCut_); // defines scaleFactor;
-        float errorSmoothMult =  1.0f/errorSmooth3[l]->getNorm(); // defines scaleFactor;
-        errMult2[l].re  *= errorSmoothMult; // defines content of errMult2
-        errMult2[l].im  *= errorSmoothMult; // defines content of errMult2
-      }
-      fillInverseAbskWRobust(k,errMult3,seisWaveletForNorm);// defines content of errMult3
-    }
-
-    for( j = 0; j < nyp_; j++) {
-      for( i = 0; i < cnxp; i++) {
-        ijkMean[0] = meanAlpha_->getNextComplex();
-        ijkMean[1] = meanBeta_ ->getNextComplex();
-        ijkMean[2] = meanRho_  ->getNextComplex();
+      realFrequency = static_cast<float>((nz_*1000.0f)/(simbox_->getlz()*nzp_)*std::min(k,nzp_-k)); // the physical frequency
+      bool invert_frequency = realFrequency > lowCut_*simbox_->getMinRelThick() &&  realFrequency < highCut_;
 
-        for(l = 0; l < ntheta_; l++ )
-        {
-          ijkData[l] = seisData_[l]->getNextComplex();
-          ijkRes[l]  = ijkData[l];
-        }
+      fillFrequencyOperators(k, diff1Operator, diff3Operator, seisWaveletForNorm, errorSmooth3, ws);
 
-        seismicParameters.getNextParameterCovariance(parVar);
-        bool invert_frequency = realFrequency > lowCut_*simbox_->getMinRelThick() &&  realFrequency < highCut_;
+      for( j = 0; j < nyp_; j++) {
+        for(int i0 = 0; i0 < cnxp; i0 += PosteriorBatch::BATCH_SIZE) {
+          int nCells = std::min(static_cast<int>(PosteriorBatch::BATCH_SIZE), cnxp - i0);
 
-        priorVarVp = parVar[0][0].re;
+          for(int c = 0; c < nCells; c++) {
+            ws.ijkMean[0] = meanAlpha_->getNextComplex();
+            ws.ijkMean[1] = meanBeta_ ->getNextComplex();
+            ws.ijkMean[2] = meanRho_  ->getNextComplex();
 
-        getNextErrorVariance(errVar, errMult1, errMult2, errMult3, ntheta_, wnc_, errThetaCov_, invert_frequency);
+            for(l = 0; l < ntheta_; l++ )
+              ws.ijkData[l] = seisData_[l]->getNextComplex();
 
-        if(invert_frequency){
-          lib_matrProdCpx(K, parVar , ntheta_, 3 ,3, KS);              //  KS is defined here
-          lib_matrProdAdjointCpx(KS, K, ntheta_, 3 ,ntheta_, margVar); // margVar = (K)S(K)' is defined here
-          lib_matrAddMatCpx(errVar, ntheta_,ntheta_, margVar);         // errVar  is added to margVar = (WDA)S(WDA)'  + errVar
+            seismicParameters.getNextParameterCovariance(ws.parVar);
 
-          cholFlag=lib_matrCholCpx(ntheta_,margVar);                   // Choleskey factor of margVar is Defined
+            getNextErrorVariance(ws.errVar, ws.errMult1, ws.errMult2, ws.errMult3, ntheta_, wnc_, errThetaCov_, invert_frequency);
 
-          if(cholFlag==0)
-          { // then it is ok else posterior is identical to prior
+            ws.batch.setCell(c, ws.parVar, ws.errVar, ws.ijkMean, ws.ijkData);
+          }
 
-            lib_matrAdjoint(KS,ntheta_,3,KScc);                        //  WDAScc is adjoint of WDAS
-            lib_matrAXeqBMatCpx(ntheta_, margVar, KS, 3);              // redefines WDAS
-            lib_matrProdCpx(KScc,KS,3,ntheta_,3,reduceVar);            // defines reduceVar
-            //double hj=1000000.0;
-            //if(reduceVar[0][0].im!=0)
-            // hj = MAXIM(reduceVar[0][0].re/reduceVar[0][0].im,-reduceVar[0][0].re/reduceVar[0][0].im); //NBNB DEBUG
-            lib_matrSubtMatCpx(reduceVar,3,3,parVar);                  // redefines parVar as the posterior solution
+          if(invert_frequency)
+            ws.batch.computePosterior(nCells);
 
-            lib_matrProdMatVecCpx(K,ijkMean, ntheta_, 3, ijkDataMean); //  defines content of ijkDataMean
-            lib_matrSubtVecCpx(ijkDataMean, ntheta_, ijkData);         //  redefines content of ijkData
+          for(int c = 0; c < nCells; c++) {
+            ws.batch.getCell(c, ws.parVar, ws.ijkMean, ws.ijkRes);
 
-            lib_matrProdAdjointMatVecCpx(KS,ijkData,3,ntheta_,ijkAns); // defines ijkAns
+            postAlpha_->setNextComplex(ws.ijkMean[0]);
+            postBeta_ ->setNextComplex(ws.ijkMean[1]);
+            postRho_  ->setNextComplex(ws.ijkMean[2]);
+            postCovAlpha->setNextComplex(ws.parVar[0][0]);
+            postCovBeta ->setNextComplex(ws.parVar[1][1]);
+            postCovRho  ->setNextComplex(ws.parVar[2][2]);
+            postCrCovAlphaBeta->setNextComplex(ws.parVar[0][1]);
+            postCrCovAlphaRho ->setNextComplex(ws.parVar[0][2]);
+            postCrCovBetaRho  ->setNextComplex(ws.parVar[1][2]);
 
-            lib_matrAddVecCpx(ijkAns, 3,ijkMean);                      // redefines ijkMean
-            lib_matrProdMatVecCpx(K,ijkMean, ntheta_, 3, ijkData);     // redefines ijkData
-            lib_matrSubtVecCpx(ijkData, ntheta_,ijkRes);               // redefines ijkRes
-          }
-
-          // quality control DEBUG
-          if(priorVarVp*4 < ijkAns[0].re*ijkAns[0].re + ijkAns[0].re*ijkAns[0].re)
-          {
-            justfactor = sqrt(ijkAns[0].re*ijkAns[0].re + ijkAns[0].re*ijkAns[0].re)/sqrt(priorVarVp);
+            for(l=0;l<ntheta_;l++)
+              seisData_[l]->setNextComplex(ws.ijkRes[l]);
           }
         }
-
-        postAlpha_->setNextComplex(ijkMean[0]);
-        postBeta_ ->setNextComplex(ijkMean[1]);
-        postRho_  ->setNextComplex(ijkMean[2]);
-        postCovAlpha->setNextComplex(parVar[0][0]);
-        postCovBeta ->setNextComplex(parVar[1][1]);
-        postCovRho  ->setNextComplex(parVar[2][2]);
-        postCrCovAlphaBeta->setNextComplex(parVar[0][1]);
-        postCrCovAlphaRho ->setNextComplex(parVar[0][2]);
-        postCrCovBetaRho  ->setNextComplex(parVar[1][2]);
-
-        for(l=0;l<ntheta_;l++)
-          seisData_[l]->setNextComplex(ijkRes[l]);
+      }
+      // Log progress
+      if (k+1 >= static_cast<int>(nextMonitor))
+      {
+        nextMonitor += monitorSize;
+        std::cout << "^";
+        fflush(stdout);
       }
     }
-    // Log progress
-    if (k+1 >= static_cast<int>(nextMonitor))
-    {
-      nextMonitor += monitorSize;
-      std::cout << "^";
-      fflush(stdout);
-    }
+    std::cout << "\n";
   }
-  std::cout << "\n";
 
   //  time(&timeend);
   // LogKit::LogFormatted(LogKit::Low,"\n Core inversion finished after %ld seconds ***\n",timeend-timestart);
@@ -1178,6 +1080,8 @@ Crava::computePostMeanResidAndFFTCov(ModelGeneral            * modelGeneral,
   postCrCovBetaRho  ->endAccess();
   errCorr_          ->endAccess();
 
+  seismicParameters.releaseCompactPrior();
+
   postAlpha_->invFFTInPlace();
   postBeta_ ->invFFTInPlace();
   postRho_  ->invFFTInPlace();
@@ -1248,50 +1152,248 @@ Crava::computePostMeanResidAndFFTCov(ModelGeneral            * modelGeneral,
   }
 
   delete [] seisData_;
-  delete [] kW;
-  delete [] errMult1;
-  delete [] errMult2;
-  delete [] errMult3;
-  delete [] ijkData;
-  delete [] ijkDataMean;
-  delete [] ijkRes;
-  delete [] ijkMean ;
-  delete [] ijkAns;
   delete    diff1Operator;
   delete    diff3Operator;
 
 
   for(i = 0; i < ntheta_; i++)
   {
-    delete[]  K[i];
-    delete[]  KS[i];
-    delete[]  margVar[i] ;
-    delete[] errVar[i] ;
     delete errorSmooth3[i];
     delete errorSmooth[i];
     delete seisWaveletForNorm[i];
   }
 
-  delete[] K;
-  delete[] KS;
-  delete[] margVar;
-  delete[] errVar  ;
   delete[] errorSmooth3;
   delete[] errorSmooth;
   delete[] seisWaveletForNorm;
 
+  Timings::setTimeInversion(wall,cpu);
+  return(0);
+}
+//--------------------------------------------------------------------
+void
+Crava::fillFrequencyOperators(int                  k,
+                              Wavelet1D          * diff1Operator,
+                              Wavelet1D          * diff3Operator,
+                              Wavelet1D         ** seisWaveletForNorm,
+                              Wavelet1D         ** errorSmooth3,
+                              PosteriorWorkspace & ws)
+{
+  // Sets up the forward operator K and the error-term multipliers for frequency index k.
+  // They depend on k only, and are shared by all (i,j) cells of the slab.
+  fftw_complex kD, kD3;
+
+  kD = diff1Operator->getCAmp(k);                            // defines content of kD
+  if(simbox_->getIsConstantThick())
+  {
+    // defines content of K=WDA
+    fillkW(k, ws.kW, seisWavelet_);
+
+    lib_matrProdScalVecCpx(kD, ws.kW, ntheta_);
+    lib_matrProdDiagCpxR(ws.kW, A_, ntheta_, 3, ws.K);       // defines content of (WDA) K
+
+    // defines error-term multipliers
+    fillkWNorm(k,ws.errMult1,seisWaveletForNorm);            // defines input of  (kWNorm) errMult1
+    fillkWNorm(k,ws.errMult2,errorSmooth3);                  // defines input of  (kWD3Norm) errMult2
+    lib_matrFillOnesVecCpx(ws.errMult3,ntheta_);             // defines content of errMult3
+  }
+  else
+  {
+    kD3 = diff3Operator->getCAmp(k);                         // defines  kD3
+
+    // defines content of K = DA
+    lib_matrFillValueVecCpx(kD, ws.errMult1, ntheta_);       // errMult1 used as dummy
+    lib_matrProdDiagCpxR(ws.errMult1, A_, ntheta_, 3, ws.K); // defines content of ( K = DA )
+
+    // defines error-term multipliers
+    lib_matrFillOnesVecCpx(ws.errMult1,ntheta_);             // defines content of errMult1
+    for(int l=0; l < ntheta_; l++)
+    {
+      ws.errMult1[l].re /= seisWavelet_[l]->getNorm();       // defines content of errMult1
+    }
+
+    lib_matrFillValueVecCpx(kD3,ws.errMult2,ntheta_);        // defines content of errMult2
+    for(int l=0; l < ntheta_; l++)
+    {
+      //float errorSmoothMult =  1.0f/errorSmooth3[l]->findNormWithinFrequencyBand(lowCut_,highCut_); // defines scaleFactor;
+      float errorSmoothMult =  1.0f/errorSmooth3[l]->getNorm(); // defines scaleFactor;
+      ws.errMult2[l].re  *= errorSmoothMult; // defines content of errMult2
+      ws.errMult2[l].im  *= errorSmoothMult; // defines content of errMult2
+    }
+    fillInverseAbskWRobust(k,ws.errMult3,seisWaveletForNorm);// defines content of errMult3
+  }
+
+  ws.batch.setForwardOperator(ws.K);
+}
+//--------------------------------------------------------------------
+void
+Crava::computePosteriorSlabsParallel(SeismicParametersHolder & seismicParameters,
+                                     Wavelet1D               * diff1Operator,
+                                     Wavelet1D               * diff3Operator,
+                                     Wavelet1D              ** seisWaveletForNorm,
+                                     Wavelet1D              ** errorSmooth3)
+{
+  // Threaded version of the frequency loop in computePostMeanResidAndFFTCov. The z-slabs
+  // are distributed over the threads, and each thread has its own workspace. Cells are
+  // accessed through row pointers, so all grids must be held in memory. Each cell is computed
+  // exactly as in the serial loop, so the result does not depend on the number of threads.
+  FFTGrid * postCovAlpha       = seismicParameters.GetCovAlpha();
+  FFTGrid * postCovBeta        = seismicParameters.GetCovBeta();
+  FFTGrid * postCovRho         = seismicParameters.GetCovRho();
+  FFTGrid * postCrCovAlphaBeta = seismicParameters.GetCrCovAlphaBeta();
+  FFTGrid * postCrCovAlphaRho  = seismicParameters.GetCrCovAlphaRho();
+  FFTGrid * postCrCovBetaRho   = seismicParameters.GetCrCovBetaRho();
+
+  int   cnxp        = nxp_/2+1;
+  int   nDone       = 0;
+  float monitorSize = std::max(1.0f, static_cast<float>(nzp_)*0.02f);
+  float nextMonitor = monitorSize;
+
+  LogKit::LogFormatted(LogKit::Low,"\n  Using %d threads", nThreads_);
+  std::cout
+    << "\n  0%       20%       40%       60%       80%      100%"
+    << "\n  |    |    |    |    |    |    |    |    |    |    |  "
+    << "\n  ^";
+
+#pragma omp parallel num_threads(nThreads_)
+  {
+    PosteriorWorkspace          ws(ntheta_);
+    std::vector<fftw_complex *> seisRow(ntheta_);
+
+#pragma omp for schedule(dynamic,1)
+    for(int k = 0; k < nzp_; k++)
+    {
+      float realFrequency   = static_cast<float>((nz_*1000.0f)/(simbox_->getlz()*nzp_)*std::min(k,nzp_-k)); // the physical frequency
+      bool invert_frequency = realFrequency > lowCut_*simbox_->getMinRelThick() &&  realFrequency < highCut_;
+
+      fillFrequencyOperators(k, diff1Operator, diff3Operator, seisWaveletForNorm, errorSmooth3, ws);
+
+      for(int j = 0; j < nyp_; j++) {
+        const fftw_complex * meanAlphaRow = meanAlpha_->getComplexRow(j, k);
+        const fftw_complex * meanBetaRow  = meanBeta_ ->getComplexRow(j, k);
+        const fftw_complex * meanRhoRow   = meanRho_  ->getComplexRow(j, k);
+        const fftw_complex * errCorrRow   = errCorr_  ->getComplexRow(j, k);
+
+        fftw_complex * postAlphaRow = postAlpha_->getWritableComplexRow(j, k);
+        fftw_complex * postBetaRow  = postBeta_ ->getWritableComplexRow(j, k);
+        fftw_complex * postRhoRow   = postRho_  ->getWritableComplexRow(j, k);
+
+        fftw_complex * covAlphaRow       = postCovAlpha      ->getWritableComplexRow(j, k);
+        fftw_complex * covBetaRow        = postCovBeta       ->getWritableComplexRow(j, k);
+        fftw_complex * covRhoRow         = postCovRho        ->getWritableComplexRow(j, k);
+        fftw_complex * crCovAlphaBetaRow = postCrCovAlphaBeta->getWritableComplexRow(j, k);
+        fftw_complex * crCovAlphaRhoRow  = postCrCovAlphaRho ->getWritableComplexRow(j, k);
+        fftw_complex * crCovBetaRhoRow   = postCrCovBetaRho  ->getWritableComplexRow(j, k);
+
+        for(int l = 0; l < ntheta_; l++)
+          seisRow[l] = seisData_[l]->getWritableComplexRow(j, k);
+
+        for(int i0 = 0; i0 < cnxp; i0 += PosteriorBatch::BATCH_SIZE) {
+          int nCells = std::min(static_cast<int>(PosteriorBatch::BATCH_SIZE), cnxp - i0);
+
+          for(int c = 0; c < nCells; c++) {
+            int i = i0 + c;
+            ws.ijkMean[0] = meanAlphaRow[i];
+            ws.ijkMean[1] = meanBetaRow[i];
+            ws.ijkMean[2] = meanRhoRow[i];
+
+            for(int l = 0; l < ntheta_; l++ )
+              ws.ijkData[l] = seisRow[l][i];
+
+            seismicParameters.getParameterCovariance(i, j, k, ws.parVar);
+
+            computeErrorVariance(ws.errVar, errCorrRow[i], ws.errMult1, ws.errMult2, ws.errMult3,
+                                 ntheta_, wnc_, errThetaCov_, invert_frequency);
+
+            ws.batch.setCell(c, ws.parVar, ws.errVar, ws.ijkMean, ws.ijkData);
+          }
+
+          if(invert_frequency)
+            ws.batch.computePosterior(nCells);
+
+          for(int c = 0; c < nCells; c++) {
+            int i = i0 + c;
+            ws.batch.getCell(c, ws.parVar, ws.ijkMean, ws.ijkRes);
+
+            postAlphaRow[i]      = ws.ijkMean[0];
+            postBetaRow[i]       = ws.ijkMean[1];
+            postRhoRow[i]        = ws.ijkMean[2];
+            covAlphaRow[i]       = ws.parVar[0][0];
+            covBetaRow[i]        = ws.parVar[1][1];
+            covRhoRow[i]         = ws.parVar[2][2];
+            crCovAlphaBetaRow[i] = ws.parVar[0][1];
+            crCovAlphaRhoRow[i]  = ws.parVar[0][2];
+            crCovBetaRhoRow[i]   = ws.parVar[1][2];
+
+            for(int l=0;l<ntheta_;l++)
+              seisRow[l][i] = ws.ijkRes[l];
+          }
+        }
+      }
+
+#pragma omp critical
+      {
+        // Log progress
+        nDone++;
+        if (nDone >= static_cast<int>(nextMonitor))
+        {
+          nextMonitor += monitorSize;
+          std::cout << "^";
+          fflush(stdout);
+        }
+      }
+    }
+  }
+  std::cout << "\n";
+}
+//--------------------------------------------------------------------
+Crava::PosteriorWorkspace::PosteriorWorkspace(int nTheta)
+  : ntheta(nTheta),
+    batch(nTheta)
+{
+  int i;
+  kW          = new fftw_complex[ntheta];
+  errMult1    = new fftw_complex[ntheta];
+  errMult2    = new fftw_complex[ntheta];
+  errMult3    = new fftw_complex[ntheta];
+  ijkData     = new fftw_complex[ntheta];
+  ijkRes      = new fftw_complex[ntheta];
+  ijkMean     = new fftw_complex[3];
+
+  K = new fftw_complex*[ntheta];
+  for(i = 0; i < ntheta; i++)
+    K[i] = new fftw_complex[3];
+
+  parVar = new fftw_complex*[3];
   for(i = 0; i < 3; i++)
+    parVar[i] = new fftw_complex[3];
+
+  errVar = new fftw_complex*[ntheta];
+  for(i = 0; i < ntheta; i++)
+    errVar[i] = new fftw_complex[ntheta];
+}
+//--------------------------------------------------------------------
+Crava::PosteriorWorkspace::~PosteriorWorkspace()
+{
+  delete [] kW;
+  delete [] errMult1;
+  delete [] errMult2;
+  delete [] errMult3;
+  delete [] ijkData;
+  delete [] ijkRes;
+  delete [] ijkMean;
+
+  for(int i = 0; i < ntheta; i++)
   {
-    delete[] KScc[i];
-    delete[] parVar[i] ;
-    delete[] reduceVar[i];
+    delete [] K[i];
+    delete [] errVar[i];
   }
-  delete[] KScc;
-  delete[] parVar;
-  delete[] reduceVar;
+  delete [] K;
+  delete [] errVar;
 
-  Timings::setTimeInversion(wall,cpu);
-  return(0);
+  for(int i = 0; i < 3; i++)
+    delete [] parVar[i];
+  delete [] parVar;
 }
 //--------------------------------------------------------------------
 void
@@ -1304,10 +1406,23 @@ Crava::getNextErrorVariance(fftw_complex **& errVar,
                             double        ** errThetaCov,
                             bool             invert_frequency) const
 {
-  fftw_complex ijkErrLam;
-  fftw_complex ijkTmp;
+  fftw_complex ijkTmp = errCorr_->getNextComplex();
 
-  ijkTmp = errCorr_->getNextComplex();
+  computeErrorVariance(errVar, ijkTmp, errMult1, errMult2, errMult3, ntheta, wnc, errThetaCov, invert_frequency);
+}
+//--------------------------------------------------------------------
+void
+Crava::computeErrorVariance(fftw_complex **& errVar,
+                            fftw_complex     ijkTmp,
+                            fftw_complex   * errMult1,
+                            fftw_complex   * errMult2,
+                            fftw_complex   * errMult3,
+                            int              ntheta,
+                            float            wnc,
+                            double        ** errThetaCov,
+                            bool             invert_frequency) const
+{
+  fftw_complex ijkErrLam;
 
   ijkErrLam.re        = float( sqrt(ijkTmp.re * ijkTmp.re));
   ijkErrLam.im        = 0.0;
@@ -1405,7 +1520,10 @@ Crava::doPredictionKriging(SeismicParametersHolder & seismicParameters)
   if(writePrediction_ == true) { //No need to do this if output not requested.
     double wall2=0.0, cpu2=0.0;
     TimeKit::getTime(wall2,cpu2);
-    doPostKriging(seismicParameters, *postAlpha_, *postBeta_, *postRho_);
+    {
+      Timings::Region region("Kriging");
+      doPostKriging(seismicParameters, *postAlpha_, *postBeta_, *postRho_);
+    }
     Timings::setTimeKrigingPred(wall2,cpu2);
     ParameterOutput::writeParameters(simbox_, modelGeneral_, modelSettings_, postAlpha_, postBeta_, postRho_,
                                      outputGridsElastic_, fileGrid_, -1, true);
@@ -1419,8 +1537,13 @@ Crava::simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomG
 
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
+  Timings::Region region("Simulation");
 
-  if(nSim_>0)
+  if(nSim_>0 && modelSettings_->getConcurrentSimulations() > 0 && !fileGrid_)
+  {
+    simulateConcurrent(seismicParameters, randomGen);
+  }
+  else if(nSim_>0)
   {
     bool kriging = (krigingParameter_ > 0);
     FFTGrid * postCovAlpha       = seismicParameters.GetCovAlpha();
@@ -1437,7 +1560,7 @@ Crava::simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomG
     assert( postCrCovAlphaRho->getIsTransformed() );
     assert( postCrCovBetaRho->getIsTransformed() );
 
-    int             simNr,i,j,k,l;
+    int             simNr,j,k,l;
     fftw_complex ** ijkPostCov;
     fftw_complex *  ijkSeed;
     FFTGrid *       seed0;
@@ -1450,6 +1573,8 @@ Crava::simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomG
 
     ijkSeed = new fftw_complex[3];
 
+    CholeskyVecBatch cholBatch;
+
     seed0 =  createFFTGrid();
     seed1 =  createFFTGrid();
     seed2 =  createFFTGrid();
@@ -1478,46 +1603,43 @@ Crava::simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomG
       seed2 ->setAccessMode(FFTGrid::READANDWRITE);
 
       int cnxp=nxp_/2+1;
-      int cholFlag;
       for(k = 0; k < nzp_; k++)
         for(j = 0; j < nyp_; j++)
-          for(i = 0; i < cnxp; i++)
+          for(int i0 = 0; i0 < cnxp; i0 += CholeskyVecBatch::BATCH_SIZE)
           {
-            ijkPostCov[0][0] = postCovAlpha      ->getNextComplex();
-            ijkPostCov[1][1] = postCovBeta       ->getNextComplex();
-            ijkPostCov[2][2] = postCovRho        ->getNextComplex();
-            ijkPostCov[0][1] = postCrCovAlphaBeta->getNextComplex();
-            ijkPostCov[0][2] = postCrCovAlphaRho ->getNextComplex();
-            ijkPostCov[1][2] = postCrCovBetaRho  ->getNextComplex();
-
-            ijkPostCov[1][0].re =  ijkPostCov[0][1].re;
-            ijkPostCov[1][0].im = -ijkPostCov[0][1].im;
-            ijkPostCov[2][0].re =  ijkPostCov[0][2].re;
-            ijkPostCov[2][0].im = -ijkPostCov[0][2].im;
-            ijkPostCov[2][1].re =  ijkPostCov[1][2].re;
-            ijkPostCov[2][1].im = -ijkPostCov[1][2].im;
-
-            ijkSeed[0]=seed0->getNextComplex();
-            ijkSeed[1]=seed1->getNextComplex();
-            ijkSeed[2]=seed2->getNextComplex();
-
-            cholFlag = lib_matrCholCpx(3,ijkPostCov);  // Choleskey factor of posterior covariance write over ijkPostCov
-            if(cholFlag == 0)
+            int nCells = std::min(static_cast<int>(CholeskyVecBatch::BATCH_SIZE), cnxp - i0);
+            for(int c = 0; c < nCells; c++)
             {
-              lib_matrProdCholVec(3,ijkPostCov,ijkSeed); // write over ijkSeed
+              ijkPostCov[0][0] = postCovAlpha      ->getNextComplex();
+              ijkPostCov[1][1] = postCovBeta       ->getNextComplex();
+              ijkPostCov[2][2] = postCovRho        ->getNextComplex();
+              ijkPostCov[0][1] = postCrCovAlphaBeta->getNextComplex();
+              ijkPostCov[0][2] = postCrCovAlphaRho ->getNextComplex();
+              ijkPostCov[1][2] = postCrCovBetaRho  ->getNextComplex();
+
+              ijkPostCov[1][0].re =  ijkPostCov[0][1].re;
+              ijkPostCov[1][0].im = -ijkPostCov[0][1].im;
+              ijkPostCov[2][0].re =  ijkPostCov[0][2].re;
+              ijkPostCov[2][0].im = -ijkPostCov[0][2].im;
+              ijkPostCov[2][1].re =  ijkPostCov[1][2].re;
+              ijkPostCov[2][1].im = -ijkPostCov[1][2].im;
+
+              ijkSeed[0]=seed0->getNextComplex();
+              ijkSeed[1]=seed1->getNextComplex();
+              ijkSeed[2]=seed2->getNextComplex();
+
+              cholBatch.setCell(c, ijkPostCov, ijkSeed);
             }
-            else
-            {
-              for(l=0; l< 3;l++)
-              {
-                ijkSeed[l].re =0.0;
-                ijkSeed[l].im = 0.0;
-              }
 
+            cholBatch.computeProduct(nCells);  // Choleskey factor of posterior covariance times seed
+
+            for(int c = 0; c < nCells; c++)
+            {
+              cholBatch.getCell(c, ijkSeed);
+              seed0->setNextComplex(ijkSeed[0]);
+              seed1->setNextComplex(ijkSeed[1]);
+              seed2->setNextComplex(ijkSeed[2]);
             }
-            seed0->setNextComplex(ijkSeed[0]);
-            seed1->setNextComplex(ijkSeed[1]);
-            seed2->setNextComplex(ijkSeed[2]);
           }
 
           postCovAlpha->endAccess();  //
@@ -1534,52 +1656,7 @@ Crava::simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomG
           // printf("Simulation in FFT domain in %ld seconds \n",timeend-timestart);
           // time(&timestart);
 
-          seed0->setAccessMode(FFTGrid::RANDOMACCESS);
-          seed0->invFFTInPlace();
-
-          seed1->setAccessMode(FFTGrid::RANDOMACCESS);
-          seed1->invFFTInPlace();
-
-
-          seed2->setAccessMode(FFTGrid::RANDOMACCESS);
-          seed2->invFFTInPlace();
-
-          if(modelAVOdynamic_->getUseLocalNoise()==true)
-          {
-            float alpha,beta, rho;
-            float alphanew, betanew, rhonew;
-
-            for(j=0;j<ny_;j++)
-              for(i=0;i<nx_;i++)
-                for(k=0;k<nz_;k++)
-                {
-                  alpha = seed0->getRealValue(i,j,k);
-                  beta = seed1->getRealValue(i,j,k);
-                  rho = seed2->getRealValue(i,j,k);
-                  alphanew = float((*sigmamdnew_)(i,j)[0][0]*alpha+ (*sigmamdnew_)(i,j)[0][1]*beta+(*sigmamdnew_)(i,j)[0][2]*rho);
-                  betanew = float((*sigmamdnew_)(i,j)[1][0]*alpha+ (*sigmamdnew_)(i,j)[1][1]*beta+(*sigmamdnew_)(i,j)[1][2]*rho);
-                  rhonew = float((*sigmamdnew_)(i,j)[2][0]*alpha+ (*sigmamdnew_)(i,j)[2][1]*beta+(*sigmamdnew_)(i,j)[2][2]*rho);
-                  seed0->setRealValue(i,j,k,alphanew);
-                  seed1->setRealValue(i,j,k,betanew);
-                  seed2->setRealValue(i,j,k,rhonew);
-                }
-          }
-
-          seed0->add(postAlpha_);
-          seed0->endAccess();
-          seed1->add(postBeta_);
-          seed1->endAccess();
-          seed2->add(postRho_);
-          seed2->endAccess();
-
-          if(kriging == true) {
-            double wall2=0.0, cpu2=0.0;
-            TimeKit::getTime(wall2,cpu2);
-            doPostKriging(seismicParameters, *seed0, *seed1, *seed2);
-            Timings::addToTimeKrigingSim(wall2,cpu2);
-          }
-          ParameterOutput::writeParameters(simbox_, modelGeneral_, modelSettings_, seed0, seed1, seed2,
-                                           outputGridsElastic_, fileGrid_, simNr, kriging);
+          completeSimulation(seismicParameters, seed0, seed1, seed2, simNr, kriging);
           // time(&timeend);
           // printf("Back transform and write of simulation in %ld seconds \n",timeend-timestart);
     }
@@ -1598,6 +1675,189 @@ Crava::simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomG
   return(0);
 }
 
+void
+Crava::completeSimulation(SeismicParametersHolder & seismicParameters,
+                          FFTGrid                 * seed0,
+                          FFTGrid                 * seed1,
+                          FFTGrid                 * seed2,
+                          int                       simNr,
+                          bool                      kriging)
+{
+  // Takes the seeds multiplied by the Cholesky factor of the posterior covariance back
+  // to the time domain, adds the posterior mean, and writes the realisation.
+  seed0->setAccessMode(FFTGrid::RANDOMACCESS);
+  seed0->invFFTInPlace();
+
+  seed1->setAccessMode(FFTGrid::RANDOMACCESS);
+  seed1->invFFTInPlace();
+
+  seed2->setAccessMode(FFTGrid::RANDOMACCESS);
+  seed2->invFFTInPlace();
+
+  if(modelAVOdynamic_->getUseLocalNoise()==true)
+  {
+    float alpha,beta, rho;
+    float alphanew, betanew, rhonew;
+
+    for(int j=0;j<ny_;j++)
+      for(int i=0;i<nx_;i++)
+        for(int k=0;k<nz_;k++)
+        {
+          alpha = seed0->getRealValue(i,j,k);
+          beta = seed1->getRealValue(i,j,k);
+          rho = seed2->getRealValue(i,j,k);
+          alphanew = float((*sigmamdnew_)(i,j)[0][0]*alpha+ (*sigmamdnew_)(i,j)[0][1]*beta+(*sigmamdnew_)(i,j)[0][2]*rho);
+          betanew = float((*sigmamdnew_)(i,j)[1][0]*alpha+ (*sigmamdnew_)(i,j)[1][1]*beta+(*sigmamdnew_)(i,j)[1][2]*rho);
+          rhonew = float((*sigmamdnew_)(i,j)[2][0]*alpha+ (*sigmamdnew_)(i,j)[2][1]*beta+(*sigmamdnew_)(i,j)[2][2]*rho);
+          seed0->setRealValue(i,j,k,alphanew);
+          seed1->setRealValue(i,j,k,betanew);
+          seed2->setRealValue(i,j,k,rhonew);
+        }
+  }
+
+  seed0->add(postAlpha_);
+  seed0->endAccess();
+  seed1->add(postBeta_);
+  seed1->endAccess();
+  seed2->add(postRho_);
+  seed2->endAccess();
+
+  if(kriging == true) {
+    double wall2=0.0, cpu2=0.0;
+    TimeKit::getTime(wall2,cpu2);
+    {
+      Timings::Region region("Kriging");
+      doPostKriging(seismicParameters, *seed0, *seed1, *seed2);
+    }
+    Timings::addToTimeKrigingSim(wall2,cpu2);
+  }
+  ParameterOutput::writeParameters(simbox_, modelGeneral_, modelSettings_, seed0, seed1, seed2,
+                                   outputGridsElastic_, fileGrid_, simNr, kriging);
+}
+
+void
+Crava::simulateConcurrent(SeismicParametersHolder & seismicParameters, RandomGen * randomGen)
+{
+  bool kriging = (krigingParameter_ > 0);
+  int  nGroup  = std::min(modelSettings_->getConcurrentSimulations(), nSim_);
+
+  // Each realisation in a group needs three seed grids, which must fit within the memory limit.
+  int  nFit    = std::max(1, (FFTGrid::getMaxAllowedGrids() - FFTGrid::getNumberOfGrids())/3);
+  if(nGroup > nFit) {
+    LogKit::LogFormatted(LogKit::Low,"\nThe number of concurrent simulations is reduced from %d to %d to stay within the memory limit.\n", nGroup, nFit);
+    nGroup = nFit;
+  }
+
+  LogKit::LogFormatted(LogKit::Low,"\nGenerating %d realisations at a time, each from its own random stream.\n", nGroup);
+
+  FFTGrid * postCov[6];
+  postCov[0] = seismicParameters.GetCovAlpha();
+  postCov[1] = seismicParameters.GetCovBeta();
+  postCov[2] = seismicParameters.GetCovRho();
+  postCov[3] = seismicParameters.GetCrCovAlphaBeta();
+  postCov[4] = seismicParameters.GetCrCovAlphaRho();
+  postCov[5] = seismicParameters.GetCrCovBetaRho();
+  for(int l=0;l<6;l++)
+    assert( postCov[l]->getIsTransformed() );
+
+  // The stream of each realisation is seeded from the common generator in realisation
+  // order, so realisation i is the same whatever the group size and number of threads.
+  std::vector<unsigned long> streamSeed(nSim_);
+  for(int simNr=0;simNr<nSim_;simNr++)
+    streamSeed[simNr] = static_cast<unsigned long>(randomGen->unif01()*4294967296.0);
+
+  std::vector<FFTGrid *> seed(3*nGroup);
+  for(int n=0;n<3*nGroup;n++) {
+    seed[n] = createFFTGrid();
+    seed[n]->createComplexGrid();
+  }
+
+  int cnxp = nxp_/2+1;
+
+  for(int first=0;first<nSim_;first+=nGroup)
+  {
+    int nReal = std::min(nGroup, nSim_-first);
+
+#pragma omp parallel for num_threads(nThreads_) schedule(dynamic,1)
+    for(int b=0;b<nReal;b++) {
+      NRLib::RandomGenerator ranGen;
+      ranGen.Initialize(streamSeed[first+b]);
+      seed[3*b  ]->fillInComplexNoise(ranGen);
+      seed[3*b+1]->fillInComplexNoise(ranGen);
+      seed[3*b+2]->fillInComplexNoise(ranGen);
+    }
+
+    // One pass over the posterior covariance for the whole group. The Cholesky factor
+    // of each cell is found once and multiplied with the seeds of every realisation.
+#pragma omp parallel num_threads(nThreads_)
+    {
+      fftw_complex    cov[3][3];
+      fftw_complex  * ijkPostCov[3] = {cov[0], cov[1], cov[2]};
+      fftw_complex    ijkSeed[3];
+      fftw_complex    zero[3];
+      for(int l=0;l<3;l++) {
+        zero[l].re = 0.0f;
+        zero[l].im = 0.0f;
+      }
+      CholeskyVecBatch cholBatch;
+
+#pragma omp for schedule(dynamic,1)
+      for(int k=0;k<nzp_;k++)
+      {
+        for(int j=0;j<nyp_;j++)
+        {
+          for(int i0=0;i0<cnxp;i0+=CholeskyVecBatch::BATCH_SIZE)
+          {
+            int nCells = std::min(static_cast<int>(CholeskyVecBatch::BATCH_SIZE), cnxp - i0);
+            for(int c=0;c<nCells;c++)
+            {
+              ijkPostCov[0][0] = postCov[0]->getComplexValue(i0+c, j, k, true);
+              ijkPostCov[1][1] = postCov[1]->getComplexValue(i0+c, j, k, true);
+              ijkPostCov[2][2] = postCov[2]->getComplexValue(i0+c, j, k, true);
+              ijkPostCov[0][1] = postCov[3]->getComplexValue(i0+c, j, k, true);
+              ijkPostCov[0][2] = postCov[4]->getComplexValue(i0+c, j, k, true);
+              ijkPostCov[1][2] = postCov[5]->getComplexValue(i0+c, j, k, true);
+
+              ijkPostCov[1][0].re =  ijkPostCov[0][1].re;
+              ijkPostCov[1][0].im = -ijkPostCov[0][1].im;
+              ijkPostCov[2][0].re =  ijkPostCov[0][2].re;
+              ijkPostCov[2][0].im = -ijkPostCov[0][2].im;
+              ijkPostCov[2][1].re =  ijkPostCov[1][2].re;
+              ijkPostCov[2][1].im = -ijkPostCov[1][2].im;
+
+              cholBatch.setCell(c, ijkPostCov, zero);
+            }
+            cholBatch.factorize(nCells);
+
+            for(int b=0;b<nReal;b++)
+            {
+              for(int c=0;c<nCells;c++)
+              {
+                for(int l=0;l<3;l++)
+                  ijkSeed[l] = seed[3*b+l]->getComplexValue(i0+c, j, k, true);
+                cholBatch.setVector(c, ijkSeed);
+              }
+              cholBatch.multiplyFactor(nCells);
+              for(int c=0;c<nCells;c++)
+              {
+                cholBatch.getCell(c, ijkSeed);
+                for(int l=0;l<3;l++)
+                  seed[3*b+l]->setComplexValue(i0+c, j, k, ijkSeed[l], true);
+              }
+            }
+          }
+        }
+      }
+    }
+
+    for(int b=0;b<nReal;b++)
+      completeSimulation(seismicParameters, seed[3*b], seed[3*b+1], seed[3*b+2], first+b, kriging);
+  }
+
+  for(int n=0;n<3*nGroup;n++)
+    delete seed[n];
+}
+
 void
 Crava::doPostKriging(SeismicParametersHolder & seismicParameters,
                      FFTGrid                 & postAlpha,
@@ -1626,7 +1886,7 @@ Crava::doPostKriging(SeismicParametersHolder & seismicParameters,
                          covGridCrAlphaBeta, covGridCrAlphaRho, covGridCrBetaRho,
                          krigingParameter_);
 
-  pKriging.KrigAll(postAlpha, postBeta, postRho, false, modelSettings_->getDebugFlag(), modelSettings_->getDoSmoothKriging());
+  pKriging.KrigAll(postAlpha, postBeta, postRho, false, modelSettings_->getDebugFlag(), modelSettings_->getDoSmoothKriging(), nThreads_);
 }
 
 FFTGrid *
@@ -1896,6 +2156,7 @@ Crava::computeFaciesProb(SpatialWellFilter             * filteredlogs,
 
     double wall=0.0, cpu=0.0;
     TimeKit::getTime(wall,cpu);
+    Timings::Region region("Facies probabilities");
 
     std::vector<std::string> facies_names = modelGeneral_->getFaciesNames();
     int nfac = static_cast<int>(facies_names.size());
@@ -2079,8 +2340,7 @@ Crava::computeFaciesProb(SpatialWellFilter             * filteredlogs,
         FFTGrid * grid = fprob_->createLHCube(likelihood, i,
                                               modelGeneral_->getPriorFacies(), modelGeneral_->getPriorFaciesCubes());
         std::string fileName = IO::PrefixLikelihood() + facies_names[i];
-        ParameterOutput::writeToFile(simbox_, modelGeneral_, modelSettings_, grid,fileName,"");
-        delete grid;
+        ParameterOutput::writeToFile(simbox_, modelGeneral_, modelSettings_, grid,fileName,"", false, true);
       }
     }
 
@@ -8,6 +8,7 @@
 #include "fftw.h"
 #include "definitions.h"
 #include "libs/nrlib/flens/nrlib_flens.hpp"
+#include "lib/lib_matrbatch.h"
 
 class ModelGeneral;
 class ModelAVOStatic;
@@ -64,6 +65,27 @@ public:
                                        NRLib::SymmetricMatrix & posteriorCov) const;
 
 private:
+  // Scratch arrays for the posterior update of one frequency cell. Every thread
+  // working on the inversion needs its own copy.
+  struct PosteriorWorkspace
+  {
+    PosteriorWorkspace(int ntheta);
+    ~PosteriorWorkspace();
+
+    int              ntheta;
+    fftw_complex   * kW;
+    fftw_complex   * errMult1;
+    fftw_complex   * errMult2;
+    fftw_complex   * errMult3;
+    fftw_complex   * ijkData;
+    fftw_complex   * ijkRes;
+    fftw_complex   * ijkMean;
+    fftw_complex  ** K;
+    fftw_complex  ** parVar;
+    fftw_complex  ** errVar;
+    PosteriorBatch   batch;
+  };
+
   void                   computeDataVariance(void);
   void                   setupErrorCorrelation(const std::vector<Grid2D *> & noiseScale);
 
@@ -77,7 +99,25 @@ private:
   float                  getErrorVariance(int l)  const { return errorVariance_[l]  ;}
   float                  getDataVariance(int l)   const { return dataVariance_[l]   ;}
   int                simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomGen );
+  void               simulateConcurrent(SeismicParametersHolder & seismicParameters, RandomGen * randomGen);
+  void               completeSimulation(SeismicParametersHolder & seismicParameters,
+                                        FFTGrid                 * seed0,
+                                        FFTGrid                 * seed1,
+                                        FFTGrid                 * seed2,
+                                        int                       simNr,
+                                        bool                      kriging);
   int                computePostMeanResidAndFFTCov(ModelGeneral * modelGeneral);
+  void               fillFrequencyOperators(int                  k,
+                                            Wavelet1D          * diff1Operator,
+                                            Wavelet1D          * diff3Operator,
+                                            Wavelet1D         ** seisWaveletForNorm,
+                                            Wavelet1D         ** errorSmooth3,
+                                            PosteriorWorkspace & ws);
+  void               computePosteriorSlabsParallel(SeismicParametersHolder & seismicParameters,
+                                                   Wavelet1D               * diff1Operator,
+                                                   Wavelet1D               * diff3Operator,
+                                                   Wavelet1D              ** seisWaveletForNorm,
+                                                   Wavelet1D              ** errorSmooth3);
   void               printEnergyToScreen();
   void               computeSyntSeismic(FFTGrid * alpha, FFTGrid * beta, FFTGrid * rho);
   void               computeFaciesProb(SpatialWellFilter       * filteredlogs,
@@ -143,6 +183,16 @@ private:
                                               double        ** errThetaCov,
                                               bool             invert_frequency) const;
 
+  void                   computeErrorVariance(fftw_complex **& errVar,
+                                              fftw_complex     ijkTmp,
+                                              fftw_complex   * errMult1,
+                                              fftw_complex   * errMult2,
+                                              fftw_complex   * errMult3,
+                                              int              ntheta,
+                                              float            wnc,
+                                              double        ** errThetaCov,
+                                              bool             invert_frequency) const;
+
   bool               fileGrid_;         // is true if is storage is on file
   const Simbox     * simbox_;           // the simbox
   int                nx_;               // dimensions of the problem
@@ -157,6 +207,7 @@ private:
   float              highCut_;          // highest frequency that is inverted
 
   int                nSim_;             // number of simulations
+  int                nThreads_;         // number of threads used in the parallelised parts of the inversion
   float            * thetaDeg_;         // in degrees
 
   FFTGrid          * meanAlpha_;        // mean values
@@ -1,5 +1,7 @@
 #include <time.h>
 
+#include "nrlib/iotools/stringtools.hpp"
+
 #include "src/crava.h"
 #include "src/spatialwellfilter.h"
 #include "src/modelsettings.h"
@@ -10,6 +12,7 @@
 #include "src/modelgeneral.h"
 #include "src/seismicparametersholder.h"
 #include "src/simbox.h"
+#include "src/timings.h"
 
 void setupStaticModels(ModelGeneral            *& modelGeneral,
                        ModelAVOStatic          *& modelAVOstatic,
@@ -40,31 +43,36 @@ bool doFirstAVOInversion(ModelSettings           * modelSettings,
                          int                       vintage,
                          Simbox                  * timeBGSimbox)
 {
+  Timings::Region region("Vintage " + NRLib::ToString(vintage));
 
   ModelAVODynamic * modelAVOdynamic = NULL;
 
   // Wells are adjusted by ModelAVODynamic constructor.
-  modelAVOdynamic = new ModelAVODynamic(modelSettings,
-                                        inputFiles,
-                                        modelGeneral->getFailedDetails(),
-                                        modelAVOstatic->getFailedDetails(),
-                                        modelGeneral->getTimeSimbox(),
-                                        timeBGSimbox,
-                                        modelGeneral->getCorrelationDirection(),
-                                        modelGeneral->getRandomGen(),
-                                        modelGeneral->getTimeDepthMapping(),
-                                        modelGeneral->getTimeCutMapping(),
-                                        modelAVOstatic->getWaveletEstimInterval(),
-                                        modelAVOstatic->getWellMoveInterval(),
-                                        modelAVOstatic->getFaciesEstimInterval(),
-                                        modelAVOstatic,
-                                        modelGeneral,
-                                        vintage,
-                                        seismicParameters);
+  {
+    Timings::Region dynamicRegion("Dynamic model");
+    modelAVOdynamic = new ModelAVODynamic(modelSettings,
+                                          inputFiles,
+                                          modelGeneral->getFailedDetails(),
+                                          modelAVOstatic->getFailedDetails(),
+                                          modelGeneral->getTimeSimbox(),
+                                          timeBGSimbox,
+                                          modelGeneral->getCorrelationDirection(),
+                                          modelGeneral->getRandomGen(),
+                                          modelGeneral->getTimeDepthMapping(),
+                                          modelGeneral->getTimeCutMapping(),
+                                          modelAVOstatic->getWaveletEstimInterval(),
+                                          modelAVOstatic->getWellMoveInterval(),
+                                          modelAVOstatic->getFaciesEstimInterval(),
+                                          modelAVOstatic,
+                                          modelGeneral,
+                                          vintage,
+                                          seismicParameters);
+  }
 
   bool failedLoadingModel = modelAVOdynamic == NULL || modelAVOdynamic->getFailed();
 
   if(failedLoadingModel == false){
+    Timings::Region cravaRegion("Crava");
 
     Crava * crava = new Crava(modelSettings, modelGeneral, modelAVOstatic, modelAVOdynamic, seismicParameters);
 
@@ -86,22 +94,28 @@ bool doTimeLapseAVOInversion(ModelSettings           * modelSettings,
                              SeismicParametersHolder & seismicParameters,
                              int                       vintage)
 {
+  Timings::Region region("Vintage " + NRLib::ToString(vintage));
+
   ModelAVODynamic * modelAVOdynamic = NULL;
 
-  modelAVOdynamic = new ModelAVODynamic(modelSettings,
-                                        inputFiles,
-                                        modelAVOstatic,
-                                        modelGeneral,
-                                        seismicParameters,
-                                        modelGeneral->getTimeSimbox(),
-                                        modelGeneral->getCorrelationDirection(),
-                                        modelGeneral->getTimeDepthMapping(),
-                                        modelGeneral->getTimeCutMapping(),
-                                        vintage);
+  {
+    Timings::Region dynamicRegion("Dynamic model");
+    modelAVOdynamic = new ModelAVODynamic(modelSettings,
+                                          inputFiles,
+                                          modelAVOstatic,
+                                          modelGeneral,
+                                          seismicParameters,
+                                          modelGeneral->getTimeSimbox(),
+                                          modelGeneral->getCorrelationDirection(),
+                                          modelGeneral->getTimeDepthMapping(),
+                                          modelGeneral->getTimeCutMapping(),
+                                          vintage);
+  }
 
   bool failedLoadingModel = modelAVOdynamic == NULL || modelAVOdynamic->getFailed();
 
   if(failedLoadingModel == false) {
+    Timings::Region cravaRegion("Crava");
 
     Crava * crava = new Crava(modelSettings, modelGeneral, modelAVOstatic, modelAVOdynamic, seismicParameters);
 
@@ -122,6 +136,8 @@ doTimeLapseTravelTimeInversion(const ModelSettings           * modelSettings,
                                const int                     & vintage,
                                SeismicParametersHolder       & /*seismicParameters*/)
 {
+  Timings::Region region("Vintage " + NRLib::ToString(vintage));
+
   ModelTravelTimeDynamic * modelTravelTimeDynamic = NULL;
 
   modelTravelTimeDynamic = new ModelTravelTimeDynamic(modelSettings,
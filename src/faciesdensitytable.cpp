@@ -0,0 +1,178 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <math.h>
+#include <algorithm>
+
+#include "src/faciesdensitytable.h"
+#include "src/fftgrid.h"
+#include "src/simbox.h"
+
+FaciesDensityTable::FaciesDensityTable(const std::vector<std::vector<FFTGrid *> > & density,
+                                       const std::vector<Simbox *>                & volume)
+  : nFacies_(0)
+{
+  int nLevels = static_cast<int>(density.size());
+  if(nLevels > 0)
+    nFacies_ = static_cast<int>(density[0].size());
+
+  volume_.resize(nLevels);
+  table_.resize(nLevels);
+  for(int i=0;i<nLevels;i++) {
+    volume_[i] = volume[i];
+    int nx = volume[i]->getnx();
+    int ny = volume[i]->getny();
+    int nz = volume[i]->getnz();
+    std::vector<float> & table = table_[i];
+    table.resize(static_cast<size_t>(nx)*ny*nz*nFacies_);
+    for(int f=0;f<nFacies_;f++) {
+      density[i][f]->setAccessMode(FFTGrid::RANDOMACCESS);
+      size_t index = f;
+      for(int l=0;l<nz;l++) {
+        for(int k=0;k<ny;k++) {
+          for(int j=0;j<nx;j++) {
+            table[index] = std::max<float>(0,density[i][f]->getRealValue(j,k,l));
+            index       += nFacies_;
+          }
+        }
+      }
+      density[i][f]->endAccess();
+    }
+  }
+}
+
+void
+FaciesDensityTable::findDensities(float                      alpha,
+                                  float                      beta,
+                                  float                      rho,
+                                  const std::vector<float> & t,
+                                  int                        nAng,
+                                  float                    * dens) const
+{
+  interpolate<float>(alpha, beta, rho, t, nAng, dens);
+}
+
+void
+FaciesDensityTable::findPdfDensities(double                     vp,
+                                     double                     vs,
+                                     double                     rho,
+                                     const std::vector<float> & t,
+                                     int                        nAng,
+                                     float                    * dens) const
+{
+  interpolate<double>(vp, vs, rho, t, nAng, dens);
+}
+
+template <typename Sum>
+void
+FaciesDensityTable::interpolate(double                     x,
+                                double                     y,
+                                double                     z,
+                                const std::vector<float> & t,
+                                int                        nAng,
+                                float                    * dens) const
+{
+  for(int f=0;f<nFacies_;f++)
+    dens[f] = 0.0f;
+
+  int nLevels = static_cast<int>(table_.size());
+  for(int i=0;i<nLevels;i++) {
+    const Simbox * volume = volume_[i];
+    int nx = volume->getnx();
+    int ny = volume->getny();
+    int nz = volume->getnz();
+
+    double jFull, kFull, lFull;
+    volume->getInterpolationIndexes(x, y, z, jFull, kFull, lFull);
+
+    int   j1, j2, k1, k2, l1, l2;
+    float wj, wk, wl;
+    j1 = static_cast<int>(floor(jFull));
+    if(j1<0) {
+      j1 = j2 = 0;
+      wj = 0;
+    }
+    else if(j1>=nx-1) {
+      j1 = j2 = nx-1;
+      wj = 0;
+    }
+    else {
+      j2 = j1 + 1;
+      wj = static_cast<float>(jFull-j1);
+    }
+
+    k1 = static_cast<int>(floor(kFull));
+    if(k1<0) {
+      k1 = k2 = 0;
+      wk = 0;
+    }
+    else if(k1>=ny-1) {
+      k1 = k2 = ny-1;
+      wk = 0;
+    }
+    else {
+      k2 = k1 + 1;
+      wk = static_cast<float>(kFull-k1);
+    }
+
+    l1 = static_cast<int>(floor(lFull));
+    if(l1<0) {
+      l1 = l2 = 0;
+      wl = 0;
+    }
+    else if(l1>=nz-1) {
+      l1 = l2 = nz-1;
+      wl = 0;
+    }
+    else {
+      l2 = l1 + 1;
+      wl = static_cast<float>(lFull-l1);
+    }
+
+    // Corner records and weights, in the order used by PosteriorElasticPDF3D::FindDensity.
+    const float * c[8];
+    const float * table = &table_[i][0];
+    c[0] = table + (j1 + static_cast<size_t>(nx)*(k1 + static_cast<size_t>(ny)*l1))*nFacies_;
+    c[1] = table + (j1 + static_cast<size_t>(nx)*(k1 + static_cast<size_t>(ny)*l2))*nFacies_;
+    c[2] = table + (j1 + static_cast<size_t>(nx)*(k2 + static_cast<size_t>(ny)*l1))*nFacies_;
+    c[3] = table + (j1 + static_cast<size_t>(nx)*(k2 + static_cast<size_t>(ny)*l2))*nFacies_;
+    c[4] = table + (j2 + static_cast<size_t>(nx)*(k1 + static_cast<size_t>(ny)*l1))*nFacies_;
+    c[5] = table + (j2 + static_cast<size_t>(nx)*(k1 + static_cast<size_t>(ny)*l2))*nFacies_;
+    c[6] = table + (j2 + static_cast<size_t>(nx)*(k2 + static_cast<size_t>(ny)*l1))*nFacies_;
+    c[7] = table + (j2 + static_cast<size_t>(nx)*(k2 + static_cast<size_t>(ny)*l2))*nFacies_;
+
+    float w[8];
+    w[0] = (1.0f-wj)*(1.0f-wk)*(1.0f-wl);
+    w[1] = (1.0f-wj)*(1.0f-wk)*(     wl);
+    w[2] = (1.0f-wj)*(     wk)*(1.0f-wl);
+    w[3] = (1.0f-wj)*(     wk)*(     wl);
+    w[4] = (     wj)*(1.0f-wk)*(1.0f-wl);
+    w[5] = (     wj)*(1.0f-wk)*(     wl);
+    w[6] = (     wj)*(     wk)*(1.0f-wl);
+    w[7] = (     wj)*(     wk)*(     wl);
+
+    for(int f=0;f<nFacies_;f++) {
+      Sum sum = 0;
+      for(int n=0;n<8;n++)
+        sum += w[n]*c[n][f];
+      float value = static_cast<float>(sum);
+
+      int factor = 1;
+      for(int j=0;j<nAng;j++) {
+        if(j>0)
+          factor*=2;
+        if((i & factor) > 0)
+          value*=t[j];
+        else
+          value*=(1-t[j]);
+      }
+      dens[f] += value;
+    }
+  }
+
+  for(int f=0;f<nFacies_;f++) {
+    if(!(dens[f] > 0.0f))
+      dens[f] = 0.0f;
+  }
+}
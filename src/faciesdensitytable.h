@@ -0,0 +1,62 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef FACIESDENSITYTABLE_H
+#define FACIESDENSITYTABLE_H
+
+#include <vector>
+
+class FFTGrid;
+class Simbox;
+
+// Facies densities in elastic parameter space, flattened into one float table per
+// noise level with the facies interleaved for each cell. The densities of all facies
+// in a point are then found from the same eight neighbouring cell records, so the
+// interpolation indexes are computed once per point and level instead of once per
+// facies. Negative densities are set to zero when the table is built.
+//
+// The table is not changed after construction and may be used by several threads.
+
+class FaciesDensityTable
+{
+public:
+  FaciesDensityTable(const std::vector<std::vector<FFTGrid *> > & density,  // [noise level][facies]
+                     const std::vector<Simbox *>                & volume);  // [noise level]
+
+  // Finds the density of each facies by trilinear interpolation. With nAng > 0 the
+  // noise levels are weighted by the scale factors t. The interpolation is summed in
+  // float, as for the density grids of FaciesProb::calculateFaciesProb.
+  void         findDensities(float                      alpha,
+                             float                      beta,
+                             float                      rho,
+                             const std::vector<float> & t,
+                             int                        nAng,
+                             float                    * dens) const;
+
+  // As findDensities, but the interpolation is summed in double, as in
+  // PosteriorElasticPDF3D::FindDensity.
+  void         findPdfDensities(double                     vp,
+                                double                     vs,
+                                double                     rho,
+                                const std::vector<float> & t,
+                                int                        nAng,
+                                float                    * dens) const;
+
+  int          getNFacies(void) const { return nFacies_ ;}
+
+private:
+  template <typename Sum>
+  void         interpolate(double                     x,
+                           double                     y,
+                           double                     z,
+                           const std::vector<float> & t,
+                           int                        nAng,
+                           float                    * dens) const;
+
+  int                               nFacies_;
+  std::vector<const Simbox *>       volume_;
+  std::vector<std::vector<float> >  table_;   // [level][(j + nx*(k + ny*l))*nFacies_ + facies]
+};
+
+#endif
@@ -40,6 +40,7 @@
 #include "src/posteriorelasticpdf3d.h"
 #include "src/posteriorelasticpdf4d.h"
 #include "src/seismicparametersholder.h"
+#include "src/faciesdensitytable.h"
 
 
 FaciesProb::FaciesProb(FFTGrid                           * alpha,
@@ -173,7 +174,8 @@ FaciesProb::FaciesProb(FFTGrid                                            * alph
 
 
   CalculateFaciesProbFromPosteriorElasticPDF(alpha, beta, rho, posteriorPdf, volume, nDimensions,
-                      p_undef, priorFacies, priorFaciesCubes, noiseScale, seismicLH, faciesProbFromRockPhysics, trend_cubes);
+                      p_undef, priorFacies, priorFaciesCubes, noiseScale, seismicLH, faciesProbFromRockPhysics, trend_cubes,
+                      modelSettings->getNumberOfThreads());
 
   for(int i = 0 ; i < densdim ; i++) {
     for(int j = 0 ; j < nFacies_ ; j++)
@@ -1252,7 +1254,8 @@ void FaciesProb::makeFaciesProb(int                                 nFac,
     normalizeCubes(priorFaciesCubes);
 
   calculateFaciesProb(postAlpha, postBeta, postRho, density, volume,
-                      p_undef, priorFacies, priorFaciesCubes, noiseScale, seismicLH);
+                      p_undef, priorFacies, priorFaciesCubes, noiseScale, seismicLH,
+                      modelSettings->getNumberOfThreads());
 
   for(int l=0;l<nFacies_;l++){
     if(ModelSettings::getDebugLevel() >= 1) {
@@ -1316,124 +1319,6 @@ float FaciesProb::FindDensityFromPosteriorPDF(const double
     return 0.0;
 }
 
-float FaciesProb::findDensity(float                                       alpha,
-                              float                                       beta,
-                              float                                       rho,
-                              const std::vector<std::vector<FFTGrid*> > & density,
-                              int                                         facies,
-                              const std::vector<Simbox *>               & volume,
-                              const std::vector<float>                  & t,
-                              int                                         nAng)
-{
-  double jFull, kFull, lFull;
-
-  int i;
-  int dim = static_cast<int>(density.size());
-  std::vector<float> value(dim);
-  for(i=0;i<dim;i++)
-  {
-  volume[i]->getInterpolationIndexes(alpha, beta, rho, jFull, kFull, lFull);
-  int j1,k1,l1;
-  int j2,k2,l2;
-  float wj,wk,wl;
-  j1=k1=l1=j2=k2=l2=0;
-  j1 = static_cast<int>(floor(jFull));
-  if(j1<0) {
-    j1 = 0;
-    j2 = 0;
-    wj = 0;
-  }
-  else if(j1>=volume[i]->getnx()-1) {
-    j1 = volume[i]->getnx()-1;
-    j2 = j1;
-    wj = 0;
-  }
-  else {
-    j2 = j1 + 1;
-    wj = static_cast<float>(jFull-j1);
-  }
-
-  k1 = static_cast<int>(floor(kFull));
-  if(k1<0) {
-    k1 = 0;
-    k2 = 0;
-    wk = 0;
-  }
-  else if(k1>=volume[i]->getny()-1) {
-    k1 = volume[i]->getny()-1;
-    k2 = k1;
-    wk = 0;
-  }
-  else {
-    k2 = k1 + 1;
-    wk = static_cast<float>(kFull-k1);
-  }
-
-  l1 = static_cast<int>(floor(lFull));
-  if(l1<0) {
-    l1 = 0;
-    l2 = 0;
-    wl = 0;
-  }
-  else if(l1>=volume[i]->getnz()-1) {
-    l1 = volume[i]->getnz()-1;
-    l2 = l1;
-    wl = 0;
-  }
-  else {
-    l2 = l1 + 1;
-    wl = static_cast<float>(lFull-l1);
-  }
-
-
-    density[i][facies]->setAccessMode(FFTGrid::RANDOMACCESS);
-    float value1 = std::max<float>(0,density[i][facies]->getRealValue(j1,k1,l1));
-    float value2 = std::max<float>(0,density[i][facies]->getRealValue(j1,k1,l2));
-    float value3 = std::max<float>(0,density[i][facies]->getRealValue(j1,k2,l1));
-    float value4 = std::max<float>(0,density[i][facies]->getRealValue(j1,k2,l2));
-    float value5 = std::max<float>(0,density[i][facies]->getRealValue(j2,k1,l1));
-    float value6 = std::max<float>(0,density[i][facies]->getRealValue(j2,k1,l2));
-    float value7 = std::max<float>(0,density[i][facies]->getRealValue(j2,k2,l1));
-    float value8 = std::max<float>(0,density[i][facies]->getRealValue(j2,k2,l2));
-    density[i][facies]->endAccess();
-    //float value=0;
-    value[i] = 0;
-    value[i] += (1.0f-wj)*(1.0f-wk)*(1.0f-wl)*value1;
-    value[i] += (1.0f-wj)*(1.0f-wk)*(     wl)*value2;
-    value[i] += (1.0f-wj)*(     wk)*(1.0f-wl)*value3;
-    value[i] += (1.0f-wj)*(     wk)*(     wl)*value4;
-    value[i] += (     wj)*(1.0f-wk)*(1.0f-wl)*value5;
-    value[i] += (     wj)*(1.0f-wk)*(     wl)*value6;
-    value[i] += (     wj)*(     wk)*(1.0f-wl)*value7;
-    value[i] += (     wj)*(     wk)*(     wl)*value8;
-  }
-
-  int factor = 1;
-  float valuesum = 0;
-  for(i=0;i<dim;i++)
-  {
-    factor = 1;
-    for(int j=0;j<nAng;j++)
-    {
-      if(j>0)
-        factor*=2;
-      if((i & factor) > 0)
-        value[i]*=t[j];
-      else
-        value[i]*=(1-t[j]);
-    }
-
-    valuesum += value[i];
-  }
-
-  if (valuesum > 0.0)
-    return(valuesum);
-  else
-    return 0.0;
-}
-
-
-
 void FaciesProb::resampleAndWriteDensity(const FFTGrid     * const density,
                                     const std::string & fileName,
                                     const Simbox      * origVol,
@@ -1924,12 +1809,11 @@ void FaciesProb::calculateFaciesProb(FFTGrid
                                      const std::vector<float>                   & priorFacies,
                                      std::vector<FFTGrid *>                     & priorFaciesCubes,
                                      const std::vector<Grid2D *>                & noiseScale,
-                                     FFTGrid                                    * seismicLH)
+                                     FFTGrid                                    * seismicLH,
+                                     int                                          nThreads)
 {
-  float * value = new float[nFacies_];
-  int i,j,k,l;
+  int i;
   int nx, ny, nz, rnxp, nyp, nzp, smallrnxp;
-  float alpha, beta, rho, sum;
 
 
   rnxp = alphagrid->getRNxp();
@@ -2000,62 +1884,95 @@ void FaciesProb::calculateFaciesProb(FFTGrid
     << "\n  |    |    |    |    |    |    |    |    |    |    |  "
     << "\n  ^";
 
-  float help;
-  float dens;
+  FaciesDensityTable table(density, volume);
+
   float undefSum = p_undefined/(volume[0]->getnx()*volume[0]->getny()*volume[0]->getnz());
+
+  // The grids may be on file, so each z-slab is read and written sequentially, while
+  // the probabilities in the slab are found by several threads.
+  int nSlab   = nyp*rnxp;
+  int nOut    = ny*smallrnxp;
+  bool useCubes = (priorFaciesCubes.size() != 0);
+  std::vector<float> alphaSlab(nSlab);
+  std::vector<float> betaSlab(nSlab);
+  std::vector<float> rhoSlab(nSlab);
+  std::vector<float> priorSlab(useCubes ? nOut*nFacies_ : 0);
+  std::vector<float> probSlab(nOut*nFacies_);
+  std::vector<float> undefSlab(nOut);
+  std::vector<float> sumSlab(nOut);
+
   for(i=0;i<nzp;i++)
   {
-    for(j=0;j<nyp;j++)
+    for(int n=0;n<nSlab;n++) {
+      alphaSlab[n] = alphagrid->getNextReal();
+      betaSlab[n]  = betagrid->getNextReal();
+      rhoSlab[n]   = rhogrid->getNextReal();
+    }
+    if(i<nz)
     {
-      for(k=0;k<rnxp;k++)
+      if(useCubes)
+        for(int l=0;l<nFacies_;l++)
+          for(int n=0;n<nOut;n++)
+            priorSlab[n*nFacies_+l] = priorFaciesCubes[l]->getNextReal();
+
+#pragma omp parallel num_threads(nThreads)
       {
-        alpha = alphagrid->getNextReal();
-        beta = betagrid->getNextReal();
-        rho = rhogrid->getNextReal();
-        if(k<smallrnxp && j<ny && i<nz)
+        std::vector<float> t(nAng);
+        std::vector<float> dens(nFacies_);
+#pragma omp for schedule(dynamic,1)
+        for(int j=0;j<ny;j++)
         {
-          sum = undefSum;
-          for(l=0;l<nFacies_;l++)
+          for(int k=0;k<smallrnxp;k++)
           {
+            int     n     = j*smallrnxp+k;
+            float * value = &probSlab[n*nFacies_];
             if(k<nx)
             {
               for(int angle = 0;angle<nAng;angle++)
                 t[angle] = float((*tgrid[angle])(k,j));
-              dens = findDensity(alpha, beta, rho, density, l,volume, t, nAng);
-            }
-            else{
-              dens = 1.0;
+              table.findDensities(alphaSlab[j*rnxp+k], betaSlab[j*rnxp+k], rhoSlab[j*rnxp+k], t, nAng, &dens[0]);
             }
-            if(priorFaciesCubes.size() != 0)
-              value[l] = priorFaciesCubes[l]->getNextReal()*dens;
             else
-              value[l] = priorFacies[l]*dens;
-            sum = sum+value[l];
-          }
-          for(l=0;l<nFacies_;l++)
-          {
-            help = value[l]/sum;
-            if(k<nx)
             {
-              faciesProb_[l]->setNextReal(help);
+              for(int l=0;l<nFacies_;l++)
+                dens[l] = 1.0;
             }
-            else
+            float sum = undefSum;
+            for(int l=0;l<nFacies_;l++)
             {
-              faciesProb_[l]->setNextReal(RMISSING);
+              if(useCubes)
+                value[l] = priorSlab[n*nFacies_+l]*dens[l];
+              else
+                value[l] = priorFacies[l]*dens[l];
+              sum = sum+value[l];
+            }
+            for(int l=0;l<nFacies_;l++)
+            {
+              if(k<nx)
+                value[l] = value[l]/sum;
+              else
+                value[l] = RMISSING;
+            }
+            if(k<nx) {
+              undefSlab[n] = undefSum/sum;
+              sumSlab[n]   = sum;
+            }
+            else {
+              undefSlab[n] = RMISSING;
+              sumSlab[n]   = RMISSING;
             }
-          }
-          if(k<nx) {
-            faciesProbUndef_->setNextReal(undefSum/sum);
-            if(seismicLH != NULL)
-              seismicLH->setNextReal(sum);
-          }
-          else {
-            faciesProbUndef_->setNextReal(RMISSING);
-            if(seismicLH != NULL)
-              seismicLH->setNextReal(RMISSING);
           }
         }
       }
+
+      for(int n=0;n<nOut;n++)
+      {
+        for(int l=0;l<nFacies_;l++)
+          faciesProb_[l]->setNextReal(probSlab[n*nFacies_+l]);
+        faciesProbUndef_->setNextReal(undefSlab[n]);
+        if(seismicLH != NULL)
+          seismicLH->setNextReal(sumSlab[n]);
+      }
     }
     // Log progress
     if (i+1 >= static_cast<int>(nextMonitor)) {
@@ -2079,8 +1996,6 @@ void FaciesProb::calculateFaciesProb(FFTGrid
   faciesProbUndef_->endAccess();
   if(seismicLH != NULL)
     seismicLH->endAccess();
-
-  delete [] value;
 }
 
 
@@ -2096,15 +2011,11 @@ void FaciesProb::CalculateFaciesProbFromPosteriorElasticPDF(FFTGrid
                                                             const std::vector<Grid2D *>                               & noiseScale,
                                                             FFTGrid                                                   * seismicLH,
                                                             bool                                                        faciesProbFromRockPhysics,
-                                                            CravaTrend                                                & trend_cubes)
+                                                            CravaTrend                                                & trend_cubes,
+                                                            int                                                         nThreads)
 {
   assert (nDimensions == 3 || nDimensions == 4 || nDimensions == 5);
-  float * value = new float[nFacies_];
-  //int i,j,k,l;
   int nx, ny, nz, rnxp, nyp, nzp, smallrnxp;
-  float alpha, beta, rho, sum;
-  float t1 = 0;
-  float t2 = 0;
 
   rnxp = alphagrid->getRNxp();
   nyp  = alphagrid->getNyp();
@@ -2151,15 +2062,15 @@ void FaciesProb::CalculateFaciesProbFromPosteriorElasticPDF(FFTGrid
   smallrnxp = faciesProb_[0]->getRNxp();
 
   int nAng = 0;
-  std::vector<float> t(nAng);
   double maxS;
   double minS;
-  std::vector<Grid2D *> tgrid(nAng);
+  std::vector<Grid2D *> tgrid;
 
   if(!faciesProbFromRockPhysics){
     for(int i=0;i<int(noiseScale.size());i++)
       if(noiseScale[i]!=NULL)
         nAng++;
+    tgrid.resize(nAng);
 
     for(int angle=0;angle<nAng;angle++) {
       minS = noiseScale[angle]->FindMin(RMISSING);
@@ -2181,8 +2092,6 @@ void FaciesProb::CalculateFaciesProbFromPosteriorElasticPDF(FFTGrid
     << "\n  |    |    |    |    |    |    |    |    |    |    |  "
     << "\n  ^";
 
-  float help;
-  float dens;
   float undefSum = 0.0;
   if (nDimensions == 3){
     undefSum = p_undefined/(volume[0]->getnx()*volume[0]->getny()*volume[0]->getnz());
@@ -2195,66 +2104,125 @@ void FaciesProb::CalculateFaciesProbFromPosteriorElasticPDF(FFTGrid
     undefSum = p_undefined/(nBinsTrend_*nBinsTrend_*volume[0]->getnx()*volume[0]->getny());
   }
 
+  // When all densities are interpolated from histograms, they are flattened into one
+  // table so that the densities of all facies are found in one pass.
+  FaciesDensityTable * table = NULL;
+  std::vector<std::vector<FFTGrid *> > histograms(posteriorPdf.size());
+  bool useTable = true;
+  for(size_t i=0;i<posteriorPdf.size() && useTable;i++) {
+    for(int l=0;l<nFacies_ && useTable;l++) {
+      histograms[i].push_back(posteriorPdf[i][l]->GetHistogram());
+      useTable = (histograms[i][l] != NULL);
+    }
+  }
+  if(useTable)
+    table = new FaciesDensityTable(histograms, volume);
+
+  // The grids may be on file, so each z-slab is read and written sequentially, while
+  // the probabilities in the slab are found by several threads.
+  int nSlab   = nyp*rnxp;
+  int nOut    = ny*smallrnxp;
+  bool useCubes = (priorFaciesCubes.size() != 0);
+  std::vector<float> alphaSlab(nSlab);
+  std::vector<float> betaSlab(nSlab);
+  std::vector<float> rhoSlab(nSlab);
+  std::vector<float> priorSlab(useCubes ? nOut*nFacies_ : 0);
+  std::vector<float> probSlab(nOut*nFacies_);
+  std::vector<float> undefSlab(nOut);
+  std::vector<float> sumSlab(nOut);
+
   for(int i=0;i<nzp;i++)
   {
-    for(int j=0;j<nyp;j++)
+    for(int n=0;n<nSlab;n++) {
+      alphaSlab[n] = alphagrid->getNextReal();
+      betaSlab[n]  = betagrid->getNextReal();
+      rhoSlab[n]   = rhogrid->getNextReal();
+    }
+    if(i<nz)
     {
-      for(int k=0;k<rnxp;k++)
+      if(useCubes)
+        for(int l=0;l<nFacies_;l++)
+          for(int n=0;n<nOut;n++)
+            priorSlab[n*nFacies_+l] = priorFaciesCubes[l]->getNextReal();
+
+#pragma omp parallel num_threads(nThreads)
       {
-        alpha = alphagrid->getNextReal();
-        beta = betagrid->getNextReal();
-        rho = rhogrid->getNextReal();
-        if(faciesProbFromRockPhysics && nDimensions>3){
-          int ii, jj, kk;
-          ii = std::min(i, trendGridSize[2]-1);
-          jj = std::min(j, trendGridSize[1]-1);
-          kk = std::min(k, trendGridSize[0]-1);
-          std::vector<double> trend_values = trend_cubes.GetTrendPosition(kk,jj,ii);
-          t1 = static_cast<float>(trend_values[0]);
-          t2 = static_cast<float>(trend_values[1]);
-        }
-        if(k<smallrnxp && j<ny && i<nz){
-          sum = undefSum;
-          for(int l=0;l<nFacies_;l++){
-            if(k<nx){
-              if(!faciesProbFromRockPhysics){
-                for(int angle = 0; angle<nAng; angle++)
-                  t[angle] = float((*tgrid[angle])(k,j));
-              }
-              dens = FindDensityFromPosteriorPDF(alpha, beta, rho, t1, t2, posteriorPdf, l, volume, t, nAng, faciesProbFromRockPhysics);
-            }
-            else
-              dens = 1.0;
-            if(priorFaciesCubes.size() != 0)
-              value[l] = priorFaciesCubes[l]->getNextReal()*dens;
-            else
-              value[l] = priorFacies[l]*dens;
-            sum = sum+value[l];
-          }
-          for(int l=0;l<nFacies_;l++)
+        std::vector<float> t(nAng);
+        std::vector<float> dens(nFacies_);
+#pragma omp for schedule(dynamic,1)
+        for(int j=0;j<ny;j++)
+        {
+          for(int k=0;k<smallrnxp;k++)
           {
-            help = value[l]/sum;
+            int     n     = j*smallrnxp+k;
+            float * value = &probSlab[n*nFacies_];
             if(k<nx)
             {
-              faciesProb_[l]->setNextReal(help);
+              float alpha = alphaSlab[j*rnxp+k];
+              float beta  = betaSlab[j*rnxp+k];
+              float rho   = rhoSlab[j*rnxp+k];
+              for(int angle = 0; angle<nAng; angle++)
+                t[angle] = float((*tgrid[angle])(k,j));
+              if(table != NULL)
+                table->findPdfDensities(alpha, beta, rho, t, nAng, &dens[0]);
+              else
+              {
+                float t1 = 0;
+                float t2 = 0;
+                if(faciesProbFromRockPhysics && nDimensions>3){
+                  int ii, jj, kk;
+                  ii = std::min(i, trendGridSize[2]-1);
+                  jj = std::min(j, trendGridSize[1]-1);
+                  kk = std::min(k, trendGridSize[0]-1);
+                  std::vector<double> trend_values = trend_cubes.GetTrendPosition(kk,jj,ii);
+                  t1 = static_cast<float>(trend_values[0]);
+                  t2 = static_cast<float>(trend_values[1]);
+                }
+                for(int l=0;l<nFacies_;l++)
+                  dens[l] = FindDensityFromPosteriorPDF(alpha, beta, rho, t1, t2, posteriorPdf, l, volume, t, nAng, faciesProbFromRockPhysics);
+              }
             }
             else
             {
-              faciesProb_[l]->setNextReal(RMISSING);
+              for(int l=0;l<nFacies_;l++)
+                dens[l] = 1.0;
+            }
+            float sum = undefSum;
+            for(int l=0;l<nFacies_;l++)
+            {
+              if(useCubes)
+                value[l] = priorSlab[n*nFacies_+l]*dens[l];
+              else
+                value[l] = priorFacies[l]*dens[l];
+              sum = sum+value[l];
+            }
+            for(int l=0;l<nFacies_;l++)
+            {
+              if(k<nx)
+                value[l] = value[l]/sum;
+              else
+                value[l] = RMISSING;
+            }
+            if(k<nx) {
+              undefSlab[n] = undefSum/sum;
+              sumSlab[n]   = sum;
+            }
+            else {
+              undefSlab[n] = RMISSING;
+              sumSlab[n]   = RMISSING;
             }
-          }
-          if(k<nx) {
-            faciesProbUndef_->setNextReal(undefSum/sum);
-            if(seismicLH != NULL)
-              seismicLH->setNextReal(sum);
-          }
-          else {
-            faciesProbUndef_->setNextReal(RMISSING);
-            if(seismicLH != NULL)
-              seismicLH->setNextReal(RMISSING);
           }
         }
       }
+
+      for(int n=0;n<nOut;n++)
+      {
+        for(int l=0;l<nFacies_;l++)
+          faciesProb_[l]->setNextReal(probSlab[n*nFacies_+l]);
+        faciesProbUndef_->setNextReal(undefSlab[n]);
+        if(seismicLH != NULL)
+          seismicLH->setNextReal(sumSlab[n]);
+      }
     }
     // Log progress
     if (i+1 >= static_cast<int>(nextMonitor)) {
@@ -2280,7 +2248,7 @@ void FaciesProb::CalculateFaciesProbFromPosteriorElasticPDF(FFTGrid
   if(seismicLH != NULL)
     seismicLH->endAccess();
 
-  delete [] value;
+  delete table;
 }
 
 void FaciesProb::calculateFaciesProbGeomodel(const std::vector<float> & priorFacies,
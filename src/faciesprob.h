@@ -181,7 +181,8 @@ private:
                                                                     const std::vector<Grid2D *>                               & noiseScale,
                                                                     FFTGrid                                                   * seismicLH,
                                                                     bool                                                        faciesProbFromRockPhysics,
-                                                                    CravaTrend                                                & trend_cubes);
+                                                                    CravaTrend                                                & trend_cubes,
+                                                                    int                                                         nThreads);
 
 
   void     makeFaciesProb(int                                 nFac,
@@ -246,15 +247,6 @@ private:
                                             float                    & varBeta,
                                             float                    & varRho);
 
-  float                  findDensity(float                                       alpha,
-                                     float                                       beta,
-                                     float                                       rho,
-                                     const std::vector<std::vector<FFTGrid*> > & density,
-                                     int                                         facies,
-                                     const std::vector<Simbox *>               & volume,
-                                     const std::vector<float>                  & t,
-                                     int                                         nAng);
-
   float                  FindDensityFromPosteriorPDF(const double                                          & alpha,
                                                      const double                                          & beta,
                                                      const double                                          & rho,
@@ -285,7 +277,8 @@ private:
                                              const std::vector<float>     & priorFacies,
                                              std::vector<FFTGrid *>       & priorFaciesCubes,
                                              const std::vector<Grid2D *>   & noiseScale,
-                                             FFTGrid                       * seismicLH);
+                                             FFTGrid                       * seismicLH,
+                                             int                             nThreads);
 
   // This function draws random facies length following a geometric distribution with mean 10.0 ms, i.e. dz/10.0 bins
   void                   GenerateSyntWellData(std::vector<SyntWellData *>                              & syntWellData,
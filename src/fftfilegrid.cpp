@@ -4,17 +4,28 @@
 
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 #include <math.h>
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "fftw.h"
 #include "rfftw.h"
 #include "fftw-int.h"
 #include "f77_func.h"
 
 #include "nrlib/iotools/logkit.hpp"
+#include "nrlib/exception/exception.hpp"
+
+#include "lib/timekit.hpp"
 
 #include "src/definitions.h"
 #include "src/fftfilegrid.h"
@@ -25,7 +36,11 @@ FFTFileGrid::FFTFileGrid(int nx, int ny, int nz, int nxp, int nyp, int nzp) :
 FFTGrid(nx, ny, nz, nxp, nyp, nzp)
 {
   genFileName();
-  accMode_=NONE;
+  accMode_      = NONE;
+  bytesRead_    = 0.0;
+  bytesWritten_ = 0.0;
+  ioTime_       = 0.0;
+  mapped_       = false;
 }
 
 FFTFileGrid::FFTFileGrid(FFTFileGrid  * fftGrid, bool expTrans) :
@@ -54,6 +69,10 @@ FFTGrid()
   istransformed_  = false;
   fNameIn_        = "";
   accMode_        = NONE;
+  bytesRead_      = 0.0;
+  bytesWritten_   = 0.0;
+  ioTime_         = 0.0;
+  mapped_         = false;
   createRealGrid();
 
   setAccessMode(WRITE);
@@ -77,7 +96,16 @@ FFTGrid()
 
 FFTFileGrid::~FFTFileGrid()
 {
-  endAccess();
+  // Closing an open writer throws if the grid could not be written, for instance on a
+  // full disk. The error is logged, as an exception must not leave a destructor.
+  try {
+    endAccess();
+  }
+  catch(NRLib::Exception & e) {
+    LogKit::LogMessage(LogKit::Error, "\nERROR: Closing temporary grid "+fNameOut_+" failed: "+std::string(e.what())+"\n");
+  }
+  LogKit::LogFormatted(LogKit::DebugLow,"\nTmp grid %s: %.1f MB read, %.1f MB written, %.2f s in load/save\n",
+                       fNameOut_.c_str(), bytesRead_/(1024.0*1024.0), bytesWritten_/(1024.0*1024.0), ioTime_);
   if(fNameIn_ != "")
   {
     remove(fNameIn_.c_str());
@@ -93,14 +121,14 @@ FFTFileGrid::setAccessMode(int mode)
   switch(mode)
   {
   case READ:
-    NRLib::OpenRead(inFile_,fNameIn_,std::ios::in | std::ios::binary);
+    inFile_.open(fNameIn_, getStreamBlockSize(), compress_);
     break;
   case WRITE:
-    NRLib::OpenWrite(outFile_,fNameOut_,std::ios::out | std::ios::binary);
+    outFile_.open(fNameOut_, getStreamBlockSize(), compress_, mantissaBits_);
     break;
   case READANDWRITE:
-    NRLib::OpenRead(inFile_,fNameIn_,std::ios::in | std::ios::binary);
-    NRLib::OpenWrite(outFile_,fNameOut_,std::ios::out | std::ios::binary);
+    inFile_.open(fNameIn_, getStreamBlockSize(), compress_);
+    outFile_.open(fNameOut_, getStreamBlockSize(), compress_, mantissaBits_);
     break;
   case RANDOMACCESS:
     modified_ = 0;
@@ -118,11 +146,17 @@ FFTFileGrid::endAccess()
   {
   case READ:
     inFile_.close();
+    addIO(inFile_.getBytesRead(), 0.0, 0.0);
+    addCodecIO(inFile_.getRawBytes(), inFile_.getBytesRead(), inFile_.getCodecTime());
     break;
   case READANDWRITE:
-    inFile_.close(); //Intentional fallthrough to WRITE
+    inFile_.close();
+    addIO(inFile_.getBytesRead(), 0.0, 0.0);
+    addCodecIO(inFile_.getRawBytes(), inFile_.getBytesRead(), inFile_.getCodecTime()); //Intentional fallthrough to WRITE
   case WRITE:
     outFile_.close();
+    addIO(0.0, outFile_.getBytesWritten(), 0.0);
+    addCodecIO(outFile_.getRawBytes(), outFile_.getBytesWritten(), outFile_.getCodecTime());
     tmp = fNameIn_;
     fNameIn_ = fNameOut_;
     if(tmp != "")
@@ -232,6 +266,35 @@ FFTFileGrid::setRealValue(int i, int j, int k, float value, bool extSimbox)
   return(FFTGrid::setRealValue(i, j, k, value, extSimbox));
 }
 
+const fftw_complex *
+FFTFileGrid::getComplexSlice(int k) const
+{
+  assert(accMode_ == RANDOMACCESS);
+  return(FFTGrid::getComplexSlice(k));
+}
+
+fftw_complex *
+FFTFileGrid::getWritableComplexSlice(int k)
+{
+  assert(accMode_ == RANDOMACCESS);
+  modified_ = 1;
+  return(FFTGrid::getWritableComplexSlice(k));
+}
+
+const fftw_real *
+FFTFileGrid::getRealSlice(int k) const
+{
+  assert(accMode_ == RANDOMACCESS);
+  return(FFTGrid::getRealSlice(k));
+}
+
+fftw_real *
+FFTFileGrid::getWritableRealSlice(int k)
+{
+  assert(accMode_ == RANDOMACCESS);
+  modified_ = 1;
+  return(FFTGrid::getWritableRealSlice(k));
+}
 
 int
 FFTFileGrid::SetNextComplex(std::complex<double> & value)
@@ -605,21 +668,35 @@ void
 FFTFileGrid::load()
 {
   assert(accMode_ == NONE || accMode_ == RANDOMACCESS);
+  if(useMemoryMap_) {
+    mapFile();
+    return;
+  }
   if(!istransformed_)
     FFTGrid::createRealGrid();
   else
     FFTGrid::createComplexGrid();
   if(fNameIn_ != "") //Something has been saved.
   {
-    int i, nRead = 1;
-    NRLib::OpenRead(inFile_,fNameIn_,std::ios::in | std::ios::binary);
     //Real/complex does not matter in next line, since same meory is used.
-    for(i=0;((i<rsize_) && (nRead == 1));i++)
-    {
-      char * buffer = reinterpret_cast<char *>(&(rvalue_[i]));
-      inFile_.read(buffer,sizeof(float));
+    size_t nBytes = static_cast<size_t>(rsize_)*sizeof(fftw_real);
+    double wall   = 0.0;
+    double cpu    = 0.0;
+    TimeKit::getTime(wall,cpu);
+    if(compress_) {
+      SlabReader reader;
+      reader.open(fNameIn_, getStreamBlockSize(), true);
+      reader.read(reinterpret_cast<char *>(rvalue_), nBytes);
+      reader.close();
+      TimeKit::getTime(wall,cpu);
+      addIO(reader.getBytesRead(), 0.0, wall);
+      addCodecIO(reader.getRawBytes(), reader.getBytesRead(), reader.getCodecTime());
+    }
+    else {
+      readBlocks(fNameIn_, reinterpret_cast<char *>(rvalue_), nBytes);
+      TimeKit::getTime(wall,cpu);
+      addIO(static_cast<double>(nBytes), 0.0, wall);
     }
-    inFile_.close();
   }
 }
 
@@ -627,15 +704,29 @@ void
 FFTFileGrid::save()
 {
   assert(accMode_ == NONE || accMode_ == RANDOMACCESS);
-  NRLib::OpenWrite(outFile_,fNameOut_,std::ios::out | std::ios::binary);
+  if(mapped_) { //Changes are already in fNameIn_
+    unmapFile();
+    return;
+  }
   //Real/complex does not matter in next line, since same meory is used.
-  int i, nWritten = 1;
-  for(i=0;((i<rsize_) && (nWritten == 1));i++)
-  {
-    char * buffer = reinterpret_cast<char *>(&(rvalue_[i]));
-    outFile_.write(buffer,sizeof(float));
+  size_t nBytes = static_cast<size_t>(rsize_)*sizeof(fftw_real);
+  double wall   = 0.0;
+  double cpu    = 0.0;
+  TimeKit::getTime(wall,cpu);
+  if(compress_) {
+    SlabWriter writer;
+    writer.open(fNameOut_, getStreamBlockSize(), true, mantissaBits_);
+    writer.write(reinterpret_cast<const char *>(rvalue_), nBytes);
+    writer.close();
+    TimeKit::getTime(wall,cpu);
+    addIO(0.0, writer.getBytesWritten(), wall);
+    addCodecIO(writer.getRawBytes(), writer.getBytesWritten(), writer.getCodecTime());
+  }
+  else {
+    writeBlocks(fNameOut_, reinterpret_cast<const char *>(rvalue_), nBytes);
+    TimeKit::getTime(wall,cpu);
+    addIO(0.0, static_cast<double>(nBytes), wall);
   }
-  outFile_.close();
   unload();
   std::string tmp = fNameIn_;
   fNameIn_ = fNameOut_;
@@ -645,9 +736,160 @@ FFTFileGrid::save()
     fNameOut_ = fNameIn_+"b";
 }
 
+void
+FFTFileGrid::mapFile()
+{
+#if !defined(_WIN32)
+  size_t nBytes = static_cast<size_t>(rsize_)*sizeof(fftw_real);
+  int    flags  = O_RDWR;
+  if(fNameIn_ == "") { //Nothing has been saved. Map a new zero-filled file, and use it as the current contents.
+    fNameIn_  = fNameOut_;
+    fNameOut_ = fNameIn_+"b";
+    flags    |= O_CREAT | O_TRUNC;
+  }
+
+  int fd = open(fNameIn_.c_str(), flags, 0644);
+  if(fd < 0)
+    throw NRLib::IOError("Failed to open " + fNameIn_ + " for memory mapping.");
+
+  struct stat fileStat;
+  if(fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < nBytes) {
+    if((flags & O_CREAT) == 0 || ftruncate(fd, static_cast<off_t>(nBytes)) != 0) {
+      close(fd);
+      throw NRLib::IOError("Failed to map " + fNameIn_ + ". The file is shorter than the grid.");
+    }
+  }
+
+  void * data = mmap(NULL, nBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED)
+    throw NRLib::IOError("Failed to memory map " + fNameIn_ + ".");
+
+  rvalue_         = static_cast<fftw_real*>(data);
+  cvalue_         = reinterpret_cast<fftw_complex*>(rvalue_);
+  counterForGet_  = 0;
+  counterForSet_  = 0;
+  mapped_         = true;
+#endif
+}
+
+void
+FFTFileGrid::unmapFile()
+{
+#if !defined(_WIN32)
+  munmap(rvalue_, static_cast<size_t>(rsize_)*sizeof(fftw_real));
+#endif
+  rvalue_ = NULL;
+  cvalue_ = NULL;
+  mapped_ = false;
+}
+
+void
+FFTFileGrid::setUseMemoryMap(bool useMemoryMap)
+{
+#if defined(_WIN32)
+  if(useMemoryMap)
+    LogKit::LogFormatted(LogKit::Warning,"\nWARNING: Memory mapped disk storage is not supported on this platform. Grids are read and written in blocks instead.\n");
+  useMemoryMap_ = false;
+#else
+  useMemoryMap_ = useMemoryMap;
+#endif
+}
+
+size_t
+FFTFileGrid::getStreamBlockSize() const
+{
+  // Whole z-slabs, so that each prefetch or flush covers complete slabs.
+  size_t slabSize  = static_cast<size_t>(rnxp_)*static_cast<size_t>(nyp_)*sizeof(fftw_real);
+  size_t nSlabs    = (streamBlockSize_ + slabSize - 1)/slabSize;
+  return(nSlabs*slabSize);
+}
+
+void
+FFTFileGrid::readBlocks(const std::string & fileName, char * data, size_t nBytes)
+{
+  // The grid is read directly into place in large blocks. Stream buffering is
+  // turned off, since it would only add a copy.
+  FILE * file = fopen(fileName.c_str(), "rb");
+  if(file == NULL)
+    throw NRLib::IOError("Failed to open " + fileName + " for reading.");
+  setvbuf(file, NULL, _IONBF, 0);
+#if defined(__linux__)
+  posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  size_t nDone = 0;
+  while(nDone < nBytes) {
+    size_t n = nBytes - nDone;
+    if(n > ioBlockSize_)
+      n = ioBlockSize_;
+    if(fread(data + nDone, 1, n, file) != n) {
+      fclose(file);
+      throw NRLib::IOError("Failed to read " + fileName + ". The file is shorter than the grid.");
+    }
+    nDone += n;
+  }
+  fclose(file);
+}
+
+void
+FFTFileGrid::writeBlocks(const std::string & fileName, const char * data, size_t nBytes)
+{
+  FILE * file = fopen(fileName.c_str(), "wb");
+  if(file == NULL)
+    throw NRLib::IOError("Failed to open " + fileName + " for writing.");
+  setvbuf(file, NULL, _IONBF, 0);
+
+  size_t nDone = 0;
+  while(nDone < nBytes) {
+    size_t n = nBytes - nDone;
+    if(n > ioBlockSize_)
+      n = ioBlockSize_;
+    if(fwrite(data + nDone, 1, n, file) != n) {
+      fclose(file);
+      throw NRLib::IOError("Failed to write " + fileName + ". The disk may be full.");
+    }
+    nDone += n;
+  }
+  if(fclose(file) != 0)
+    throw NRLib::IOError("Failed to write " + fileName + ". The disk may be full.");
+}
+
+void
+FFTFileGrid::addIO(double bytesRead, double bytesWritten, double ioTime)
+{
+  bytesRead_         += std::max(bytesRead, 0.0);
+  bytesWritten_      += std::max(bytesWritten, 0.0);
+  ioTime_            += ioTime;
+  totalBytesRead_    += std::max(bytesRead, 0.0);
+  totalBytesWritten_ += std::max(bytesWritten, 0.0);
+  totalIOTime_       += ioTime;
+}
+
+void
+FFTFileGrid::addCodecIO(double rawBytes, double storedBytes, double codecTime)
+{
+  if(compress_) {
+    totalRawBytes_    += rawBytes;
+    totalStoredBytes_ += storedBytes;
+    totalCodecTime_   += codecTime;
+  }
+}
+
+void
+FFTFileGrid::setCompression(bool compress, int mantissaBits)
+{
+  compress_     = compress;
+  mantissaBits_ = mantissaBits;
+}
+
 void
 FFTFileGrid::unload()
 {
+  if(mapped_) {
+    unmapFile();
+    return;
+  }
   fftw_free(rvalue_); // changed
   nGrids_ = nGrids_ - 1;
 // LogKit::LogFormatted(LogKit::Error,"\nFFTFileGrid unload: nGrids_ = %d\n",nGrids_);
@@ -709,3 +951,14 @@ FFTFileGrid::setRealTrace(int i, int j, float *value)
 
 
 int FFTFileGrid::gNum = 0; //Starting value
+
+double FFTFileGrid::totalBytesRead_    = 0.0;
+double FFTFileGrid::totalBytesWritten_ = 0.0;
+double FFTFileGrid::totalIOTime_       = 0.0;
+double FFTFileGrid::totalRawBytes_     = 0.0;
+double FFTFileGrid::totalStoredBytes_  = 0.0;
+double FFTFileGrid::totalCodecTime_    = 0.0;
+
+bool   FFTFileGrid::useMemoryMap_      = false;
+bool   FFTFileGrid::compress_          = false;
+int    FFTFileGrid::mantissaBits_      = SlabCodec::losslessBits_;
@@ -9,6 +9,7 @@
 #include "fftw.h"
 
 #include "fftgrid.h"
+#include "slabstream.h"
 
 class Wavelet;
 class Simbox;
@@ -26,6 +27,10 @@ public:
   float        getRealValue(int i, int j, int k, bool extSimbox = false);
   float        getRealValueInterpolated(int i, int j, float kindex);
   int          setRealValue(int i, int j, int k, float value, bool extSimbox = false);
+  const fftw_complex * getComplexSlice(int k) const;
+  fftw_complex       * getWritableComplexSlice(int k);
+  const fftw_real    * getRealSlice(int k) const;
+  fftw_real          * getWritableRealSlice(int k);
   int          SetNextComplex(std::complex<double> & value);
   int          setNextComplex(fftw_complex);
   int          setNextReal(float);
@@ -68,19 +73,75 @@ public:
   bool         isFile() {return(1);}
   void         getRealTrace(float * value, int i, int j);
   int          setRealTrace(int i, int j, float *value);
+
+  double       getBytesRead()    const { return bytesRead_    ;}
+  double       getBytesWritten() const { return bytesWritten_ ;}
+  double       getIOTime()       const { return ioTime_       ;}
+
+  static double getTotalBytesRead()    { return totalBytesRead_    ;}
+  static double getTotalBytesWritten() { return totalBytesWritten_ ;}
+  static double getTotalIOTime()       { return totalIOTime_       ;}
+
+  // With a memory map, load() maps the tmp file instead of reading it, and save() and
+  // unload() unmap it. The page cache then decides which parts are held in memory.
+  static void   setUseMemoryMap(bool useMemoryMap);
+  static bool   getUseMemoryMap()      { return useMemoryMap_      ;}
+
+  // With compression, tmp files are stored as SlabCodec blocks of whole z-slabs. With
+  // less than SlabCodec::losslessBits_ mantissa bits the compression is lossy.
+  static void   setCompression(bool compress, int mantissaBits);
+  static bool   getCompression()       { return compress_          ;}
+
+  static double getTotalRawBytes()     { return totalRawBytes_     ;} // Uncompressed size of compressed data
+  static double getTotalStoredBytes()  { return totalStoredBytes_  ;} // Size on disk of compressed data
+  static double getTotalCodecTime()    { return totalCodecTime_    ;}
+
 private:
+  FFTFileGrid(const FFTFileGrid &);             // The streams own open files and threads
+  FFTFileGrid & operator=(const FFTFileGrid &);
+
   void         genFileName();
   void         load();
   void         unload();
   void         save();
 
+  void         mapFile();
+  void         unmapFile();
+
+  static void  readBlocks(const std::string & fileName, char * data, size_t nBytes);
+  static void  writeBlocks(const std::string & fileName, const char * data, size_t nBytes);
+  void         addIO(double bytesRead, double bytesWritten, double ioTime);
+  void         addCodecIO(double rawBytes, double storedBytes, double codecTime);
+
   int          accMode_;
   int          modified_;   //Tells if grid is modified during RANDOMACCESS.
   std::string  fNameIn_; //Temporary names, switches whenever a write has occured.
   std::string  fNameOut_;
-  std::ifstream inFile_;
-  std::ofstream outFile_;
+  SlabReader   inFile_;  // Used in READ and READANDWRITE modes. Prefetches the next block.
+  SlabWriter   outFile_; // Used in WRITE and READANDWRITE modes. Writes filled blocks in the background.
+
+  double       bytesRead_;    // Bytes read from tmp files by this grid.
+  double       bytesWritten_; // Bytes written to tmp files by this grid.
+  double       ioTime_;       // Wall time used in load() and save(). Streaming access is not timed.
+  bool         mapped_;       // True if rvalue_ points into a memory map of fNameIn_.
 
   static int   gNum; //Number used for generating temporary files.
+
+  static const size_t ioBlockSize_     = 8*1024*1024; // Size of each read/write call in load() and save()
+  static const size_t streamBlockSize_ = 1024*1024;   // Minimum block size for streaming access
+
+  size_t       getStreamBlockSize() const;
+
+  static double totalBytesRead_;
+  static double totalBytesWritten_;
+  static double totalIOTime_;
+
+  static double totalRawBytes_;
+  static double totalStoredBytes_;
+  static double totalCodecTime_;
+
+  static bool   useMemoryMap_;
+  static bool   compress_;
+  static int    mantissaBits_;
 };
 #endif
@@ -23,6 +23,7 @@
 #include "nrlib/iotools/logkit.hpp"
 #include "nrlib/iotools/fileio.hpp"
 #include "nrlib/segy/segy.hpp"
+#include "nrlib/random/randomgenerator.hpp"
 
 #include "src/fftgrid.h"
 #include "src/simbox.h"
@@ -32,6 +33,8 @@
 #include "src/io.h"
 #include "src/tasklist.h"
 #include "src/seismicparametersholder.h"
+#include "src/fftplancache.h"
+#include "src/gridwriter.h"
 
 
 FFTGrid::FFTGrid(int nx, int ny, int nz, int nxp, int nyp, int nzp)
@@ -134,10 +137,11 @@ FFTGrid::fillInSeismicDataFromSegY(const SegY   * segy,
 
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
+  Timings::Region region("Resampling");
 
   LogKit::LogFormatted(LogKit::Low,"\nResampling seismic data into %dx%dx%d grid:",nxp_,nyp_,nzp_);
 
-  setAccessMode(READANDWRITE);
+  setAccessMode(RANDOMACCESS);
 
   float monitorSize = std::max(1.0f, static_cast<float>(nyp_*rnxp_)*0.02f);
   float nextMonitor = monitorSize;
@@ -157,149 +161,167 @@ FFTGrid::fillInSeismicDataFromSegY(const SegY   * segy,
   //
   // Create FFT plans
   //
-  rfftwnd_plan fftplan1 = rfftwnd_create_plan(1, &nt, FFTW_REAL_TO_COMPLEX, FFTW_ESTIMATE | FFTW_IN_PLACE);
-  rfftwnd_plan fftplan2 = rfftwnd_create_plan(1, &mt, FFTW_COMPLEX_TO_REAL, FFTW_ESTIMATE | FFTW_IN_PLACE);
+  rfftwnd_plan fftplan1 = FFTPlanCache::getPlan1D(nt, FFTW_REAL_TO_COMPLEX);
+  rfftwnd_plan fftplan2 = FFTPlanCache::getPlan1D(mt, FFTW_COMPLEX_TO_REAL);
 
   //
-  // Do resampling
+  // Do resampling. The traces are independent, so the rows of the grid are
+  // distributed over the threads. Each thread has its own scratch buffers,
+  // while the FFT plans are shared.
   //
-  missingTracesSimbox  = 0; // Part of simbox is outside seismic data
-  missingTracesPadding = 0; // Part of padding is outside seismic data
-  deadTracesSimbox     = 0; // Simbox is inside seismic data but trace is missing
-
-  for (int j = 0 ; j < nyp_ ; j++) {
-    for (int i = 0 ; i < rnxp_ ; i++) {
-
-      int refi  = getFillNumber(i, nx_, nxp_ ); // Find index (special treatment for padding)
-      int refj  = getFillNumber(j, ny_, nyp_ ); // Find index (special treatment for padding)
-      int refk  = 0;
-
-      double x, y, z0;
-      timeSimbox->getCoord(refi, refj, refk, x, y, z0);  // Get lateral position and z-start (z0)
-
-      double dz = timeSimbox->getdz(refi, refj);
-      float  xf = static_cast<float>(x);
-      float  yf = static_cast<float>(y);
-
-      if (segy->GetGeometry()->IsInside(xf, yf)) {
-        bool  missing = false;
-        float z0_data = RMISSING;
-
-        std::vector<float> data_trace;
-
-        segy->GetNearestTrace(data_trace, missing, z0_data, xf, yf);
-
-        if (!missing) {
-          int         cnt      = nt/2 + 1;
-          int         rnt      = 2*cnt;
-          int         cmt      = mt/2 + 1;
-          int         rmt      = 2*cmt;
-
-          fftw_real * rAmpData = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*rnt));
-          fftw_real * rAmpFine = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*rmt));
-
-          float       dz_grid  = static_cast<float>(dz);
-          float       z0_grid  = static_cast<float>(z0);
-
-          float       zn_data  = z0_data + dz_data*static_cast<float>(data_trace.size());
-
-          std::vector<float> grid_trace(nzp_);
-
-          std::string errText = "";
-          smoothTraceInGuardZone(data_trace,
-                                 z0_data,
-                                 zn_data,
-                                 dz_data,
-                                 smooth_length,
-                                 errText);
-          resampleTrace(data_trace,
-                        fftplan1,
-                        fftplan2,
-                        rAmpData,
-                        rAmpFine,
-                        cnt,
-                        rnt,
-                        cmt,
-                        rmt);
-          interpolateGridValues(grid_trace,
-                                z0_grid,     // Centre of first cell
-                                dz_grid,
-                                rAmpFine,
-                                z0_data,     // Time of first data sample
-                                dz_min,
-                                rmt);
-          errTxt += errText;
-
-          if (errText != "") {
-            // Keep for a few weeks until new resampling has been tested extensively.
-            //  if (true) {
-            std::cout << "i j = " << i << " " << j << std::endl;
-            std::cout << errText << std::endl;
-            std::ofstream fout;
-
-            NRLib::OpenWrite(fout,"data.txt");
-            for (size_t k = 0 ; k < data_trace.size() ; k++) {
-              fout << std::fixed
-                   << std::setprecision(2)
-                   << std::setw(6)  << k
-                   << std::setw(10) << z0_data + k*dz_data
-                   << std::setw(12) << data_trace[k] << "\n";
-            }
-            fout.close();
-
-            NRLib::OpenWrite(fout,"fine.txt");
-            for (int k = 0 ; k < static_cast<int>(data_trace.size())*4 ; k++) {
-              fout << std::fixed
-                   << std::setprecision(2)
-                   << std::setw(6)  << k
-                   << std::setw(10) << z0_data + k*dz_min
-                   << std::setw(12) << rAmpFine[k] << "\n";
-            }
-            fout.close();
-
-            NRLib::OpenWrite(fout,"grid.txt");
-            for (size_t k = 0 ; k < grid_trace.size() ; k++) {
-              fout << std::fixed
-                   << std::setprecision(2)
-                   << std::setw(6)  << k
-                   << std::setw(10) << z0_grid + k*dz_grid
-                   << std::setw(12) << grid_trace[k] << "\n";
-            }
-            fout.close();
-            exit(1);
-          }
+  int cnt = nt/2 + 1;
+  int rnt = 2*cnt;
+  int cmt = mt/2 + 1;
+  int rmt = 2*cmt;
+
+  int nMissingSimbox  = 0; // Part of simbox is outside seismic data
+  int nMissingPadding = 0; // Part of padding is outside seismic data
+  int nDead           = 0; // Simbox is inside seismic data but trace is missing
+  int nDone           = 0;
+
+  getWritableRealSlice(0); // Marks a file grid as modified, since setTrace writes directly to the grid.
+
+#pragma omp parallel num_threads(nThreads_) reduction(+:nMissingSimbox,nMissingPadding,nDead)
+  {
+    fftw_real * rAmpData = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*rnt));
+    fftw_real * rAmpFine = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*rmt));
 
-          fftw_free(rAmpData);
-          fftw_free(rAmpFine);
+    std::vector<float> data_trace;
+    std::vector<float> grid_trace(nzp_);
 
-          setTrace(grid_trace, i, j);
+#pragma omp for schedule(dynamic,1)
+    for (int j = 0 ; j < nyp_ ; j++) {
+      for (int i = 0 ; i < rnxp_ ; i++) {
+
+        int refi  = getFillNumber(i, nx_, nxp_ ); // Find index (special treatment for padding)
+        int refj  = getFillNumber(j, ny_, nyp_ ); // Find index (special treatment for padding)
+        int refk  = 0;
+
+        double x, y, z0;
+        timeSimbox->getCoord(refi, refj, refk, x, y, z0);  // Get lateral position and z-start (z0)
+
+        double dz = timeSimbox->getdz(refi, refj);
+        float  xf = static_cast<float>(x);
+        float  yf = static_cast<float>(y);
+
+        if (segy->GetGeometry()->IsInside(xf, yf)) {
+          bool  missing = false;
+          float z0_data = RMISSING;
+
+          segy->GetNearestTrace(data_trace, missing, z0_data, xf, yf);
+
+          if (!missing) {
+            float       dz_grid  = static_cast<float>(dz);
+            float       z0_grid  = static_cast<float>(z0);
+
+            float       zn_data  = z0_data + dz_data*static_cast<float>(data_trace.size());
+
+            std::string errText = "";
+            smoothTraceInGuardZone(data_trace,
+                                   z0_data,
+                                   zn_data,
+                                   dz_data,
+                                   smooth_length,
+                                   errText);
+            resampleTrace(data_trace,
+                          fftplan1,
+                          fftplan2,
+                          rAmpData,
+                          rAmpFine,
+                          cnt,
+                          rnt,
+                          cmt,
+                          rmt);
+            interpolateGridValues(grid_trace,
+                                  z0_grid,     // Centre of first cell
+                                  dz_grid,
+                                  rAmpFine,
+                                  z0_data,     // Time of first data sample
+                                  dz_min,
+                                  rmt);
+
+            if (errText != "") {
+#pragma omp critical
+              {
+                errTxt += errText;
+                // Keep for a few weeks until new resampling has been tested extensively.
+                //  if (true) {
+                std::cout << "i j = " << i << " " << j << std::endl;
+                std::cout << errText << std::endl;
+                std::ofstream fout;
+
+                NRLib::OpenWrite(fout,"data.txt");
+                for (size_t k = 0 ; k < data_trace.size() ; k++) {
+                  fout << std::fixed
+                       << std::setprecision(2)
+                       << std::setw(6)  << k
+                       << std::setw(10) << z0_data + k*dz_data
+                       << std::setw(12) << data_trace[k] << "\n";
+                }
+                fout.close();
+
+                NRLib::OpenWrite(fout,"fine.txt");
+                for (int k = 0 ; k < static_cast<int>(data_trace.size())*4 ; k++) {
+                  fout << std::fixed
+                       << std::setprecision(2)
+                       << std::setw(6)  << k
+                       << std::setw(10) << z0_data + k*dz_min
+                       << std::setw(12) << rAmpFine[k] << "\n";
+                }
+                fout.close();
+
+                NRLib::OpenWrite(fout,"grid.txt");
+                for (size_t k = 0 ; k < grid_trace.size() ; k++) {
+                  fout << std::fixed
+                       << std::setprecision(2)
+                       << std::setw(6)  << k
+                       << std::setw(10) << z0_grid + k*dz_grid
+                       << std::setw(12) << grid_trace[k] << "\n";
+                }
+                fout.close();
+                exit(1);
+              }
+            }
+
+            setTrace(grid_trace, i, j);
+          }
+          else {
+            setTrace(0.0f, i, j); // Dead traces (in case we allow them)
+            nDead++;
+          }
         }
         else {
-          setTrace(0.0f, i, j); // Dead traces (in case we allow them)
-          deadTracesSimbox++;
+          setTrace(0.0f, i, j);   // Outside seismic data grid
+          if (i < nx_ && j < ny_ )
+            nMissingSimbox++;
+          else
+            nMissingPadding++;
         }
       }
-      else {
-        setTrace(0.0f, i, j);   // Outside seismic data grid
-        if (i < nx_ && j < ny_ )
-          missingTracesSimbox++;
-        else
-          missingTracesPadding++;
-      }
 
-      if (rnxp_*j + i + 1 >= static_cast<int>(nextMonitor)) {
-        nextMonitor += monitorSize;
-        printf("^");
-        fflush(stdout);
+#pragma omp critical
+      {
+        // Log progress
+        nDone += rnxp_;
+        while (nDone >= static_cast<int>(nextMonitor)) {
+          nextMonitor += monitorSize;
+          printf("^");
+          fflush(stdout);
+        }
       }
     }
+
+    fftw_free(rAmpData);
+    fftw_free(rAmpFine);
   }
+
+  missingTracesSimbox  = nMissingSimbox;
+  missingTracesPadding = nMissingPadding;
+  deadTracesSimbox     = nDead;
+
   LogKit::LogFormatted(LogKit::Low,"\n");
   endAccess();
 
-  fftwnd_destroy_plan(fftplan1);
-  fftwnd_destroy_plan(fftplan2);
-
   Timings::setTimeResamplingSeismic(wall,cpu);
 }
 
@@ -671,16 +693,24 @@ FFTGrid::interpolateGridValues(std::vector<float> & grid_trace,
 void
 FFTGrid::setTrace(const std::vector<float> & trace, size_t i, size_t j)
 {
+  assert(istransformed_ == false);
+  size_t index = i + rnxp_*j;
+  size_t step  = static_cast<size_t>(rnxp_)*nyp_;
   for (int k = 0 ; k < nzp_ ; k++) {
-    setRealValue(i, j, k, trace[k], true);
+    rvalue_[index] = trace[k];
+    index         += step;
   }
 }
 
 void
 FFTGrid::setTrace(float value, size_t i, size_t j)
 {
+  assert(istransformed_ == false);
+  size_t index = i + rnxp_*j;
+  size_t step  = static_cast<size_t>(rnxp_)*nyp_;
   for (int k = 0 ; k < nzp_ ; k++) {
-    setRealValue(i, j, k, value, true);
+    rvalue_[index] = value;
+    index         += step;
   }
 }
 
@@ -736,6 +766,7 @@ FFTGrid::fillInFromSegY(const SegY              * segy,
 
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
+  Timings::Region region("Resampling");
 
   LogKit::LogFormatted(LogKit::Low,"\nResampling %s into %dx%dx%d grid:\n",parName.c_str(),nxp_,nyp_,nzp_);
   setAccessMode(WRITE);
@@ -1197,10 +1228,10 @@ FFTGrid::fillInGenExpCorr(double Rx,
 }
 
 
+template <class Generator>
 void
-FFTGrid::fillInComplexNoise(RandomGen * ranGen)
+FFTGrid::fillInComplexNoiseFrom(Generator & ranGen)
 {
-  assert(ranGen);
   istransformed_ = true;
   int i;
   cubetype_=PARAMETER;
@@ -1226,13 +1257,13 @@ FFTGrid::fillInComplexNoise(RandomGen * ranGen)
       jkccind = jccind+kccind*nyp_;
       if(jkccind == jkind)             //Number is its own cc, i. e. real
       {
-        cvalue_[i].re = float(ranGen->rnorm01());
+        cvalue_[i].re = float(ranGen.rnorm01());
         cvalue_[i].im = 0;
       }
       else if(jkccind > jkind)         //Have not simulated cc yet.
       {
-        cvalue_[i].re = float(std*ranGen->rnorm01());
-        cvalue_[i].im = float(std*ranGen->rnorm01());
+        cvalue_[i].re = float(std*ranGen.rnorm01());
+        cvalue_[i].im = float(std*ranGen.rnorm01());
       }
       else                             //Look up cc value
       {
@@ -1243,19 +1274,44 @@ FFTGrid::fillInComplexNoise(RandomGen * ranGen)
     }
     else
     {
-      cvalue_[i].re = float(std*ranGen->rnorm01());
-      cvalue_[i].im = float(std*ranGen->rnorm01());
+      cvalue_[i].re = float(std*ranGen.rnorm01());
+      cvalue_[i].im = float(std*ranGen.rnorm01());
     }
   }
 }
 
+void
+FFTGrid::fillInComplexNoise(RandomGen * ranGen)
+{
+  assert(ranGen);
+  fillInComplexNoiseFrom(*ranGen);
+}
+
+// Gives NRLib::RandomGenerator the interface of RandomGen used in fillInComplexNoiseFrom.
+struct RandomStream
+{
+  NRLib::RandomGenerator & ranGen;
+  double                   rnorm01() { return ranGen.Norm01(); }
+};
+
+void
+FFTGrid::fillInComplexNoise(NRLib::RandomGenerator & ranGen)
+{
+  assert(cvalue_ != NULL);
+  RandomStream stream = {ranGen};
+  fillInComplexNoiseFrom(stream);
+}
+
 void
 FFTGrid::createRealGrid(bool add)
 {
   istransformed_=false;
   add_ = add;
-  if(add==true)
+  if(add==true) {
+    if(nGrids_ >= maxAllowedGrids_)
+      GridWriter::reserve(1); // Grids held by pending output count against the limit.
     nGrids_ += 1;
+  }
   createGrid();
 }
 
@@ -1263,6 +1319,8 @@ void
 FFTGrid::createComplexGrid()
 {
   istransformed_  = true;
+  if(nGrids_ >= maxAllowedGrids_)
+    GridWriter::reserve(1);
   nGrids_        += 1;
   createGrid();
 }
@@ -1682,6 +1740,38 @@ FFTGrid::setComplexValue(int i, int j ,int k, fftw_complex value, bool extSimbox
     return(1);
 }
 
+const fftw_complex *
+FFTGrid::getComplexSlice(int k) const
+{
+  assert(istransformed_ == true);
+  assert(k >= 0 && k < nzp_);
+  return(cvalue_ + k*cnxp_*nyp_);
+}
+
+fftw_complex *
+FFTGrid::getWritableComplexSlice(int k)
+{
+  assert(istransformed_ == true);
+  assert(k >= 0 && k < nzp_);
+  return(cvalue_ + k*cnxp_*nyp_);
+}
+
+const fftw_real *
+FFTGrid::getRealSlice(int k) const
+{
+  assert(istransformed_ == false);
+  assert(k >= 0 && k < nzp_);
+  return(rvalue_ + k*rnxp_*nyp_);
+}
+
+fftw_real *
+FFTGrid::getWritableRealSlice(int k)
+{
+  assert(istransformed_ == false);
+  assert(k >= 0 && k < nzp_);
+  return(rvalue_ + k*rnxp_*nyp_);
+}
+
 int
 FFTGrid::square()
 {
@@ -1726,8 +1816,8 @@ int
 FFTGrid::expTransf()
 {
   assert(istransformed_==false);
-  int i;
-  for(i = 0;i < rsize_; i++)
+  #pragma omp parallel for num_threads(nThreads_)
+  for(int i = 0;i < rsize_; i++)
   {
     if( rvalue_[i]== RMISSING)
     {
@@ -1746,8 +1836,8 @@ int
 FFTGrid::logTransf()
 {
   assert(istransformed_==false);
-  int i;
-  for(i = 0;i < rsize_; i++)
+  #pragma omp parallel for num_threads(nThreads_)
+  for(int i = 0;i < rsize_; i++)
   {
     if( rvalue_[i]== RMISSING ||  rvalue_[i] <= 0.0 )
     {
@@ -1779,6 +1869,55 @@ FFTGrid::collapseAndAdd(float * grid)
     return(0);
 }
 
+void
+FFTGrid::addLateralAutoCorrelation(float * grid)
+{
+  // Adds the same nxp_*nyp_ values as fftInPlace, square, invFFTInPlace and collapseAndAdd
+  // would for a data grid. The zero time lag plane of the circular 3D autocorrelation is
+  // the sum of the circular 2D autocorrelations of the z-slices, so the grid is read one
+  // slice at a time, and a batch of slices is transformed in parallel.
+  assert(istransformed_==false);
+
+  rfftwnd_plan planForward  = FFTPlanCache::getPlan2D(nyp_, nxp_, FFTW_REAL_TO_COMPLEX);
+  rfftwnd_plan planBackward = FFTPlanCache::getPlan2D(nyp_, nxp_, FFTW_COMPLEX_TO_REAL);
+
+  double nxy   = static_cast<double>(nxp_)*nyp_;
+  double scale = 1.0/(nxy*sqrt(nxy*nzp_));
+
+  int    sliceSize = rnxp_*nyp_;
+  int    nBatch    = std::min(nThreads_, nzp_);
+  fftw_real * slices = static_cast<fftw_real*>(fftw_malloc(static_cast<size_t>(nBatch)*sliceSize*sizeof(fftw_real)));
+  std::vector<double> sum(nxp_*nyp_, 0.0);
+
+  for(int k0 = 0; k0 < nzp_; k0 += nBatch) {
+    int n = std::min(nBatch, nzp_ - k0);
+    for(int i = 0; i < n*sliceSize; i++)
+      slices[i] = getNextReal();
+
+#pragma omp parallel for num_threads(nThreads_)
+    for(int b = 0; b < n; b++) {
+      fftw_real    * rslice = slices + static_cast<size_t>(b)*sliceSize;
+      fftw_complex * cslice = reinterpret_cast<fftw_complex*>(rslice);
+      rfftwnd_one_real_to_complex(planForward, rslice, NULL);
+      for(int i = 0; i < cnxp_*nyp_; i++) {
+        cslice[i].re = cslice[i].re*cslice[i].re + cslice[i].im*cslice[i].im;
+        cslice[i].im = 0.0;
+      }
+      rfftwnd_one_complex_to_real(planBackward, cslice, NULL);
+    }
+
+    // Summed in slice order, so the result does not depend on the number of threads.
+    for(int b = 0; b < n; b++)
+      for(int j = 0; j < nyp_; j++)
+        for(int i = 0; i < nxp_; i++)
+          sum[i + j*nxp_] += slices[b*sliceSize + i + j*rnxp_];
+  }
+  fftw_free(slices);
+
+  for(int i = 0; i < nxp_*nyp_; i++)
+    grid[i] += static_cast<float>(scale*sum[i]);
+}
+
 void
 FFTGrid::fftInPlace()
 {
@@ -1796,13 +1935,15 @@ FFTGrid::fftInPlace()
   if( cubetype_!= COVARIANCE )
     FFTGrid::multiplyByScalar(1.0f/sqrt(static_cast<float>(nxp_*nyp_*nzp_)));
 
-  int flag;
-  rfftwnd_plan plan;
-  flag = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan= rfftw3d_create_plan(nzp_,nyp_,nxp_,FFTW_REAL_TO_COMPLEX,flag);
-  rfftwnd_one_real_to_complex(plan,rvalue_,cvalue_);
-  fftwnd_destroy_plan(plan);
+  if(nThreads_ > 1)
+    realToComplexThreaded();
+  else {
+    rfftwnd_plan plan = FFTPlanCache::getPlan3D(nzp_,nyp_,nxp_,FFTW_REAL_TO_COMPLEX);
+    rfftwnd_one_real_to_complex(plan,rvalue_,cvalue_);
+  }
   istransformed_=true;
+#pragma omp atomic
+  nFFTs_++;
   time(&timeend);
   LogKit::LogFormatted(LogKit::DebugLow,"\nFFT of grid type %d finished after %ld seconds \n",cubetype_, timeend-timestart);
 }
@@ -1822,24 +1963,86 @@ FFTGrid::invFFTInPlace()
   assert(cubetype_!= CTMISSING);
 
   float scale;
-  int flag;
-  rfftwnd_plan plan;
   if(cubetype_==COVARIANCE)
     scale=float( 1.0/(nxp_*nyp_*nzp_));
   else
     scale=float( 1.0/sqrt(float(nxp_*nyp_*nzp_)));
 
-  flag = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan= rfftw3d_create_plan(nzp_,nyp_,nxp_,FFTW_COMPLEX_TO_REAL,flag);
-  rfftwnd_one_complex_to_real(plan,cvalue_,rvalue_);
-  fftwnd_destroy_plan(plan);
+  if(nThreads_ > 1)
+    complexToRealThreaded();
+  else {
+    rfftwnd_plan plan = FFTPlanCache::getPlan3D(nzp_,nyp_,nxp_,FFTW_COMPLEX_TO_REAL);
+    rfftwnd_one_complex_to_real(plan,cvalue_,rvalue_);
+  }
   istransformed_=false;
+#pragma omp atomic
+  nInvFFTs_++;
 
   FFTGrid::multiplyByScalar(scale);
   time(&timeend);
   LogKit::LogFormatted(LogKit::DebugLow,"\nInverse FFT of grid type %d finished after %ld seconds \n",cubetype_, timeend-timestart);
 }
 
+void
+FFTGrid::realToComplexThreaded()
+{
+  // Same passes as the rfftwnd transform: real-to-complex along x for all rows, then
+  // complex transforms along y and z. Each pass consists of independent 1D transforms,
+  // which are split over the threads. A slab is done in x and y by the same thread.
+  rfftwnd_plan planX = FFTPlanCache::getPlan1D(nxp_, FFTW_REAL_TO_COMPLEX);
+  fftw_plan    planY = FFTPlanCache::getComplexPlan1D(nyp_, FFTW_FORWARD);
+  fftw_plan    planZ = FFTPlanCache::getComplexPlan1D(nzp_, FFTW_FORWARD);
+
+  int slabSize = cnxp_*nyp_;
+
+#pragma omp parallel num_threads(nThreads_)
+  {
+    fftw_complex * work = static_cast<fftw_complex*>(fftw_malloc(std::max(nyp_,nzp_)*sizeof(fftw_complex)));
+
+#pragma omp for
+    for(int k = 0; k < nzp_; k++) {
+      fftw_complex * slab = cvalue_ + static_cast<size_t>(k)*slabSize;
+      rfftwnd_real_to_complex(planX, nyp_, reinterpret_cast<fftw_real*>(slab), 1, rnxp_, NULL, 1, cnxp_);
+      fftw(planY, cnxp_, slab, cnxp_, 1, work, 1, 0);
+    }
+
+#pragma omp for
+    for(int j = 0; j < nyp_; j++)
+      fftw(planZ, cnxp_, cvalue_ + j*cnxp_, slabSize, 1, work, 1, 0);
+
+    fftw_free(work);
+  }
+}
+
+void
+FFTGrid::complexToRealThreaded()
+{
+  // Inverse of realToComplexThreaded, with the passes in the order used by rfftwnd.
+  rfftwnd_plan planX = FFTPlanCache::getPlan1D(nxp_, FFTW_COMPLEX_TO_REAL);
+  fftw_plan    planY = FFTPlanCache::getComplexPlan1D(nyp_, FFTW_BACKWARD);
+  fftw_plan    planZ = FFTPlanCache::getComplexPlan1D(nzp_, FFTW_BACKWARD);
+
+  int slabSize = cnxp_*nyp_;
+
+#pragma omp parallel num_threads(nThreads_)
+  {
+    fftw_complex * work = static_cast<fftw_complex*>(fftw_malloc(std::max(nyp_,nzp_)*sizeof(fftw_complex)));
+
+#pragma omp for
+    for(int j = 0; j < nyp_; j++)
+      fftw(planZ, cnxp_, cvalue_ + j*cnxp_, slabSize, 1, work, 1, 0);
+
+#pragma omp for
+    for(int k = 0; k < nzp_; k++) {
+      fftw_complex * slab = cvalue_ + static_cast<size_t>(k)*slabSize;
+      fftw(planY, cnxp_, slab, cnxp_, 1, work, 1, 0);
+      rfftwnd_complex_to_real(planX, nyp_, slab, 1, cnxp_, NULL, 1, rnxp_);
+    }
+
+    fftw_free(work);
+  }
+}
+
 void
 FFTGrid::realAbs()
 {
@@ -1961,16 +2164,12 @@ FFTGrid::fft1DzInPlace(fftw_real*  in, int nzp)
   // in is over vritten by out
   // not norm preservingtransform ifft(fft(funk))=N*funk
 
-  int flag;
-
   rfftwnd_plan plan;
   fftw_complex* out;
   out = reinterpret_cast<fftw_complex*>(in);
 
-  flag    = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan    = rfftwnd_create_plan(1, &nzp ,FFTW_REAL_TO_COMPLEX,flag);
+  plan    = FFTPlanCache::getPlan1D(nzp, FFTW_REAL_TO_COMPLEX);
   rfftwnd_one_real_to_complex(plan,in ,out);
-  fftwnd_destroy_plan(plan);
 
   return out;
 }
@@ -1981,15 +2180,12 @@ FFTGrid::invFFT1DzInPlace(fftw_complex* in, int nzp)
   // in is over vritten by out
   // not norm preserving transform  ifft(fft(funk))=N*funk
 
-  int flag;
   rfftwnd_plan plan;
   fftw_real*  out;
   out = reinterpret_cast<fftw_real*>(in);
 
-  flag = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan= rfftwnd_create_plan(1,&nzp,FFTW_COMPLEX_TO_REAL,flag);
+  plan= FFTPlanCache::getPlan1D(nzp, FFTW_COMPLEX_TO_REAL);
   rfftwnd_one_complex_to_real(plan,in,out);
-  fftwnd_destroy_plan(plan);
   return out;
 }
 
@@ -2148,11 +2344,7 @@ FFTGrid::writeSegyFile(const std::string       & fileName,
                        float                     z0,
                        const TraceHeaderFormat & thf)
 {
-  //  long int timestart, timeend;
-  //  time(&timestart);
-
   std::string gfName = fileName + IO::SuffixSegy();
-  //SegY * segy = new SegY(gfName, simbox);
   TextualHeader header = TextualHeader::standardHeader();
   float dz = float(floor(simbox->getdz()+0.5));
   if(dz==0)
@@ -2171,55 +2363,72 @@ FFTGrid::writeSegyFile(const std::string       & fileName,
   delete geometry; //Call above takes a copy.
   LogKit::LogFormatted(LogKit::Low,"\nWriting SEGY file "+gfName+"...");
 
-  int i,j,k;
-  double x,y,z;
-  std::vector<float> trace(segynz);//Maximum amount of data needed.
-  for(j=0;j<simbox->getny();j++)
-  {
-    for(i=0;i<simbox->getnx();i++)
-    {
+  // Columns with a defined top. Traces are not written for the other columns.
+  std::vector<int>    iCol;
+  std::vector<int>    jCol;
+  std::vector<double> zCol;
+  std::vector<float>  xCol;
+  std::vector<float>  yCol;
+  for(int j=0;j<simbox->getny();j++) {
+    for(int i=0;i<simbox->getnx();i++) {
+      double x, y, z;
       simbox->getCoord(i, j, 0, x, y, z);
       z = simbox->getTop(x,y);
-
-      if(z == RMISSING || z == WELLMISSING)
-      {
-        //printf("Missing trace.\n");
-        for(k=0;k<segynz;k++)
-          trace[k] = 0;
+      if(z != RMISSING && z != WELLMISSING) {
+        iCol.push_back(i);
+        jCol.push_back(j);
+        zCol.push_back(z);
+        xCol.push_back(static_cast<float>(x));
+        yCol.push_back(static_cast<float>(y));
       }
-      else
-      {
-        double gdz       = simbox->getdz()*simbox->getRelThick(i,j);
-        int    firstData = static_cast<int>(floor(0.5+(z-z0)/dz));
-        int    endData   = static_cast<int>(floor(0.5+((z-z0)+nz_*gdz)/dz));
+    }
+  }
 
-        if(endData > segynz)
-        {
-          printf("Internal warning: SEGY-grid too small (%d, %d needed). Truncating data.\n", nz_, endData);
-          endData = segynz;
-        }
-        for(k=0;k<firstData;k++)
-          trace[k] = 0;
-//          trace[k] = -1e35; //NBNB-Frode: Norsar-hack
-        for(;k<endData;k++)
-          trace[k] = this->getRegularZInterpolatedRealValue(i,j,z0,dz,k,z,gdz);
-        for(;k<segynz;k++)
-          trace[k] = 0;
-//          trace[k] = -1e35; //NBNB-Frode: Norsar-hack
-        float xx = static_cast<float>(x);
-        float yy = static_cast<float>(y);
-        segy->StoreTrace(xx, yy, trace, NULL);
+  // The traces are made and written in blocks of about 64MB, in file order.
+  std::vector<size_t> order;
+  segy->FindTraceOrder(xCol, yCol, order);
+
+  size_t nTraces   = order.size();
+  size_t blockSize = std::max(static_cast<size_t>(1), static_cast<size_t>(64*1024*1024)/(4*segynz + 240));
+  std::vector<float> x(std::min(blockSize, nTraces));
+  std::vector<float> y(x.size());
+  std::vector<float> data(x.size()*segynz);
+
+  int nThreads = (GridWriter::onWriterThread() ? 1 : nThreads_);
+
+  for(size_t start=0;start<nTraces;start+=blockSize) {
+    int n = static_cast<int>(std::min(blockSize, nTraces-start));
+#pragma omp parallel for num_threads(nThreads)
+    for(int t=0;t<n;t++) {
+      size_t c       = order[start+t];
+      int    i       = iCol[c];
+      int    j       = jCol[c];
+      double z       = zCol[c];
+      float * trace  = &data[t*segynz];
+      double gdz       = simbox->getdz()*simbox->getRelThick(i,j);
+      int    firstData = static_cast<int>(floor(0.5+(z-z0)/dz));
+      int    endData   = static_cast<int>(floor(0.5+((z-z0)+nz_*gdz)/dz));
+
+      if(endData > segynz)
+      {
+        printf("Internal warning: SEGY-grid too small (%d, %d needed). Truncating data.\n", nz_, endData);
+        endData = segynz;
       }
+      int k;
+      for(k=0;k<firstData;k++)
+        trace[k] = 0;
+      if(k < endData)
+        getRegularZInterpolatedRealTrace(i,j,z0,dz,k,endData,z,gdz,trace);
+      for(k=std::max(k,endData);k<segynz;k++)
+        trace[k] = 0;
+      x[t] = xCol[c];
+      y[t] = yCol[c];
     }
+    segy->WriteTraces(&x[0], &y[0], &data[0], n, nThreads);
   }
 
-  segy->WriteAllTracesToFile();
-
   delete segy; //Closes file.
-  // delete [] value;
   LogKit::LogFormatted(LogKit::Low,"done\n");
-  //  time(&timeend);
-  //printf("\n Write SEGY was performed in %ld seconds.\n",timeend-timestart);
   return(0);
 }
 
@@ -2478,6 +2687,46 @@ FFTGrid::getRegularZInterpolatedRealValue(int i, int j, double z0Reg,
   return(v);
 }
 
+void
+FFTGrid::getRegularZInterpolatedRealTrace(int i, int j, double z0Reg,
+                                          double dzReg, int kStart, int kEnd,
+                                          double z0Grid, double dzGrid,
+                                          float * trace) const
+{
+  // The column is read directly, with stride one z-slice.
+  const fftw_real * column = rvalue_ + i + rnxp_*j;
+  size_t            stride = static_cast<size_t>(rnxp_)*nyp_;
+
+  for(int kReg=kStart;kReg<kEnd;kReg++) {
+    float z     = static_cast<float> (z0Reg+dzReg*kReg);
+    float t     = static_cast<float> ((z-z0Grid)/dzGrid);
+    int   kGrid = int(t);
+
+    t -= kGrid;
+
+    if(kGrid<0) {
+      if(kGrid<-1) {
+        trace[kReg] = RMISSING;
+        continue;
+      }
+      kGrid = 0;
+      t = 0;
+    }
+    else if(kGrid>nz_-2) {
+      if(kGrid > nz_-1) {
+        trace[kReg] = RMISSING;
+        continue;
+      }
+      kGrid = nz_-2;
+      t = 1;
+    }
+
+    float v1 = (kGrid   >= 0 && kGrid   < nz_) ? static_cast<float>(column[kGrid*stride])     : RMISSING;
+    float v2 = (kGrid+1 >= 0 && kGrid+1 < nz_) ? static_cast<float>(column[(kGrid+1)*stride]) : RMISSING;
+    trace[kReg] = (1-t)*v1+t*v2;
+  }
+}
+
 void
 FFTGrid::writeAsciiFile(const std::string & fileName)
 {
@@ -2831,3 +3080,6 @@ int FFTGrid::nGrids_            = 0;
 bool FFTGrid::terminateOnMaxGrid_ = false;
 float FFTGrid::maxFFTMemUse_    = 0;
 float FFTGrid::FFTMemUse_       = 0;
+int FFTGrid::nFFTs_            = 0;
+int FFTGrid::nInvFFTs_         = 0;
+int FFTGrid::nThreads_          = 1;
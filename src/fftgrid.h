@@ -16,6 +16,7 @@
 class Wavelet;
 class Simbox;
 class RandomGen;
+namespace NRLib { class RandomGenerator; }
 class GridMapping;
 class SeismicParametersHolder;
 
@@ -83,6 +84,8 @@ public:
                                              float                z0_data,
                                              float                dz_fine,
                                              int                  n_fine);
+  // Write directly to the real grid, so different traces may be set from several threads.
+  // A file grid must be in RANDOMACCESS mode and marked as modified by the caller.
   void                 setTrace(const std::vector<float> & trace, size_t i, size_t j);
   void                 setTrace(float value, size_t i, size_t j);
   int                  fillInFromStorm(const Simbox      * actSimBox,
@@ -108,6 +111,7 @@ public:
 
 
   virtual void         fillInComplexNoise(RandomGen * ranGen);   // No mode/randomaccess
+  void                 fillInComplexNoise(NRLib::RandomGenerator & ranGen); // Own random stream. In-memory grids only
 
   void                 fillInFromArray(float *value);
   void                 calculateStatistics();                    // min,max, avg
@@ -124,12 +128,26 @@ public:
   fftw_complex         getComplexValue(int i, int j, int k, bool extSimbox = false) const;
   virtual int          setRealValue(int i, int j, int k, float value, bool extSimbox = false);  // Accessmode randomaccess
   int                  setComplexValue(int i, int j ,int k, fftw_complex value, bool extSimbox = false);
+
+  // Direct access to the padded grid storage, one z-slice (nyp_ rows) or one (j,k) row at a time.
+  // A complex row holds cnxp_ values and a real row rnxp_ values. Pointers stay valid until the
+  // grid is transformed or, for FFTFileGrid, until endAccess(). Different slices may be used
+  // from different threads.
+  virtual const fftw_complex * getComplexSlice(int k) const;                           // Accessmode randomaccess
+  virtual fftw_complex       * getWritableComplexSlice(int k);                         // Accessmode randomaccess
+  virtual const fftw_real    * getRealSlice(int k) const;                              // Accessmode randomaccess
+  virtual fftw_real          * getWritableRealSlice(int k);                            // Accessmode randomaccess
+  const fftw_complex   * getComplexRow(int j, int k) const  { return(getComplexSlice(k) + j*cnxp_) ;}
+  fftw_complex         * getWritableComplexRow(int j, int k) { return(getWritableComplexSlice(k) + j*cnxp_) ;}
+  const fftw_real      * getRealRow(int j, int k) const     { return(getRealSlice(k) + j*rnxp_) ;}
+  fftw_real            * getWritableRealRow(int j, int k)    { return(getWritableRealSlice(k) + j*rnxp_) ;}
   fftw_complex         getFirstComplexValue();
   virtual int          square();                                // No mode/randomaccess
   virtual int          expTransf();                             // No mode/randomaccess
   virtual int          logTransf();                             // No mode/randomaccess
   virtual void         realAbs();
   virtual int          collapseAndAdd(float* grid);             // No mode/randomaccess
+  void                 addLateralAutoCorrelation(float* grid);  // Accessmode read
   virtual void         fftInPlace();                            // No mode/randomaccess
   virtual void         invFFTInPlace();                         // No mode/randomaccess
 
@@ -201,7 +219,12 @@ public:
   static void          setMaxAllowedGrids(int maxAllowedGrids) {maxAllowedGrids_ = maxAllowedGrids ;}
   static int           getMaxAllowedGrids()   { return maxAllowedGrids_   ;}
   static int           getMaxAllocatedGrids() { return maxAllocatedGrids_ ;}
+  static int           getNumberOfGrids()     { return nGrids_            ;}
+  static double        getMaxFFTMemUse()      { return maxFFTMemUse_      ;}
+  static int           getNumberOfFFTs()      { return nFFTs_             ;}
+  static int           getNumberOfInvFFTs()   { return nInvFFTs_          ;}
   static void          setTerminateOnMaxGrid(bool terminate) {terminateOnMaxGrid_ = terminate ;}
+  static void          setNumberOfThreads(int nThreads) {nThreads_ = nThreads ;}
   static int           findClosestFactorableNumber(int leastint);
 
   static fftw_complex* fft1DzInPlace(fftw_real*  in, int nzp);
@@ -241,11 +264,23 @@ protected:
   float                getRegularZInterpolatedRealValue(int i, int j, double z0Reg,
                                                          double dzReg, int kReg,
                                                          double z0Grid, double dzGrid);
+  void                 getRegularZInterpolatedRealTrace(int i, int j, double z0Reg,          // Samples kStart to kEnd-1 of the
+                                                         double dzReg, int kStart, int kEnd, // trace, as given by the function above
+                                                         double z0Grid, double dzGrid,
+                                                         float * trace) const;
 
   //Supporting functions for interpolateSeismic
   int                  interpolateTrace(int index, short int * flags, int i, int j);
   void                 extrapolateSeismic(int imin, int imax, int jmin, int jmax);
 
+  //Shared by the fillInComplexNoise versions. Generator must provide rnorm01()
+  template <class Generator>
+  void                 fillInComplexNoiseFrom(Generator & ranGen);
+
+  //Threaded versions of the 3D transforms in fftInPlace and invFFTInPlace
+  void                 realToComplexThreaded();
+  void                 complexToRealThreaded();
+
   /// Called from writeResampledStormCube
   void                 writeSegyFromStorm(StormContGrid *data, std::string fileName);
   void                 makeDepthCubeForSegy(Simbox *simbox,const std::string & fileName);
@@ -289,5 +324,10 @@ protected:
   static float         maxFFTMemUse_;
   static float         FFTMemUse_;
 
+  static int           nFFTs_;             // Number of 3D transforms done, for the timings report.
+  static int           nInvFFTs_;
+
+  static int           nThreads_;          // Number of threads used in the 3D transforms and trace resampling.
+
 };
 #endif
@@ -0,0 +1,177 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <stdio.h>
+
+#include "nrlib/iotools/logkit.hpp"
+
+#include "src/definitions.h"
+#include "src/fftplancache.h"
+
+std::map<FFTPlanCache::PlanKey, rfftwnd_plan> FFTPlanCache::plans_;
+std::map<FFTPlanCache::PlanKey, fftw_plan>    FFTPlanCache::complexPlans_;
+
+bool FFTPlanCache::measure_ = false;
+int  FFTPlanCache::hits_    = 0;
+int  FFTPlanCache::misses_  = 0;
+
+bool
+FFTPlanCache::PlanKey::operator<(const PlanKey & other) const
+{
+  if(rank != other.rank)
+    return(rank < other.rank);
+  for(int i=0;i<rank;i++) {
+    if(n[i] != other.n[i])
+      return(n[i] < other.n[i]);
+  }
+  if(dir != other.dir)
+    return(dir < other.dir);
+  return(inPlace < other.inPlace);
+}
+
+rfftwnd_plan
+FFTPlanCache::getPlan1D(int n, fftw_direction dir, bool inPlace)
+{
+  PlanKey key;
+  key.rank    = 1;
+  key.n[0]    = n;
+  key.n[1]    = 0;
+  key.n[2]    = 0;
+  key.dir     = dir;
+  key.inPlace = inPlace;
+  return(getPlan(key));
+}
+
+rfftwnd_plan
+FFTPlanCache::getPlan2D(int ny, int nx, fftw_direction dir, bool inPlace)
+{
+  PlanKey key;
+  key.rank    = 2;
+  key.n[0]    = ny;
+  key.n[1]    = nx;
+  key.n[2]    = 0;
+  key.dir     = dir;
+  key.inPlace = inPlace;
+  return(getPlan(key));
+}
+
+rfftwnd_plan
+FFTPlanCache::getPlan3D(int nz, int ny, int nx, fftw_direction dir, bool inPlace)
+{
+  PlanKey key;
+  key.rank    = 3;
+  key.n[0]    = nz;
+  key.n[1]    = ny;
+  key.n[2]    = nx;
+  key.dir     = dir;
+  key.inPlace = inPlace;
+  return(getPlan(key));
+}
+
+fftw_plan
+FFTPlanCache::getComplexPlan1D(int n, fftw_direction dir)
+{
+  PlanKey key;
+  key.rank    = 1;
+  key.n[0]    = n;
+  key.n[1]    = 0;
+  key.n[2]    = 0;
+  key.dir     = dir;
+  key.inPlace = true;
+
+  fftw_plan plan;
+
+#pragma omp critical(FFTPlanCache)
+  {
+    std::map<PlanKey, fftw_plan>::const_iterator it = complexPlans_.find(key);
+    if(it != complexPlans_.end()) {
+      plan = it->second;
+      hits_++;
+    }
+    else {
+      plan = fftw_create_plan(n, dir, getPlanFlag(true));
+      complexPlans_[key] = plan;
+      misses_++;
+    }
+  }
+  return(plan);
+}
+
+int
+FFTPlanCache::getPlanFlag(bool inPlace)
+{
+  int flag = FFTW_THREADSAFE;
+  if(measure_)
+    flag |= FFTW_MEASURE | FFTW_USE_WISDOM;
+  else
+    flag |= FFTW_ESTIMATE;
+  if(inPlace)
+    flag |= FFTW_IN_PLACE;
+  return(flag);
+}
+
+rfftwnd_plan
+FFTPlanCache::getPlan(const PlanKey & key)
+{
+  rfftwnd_plan plan;
+
+#pragma omp critical(FFTPlanCache)
+  {
+    std::map<PlanKey, rfftwnd_plan>::const_iterator it = plans_.find(key);
+    if(it != plans_.end()) {
+      plan = it->second;
+      hits_++;
+    }
+    else {
+      plan = rfftwnd_create_plan(key.rank, key.n, key.dir, getPlanFlag(key.inPlace));
+      plans_[key] = plan;
+      misses_++;
+    }
+  }
+  return(plan);
+}
+
+bool
+FFTPlanCache::importWisdom(const std::string & fileName)
+{
+  FILE * file = fopen(fileName.c_str(), "r");
+  if(file == NULL)
+    return(false);
+
+  fftw_status status = fftw_import_wisdom_from_file(file);
+  fclose(file);
+
+  if(status != FFTW_SUCCESS) {
+    LogKit::LogFormatted(LogKit::Warning,"\nWARNING: Could not read FFT wisdom from file %s. Plans will be remeasured.\n",fileName.c_str());
+    return(false);
+  }
+  return(true);
+}
+
+bool
+FFTPlanCache::exportWisdom(const std::string & fileName)
+{
+  FILE * file = fopen(fileName.c_str(), "w");
+  if(file == NULL) {
+    LogKit::LogFormatted(LogKit::Warning,"\nWARNING: Could not write FFT wisdom to file %s.\n",fileName.c_str());
+    return(false);
+  }
+  fftw_export_wisdom_to_file(file);
+  fclose(file);
+  return(true);
+}
+
+void
+FFTPlanCache::clear(void)
+{
+  std::map<PlanKey, rfftwnd_plan>::iterator it;
+  for(it = plans_.begin(); it != plans_.end(); it++)
+    rfftwnd_destroy_plan(it->second);
+  plans_.clear();
+
+  std::map<PlanKey, fftw_plan>::iterator itc;
+  for(itc = complexPlans_.begin(); itc != complexPlans_.end(); itc++)
+    fftw_destroy_plan(itc->second);
+  complexPlans_.clear();
+}
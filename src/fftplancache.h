@@ -0,0 +1,67 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef FFTPLANCACHE_H
+#define FFTPLANCACHE_H
+
+#include <map>
+#include <string>
+
+#include "rfftw.h"
+
+// Process-wide cache of rfftw plans. Plans are created the first time a given
+// (dimensions, direction, in-place) combination is requested, and are kept until
+// clear() is called. All plans are made with FFTW_THREADSAFE, so a cached plan may
+// be executed by several threads at the same time.
+//
+// By default plans are made with FFTW_ESTIMATE. With setMeasure(true) they are made
+// with FFTW_MEASURE, and the accumulated wisdom can be exported to file and imported
+// in later runs, so planning is skipped for geometries that have been seen before.
+
+class FFTPlanCache
+{
+public:
+  static rfftwnd_plan getPlan1D(int n, fftw_direction dir, bool inPlace = true);
+  static rfftwnd_plan getPlan2D(int ny, int nx, fftw_direction dir, bool inPlace = true);
+  static rfftwnd_plan getPlan3D(int nz, int ny, int nx, fftw_direction dir, bool inPlace = true);
+
+  // In-place complex plan, used for the y and z passes of the threaded 3D transform.
+  static fftw_plan    getComplexPlan1D(int n, fftw_direction dir);
+
+  static void         setMeasure(bool measure) { measure_ = measure ;}
+  static bool         getMeasure(void)         { return measure_    ;}
+
+  static bool         importWisdom(const std::string & fileName);
+  static bool         exportWisdom(const std::string & fileName);
+
+  static int          getHits(void)            { return hits_       ;}
+  static int          getMisses(void)          { return misses_     ;}
+
+  static void         clear(void);
+
+private:
+  FFTPlanCache();
+
+  struct PlanKey
+  {
+    int            rank;
+    int            n[3];
+    fftw_direction dir;
+    bool           inPlace;
+
+    bool operator<(const PlanKey & other) const;
+  };
+
+  static rfftwnd_plan getPlan(const PlanKey & key);
+  static int          getPlanFlag(bool inPlace);
+
+  static std::map<PlanKey, rfftwnd_plan> plans_;
+  static std::map<PlanKey, fftw_plan>    complexPlans_;
+
+  static bool         measure_;
+  static int          hits_;
+  static int          misses_;
+};
+
+#endif
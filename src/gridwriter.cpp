@@ -0,0 +1,269 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <algorithm>
+#include <exception>
+
+#include "nrlib/exception/exception.hpp"
+#include "nrlib/iotools/logkit.hpp"
+
+#include "src/gridwriter.h"
+#include "src/fftgrid.h"
+#include "src/timings.h"
+
+void
+GridWriter::start(int nThreads)
+{
+#if !defined(_WIN32)
+  int nWriters = std::min(maxWriters_, nThreads - 1);
+  for(int i=0;i<nWriters;i++) {
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, work, NULL) != 0)
+      break;
+    threads_.push_back(thread);
+  }
+#else
+  (void) nThreads;
+#endif
+}
+
+void
+GridWriter::stop(void)
+{
+  // The threads are ended even if a grid could not be written. The queue is emptied
+  // before the writers see stopping_, so all grids have been handled after the join.
+  std::string error;
+  try {
+    flush();
+  }
+  catch(NRLib::IOError & e) {
+    error = e.what();
+  }
+#if !defined(_WIN32)
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&jobReady_);
+  pthread_mutex_unlock(&mutex_);
+  for(size_t i=0;i<threads_.size();i++)
+    pthread_join(threads_[i], NULL);
+  stopping_ = false;
+#endif
+  threads_.clear();
+
+  try {
+    collectFinished();
+  }
+  catch(NRLib::IOError & e) {
+    if(error == "")
+      error = e.what();
+  }
+  if(error != "")
+    throw NRLib::IOError(error);
+}
+
+GridWriter::StopGuard::~StopGuard()
+{
+  try {
+    GridWriter::stop();
+  }
+  catch(NRLib::IOError & e) {
+    LogKit::LogMessage(LogKit::Error, std::string("\nERROR: Writing of grid failed: ") + e.what() + "\n");
+  }
+}
+
+void
+GridWriter::writeFile(FFTGrid                 * grid,
+                      bool                      deleteGrid,
+                      const std::string       & fileName,
+                      const std::string       & subDir,
+                      const Simbox            * simbox,
+                      const std::string       & label,
+                      float                     z0,
+                      const GridMapping       * depthMap,
+                      const GridMapping       * timeMap,
+                      const TraceHeaderFormat & thf,
+                      bool                      padding)
+{
+  collectFinished();
+
+  bool direct = threads_.empty() || grid->isFile();
+  if(!direct && !deleteGrid) {
+    // The copy is read with getNextReal from the current position and filled with
+    // setNextReal from the start, so both cursors must be at the start.
+    waitForRoom(1);
+    direct = !hasRoom(1) || grid->getIsTransformed()
+             || grid->getCounterForGet() != 0 || grid->getCounterForSet() != 0;
+  }
+
+  if(direct) {
+    grid->writeFile(fileName, subDir, simbox, label, z0, depthMap, timeMap, thf, padding);
+    if(deleteGrid)
+      delete grid;
+    return;
+  }
+
+  Job * job      = new Job(deleteGrid ? grid : new FFTGrid(grid), thf);
+  job->fileName  = fileName;
+  job->subDir    = subDir;
+  job->simbox    = simbox;
+  job->label     = label;
+  job->z0        = z0;
+  job->depthMap  = depthMap;
+  job->timeMap   = timeMap;
+  job->padding   = padding;
+
+#if !defined(_WIN32)
+  pthread_mutex_lock(&mutex_);
+  queue_.push_back(job);
+  nPending_++;
+  pthread_cond_signal(&jobReady_);
+  pthread_mutex_unlock(&mutex_);
+#endif
+
+  // A handed over grid would otherwise have been deleted by now.
+  if(deleteGrid)
+    waitForRoom(0);
+}
+
+void
+GridWriter::reserve(int nGrids)
+{
+  collectFinished();
+  waitForRoom(nGrids);
+}
+
+void
+GridWriter::flush(void)
+{
+  while(getPending() > 0)
+    waitForOne();
+  collectFinished();
+}
+
+bool
+GridWriter::onWriterThread(void)
+{
+#if !defined(_WIN32)
+  pthread_t self = pthread_self();
+  for(size_t i=0;i<threads_.size();i++) {
+    if(pthread_equal(threads_[i], self))
+      return(true);
+  }
+#endif
+  return(false);
+}
+
+bool
+GridWriter::hasRoom(int nGrids)
+{
+  return(FFTGrid::getNumberOfGrids() + nGrids <= FFTGrid::getMaxAllowedGrids());
+}
+
+void
+GridWriter::waitForRoom(int nGrids)
+{
+  while(!hasRoom(nGrids) && getPending() > 0)
+    waitForOne();
+}
+
+void
+GridWriter::waitForOne(void)
+{
+  Timings::Region region("Waiting for grid output");
+#if !defined(_WIN32)
+  pthread_mutex_lock(&mutex_);
+  while(finished_.empty() && nPending_ > 0)
+    pthread_cond_wait(&jobDone_, &mutex_);
+  pthread_mutex_unlock(&mutex_);
+#endif
+  collectFinished();
+}
+
+int
+GridWriter::getPending(void)
+{
+#if !defined(_WIN32)
+  pthread_mutex_lock(&mutex_);
+  int nPending = nPending_;
+  pthread_mutex_unlock(&mutex_);
+  return(nPending);
+#else
+  return(nPending_);
+#endif
+}
+
+void
+GridWriter::collectFinished(void)
+{
+  std::vector<Job *> finished;
+  std::string        error;
+#if !defined(_WIN32)
+  pthread_mutex_lock(&mutex_);
+  finished.swap(finished_);
+  error.swap(error_);
+  pthread_mutex_unlock(&mutex_);
+#endif
+
+  for(size_t i=0;i<finished.size();i++) {
+    delete finished[i]->grid;
+    delete finished[i];
+  }
+  if(error != "")
+    throw NRLib::IOError(error);
+}
+
+void
+GridWriter::write(Job * job)
+{
+  job->grid->writeFile(job->fileName, job->subDir, job->simbox, job->label, job->z0,
+                       job->depthMap, job->timeMap, job->thf, job->padding);
+}
+
+void *
+GridWriter::work(void * /*arg*/)
+{
+#if !defined(_WIN32)
+  pthread_mutex_lock(&mutex_);
+  for(;;) {
+    while(queue_.empty() && !stopping_)
+      pthread_cond_wait(&jobReady_, &mutex_);
+    if(queue_.empty())
+      break;
+    Job * job = queue_.front();
+    queue_.pop_front();
+    pthread_mutex_unlock(&mutex_);
+
+    std::string error;
+    try {
+      write(job);
+    }
+    catch(std::exception & e) {
+      error = e.what();
+    }
+
+    pthread_mutex_lock(&mutex_);
+    if(error != "" && error_ == "")
+      error_ = error;
+    finished_.push_back(job);
+    nPending_--;
+    pthread_cond_broadcast(&jobDone_);
+  }
+  pthread_mutex_unlock(&mutex_);
+#endif
+  return(NULL);
+}
+
+std::deque<GridWriter::Job *>  GridWriter::queue_;
+std::vector<GridWriter::Job *> GridWriter::finished_;
+int                            GridWriter::nPending_ = 0;
+bool                           GridWriter::stopping_ = false;
+std::string                    GridWriter::error_;
+#if !defined(_WIN32)
+std::vector<pthread_t>         GridWriter::threads_;
+pthread_mutex_t                GridWriter::mutex_    = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t                 GridWriter::jobReady_ = PTHREAD_COND_INITIALIZER;
+pthread_cond_t                 GridWriter::jobDone_  = PTHREAD_COND_INITIALIZER;
+#else
+std::vector<int>               GridWriter::threads_;
+#endif
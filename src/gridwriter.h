@@ -0,0 +1,117 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef GRIDWRITER_H
+#define GRIDWRITER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+#include "src/definitions.h"
+
+class FFTGrid;
+class Simbox;
+class GridMapping;
+
+// Writes FFTGrids to file (FFTGrid::writeFile) on a small pool of background threads,
+// so that the output formats of one grid are written while the next grid is computed.
+//
+// A grid the caller keeps using is copied before it is queued. The writer may hold
+// grids only while the number of allocated grids is within the limit set by
+// ModelAVOStatic::checkAvailableMemory (FFTGrid::getMaxAllowedGrids). When there is
+// no room for a copy, the caller waits for pending writes to finish, and the grid is
+// written directly if there is still no room. File grids and grids written without
+// writer threads (one thread, or Windows) are always written directly.
+//
+// Grids are allocated and deleted by the main thread only, so the grid counters in
+// FFTGrid are never updated by the writer threads.
+
+class GridWriter
+{
+public:
+  static void    start(int nThreads);   // Uses up to maxWriters_ threads, and fewer than nThreads
+  static void    stop(void);            // Writes all pending grids and ends the threads, also after a write error
+
+  // Stops the writers when it goes out of scope, so that every exit from main waits for
+  // the pending grids. A write error is logged, as it cannot be thrown from a destructor.
+  class StopGuard
+  {
+  public:
+    StopGuard() {}
+    ~StopGuard();
+  };
+
+  // If deleteGrid is true, the grid is handed over and deleted when it has been written.
+  static void    writeFile(FFTGrid                 * grid,
+                           bool                      deleteGrid,
+                           const std::string       & fileName,
+                           const std::string       & subDir,
+                           const Simbox            * simbox,
+                           const std::string       & label,
+                           float                     z0,
+                           const GridMapping       * depthMap,
+                           const GridMapping       * timeMap,
+                           const TraceHeaderFormat & thf,
+                           bool                      padding);
+
+  static void    reserve(int nGrids);   // Waits until nGrids more grids fit within the memory limit
+  static void    flush(void);           // Waits until all pending grids are written
+
+  static int     getNumberOfWriters(void) { return static_cast<int>(threads_.size()) ;}
+
+  // True on a writer thread. Writers run beside the computation, so grid output code
+  // uses a single OpenMP thread there.
+  static bool    onWriterThread(void);
+
+private:
+  GridWriter() {}
+
+  struct Job
+  {
+    Job(FFTGrid * g, const TraceHeaderFormat & t) : grid(g), thf(t) {}
+
+    FFTGrid           * grid;
+    std::string         fileName;
+    std::string         subDir;
+    const Simbox      * simbox;
+    std::string         label;
+    float               z0;
+    const GridMapping * depthMap;
+    const GridMapping * timeMap;
+    TraceHeaderFormat   thf;
+    bool                padding;
+  };
+
+  static bool    hasRoom(int nGrids);
+  static void    waitForRoom(int nGrids);
+  static void    waitForOne(void);
+  static int     getPending(void);
+  static void    collectFinished(void);
+  static void    write(Job * job);
+
+  static void  * work(void * arg);
+
+  static const int            maxWriters_ = 2;
+
+  static std::deque<Job *>    queue_;      // Jobs waiting for a writer
+  static std::vector<Job *>   finished_;   // Written jobs whose grids are not yet deleted
+  static int                  nPending_;   // Jobs queued or being written
+  static bool                 stopping_;
+  static std::string          error_;      // First error from a writer thread
+#if !defined(_WIN32)
+  static std::vector<pthread_t> threads_;
+  static pthread_mutex_t      mutex_;
+  static pthread_cond_t       jobReady_;
+  static pthread_cond_t       jobDone_;
+#else
+  static std::vector<int>     threads_;
+#endif
+};
+
+#endif
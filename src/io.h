@@ -38,6 +38,8 @@ public:
   inline static  std::string    FileDebug(void)                    { return std::string("debug")                    ;}
   inline static  std::string    FileError(void)                    { return std::string("error")                    ;}
   inline static  std::string    FileTasks(void)                    { return std::string("tasks")                    ;}
+  inline static  std::string    FileFFTWisdom(void)                { return std::string("fft_wisdom")               ;}
+  inline static  std::string    FileTimings(void)                  { return std::string("timings")                  ;}
   inline static  std::string    FileParameterCov(void)             { return std::string("Parameter_Covariance")     ;}
   inline static  std::string    FileLateralCorr(void)              { return std::string("Lateral_Correlation")      ;}
   inline static  std::string    FileTemporalCorr(void)             { return std::string("Temporal_Correlation")     ;}
@@ -84,6 +86,8 @@ public:
 
   inline static  std::string    SuffixGeneralData(void)            { return std::string(".dat")                     ;}
   inline static  std::string    SuffixTextFiles(void)              { return std::string(".txt")                     ;}
+  inline static  std::string    SuffixJsonFiles(void)              { return std::string(".json")                    ;}
+  inline static  std::string    SuffixCsvFiles(void)               { return std::string(".csv")                     ;}
   inline static  std::string    SuffixCrava(void)                  { return std::string(".crava")                   ;}
   inline static  std::string    SuffixAsciiFiles(void)             { return std::string(".ascii")                   ;}
   inline static  std::string    SuffixAsciiIrapClassic(void)       { return std::string(".irap")                    ;}
@@ -171,7 +175,8 @@ public:
                              LOCAL_NOISE         =  8,
                              ROCK_PHYSICS        = 16,
                              ERROR_FILE          = 32,
-                             TASK_FILE           = 64};
+                             TASK_FILE           = 64,
+                             TIMINGS             = 128};
 
   enum           outputWavelets{WELL_WAVELETS    = 1,
                                 GLOBAL_WAVELETS  = 2,
@@ -58,6 +58,104 @@ void Kriging2D::krigSurface(Grid2D              & trend,
   }
 }
 
+Kriging2D::FactorCache::~FactorCache(void)
+{
+  std::map<Locations, NRLib::SymmetricMatrix *>::iterator it;
+  for(it = factors_.begin(); it != factors_.end(); it++)
+    delete it->second;
+}
+
+void Kriging2D::krigSurfaces(std::vector<Grid2D *>                    & trends,
+                             const std::vector<const KrigingData2D *> & krigingData,
+                             const CovGrid2D                          & cov,
+                             FactorCache                              & cache,
+                             int                                        nThreads)
+{
+  int nSurfaces = static_cast<int>(trends.size());
+  if (nSurfaces == 0)
+    return;
+
+  int nx = static_cast<int>(trends[0]->GetNI());
+  int ny = static_cast<int>(trends[0]->GetNJ());
+
+  std::vector<bool> done(nSurfaces, false);
+
+  for (int s = 0 ; s < nSurfaces ; s++) {
+    if (done[s])
+      continue;
+    done[s] = true;
+
+    int md = krigingData[s]->getNumberOfData();
+    if (md == 0 || md >= nx*ny)
+      continue;
+
+    const std::vector<int> & indexi = krigingData[s]->getIndexI();
+    const std::vector<int> & indexj = krigingData[s]->getIndexJ();
+
+    // Surfaces with data in the same locations, in the same order, share the kriging system
+    std::vector<int> group(1, s);
+    for (int t = s + 1 ; t < nSurfaces ; t++) {
+      if (!done[t] && krigingData[t]->getIndexI() == indexi && krigingData[t]->getIndexJ() == indexj) {
+        group.push_back(t);
+        done[t] = true;
+      }
+    }
+    int nRhs = static_cast<int>(group.size());
+
+    NRLib::SymmetricMatrix & L = getFactor(cache, cov, indexi, indexj);
+
+    NRLib::Matrix B(md, nRhs);
+    NRLib::Vector residual(md);
+    for (int c = 0 ; c < nRhs ; c++) {
+      subtractTrend(residual, krigingData[group[c]]->getData(), *trends[group[c]], indexi, indexj);
+      B(flens::_, c) = residual;
+    }
+
+    NRLib::CholeskySolveFactorized(L, B);
+
+    std::vector<NRLib::Vector *> x(nRhs);
+    for (int c = 0 ; c < nRhs ; c++) {
+      x[c]  = new NRLib::Vector(md);
+      *x[c] = B(flens::_, c);
+    }
+
+#pragma omp parallel num_threads(nThreads)
+    {
+      NRLib::Vector k(md);
+#pragma omp for schedule(static)
+      for (int i = 0 ; i < nx ; i++) {
+        for (int j = 0 ; j < ny ; j++) {
+          fillKrigingVector(k, cov, indexi, indexj, i, j);
+          for (int c = 0 ; c < nRhs ; c++)
+            (*trends[group[c]])(i,j) += k * (*x[c]);
+        }
+      }
+    }
+
+    for (int c = 0 ; c < nRhs ; c++)
+      delete x[c];
+  }
+}
+
+NRLib::SymmetricMatrix &
+Kriging2D::getFactor(FactorCache            & cache,
+                     const CovGrid2D        & cov,
+                     const std::vector<int> & indexi,
+                     const std::vector<int> & indexj)
+{
+  FactorCache::Locations locations(indexi, indexj);
+
+  std::map<FactorCache::Locations, NRLib::SymmetricMatrix *>::iterator it = cache.factors_.find(locations);
+  if (it != cache.factors_.end())
+    return *(it->second);
+
+  NRLib::SymmetricMatrix * K = new NRLib::SymmetricMatrix(static_cast<int>(indexi.size()));
+  fillKrigingMatrix(*K, cov, indexi, indexj);
+  NRLib::CholeskyFactorize(*K);
+  cache.factors_[locations] = K;
+  return *K;
+}
+
 void
 Kriging2D::subtractTrend(NRLib::Vector            & residual,
                          const std::vector<float> & data,
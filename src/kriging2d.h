@@ -5,6 +5,9 @@
 #ifndef KRIGING2D_H
 #define KRIGING2D_H
 
+#include <map>
+#include <vector>
+
 #include "src/definitions.h"
 #include "src/covgrid2d.h"
 #include "src/krigingdata2d.h"
@@ -18,16 +21,47 @@ class CovGrid2D;
 class Kriging2D
 {
 public:
+  // Cholesky factors of kriging matrices, kept for each set of data locations.
+  class FactorCache
+  {
+  public:
+    FactorCache(void) {}
+    ~FactorCache(void);
+
+  private:
+    friend class Kriging2D;
+    FactorCache(const FactorCache &);
+    FactorCache & operator=(const FactorCache &);
+
+    typedef std::pair<std::vector<int>, std::vector<int> > Locations;
+    std::map<Locations, NRLib::SymmetricMatrix *> factors_;
+  };
+
   static void  krigSurface(Grid2D              & trend,
                            const KrigingData2D & krigingData,
                            const CovGrid2D     & cov,
                            bool                  getResiduals = false);
 
+  // Kriges several surfaces of the same size, as krigSurface does. Surfaces with data in
+  // the same locations are kriged together: the kriging vector of each grid node is made
+  // once, and the residuals are solved for as multiple right-hand sides. The Cholesky
+  // factor for each set of locations is kept in cache and reused in later calls.
+  static void  krigSurfaces(std::vector<Grid2D *>                    & trends,
+                            const std::vector<const KrigingData2D *> & krigingData,
+                            const CovGrid2D                          & cov,
+                            FactorCache                              & cache,
+                            int                                        nThreads);
+
   static CovGrid2D & makeCovGrid2D(const Simbox * simbox,
                                    Vario        * vario,
                                    int            debugFlag);
 
 private:
+  static NRLib::SymmetricMatrix & getFactor(FactorCache            & cache,
+                                            const CovGrid2D        & cov,
+                                            const std::vector<int> & indexi,
+                                            const std::vector<int> & indexj);
+
   static void  subtractTrend(NRLib::Vector            & d,
                              const std::vector<float> & data,
                              const Grid2D             & trend,
@@ -50,9 +50,6 @@ CKrigingAdmin::~CKrigingAdmin(void)
 {
   delete pBWellGrid_;
 
-  delete [] pIndexAlpha_;
-  delete [] pIndexBeta_;
-  delete [] pIndexRho_;
   int i;
   for (i = 0; i < GetSmoothBlockNx() - 2; i++) {
     delete [] ppKrigSmoothWeightsX_[i];
@@ -71,7 +68,7 @@ CKrigingAdmin::~CKrigingAdmin(void)
 }
 
 void CKrigingAdmin::Init() {
-  i_ = j_ = k_ = 0;
+  nThreads_ = 1;
 
   //
   // Create indicator grid having 1.0f if data in cell and -1.0f if no data in cell
@@ -94,8 +91,7 @@ void CKrigingAdmin::Init() {
   }
   noValid_ = noValidAlpha_ + noValidBeta_ + noValidRho_;
 
-  noKrigedCells_ = noKrigedVariables_ = totalNoDataInCurrKrigBlock_= noEmptyDataBlocks_ = 0;
-  sizeAlpha_ = sizeBeta_ = sizeRho_ = 0;
+  noKrigedCells_ = noKrigedVariables_ = noEmptyDataBlocks_ = 0;
   rangeAlphaX_ = rangeAlphaY_ = rangeAlphaZ_ = 0;
   rangeBetaX_ = rangeBetaY_ = rangeBetaZ_ = 0;
   rangeRhoX_ = rangeRhoY_ = rangeRhoZ_ = 0;
@@ -155,13 +151,9 @@ void CKrigingAdmin::Init() {
     (dyBlock_ + 2*static_cast<int>(ceil(rangeY_))) *
     (dzBlock_ + 2*static_cast<int>(ceil(rangeZ_)));
 
-  int maxAlphaData2 = std::min(noValidAlpha_, sizeMaxBlock);
-  int maxBetaData2  = std::min(noValidBeta_, sizeMaxBlock);
-  int maxRhoData2   = std::min(noValidRho_, sizeMaxBlock);
-
-  pIndexAlpha_ = new int[maxAlphaData2];
-  pIndexBeta_ = new int[maxBetaData2];
-  pIndexRho_  = new int[maxRhoData2];
+  maxAlphaData_ = std::min(noValidAlpha_, sizeMaxBlock);
+  maxBetaData_  = std::min(noValidBeta_, sizeMaxBlock);
+  maxRhoData_   = std::min(noValidRho_, sizeMaxBlock);
 
   Require(dxBlockExt_ <= rangeX_ && dyBlockExt_ <= rangeY_ && dzBlockExt_ <= rangeZ_,
     "dxBlockExt_ <= rangeX_ && dyBlockExt_ <= rangeY_ && dzBlockExt_ <= rangeZ_");
@@ -169,6 +161,14 @@ void CKrigingAdmin::Init() {
   WriteDebugOutput();
 }
 
+void CKrigingAdmin::InitKrigingBlock(KrigingBlock & block) const {
+  block.indexAlpha.resize(maxAlphaData_);
+  block.indexBeta.resize(maxBetaData_);
+  block.indexRho.resize(maxRhoData_);
+  block.sizeAlpha = block.sizeBeta = block.sizeRho = block.totalNoData = 0;
+  block.separable = false;
+}
+
 void CKrigingAdmin::KrigAll(Gamma gamma, bool doSmoothing) {
   // basic set of neighbourhoods
   noCholeskyDecomp_ = noSolvedMatrixEq_ = 0;
@@ -176,27 +176,32 @@ void CKrigingAdmin::KrigAll(Gamma gamma, bool doSmoothing) {
   const int nxBlock = NBlocks(dxBlock_, simbox_.getnx());
   const int nyBlock = NBlocks(dyBlock_, simbox_.getny());
   const int nzBlock = NBlocks(dzBlock_, simbox_.getnz());
+  const int nBlocks = nxBlock*nyBlock*nzBlock;
 
   monitorSize_ = int(3*simbox_.getnx()*simbox_.getny()*simbox_.getnz()*0.02);
   monitorSize_ = std::max(1,monitorSize_);
 
-  // loop over all kriging blocks
-  int i,j,k;
-  for (k = 0; k < nzBlock; k++) {
-    int k1 = k*dzBlock_;
-    for (j = 0; j < nyBlock; j++) {
+  // loop over all kriging blocks. The blocks are independent and cover disjoint cells.
+#pragma omp parallel num_threads(nThreads_)
+  {
+    KrigingBlock block;
+    InitKrigingBlock(block);
+
+#pragma omp for schedule(dynamic, 1)
+    for (int b = 0; b < nBlocks; b++) {
+      int i = b % nxBlock;
+      int j = (b / nxBlock) % nyBlock;
+      int k = b / (nxBlock*nyBlock);
+      int i1 = i*dxBlock_;
       int j1 = j*dyBlock_;
-      for (i = 0; i < nxBlock; i++) {
-   //     LogKit::LogFormatted(LogKit::DebugLow,"%d %d %d : %d %d %d\n",i, j, k, nxBlock, nyBlock, nzBlock);
-        int i1 = i*dxBlock_;
-        currBlock_ = CBox(i1, j1, k1, i1 + dxBlock_ - 1, j1 + dyBlock_ - 1, k1 + dzBlock_ - 1, &simbox_);
-        currDataBox_ = CBox(i1 - dxBlockExt_, j1 - dyBlockExt_, k1 - dzBlockExt_,
-          i1 + dxBlock_ + dxBlockExt_ - 1, j1 + dyBlock_ + dyBlockExt_ - 1, k1 + dzBlock_ + dzBlockExt_ - 1,
-          &simbox_);
-        KrigBlock(gamma);
-      } // end i
-    } // end j
-  } // end k
+      int k1 = k*dzBlock_;
+      block.currBlock   = CBox(i1, j1, k1, i1 + dxBlock_ - 1, j1 + dyBlock_ - 1, k1 + dzBlock_ - 1, &simbox_);
+      block.currDataBox = CBox(i1 - dxBlockExt_, j1 - dyBlockExt_, k1 - dzBlockExt_,
+        i1 + dxBlock_ + dxBlockExt_ - 1, j1 + dyBlock_ + dyBlockExt_ - 1, k1 + dzBlock_ + dzBlockExt_ - 1,
+        &simbox_);
+      KrigBlock(gamma, block);
+    } // end b
+  }
   noKrigedVariables_++;
   if (!backgroundModel_ && doSmoothing==true) {
     //LogKit::LogFormatted(LogKit::Low,"SmoothKrigedResult start\n");
@@ -208,7 +213,8 @@ void CKrigingAdmin::KrigAll(Gamma gamma, bool doSmoothing) {
 }
 
 void CKrigingAdmin::KrigAll(FFTGrid& trendAlpha, FFTGrid& trendBeta, FFTGrid& trendRho,
-                            bool trendsAlreadySubtracted, int debugflag, bool doSmoothing) {
+                            bool trendsAlreadySubtracted, int debugflag, bool doSmoothing,
+                            int nThreads) {
   Require(!trendAlpha.getIsTransformed()
           && !trendBeta.getIsTransformed()
           && !trendRho.getIsTransformed(),
@@ -245,6 +251,7 @@ void CKrigingAdmin::KrigAll(FFTGrid& trendAlpha, FFTGrid& trendBeta, FFTGrid& tr
   trendAlpha_ = &trendAlpha;
   trendBeta_  = &trendBeta;
   trendRho_   = &trendRho;
+  nThreads_   = std::max(1, nThreads);
 
   printf("\n  0%%       20%%       40%%       60%%       80%%      100%%");
   printf("\n  |    |    |    |    |    |    |    |    |    |    |  ");
@@ -275,34 +282,43 @@ void CKrigingAdmin::KrigAll(FFTGrid& trendAlpha, FFTGrid& trendBeta, FFTGrid& tr
   LogKit::LogFormatted(LogKit::DebugHigh,"KrigAll finished\n");
 }
 
-void CKrigingAdmin::KrigBlock(Gamma gamma)
+void CKrigingAdmin::KrigBlock(Gamma gamma, KrigingBlock & block)
 {
   // search for neighbours
-  LogKit::LogFormatted(LogKit::DebugHigh,"FindDataInDataBlockLoop(gamma) called next\n");
-  FindDataInDataBlockLoop(gamma);
-  LogKit::LogFormatted(LogKit::DebugHigh,"sizeAlpha_: %d\n", sizeAlpha_);
-  LogKit::LogFormatted(LogKit::DebugHigh,"sizeBeta_: %d\n", sizeBeta_);
-  LogKit::LogFormatted(LogKit::DebugHigh,"sizeRho_: %d\n", sizeRho_);
-  LogKit::LogFormatted(LogKit::DebugHigh,"totalNoDataInCurrKrigBlock_: %d\n", totalNoDataInCurrKrigBlock_);
+  FindDataInDataBlockLoop(gamma, block);
+#pragma omp critical(krigingadmin_log)
+  {
+    LogKit::LogFormatted(LogKit::DebugHigh,"sizeAlpha: %d\n", block.sizeAlpha);
+    LogKit::LogFormatted(LogKit::DebugHigh,"sizeBeta: %d\n", block.sizeBeta);
+    LogKit::LogFormatted(LogKit::DebugHigh,"sizeRho: %d\n", block.sizeRho);
+    LogKit::LogFormatted(LogKit::DebugHigh,"totalNoData: %d\n", block.totalNoData);
+  }
   //FindDataInDataBlock(gamma); //DEBUG
 
   int iMin, jMin, kMin, iMax, jMax, kMax;
-  currBlock_.GetMin(iMin, jMin, kMin); currBlock_.GetMax(iMax, jMax, kMax);
-  if (!totalNoDataInCurrKrigBlock_) {
-    int cellsInBlock = (kMax - kMin + 1)*(jMax - jMin + 1)*(iMax - iMin + 1);
-    int i;
-    for (i=noKrigedCells_ ; i<noKrigedCells_+cellsInBlock ; i++) {
-      if (noKrigedCells_ > 0 && i%monitorSize_ == 0) {
-        printf("^");
-        fflush(stdout);
+  block.currBlock.GetMin(iMin, jMin, kMin); block.currBlock.GetMax(iMax, jMax, kMax);
+  const int nxB = iMax - iMin + 1;
+  const int nyB = jMax - jMin + 1;
+  const int nzB = kMax - kMin + 1;
+  const int cellsInBlock = nxB*nyB*nzB;
+
+  if (!block.totalNoData) {
+#pragma omp critical(krigingadmin_result)
+    {
+      int i;
+      for (i=noKrigedCells_ ; i<noKrigedCells_+cellsInBlock ; i++) {
+        if (noKrigedCells_ > 0 && i%monitorSize_ == 0) {
+          printf("^");
+          fflush(stdout);
+        }
       }
+      noKrigedCells_ += cellsInBlock;
+      noEmptyDataBlocks_++;
     }
-    noKrigedCells_ += cellsInBlock;
-    noEmptyDataBlocks_++;
     return;
   }
 
-  int n = sizeAlpha_ + sizeBeta_ + sizeRho_;
+  int n = block.sizeAlpha + block.sizeBeta + block.sizeRho;
 
   NRLib::Matrix krigMatrix(n, n);
   NRLib::Vector residual(n);
@@ -311,7 +327,7 @@ void CKrigingAdmin::KrigBlock(Gamma gamma)
 
   SetMatrix(krigMatrix,
             residual,
-            gamma);
+            block);
 
   NRLib::SymmetricMatrix K(n);
 
@@ -341,39 +357,88 @@ void CKrigingAdmin::KrigBlock(Gamma gamma)
   // NBNB-PAL: Add try/catch loop around CholeskySolve call with a regularization term.
   NRLib::CholeskySolve(K, residual, x);
 
-  NRLib::Vector kVec(n);
+  SetCovarianceLookups(block, gamma);
 
-  for (k_ = kMin; k_ <= kMax; k_++) {
-    for (j_ = jMin; j_ <= jMax; j_++) {
-      for (i_ = iMin; i_ <= iMax; i_++) {
+  //
+  // For tabulated covariances the kriging vector of a cell is the product of a lateral
+  // and a vertical factor for each data point. The vertical factors are found once for
+  // the block and the lateral factors once for each column.
+  //
+  std::vector<float> gammaZ;
+  std::vector<float> gammaXY;
+  if (block.separable) {
+    gammaZ.resize(n*nzB);
+    gammaXY.resize(n);
+    for (int m = 0; m < n; m++) {
+      for (int k = kMin; k <= kMax; k++) {
+        gammaZ[m*nzB + k - kMin] = (!block.flip[m] ? block.cov[m]->GetGammaZ2(k, block.dataK[m])
+                                                   : block.cov[m]->GetGammaZ2(block.dataK[m], k));
+      }
+    }
+  }
 
-        // set kriging vector
-        SetKrigVector(kVec, gamma);
+  NRLib::Vector      kVec(n);
+  std::vector<float> result(cellsInBlock);
+  int                noSolvedMatrixEq = 0;
+  int                noRMissing       = 0;
 
-        // kriging
-        float result = pGrid->getRealValue(i_, j_, k_);
-        if (result == RMISSING) {
-          noRMissing_++;
-        }
-        else {
-          result += static_cast<float>(kVec * x);
+  for (int j = jMin; j <= jMax; j++) {
+    for (int i = iMin; i <= iMax; i++) {
 
-          if(pGrid->setRealValue(i_, j_, k_, result))
-            Require(false, "pGrid->setRealValue failed"); // something is serious wrong...
+      if (block.separable) {
+        for (int m = 0; m < n; m++) {
+          gammaXY[m] = (!block.flip[m] ? block.cov[m]->GetGammaXY2(i, j, block.dataI[m], block.dataJ[m])
+                                       : block.cov[m]->GetGammaXY2(block.dataI[m], block.dataJ[m], i, j));
+        }
+      }
 
-          noSolvedMatrixEq_++;
+      for (int k = kMin; k <= kMax; k++) {
+        // set kriging vector
+        if (block.separable) {
+          for (int m = 0; m < n; m++)
+            kVec(m) = gammaXY[m]*gammaZ[m*nzB + k - kMin];
         }
+        else
+          SetKrigVector(kVec, block, i, j, k);
 
-        noKrigedCells_++;
-        // return result
-        if (noKrigedCells_%monitorSize_ == 0) {
-          printf("^");
-          fflush(stdout);
+        // kriging
+        float value = pGrid->getRealValue(i, j, k);
+        if (value == RMISSING) {
+          noRMissing++;
         }
-      } // end for i
-    } // end for j
-  } // end for k
+        else {
+          value += static_cast<float>(kVec * x);
+          noSolvedMatrixEq++;
+        }
+        result[(i - iMin) + nxB*((j - jMin) + nyB*(k - kMin))] = value;
+      } // end for k
+    } // end for i
+  } // end for j
 
+  // Grid values are written by one thread at a time
+#pragma omp critical(krigingadmin_result)
+  {
+    for (int k = kMin; k <= kMax; k++) {
+      for (int j = jMin; j <= jMax; j++) {
+        for (int i = iMin; i <= iMax; i++) {
+          float value = result[(i - iMin) + nxB*((j - jMin) + nyB*(k - kMin))];
+          if (value != RMISSING) {
+            if(pGrid->setRealValue(i, j, k, value))
+              Require(false, "pGrid->setRealValue failed"); // something is serious wrong...
+          }
+
+          noKrigedCells_++;
+          // return result
+          if (noKrigedCells_%monitorSize_ == 0) {
+            printf("^");
+            fflush(stdout);
+          }
+        } // end for i
+      } // end for j
+    } // end for k
+    noSolvedMatrixEq_ += noSolvedMatrixEq;
+    noRMissing_       += noRMissing;
+  }
 }
 
 FFTGrid* CKrigingAdmin::CreateValidGrid() const
@@ -439,8 +504,12 @@ CKrigingAdmin::SubtractTrends(FFTGrid& trend_alpha, FFTGrid& trend_beta, FFTGrid
 }
 
 CKrigingAdmin::DataBoxSize
-CKrigingAdmin::FindDataInDataBlock(Gamma gamma, const CBox & dataBox) {
-  sizeAlpha_ = sizeBeta_ = sizeRho_ = totalNoDataInCurrKrigBlock_ = 0;
+CKrigingAdmin::FindDataInDataBlock(Gamma gamma, const CBox & dataBox, KrigingBlock & block) const {
+  int & sizeAlpha                   = block.sizeAlpha;
+  int & sizeBeta                    = block.sizeBeta;
+  int & sizeRho                     = block.sizeRho;
+  int & totalNoDataInCurrKrigBlock  = block.totalNoData;
+  sizeAlpha = sizeBeta = sizeRho = totalNoDataInCurrKrigBlock = 0;
   const int countTotalMin = int(dataTarget_*(1.0f - maxDataTolerance_/100.0f));
   const int countTotalMax = int(dataTarget_*(1.0f + maxDataTolerance_/100.0f));
 
@@ -452,37 +521,37 @@ CKrigingAdmin::FindDataInDataBlock(Gamma gamma, const CBox & dataBox) {
       pBWellPt_[i]->IsValidObs(validA, validB, validR);
       switch (gamma) {
       case ALPHA_KRIG :
-        if (validA && ++totalNoDataInCurrKrigBlock_)
-          pIndexAlpha_[sizeAlpha_++] = i;
+        if (validA && ++totalNoDataInCurrKrigBlock)
+          block.indexAlpha[sizeAlpha++] = i;
         else {
-          if (validB && ++totalNoDataInCurrKrigBlock_)
-            pIndexBeta_[sizeBeta_++] = i;
+          if (validB && ++totalNoDataInCurrKrigBlock)
+            block.indexBeta[sizeBeta++] = i;
 
-          if (validR && ++totalNoDataInCurrKrigBlock_)
-            pIndexRho_[sizeRho_++] = i;
+          if (validR && ++totalNoDataInCurrKrigBlock)
+            block.indexRho[sizeRho++] = i;
         }
         break;
 
       case BETA_KRIG :
-        if (validB && ++totalNoDataInCurrKrigBlock_)
-          pIndexBeta_[sizeBeta_++] = i;
+        if (validB && ++totalNoDataInCurrKrigBlock)
+          block.indexBeta[sizeBeta++] = i;
         else {
-          if (validA && ++totalNoDataInCurrKrigBlock_)
-            pIndexAlpha_[sizeAlpha_++] = i;
+          if (validA && ++totalNoDataInCurrKrigBlock)
+            block.indexAlpha[sizeAlpha++] = i;
 
-          if (validR && ++totalNoDataInCurrKrigBlock_)
-            pIndexRho_[sizeRho_++] = i;
+          if (validR && ++totalNoDataInCurrKrigBlock)
+            block.indexRho[sizeRho++] = i;
         }
         break;
       case RHO_KRIG :
-        if (validR && ++totalNoDataInCurrKrigBlock_)
-          pIndexRho_[sizeRho_++] = i;
+        if (validR && ++totalNoDataInCurrKrigBlock)
+          block.indexRho[sizeRho++] = i;
         else {
-          if (validA && ++totalNoDataInCurrKrigBlock_)
-            pIndexAlpha_[sizeAlpha_++] = i;
+          if (validA && ++totalNoDataInCurrKrigBlock)
+            block.indexAlpha[sizeAlpha++] = i;
 
-          if (validB && ++totalNoDataInCurrKrigBlock_)
-            pIndexBeta_[sizeBeta_++] = i;
+          if (validB && ++totalNoDataInCurrKrigBlock)
+            block.indexBeta[sizeBeta++] = i;
         }
         break;
 
@@ -493,28 +562,30 @@ CKrigingAdmin::FindDataInDataBlock(Gamma gamma, const CBox & dataBox) {
       // early exit
     } // end if
   } // end i
-  LogKit::LogFormatted(LogKit::DebugHigh,"Found %d data. (%d, %d)\n", totalNoDataInCurrKrigBlock_,
+#pragma omp critical(krigingadmin_log)
+  LogKit::LogFormatted(LogKit::DebugHigh,"Found %d data. (%d, %d)\n", totalNoDataInCurrKrigBlock,
     countTotalMin, countTotalMax);
-  if (totalNoDataInCurrKrigBlock_ <= countTotalMax && totalNoDataInCurrKrigBlock_ >= countTotalMin)
+  if (totalNoDataInCurrKrigBlock <= countTotalMax && totalNoDataInCurrKrigBlock >= countTotalMin)
     return DBS_RIGHT;
-  if (totalNoDataInCurrKrigBlock_ < countTotalMin)
+  if (totalNoDataInCurrKrigBlock < countTotalMin)
     return DBS_TOO_SMALL;
-  else {//(totalNoDataInCurrKrigBlock_ > countTotalMax)
+  else {//(totalNoDataInCurrKrigBlock > countTotalMax)
     return DBS_TOO_BIG;
   }
 }
 
 
-void CKrigingAdmin::FindDataInDataBlockLoop(Gamma gamma) {
+void CKrigingAdmin::FindDataInDataBlockLoop(Gamma gamma, KrigingBlock & block) const {
+  CBox & currDataBox = block.currDataBox;
   int counter = 0;
   DataBoxSize currDataBoxSize, startDataboxSize, testDataBoxSize;
-  currDataBoxSize = FindDataInDataBlock(gamma, currDataBox_);
+  currDataBoxSize = FindDataInDataBlock(gamma, currDataBox, block);
   startDataboxSize = currDataBoxSize;
   //CBox minDataBox = currBlock_;
-  CBox minDataBox = currDataBox_;
+  CBox minDataBox = currDataBox;
   int iMin,iMax,jMin,jMax,kMin,kMax;
-  currBlock_.GetMin(iMin,jMin,kMin);
-  currBlock_.GetMax(iMax,jMax,kMax);
+  block.currBlock.GetMin(iMin,jMin,kMin);
+  block.currBlock.GetMax(iMax,jMax,kMax);
   CBox maxDataBox(iMin-int(rangeX_),jMin-int(rangeY_),kMin-int(rangeZ_),
     iMax+int(rangeX_),jMax+int(rangeY_),kMax+int(rangeZ_));
 
@@ -523,18 +594,18 @@ void CKrigingAdmin::FindDataInDataBlockLoop(Gamma gamma) {
     // NBNB-PAL: Nothing to do here? I put in this switch option to avoid a crash (CRA-75)
     break;
   case DBS_TOO_SMALL:
-    testDataBoxSize = FindDataInDataBlock(gamma, maxDataBox);
+    testDataBoxSize = FindDataInDataBlock(gamma, maxDataBox, block);
     if(testDataBoxSize != DBS_TOO_BIG)
     {
-      currDataBox_ = maxDataBox;
+      currDataBox = maxDataBox;
       currDataBoxSize = DBS_RIGHT;
     }
     break;
   case DBS_TOO_BIG:
-    testDataBoxSize = FindDataInDataBlock(gamma, minDataBox);
+    testDataBoxSize = FindDataInDataBlock(gamma, minDataBox, block);
     if(testDataBoxSize != DBS_TOO_SMALL)
     {
-      currDataBox_ = minDataBox;
+      currDataBox = minDataBox;
       currDataBoxSize = DBS_RIGHT;
     }
     break;
@@ -547,12 +618,12 @@ void CKrigingAdmin::FindDataInDataBlockLoop(Gamma gamma) {
   while (currDataBoxSize != DBS_RIGHT) {
     switch (currDataBoxSize) {
     case DBS_TOO_SMALL :
-      minDataBox = currDataBox_;
-      currDataBox_.ModifyBox(maxDataBox);
+      minDataBox = currDataBox;
+      currDataBox.ModifyBox(maxDataBox);
       break;
     case DBS_TOO_BIG :
-      maxDataBox = currDataBox_;
-      currDataBox_.ModifyBox(minDataBox);
+      maxDataBox = currDataBox;
+      currDataBox.ModifyBox(minDataBox);
       break;
     default :
       Require(false, "switch failed");
@@ -560,16 +631,17 @@ void CKrigingAdmin::FindDataInDataBlockLoop(Gamma gamma) {
 
     } // end switch
     counter++;
-    //if (currDataBoxSize != startDataboxSize || counter++ >= maxDataBlockLoopCounter_ || prevDataBox == currDataBox_)
-    //if (currDataBoxSize != startDataboxSize || prevDataBox == currDataBox_)
-    if(currDataBox_ == maxDataBox || currDataBox_ == minDataBox)
+    //if (currDataBoxSize != startDataboxSize || counter++ >= maxDataBlockLoopCounter_ || prevDataBox == currDataBox)
+    //if (currDataBoxSize != startDataboxSize || prevDataBox == currDataBox)
+    if(currDataBox == maxDataBox || currDataBox == minDataBox)
       break;
 
-    currDataBoxSize = FindDataInDataBlock(gamma, currDataBox_);
+    currDataBoxSize = FindDataInDataBlock(gamma, currDataBox, block);
 
   } // end while
-  currDataBox_.ModifyBox(currDataBox_, &simbox_); //Does not modify, only truncates.
+  currDataBox.ModifyBox(currDataBox, &simbox_); //Does not modify, only truncates.
 
+#pragma omp critical(krigingadmin_log)
   LogKit::LogFormatted(LogKit::DebugHigh,"FindDataInDataBlock iterations: %d\n", counter);
 }
 
@@ -581,11 +653,10 @@ int CKrigingAdmin::NBlocks(int dBlocks, int lSBox) const {
   return lSBox/dBlocks + 1;
 }
 
-void CKrigingAdmin::SetMatrix(NRLib::Matrix & krigMatrix,
-                              NRLib::Vector & residual,
-                              Gamma           gamma) {
-  assert(gamma >= 0);
-  if (!totalNoDataInCurrKrigBlock_)
+void CKrigingAdmin::SetMatrix(NRLib::Matrix      & krigMatrix,
+                              NRLib::Vector      & residual,
+                              const KrigingBlock & block) const {
+  if (!block.totalNoData)
     return;
   int a, b, r;
 
@@ -593,14 +664,14 @@ void CKrigingAdmin::SetMatrix(NRLib::Matrix & krigMatrix,
   // for alpha kriging
   int a2, b2, r2;
   // first row
-  for (a = 0; a < sizeAlpha_; a++) {
+  for (a = 0; a < block.sizeAlpha; a++) {
     int krigRowIndex = a;
-    int indexA = pIndexAlpha_[a];
+    int indexA = block.indexAlpha[a];
     int i,j,k;
     pBWellPt_[indexA]->GetIJK(i, j, k);
     // K_aa
-    for (a2 = 0; a2 < sizeAlpha_; a2++) {
-      int indexA2 = pIndexAlpha_[a2];
+    for (a2 = 0; a2 < block.sizeAlpha; a2++) {
+      int indexA2 = block.indexAlpha[a2];
       int i2, j2, k2;
       pBWellPt_[indexA2]->GetIJK(i2, j2, k2);
 
@@ -608,106 +679,104 @@ void CKrigingAdmin::SetMatrix(NRLib::Matrix & krigMatrix,
     } // end a2
 
     // K_ab
-    for (b2 = 0; b2 < sizeBeta_; b2++) {
-      int indexB2 = pIndexBeta_[b2];
+    for (b2 = 0; b2 < block.sizeBeta; b2++) {
+      int indexB2 = block.indexBeta[b2];
       int i2, j2, k2;
       pBWellPt_[indexB2]->GetIJK(i2, j2, k2);
-      krigMatrix(krigRowIndex, b2 + sizeAlpha_) = covCrAlphaBeta_.GetGamma2(i, j, k, i2, j2, k2);
+      krigMatrix(krigRowIndex, b2 + block.sizeAlpha) = covCrAlphaBeta_.GetGamma2(i, j, k, i2, j2, k2);
     } // end b2
 
     // K_ar
-    for (r2 = 0; r2 < sizeRho_; r2++) {
-      int indexR2 = pIndexRho_[r2];
+    for (r2 = 0; r2 < block.sizeRho; r2++) {
+      int indexR2 = block.indexRho[r2];
       int i2, j2, k2;
       pBWellPt_[indexR2]->GetIJK(i2, j2, k2);
-      krigMatrix(krigRowIndex, r2 + sizeAlpha_ + sizeBeta_) = covCrAlphaRho_.GetGamma2(i, j, k, i2, j2, k2);
+      krigMatrix(krigRowIndex, r2 + block.sizeAlpha + block.sizeBeta) = covCrAlphaRho_.GetGamma2(i, j, k, i2, j2, k2);
     } // end r2
   }// end a
 
   // second row
-  for (b = 0; b < sizeBeta_; b++) {
-    int krigRowIndex = b + sizeAlpha_;
-    int indexB = pIndexBeta_[b];
+  for (b = 0; b < block.sizeBeta; b++) {
+    int krigRowIndex = b + block.sizeAlpha;
+    int indexB = block.indexBeta[b];
     int i,j,k;
     pBWellPt_[indexB]->GetIJK(i, j, k);
     // K_ba
-    for (a2 = 0; a2 < sizeAlpha_; a2++) {
-      int indexA2 = pIndexAlpha_[a2];
+    for (a2 = 0; a2 < block.sizeAlpha; a2++) {
+      int indexA2 = block.indexAlpha[a2];
       int i2, j2, k2;
       pBWellPt_[indexA2]->GetIJK(i2, j2, k2);
       krigMatrix(krigRowIndex,a2) = covCrAlphaBeta_.GetGamma2(i2, j2, k2, i, j, k); // flip
     } // end a2
 
     // K_bb
-    for (b2 = 0; b2 < sizeBeta_; b2++) {
-      int indexB2 = pIndexBeta_[b2];
+    for (b2 = 0; b2 < block.sizeBeta; b2++) {
+      int indexB2 = block.indexBeta[b2];
       int i2, j2, k2;
       pBWellPt_[indexB2]->GetIJK(i2, j2, k2);
-      krigMatrix(krigRowIndex, b2 + sizeAlpha_) = covBeta_.GetGamma2(i, j, k, i2, j2, k2);
+      krigMatrix(krigRowIndex, b2 + block.sizeAlpha) = covBeta_.GetGamma2(i, j, k, i2, j2, k2);
     } // end b2
 
     // K_br
-    for (r2 = 0; r2 < sizeRho_; r2++) {
-      int indexR2 = pIndexRho_[r2];
+    for (r2 = 0; r2 < block.sizeRho; r2++) {
+      int indexR2 = block.indexRho[r2];
       int i2, j2, k2;
       pBWellPt_[indexR2]->GetIJK(i2, j2, k2);
-      krigMatrix(krigRowIndex,r2 + sizeAlpha_ + sizeBeta_) = covCrBetaRho_.GetGamma2(i, j, k, i2, j2, k2);
+      krigMatrix(krigRowIndex,r2 + block.sizeAlpha + block.sizeBeta) = covCrBetaRho_.GetGamma2(i, j, k, i2, j2, k2);
     } // end r2
   }// end b
   // third row
-  for (r = 0; r < sizeRho_; r++) {
-    int krigRowIndex = r + sizeAlpha_ + sizeBeta_;
-    int indexR = pIndexRho_[r];
+  for (r = 0; r < block.sizeRho; r++) {
+    int krigRowIndex = r + block.sizeAlpha + block.sizeBeta;
+    int indexR = block.indexRho[r];
     int i,j,k;
     pBWellPt_[indexR]->GetIJK(i, j, k);
     // K_ra
-    for (a2 = 0; a2 < sizeAlpha_; a2++) {
-      int indexA2 = pIndexAlpha_[a2];
+    for (a2 = 0; a2 < block.sizeAlpha; a2++) {
+      int indexA2 = block.indexAlpha[a2];
       int i2, j2, k2;
       pBWellPt_[indexA2]->GetIJK(i2, j2, k2);
       krigMatrix(krigRowIndex, a2) = covCrAlphaRho_.GetGamma2(i2, j2, k2, i, j, k); // flip
     } // end a2
 
     // K_rb
-    for (b2 = 0; b2 < sizeBeta_; b2++) {
-      int indexB2 = pIndexBeta_[b2];
+    for (b2 = 0; b2 < block.sizeBeta; b2++) {
+      int indexB2 = block.indexBeta[b2];
       int i2, j2, k2;
       pBWellPt_[indexB2]->GetIJK(i2, j2, k2);
-      krigMatrix(krigRowIndex, b2  + sizeAlpha_) = covCrBetaRho_.GetGamma2(i2, j2, k2, i, j, k); // flip
+      krigMatrix(krigRowIndex, b2  + block.sizeAlpha) = covCrBetaRho_.GetGamma2(i2, j2, k2, i, j, k); // flip
     } // end b2
 
     // K_rr
-    for (r2 = 0; r2 < sizeRho_; r2++) {
-      int indexR2 = pIndexRho_[r2];
+    for (r2 = 0; r2 < block.sizeRho; r2++) {
+      int indexR2 = block.indexRho[r2];
       int i2, j2, k2;
       pBWellPt_[indexR2]->GetIJK(i2, j2, k2);
-      krigMatrix(krigRowIndex, r2 + sizeAlpha_ + sizeBeta_) = covRho_.GetGamma2(i, j, k, i2, j2, k2);
+      krigMatrix(krigRowIndex, r2 + block.sizeAlpha + block.sizeBeta) = covRho_.GetGamma2(i, j, k, i2, j2, k2);
     } // end r2
   }// end r
 
   // Also calulates the kriging data vector
-  for (a = 0; a < sizeAlpha_; a++) {
-    int indexA = pIndexAlpha_[a];
+  for (a = 0; a < block.sizeAlpha; a++) {
+    int indexA = block.indexAlpha[a];
     residual(a) = pBWellPt_[indexA]->GetAlpha();
   } // end a
 
-  for (b = 0; b < sizeBeta_; b++) {
-    int indexB = pIndexBeta_[b];
-    residual(sizeAlpha_ + b) = pBWellPt_[indexB]->GetBeta();
+  for (b = 0; b < block.sizeBeta; b++) {
+    int indexB = block.indexBeta[b];
+    residual(block.sizeAlpha + b) = pBWellPt_[indexB]->GetBeta();
   } // end b
 
-  for (r = 0; r < sizeRho_; r++) {
-    int indexR = pIndexRho_[r];
-    residual(sizeAlpha_ + sizeBeta_ + r) = pBWellPt_[indexR]->GetRho();
+  for (r = 0; r < block.sizeRho; r++) {
+    int indexR = block.indexRho[r];
+    residual(block.sizeAlpha + block.sizeBeta + r) = pBWellPt_[indexR]->GetRho();
   } // end r
 
 }
 
-void CKrigingAdmin::SetKrigVector(NRLib::Vector & k,
-                                  Gamma           gamma)
+void CKrigingAdmin::SetCovarianceLookups(KrigingBlock & block,
+                                         Gamma          gamma) const
 {
-  int offsetB1, offsetR1;
-  offsetB1 = sizeAlpha_; offsetR1 = sizeAlpha_ + sizeBeta_;
   const CovGridSeparated *pA = NULL, *pB = NULL, *pR = NULL;
   bool flipA = false, flipB = false, flipR = false;
   switch(gamma) {
@@ -729,37 +798,57 @@ void CKrigingAdmin::SetKrigVector(NRLib::Vector & k,
 
   } // end switch
 
-  // set krig vector
-  // for alpha kriging
-
-  //LogKit::LogFormatted(LogKit::DebugHigh,"\n");
+  // Covariance, argument order and data position for each element of the kriging
+  // vector, in the order k_a, k_b, k_r
+  int n = block.sizeAlpha + block.sizeBeta + block.sizeRho;
+  block.cov.resize(n);
+  block.flip.resize(n);
+  block.dataI.resize(n);
+  block.dataJ.resize(n);
+  block.dataK.resize(n);
 
-  // k_a
+  int m = 0;
   int a2;
-  for (a2 = 0; a2 < sizeAlpha_; a2++) {
-    int indexA2 = pIndexAlpha_[a2];
-    int i2, j2, k2;
-    pBWellPt_[indexA2]->GetIJK(i2, j2, k2);
-    k(a2) = (!flipA ? pA->GetGamma2(i_, j_, k_, i2, j2, k2) : pA->GetGamma2(i2, j2, k2, i_, j_, k_));
+  for (a2 = 0; a2 < block.sizeAlpha; a2++, m++) {
+    pBWellPt_[block.indexAlpha[a2]]->GetIJK(block.dataI[m], block.dataJ[m], block.dataK[m]);
+    block.cov[m]  = pA;
+    block.flip[m] = flipA;
   } // end a2
 
-  // k_b
   int b2;
-  for (b2 = 0; b2 < sizeBeta_; b2++) {
-    int indexB2 = pIndexBeta_[b2];
-    int i2, j2, k2;
-    pBWellPt_[indexB2]->GetIJK(i2, j2, k2);
-    k(b2 + offsetB1) = (!flipB ? pB->GetGamma2(i_, j_, k_, i2, j2, k2) : pB->GetGamma2(i2, j2, k2, i_, j_, k_));
+  for (b2 = 0; b2 < block.sizeBeta; b2++, m++) {
+    pBWellPt_[block.indexBeta[b2]]->GetIJK(block.dataI[m], block.dataJ[m], block.dataK[m]);
+    block.cov[m]  = pB;
+    block.flip[m] = flipB;
   } // end b2
 
-  // k_r
   int r2;
-  for (r2 = 0; r2 < sizeRho_; r2++) {
-    int indexR2 = pIndexRho_[r2];
-    int i2, j2, k2;
-    pBWellPt_[indexR2]->GetIJK(i2, j2, k2);
-    k(r2 + offsetR1) = (!flipR ? pR->GetGamma2(i_, j_, k_, i2, j2, k2) : pR->GetGamma2(i2, j2, k2, i_, j_, k_));
+  for (r2 = 0; r2 < block.sizeRho; r2++, m++) {
+    pBWellPt_[block.indexRho[r2]]->GetIJK(block.dataI[m], block.dataJ[m], block.dataK[m]);
+    block.cov[m]  = pR;
+    block.flip[m] = flipR;
   } // end r2
+
+  // Missing indexes must go through GetGamma2, which returns RMISSING for them
+  block.separable = pA->IsSeparable() && pB->IsSeparable() && pR->IsSeparable();
+  for (m = 0; m < n; m++) {
+    if (block.dataI[m] == IMISSING || block.dataJ[m] == IMISSING || block.dataK[m] == IMISSING)
+      block.separable = false;
+  }
+}
+
+void CKrigingAdmin::SetKrigVector(NRLib::Vector      & k,
+                                  const KrigingBlock & block,
+                                  int                  i,
+                                  int                  j,
+                                  int                  kk) const
+{
+  int n = block.sizeAlpha + block.sizeBeta + block.sizeRho;
+  for (int m = 0; m < n; m++) {
+    const CovGridSeparated * pCov = block.cov[m];
+    k(m) = (!block.flip[m] ? pCov->GetGamma2(i, j, kk, block.dataI[m], block.dataJ[m], block.dataK[m])
+                           : pCov->GetGamma2(block.dataI[m], block.dataJ[m], block.dataK[m], i, j, kk));
+  }
 }
 
 void CKrigingAdmin::EstimateSizeOfBlock() {
@@ -1285,10 +1374,6 @@ void CKrigingAdmin::SmoothKrigedResult(Gamma gamma) {
   CalcSmoothWeights(gamma, 2);
   CalcSmoothWeights(gamma, 3);
 
-  const int nxBlock = NBlocks(dxBlock_, simbox_.getnx());
-  const int nyBlock = NBlocks(dyBlock_, simbox_.getny());
-  const int nzBlock = NBlocks(dzBlock_, simbox_.getnz());
-
   FFTGrid* pGrid = 0;
   switch(gamma) {
   case ALPHA_KRIG :
@@ -1305,147 +1390,168 @@ void CKrigingAdmin::SmoothKrigedResult(Gamma gamma) {
     Require(false, "switch failed");
   } // end switch
 
-  // loop over all kriging blocks
-  int i,j,k;
-  for (k = 0; k < nzBlock; k++) {
-    int k1 = k*dzBlock_;
-    const int k2Max = std::min(k1 + dzBlock_, simbox_.getnz());
-    for (j = 0; j < nyBlock; j++) {
-      int j1 = j*dyBlock_;
-      const int j2Max = std::min(j1 + dyBlock_, simbox_.getny());
-      for (i = 0; i < nxBlock; i++) {
-        int i1 = i*dxBlock_;
-        const int i2Max = std::min(i1 + dxBlock_, simbox_.getnx());
-        int j2, k2,i2;
-        // smooth in X direction
-        if(dxBlock_>1)
-        {
-        const int i2Start = i1 + dxBlock_ - dxSmoothBlock_;
-        const int i2End = std::min(i1 + dxBlock_ + dxSmoothBlock_, simbox_.getnx());
-        const int c2EndX = i2End;
-
-        for (k2 = k1; k2 < k2Max; k2++) {
-          for (j2 = j1; j2 < j2Max; j2++) {
-            // check for well obs
-        //    bool foundObs = false;
-       //     for (i2 = i2Start; i2 < i2End; i2++) {
-       //       if (pBWellGrid_->getRealValue(i2, j2, k2) == 1.0f) {
-       //         foundObs = true; break;
-       //       }
-       //     } // end i2
-
-            // actually smoothing
-          //  if (!foundObs) {
-              for (i2 = i2Start; i2 < i2End; i2++) {
-                if (pBWellGrid_->getRealValue(i2, j2, k2) != 1.0f) {
-                float result = pGrid->getRealValue(i2, j2, k2);
-                if (result != RMISSING) {
-                  const float trend = result;
-                  int c;
-                  for (c = i2Start - 1; c <= c2EndX; c++) {
-                 // for(c = i2 - dxSmoothBlock_; c<= i2+dxSmoothBlock_;c++){
-                    int c2 = (c >= simbox_.getnx() ? 2*simbox_.getnx() - c - 1 : c);
-                    c2 = (c2<0 ? 0 : c2);
-                    result += static_cast<float>(ppKrigSmoothWeightsX_[i2-i2Start][c - i2Start + 1])
-                  //  result += static_cast<float>(ppKrigSmoothWeightsX_[1][c - i2 + dxSmoothBlock_])
-                      * (pGrid->getRealValue(c2, j2, k2) - trend);
-                  } // end c
-                  if (pGrid->setRealValue(i2, j2, k2, result))
-                    //if (pGrid->setRealValue(i2, j2, k2, 1.0f))
-                    Require(false, "pGrid->setRealValue failed"); // something is serious wrong...
-                }
-              } // end if
-            } // end i2
-          } // end j2
-        } // end k2
-        }
-        if(dyBlock_>1)
-        {
-        // smooth in y direction
-        int j2Start = j1 + dyBlock_ - dySmoothBlock_;
-        const int j2End = std::min(j1 + dyBlock_ + dySmoothBlock_, simbox_.getny());
-        const int c2EndY = j2End;
-
-        for (k2 = k1; k2 < k2Max; k2++) {
-          for (i2 = i1; i2 < i2Max; i2++) {
-            // check for well obs
-        //    bool foundObs = false;
-       //     for (j2 = j2Start; j2 < j2End; j2++) {
-        //      if (pBWellGrid_->getRealValue(i2, j2, k2) == 1.0f) {
-       //         foundObs = true; break;
-        //      }
-        //    } // end j2
-
-            // actually smoothing
-          //  if (!foundObs) {
-              for (j2 = j2Start; j2 < j2End; j2++) {
-              if (pBWellGrid_->getRealValue(i2, j2, k2) != 1.0f) {
-                float result = pGrid->getRealValue(i2, j2, k2);
-                if (result != RMISSING) {
-                  const float trend = result;
-                  int c;
-                  for (c = j2Start - 1; c <= c2EndY; c++) {
-                    //for(c = j2 - dySmoothBlock_; c<= j2+dySmoothBlock_;c++){
-                    int c2 = (c >= simbox_.getny() ? 2*simbox_.getny() - c - 1 : c);
-                    c2 = (c2<0 ? 0 : c2);
-                    result += static_cast<float>(ppKrigSmoothWeightsY_[j2 - j2Start][c - j2Start + 1])
-                   // result += static_cast<float>(ppKrigSmoothWeightsY_[1][c - j2 + dySmoothBlock_])
-                      * (pGrid->getRealValue(i2, c2, k2) - trend);
-                  } // end c
-                  if (pGrid->setRealValue(i2, j2, k2, result))
-                    //if (pGrid->setRealValue(i2, j2, k2, 1.0f))
-                    Require(false, "pGrid->setRealValue failed"); // something is serious wrong...
-                }
-              } // end j2
-            } // end if
-          } // end i2
-        } // end k2
+  const int nxBlock = NBlocks(dxBlock_, simbox_.getnx());
+  const int nyBlock = NBlocks(dyBlock_, simbox_.getny());
+  const int nzBlock = NBlocks(dzBlock_, simbox_.getnz());
 
-        }
-        if(dzBlock_>1)
-        {
-        // smooth in z direction
-        const int k2Start = k1 + dzBlock_ - dzSmoothBlock_;
-        const int k2End = std::min(k1 + dzBlock_ + dzSmoothBlock_, simbox_.getnz());
-        const int c2EndZ = k2End;
-        for (j2 = j1; j2 < j2Max; j2++) {
-          for (i2 = i1; i2 < i2Max; i2++) {
-            // check for well obs
-         //   bool foundObs = false;
-         //   for (k2 = k2Start; k2 <= k2End; k2++) {
-          //    if (pBWellGrid_->getRealValue(i2, j2, k2) == 1.0f) {
-         //       foundObs = true; break;
-         //     }
-         //   } // end k2
-
-            // actually smoothing
-          //  if (!foundObs) {
-              for (k2 = k2Start; k2 < k2End; k2++) {
-              if (pBWellGrid_->getRealValue(i2, j2, k2) != 1.0f) {
-                float result = pGrid->getRealValue(i2, j2, k2);
-                if (result != RMISSING) {
-                  const float trend = result;
-                  int c;
-                  for (c = k2Start - 1; c <= c2EndZ; c++) {
-                  //for(c = k2 - dzSmoothBlock_; c<= k2+dzSmoothBlock_;c++){
-                    int c2 = (c >= simbox_.getnz() ? 2*simbox_.getnz() - c - 1 : c);
-                    c2 = (c2<0 ? 0 : c2);
-                    result += static_cast<float>(ppKrigSmoothWeightsZ_[k2 - k2Start][c - k2Start + 1])
-                   // result += static_cast<float>(ppKrigSmoothWeightsZ_[1][c - k2 + dzSmoothBlock_])
-                      * (pGrid->getRealValue(i2, j2, c2) - trend);
-                  } // end c
-                  if (pGrid->setRealValue(i2, j2, k2, result))
-                    //if (pGrid->setRealValue(i2, j2, k2, 1.0f))
-                    Require(false, "pGrid->setRealValue failed"); // something is serious wrong...
-                }
-              } // end k2
-            } // end if
-          } // end i2
+  //
+  // Smoothing a block reads and writes cells in the block and in the next block in
+  // each direction. Blocks are therefore smoothed in waves with i + 2j + 4k constant.
+  // Blocks in the same wave do not touch the same cells, and every block that shares
+  // cells with a block and comes before it in (k,j,i) order belongs to an earlier
+  // wave, so the result is the same as when smoothing one block at a time.
+  //
+  const int nWaves = (nxBlock - 1) + 2*(nyBlock - 1) + 4*(nzBlock - 1) + 1;
+  for (int wave = 0; wave < nWaves; wave++) {
+    const int kFirst = std::max(0, (wave - (nxBlock - 1) - 2*(nyBlock - 1) + 3)/4);
+    const int kLast  = std::min(nzBlock - 1, wave/4);
+    const int nk     = std::max(0, kLast - kFirst + 1);
+
+#pragma omp parallel for num_threads(nThreads_) schedule(dynamic, 1)
+    for (int kj = 0; kj < nk*nyBlock; kj++) {
+      const int k = kFirst + kj/nyBlock;
+      const int j = kj % nyBlock;
+      const int i = wave - 2*j - 4*k;
+      if (i >= 0 && i < nxBlock)
+        SmoothBlock(pGrid, i, j, k);
+    }
+  }
+}
+
+void CKrigingAdmin::SmoothBlock(FFTGrid * pGrid, int i, int j, int k) const {
+  int k1 = k*dzBlock_;
+  const int k2Max = std::min(k1 + dzBlock_, simbox_.getnz());
+  int j1 = j*dyBlock_;
+  const int j2Max = std::min(j1 + dyBlock_, simbox_.getny());
+  int i1 = i*dxBlock_;
+  const int i2Max = std::min(i1 + dxBlock_, simbox_.getnx());
+  int j2, k2,i2;
+  // smooth in X direction
+  if(dxBlock_>1)
+  {
+  const int i2Start = i1 + dxBlock_ - dxSmoothBlock_;
+  const int i2End = std::min(i1 + dxBlock_ + dxSmoothBlock_, simbox_.getnx());
+  const int c2EndX = i2End;
+
+  for (k2 = k1; k2 < k2Max; k2++) {
+    for (j2 = j1; j2 < j2Max; j2++) {
+      // check for well obs
+  //    bool foundObs = false;
+ //     for (i2 = i2Start; i2 < i2End; i2++) {
+ //       if (pBWellGrid_->getRealValue(i2, j2, k2) == 1.0f) {
+ //         foundObs = true; break;
+ //       }
+ //     } // end i2
+
+      // actually smoothing
+    //  if (!foundObs) {
+        for (i2 = i2Start; i2 < i2End; i2++) {
+          if (pBWellGrid_->getRealValue(i2, j2, k2) != 1.0f) {
+          float result = pGrid->getRealValue(i2, j2, k2);
+          if (result != RMISSING) {
+            const float trend = result;
+            int c;
+            for (c = i2Start - 1; c <= c2EndX; c++) {
+           // for(c = i2 - dxSmoothBlock_; c<= i2+dxSmoothBlock_;c++){
+              int c2 = (c >= simbox_.getnx() ? 2*simbox_.getnx() - c - 1 : c);
+              c2 = (c2<0 ? 0 : c2);
+              result += static_cast<float>(ppKrigSmoothWeightsX_[i2-i2Start][c - i2Start + 1])
+            //  result += static_cast<float>(ppKrigSmoothWeightsX_[1][c - i2 + dxSmoothBlock_])
+                * (pGrid->getRealValue(c2, j2, k2) - trend);
+            } // end c
+            if (pGrid->setRealValue(i2, j2, k2, result))
+              //if (pGrid->setRealValue(i2, j2, k2, 1.0f))
+              Require(false, "pGrid->setRealValue failed"); // something is serious wrong...
+          }
+        } // end if
+      } // end i2
+    } // end j2
+  } // end k2
+  }
+  if(dyBlock_>1)
+  {
+  // smooth in y direction
+  int j2Start = j1 + dyBlock_ - dySmoothBlock_;
+  const int j2End = std::min(j1 + dyBlock_ + dySmoothBlock_, simbox_.getny());
+  const int c2EndY = j2End;
+
+  for (k2 = k1; k2 < k2Max; k2++) {
+    for (i2 = i1; i2 < i2Max; i2++) {
+      // check for well obs
+  //    bool foundObs = false;
+ //     for (j2 = j2Start; j2 < j2End; j2++) {
+  //      if (pBWellGrid_->getRealValue(i2, j2, k2) == 1.0f) {
+ //         foundObs = true; break;
+  //      }
+  //    } // end j2
+
+      // actually smoothing
+    //  if (!foundObs) {
+        for (j2 = j2Start; j2 < j2End; j2++) {
+        if (pBWellGrid_->getRealValue(i2, j2, k2) != 1.0f) {
+          float result = pGrid->getRealValue(i2, j2, k2);
+          if (result != RMISSING) {
+            const float trend = result;
+            int c;
+            for (c = j2Start - 1; c <= c2EndY; c++) {
+              //for(c = j2 - dySmoothBlock_; c<= j2+dySmoothBlock_;c++){
+              int c2 = (c >= simbox_.getny() ? 2*simbox_.getny() - c - 1 : c);
+              c2 = (c2<0 ? 0 : c2);
+              result += static_cast<float>(ppKrigSmoothWeightsY_[j2 - j2Start][c - j2Start + 1])
+             // result += static_cast<float>(ppKrigSmoothWeightsY_[1][c - j2 + dySmoothBlock_])
+                * (pGrid->getRealValue(i2, c2, k2) - trend);
+            } // end c
+            if (pGrid->setRealValue(i2, j2, k2, result))
+              //if (pGrid->setRealValue(i2, j2, k2, 1.0f))
+              Require(false, "pGrid->setRealValue failed"); // something is serious wrong...
+          }
         } // end j2
-        }
-      } // end i
-    } // end j
-  } // end k
+      } // end if
+    } // end i2
+  } // end k2
+
+  }
+  if(dzBlock_>1)
+  {
+  // smooth in z direction
+  const int k2Start = k1 + dzBlock_ - dzSmoothBlock_;
+  const int k2End = std::min(k1 + dzBlock_ + dzSmoothBlock_, simbox_.getnz());
+  const int c2EndZ = k2End;
+  for (j2 = j1; j2 < j2Max; j2++) {
+    for (i2 = i1; i2 < i2Max; i2++) {
+      // check for well obs
+   //   bool foundObs = false;
+   //   for (k2 = k2Start; k2 <= k2End; k2++) {
+    //    if (pBWellGrid_->getRealValue(i2, j2, k2) == 1.0f) {
+   //       foundObs = true; break;
+   //     }
+   //   } // end k2
+
+      // actually smoothing
+    //  if (!foundObs) {
+        for (k2 = k2Start; k2 < k2End; k2++) {
+        if (pBWellGrid_->getRealValue(i2, j2, k2) != 1.0f) {
+          float result = pGrid->getRealValue(i2, j2, k2);
+          if (result != RMISSING) {
+            const float trend = result;
+            int c;
+            for (c = k2Start - 1; c <= c2EndZ; c++) {
+            //for(c = k2 - dzSmoothBlock_; c<= k2+dzSmoothBlock_;c++){
+              int c2 = (c >= simbox_.getnz() ? 2*simbox_.getnz() - c - 1 : c);
+              c2 = (c2<0 ? 0 : c2);
+              result += static_cast<float>(ppKrigSmoothWeightsZ_[k2 - k2Start][c - k2Start + 1])
+             // result += static_cast<float>(ppKrigSmoothWeightsZ_[1][c - k2 + dzSmoothBlock_])
+                * (pGrid->getRealValue(i2, j2, c2) - trend);
+            } // end c
+            if (pGrid->setRealValue(i2, j2, k2, result))
+              //if (pGrid->setRealValue(i2, j2, k2, 1.0f))
+              Require(false, "pGrid->setRealValue failed"); // something is serious wrong...
+          }
+        } // end k2
+      } // end if
+    } // end i2
+  } // end j2
+  }
 }
 
 void CKrigingAdmin::WriteDebugOutput() const {
@@ -11,6 +11,8 @@ class CBWellPt;
 class Simbox;
 class CovGridSeparated;
 
+#include <vector>
+
 #include "nrlib/flens/nrlib_flens.hpp"
 
 #include "src/box.h"
@@ -31,25 +33,46 @@ public:
   ~CKrigingAdmin(void);
   enum Gamma {ALPHA_KRIG, BETA_KRIG, RHO_KRIG};
   void KrigAll(FFTGrid& trendAlpha, FFTGrid& trendBeta, FFTGrid& trendRho,
-               bool trendsAlreadySubtracted = false, int debugFlag = 0, bool doSmoothing = false);
+               bool trendsAlreadySubtracted = false, int debugFlag = 0, bool doSmoothing = false,
+               int nThreads = 1);
 
 private:
+  // Data neighbourhood and kriging system of one kriging block. Blocks are kriged
+  // in parallel, so each thread has its own.
+  struct KrigingBlock
+  {
+    CBox                                  currBlock, currDataBox;  // kriging area and data neighbourhood
+    std::vector<int>                      indexAlpha, indexBeta, indexRho; // indexes into pBWellPt_
+    int                                   sizeAlpha, sizeBeta, sizeRho;    // current sizes
+    int                                   totalNoData;             // total number of data in block
+    std::vector<const CovGridSeparated *> cov;                     // covariance for each element of kriging vector
+    std::vector<bool>                     flip;                    // true if data point is first argument to cov
+    std::vector<int>                      dataI, dataJ, dataK;     // data position for each element of kriging vector
+    bool                                  separable;               // true if all cov are tabulated
+  };
+
   void            Init();
+  void            InitKrigingBlock(KrigingBlock & block) const;
   void            KrigAll(Gamma gamma, bool doSmoothing = false);
-  void            KrigBlock(Gamma gamma);
+  void            KrigBlock(Gamma gamma, KrigingBlock & block);
   /* Finds the data by using the following rule: Cokriging 3 variables X,Y,Z.
   If you are doing kriging on X. Then for each well obs: if you have info on X use it and
   ignore the two others Y,Z. Else use info on Y and Z.
   */
   void            SubtractTrends(FFTGrid& trend_alpha, FFTGrid& trend_beta, FFTGrid& trend_rho);
-  void            FindDataInDataBlockLoop(Gamma gamma);
-  DataBoxSize     FindDataInDataBlock(Gamma gamma, const CBox & dataBlock);
+  void            FindDataInDataBlockLoop(Gamma gamma, KrigingBlock & block) const;
+  DataBoxSize     FindDataInDataBlock(Gamma gamma, const CBox & dataBlock, KrigingBlock & block) const;
   int             NBlocks(int dBlocks, int lSBox) const;
-  void            SetMatrix(NRLib::Matrix & krigMatrix,
-                            NRLib::Vector & residual,
-                            Gamma           gamma);
-  void            SetKrigVector(NRLib::Vector & k,
-                                Gamma           gamma);
+  void            SetMatrix(NRLib::Matrix      & krigMatrix,
+                            NRLib::Vector      & residual,
+                            const KrigingBlock & block) const;
+  void            SetCovarianceLookups(KrigingBlock & block,
+                                       Gamma          gamma) const;
+  void            SetKrigVector(NRLib::Vector      & k,
+                                const KrigingBlock & block,
+                                int                  i,
+                                int                  j,
+                                int                  kk) const;
   void            EstimateSizeOfBlock();
   void            EstimateSizeOfBlock2();
   float           CalcCPUTime(float dxBlock, float dyBlockExt, float& nd, bool& rapidInc);
@@ -60,6 +83,7 @@ private:
 
   void            RotateVec(float& rx, float& ry, float& rz, const float mat[][3]);
   void            SmoothKrigedResult(Gamma gamma);
+  void            SmoothBlock(FFTGrid * pGrid, int i, int j, int k) const;
   void            CalcSmoothWeights(Gamma gamma, int direction); // direction X(1), Y(2), Z(3)
   int             GetSmoothBlockNx() { return 2 * (dxSmoothBlock_ + 1); }
   int             GetSmoothBlockNy() { return 2 * (dySmoothBlock_ + 1); }
@@ -74,12 +98,9 @@ private:
   CovGridSeparated &covAlpha_, &covBeta_, &covRho_, &covCrAlphaBeta_, &covCrAlphaRho_, &covCrBetaRho_;
   FFTGrid       * pBWellGrid_; // a "bool" grid that says "true" (1.0f), (or NOT -1.0f) if there is at least one blocked valid well data in the cell
   CBWellPt     ** pBWellPt_;
-  CBox            currDataBox_, currBlock_;                  // current data neightbourhood and kriging area
   int             dxBlock_, dyBlock_, dzBlock_;              // number of cells to define a kriging block
   int             dxBlockExt_, dyBlockExt_, dzBlockExt_;     // number of additional cells to reach data neighbourhood
-  int             i_, j_, k_;                                // current kriging indexes
-  int           * pIndexAlpha_, *pIndexBeta_, *pIndexRho_;  // holds an array of indexes into pBWells_
-  int             sizeAlpha_, sizeBeta_, sizeRho_;           // current sizes
+  int             maxAlphaData_, maxBetaData_, maxRhoData_;  // max number of a, b and r data in a data neighbourhood
   int             noValidAlpha_, noValidBeta_, noValidRho_;  // number of valid a, b og r data
   int             noValid_;                                  // total number of valid data
   int             noData_;                                   // number kriging data (blocks)
@@ -89,6 +110,7 @@ private:
   int             noKrigedVariables_;                        // number of kriged variables so far
   int             noCholeskyDecomp_;                         // number of cholesky decompositions
   int             monitorSize_;                              // for progress monitor
+  int             nThreads_;                                 // threads used for kriging and smoothing
 
   int             rangeAlphaX_, rangeAlphaY_, rangeAlphaZ_;
   int             rangeBetaX_, rangeBetaY_, rangeBetaZ_;
@@ -99,7 +121,6 @@ private:
                     maxCholeskyLoopCounter_   = 20,          // max number of attempts to cholesky decomposition
                     switchFailed_             =  1};         // assert flag
 
-  int             totalNoDataInCurrKrigBlock_;               // total number of data in current kriging block
   int             noSolvedMatrixEq_;                         // total number of times we have actually solved the matrix eq, for debug
   int              noRMissing_;                               // total number of times we have missing real values
   bool            failed2EstimateRange_, failed2EstimateDefaultDataBoxAndBlock_;             // bool flags if we failed 2 estimate true
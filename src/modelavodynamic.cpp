@@ -494,6 +494,7 @@ ModelAVODynamic::processSeismic(FFTGrid             **& seisCube,
 {
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
+  Timings::Region region("Seismic data");
 
   if(inputFiles->getNumberOfSeismicFiles(thisTimeLapse_) > 0)
   {
@@ -515,6 +516,7 @@ ModelAVODynamic::processSeismic(FFTGrid             **& seisCube,
       std::string fileName = inputFiles->getSeismicFile(thisTimeLapse_,i);
       std::string angle    = NRLib::ToString(angle_[i]*(180/M_PI), 1);
       std::string dataName = "Seismic data angle stack "+angle;
+      Timings::Region angleRegion("Angle stack "+angle);
       if(offset[i] < 0)
         offset[i] = modelSettings->getSegyOffset(thisTimeLapse_);
 
@@ -624,6 +626,7 @@ ModelAVODynamic::processBackground(Background                    *& background,
 
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
+  Timings::Region region("Prior expectation");
 
   const Simbox * timeCutSimbox = NULL;
   if (timeCutMapping != NULL)
@@ -964,6 +967,7 @@ ModelAVODynamic::processWavelets(Wavelet                    **& wavelet,
 
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
+  Timings::Region region("Wavelets");
 
   wavelet = new Wavelet * [numberOfAngles_];
   localNoiseScale_.resize(numberOfAngles_);
@@ -1055,6 +1059,7 @@ ModelAVODynamic::processWavelets(Wavelet                    **& wavelet,
   for(int i=0 ; i < numberOfAngles_ ; i++) {
     float angle = float(angle_[i]*180.0/M_PI);
     LogKit::LogFormatted(LogKit::Low,"\nAngle stack : %.1f deg",angle);
+    Timings::Region angleRegion("Angle stack "+NRLib::ToString(angle, 1));
     if(modelSettings->getForwardModeling()==false)
       seisCube[i]->setAccessMode(FFTGrid::RANDOMACCESS);
     if (modelSettings->getWaveletDim(i) == Wavelet::ONE_D)
@@ -29,6 +29,8 @@
 #include "src/blockedlogsforrockphysics.h"
 #include "src/fftgrid.h"
 #include "src/fftfilegrid.h"
+#include "src/fftplancache.h"
+#include "src/gridwriter.h"
 #include "src/gridmapping.h"
 #include "src/inputfiles.h"
 #include "src/timings.h"
@@ -139,6 +141,19 @@ ModelGeneral::ModelGeneral(ModelSettings           *& modelSettings,
     //Set output for all FFTGrids.
     FFTGrid::setOutputFlags(modelSettings->getOutputGridFormat(),
                             modelSettings->getOutputGridDomain());
+    FFTGrid::setNumberOfThreads(modelSettings->getNumberOfThreads());
+    GridWriter::start(modelSettings->getNumberOfThreads());
+    FFTFileGrid::setCompression(modelSettings->getFileGrid() && modelSettings->getCompressedFileGrid(),
+                                modelSettings->getCompressionMantissaBits());
+    if(FFTFileGrid::getCompression() && modelSettings->getMemoryMappedFileGrid())
+      LogKit::LogFormatted(LogKit::Warning,"\nWARNING: Memory mapped disk storage can not be combined with compression. Grids are read and written in blocks instead.\n");
+    FFTFileGrid::setUseMemoryMap(modelSettings->getFileGrid() && modelSettings->getMemoryMappedFileGrid()
+                                 && !FFTFileGrid::getCompression());
+
+    //Set planning mode for all FFTs, and pick up plans measured in earlier runs.
+    FFTPlanCache::setMeasure(modelSettings->getMeasureFFTPlans());
+    if(modelSettings->getMeasureFFTPlans())
+      FFTPlanCache::importWisdom(IO::makeFullFileName(IO::PathToTmpFiles(), IO::FileFFTWisdom()+IO::SuffixTextFiles()));
 
     std::string errText("");
 
@@ -349,7 +364,8 @@ ModelGeneral::readSegyFile(const std::string       & fileName,
       segy->ReadAllTraces(timeCutSimbox,
                           padding,
                           onlyVolume,
-                          relativePadding);
+                          relativePadding,
+                          modelSettings->getNumberOfThreads());
       segy->CreateRegularGrid();
     }
     else {
@@ -1645,6 +1661,17 @@ ModelGeneral::printSettings(ModelSettings     * modelSettings,
     LogKit::LogFormatted(LogKit::High,"\nAdvanced settings:\n");
 
   LogKit::LogFormatted(LogKit::Medium, "  Use intermediate disk storage for grids  : %10s\n", (modelSettings->getFileGrid() ? "yes" : "no"));
+  if (modelSettings->getFileGrid())
+  {
+    LogKit::LogFormatted(LogKit::Medium, "  Use memory map for intermediate storage  : %10s\n", (modelSettings->getMemoryMappedFileGrid() ? "yes" : "no"));
+    LogKit::LogFormatted(LogKit::Medium, "  Compress intermediate storage            : %10s\n", (modelSettings->getCompressedFileGrid() ? "yes" : "no"));
+    if (modelSettings->getCompressedFileGrid())
+      LogKit::LogFormatted(LogKit::Medium, "  Mantissa bits kept in compressed grids   : %10d\n", modelSettings->getCompressionMantissaBits());
+  }
+  LogKit::LogFormatted(LogKit::High  , "  Number of threads                        : %10d\n", modelSettings->getNumberOfThreads());
+  LogKit::LogFormatted(LogKit::High  , "  Measure FFT plans                        : %10s\n", (modelSettings->getMeasureFFTPlans() ? "yes" : "no"));
+  LogKit::LogFormatted(LogKit::High  , "  Compact prior covariance                 : %10s\n", (modelSettings->getCompactPriorCovariance() ? "yes" : "no"));
+  LogKit::LogFormatted(LogKit::High  , "  Concurrent simulations                   : %10d\n", modelSettings->getConcurrentSimulations());
 
   if (inputFiles->getReflMatrFile() != "")
     LogKit::LogFormatted(LogKit::Medium, "  Take reflection matrix from file         : %10s\n", inputFiles->getReflMatrFile().c_str());
@@ -2217,6 +2244,7 @@ ModelGeneral::printSettings(ModelSettings     * modelSettings,
         LogKit::LogFormatted(LogKit::Low,"\nGeneral settings for well locations:\n");
         LogKit::LogFormatted(LogKit::Low,"  Maximum offset                           : %10.1f\n",modelSettings->getMaxWellOffset());
         LogKit::LogFormatted(LogKit::Low,"  Maximum vertical shift                   : %10.1f\n",modelSettings->getMaxWellShift());
+        LogKit::LogFormatted(LogKit::Low,"  Coarse-to-fine offset search             : %10s\n",(modelSettings->getWellMoveCoarseToFine() ? "yes" : "no"));
       }
         std::vector<float> angle = modelSettings->getAngle(i);
         std::vector<float> SNRatio = modelSettings->getSNRatio(i);
@@ -2490,7 +2518,8 @@ void ModelGeneral::processRockPhysics(Simbox                        * timeSimbox
 
                 //Completing the top level rocks, by setting access to reservoir variables and sampling distribution.
                 rock[i]->CompleteTopLevelObject(res_var_vintage[i],
-                                                tmpErrTxt);
+                                                tmpErrTxt,
+                                                modelSettings->getNumberOfThreads());
 
                 std::vector<bool> has_trends = rock[i]->HasTrend();
                 bool              has_trend = false;
@@ -3332,6 +3361,7 @@ ModelGeneral::processWells(std::vector<WellData *> & wells,
 
     double wall=0.0, cpu=0.0;
     TimeKit::getTime(wall,cpu);
+    Timings::Region region("Wells");
 
     LogKit::WriteHeader("Reading and processing wells");
 
@@ -3689,6 +3719,7 @@ ModelGeneral::processWellLocation(FFTGrid                       ** seisCube,
   int     jMaxOffset;
   int     nMoveAngles = 0;
   int     nWells      = modelSettings->getNumberOfWells();
+  int     nThreads    = modelSettings->getNumberOfThreads();
   int     nAngles     = modelSettings->getNumberOfAngles(0);//Well location is not estimated when using time lapse data
   float   maxShift    = modelSettings->getMaxWellShift();
   float   maxOffset   = modelSettings->getMaxWellOffset();
@@ -3698,15 +3729,13 @@ ModelGeneral::processWellLocation(FFTGrid                       ** seisCube,
   std::vector<float> seismicAngle = modelSettings->getAngle(0); //Use first time lapse as this not is allowed in 4D
 
   std::vector<float> angleWeight(nAngles);
-  LogKit::LogFormatted(LogKit::Low,"\n");
-  LogKit::LogFormatted(LogKit::Low,"  Well             Shift[ms]       DeltaI   DeltaX[m]   DeltaJ   DeltaY[m] \n");
-  LogKit::LogFormatted(LogKit::Low,"  ----------------------------------------------------------------------------------\n");
+  std::vector<int>   moveWells;
+  std::vector<std::vector<float> > moveWeights;
 
   for (w = 0 ; w < nWells ; w++) {
     if( wells_[w]->isDeviated()==true )
       continue;
 
-    BlockedLogs * bl = wells_[w]->getBlockedLogsOrigThick();
     nMoveAngles = modelSettings->getNumberOfWellAngles(w);
 
     if( nMoveAngles==0 )
@@ -3732,10 +3761,58 @@ ModelGeneral::processWellLocation(FFTGrid                       ** seisCube,
     if( sum == 0 )
       continue;
 
-    iMaxOffset = static_cast<int>(std::ceil(maxOffset/dx));
-    jMaxOffset = static_cast<int>(std::ceil(maxOffset/dy));
+    moveWells.push_back(w);
+    moveWeights.push_back(angleWeight);
+  }
 
-    bl->findOptimalWellLocation(seisCube,timeSimbox_,reflectionMatrix,nAngles,angleWeight,maxShift,iMaxOffset,jMaxOffset,interval,iMove,jMove,kMove);
+  int nMoveWells = static_cast<int>(moveWells.size());
+  iMaxOffset     = static_cast<int>(std::ceil(maxOffset/dx));
+  jMaxOffset     = static_cast<int>(std::ceil(maxOffset/dy));
+
+  std::vector<int>   iMoves(nMoveWells);
+  std::vector<int>   jMoves(nMoveWells);
+  std::vector<float> kMoves(nMoveWells);
+
+  // The seismic windows around the wells are not part of the grid memory estimate, so
+  // the wells are handled in batches of one well per thread, and the windows of a batch
+  // are freed before the next batch is collected.
+  for (int first = 0 ; first < nMoveWells ; first += nThreads) {
+    int nBatch = std::min(nThreads, nMoveWells - first);
+
+    // The seismic is collected one angle at a time, so that a file grid is loaded once per batch.
+    std::vector<std::vector<NRLib::Grid<float> > > seisWindow(nBatch, std::vector<NRLib::Grid<float> >(nAngles));
+    for (j = 0 ; j < nAngles ; j++) {
+      seisCube[j]->setAccessMode(FFTGrid::RANDOMACCESS);
+#pragma omp parallel for schedule(dynamic,1) num_threads(nThreads)
+      for (int b = 0 ; b < nBatch ; b++)
+        wells_[moveWells[first+b]]->getBlockedLogsOrigThick()->getBlockedGridWindow(seisCube[j], iMaxOffset, jMaxOffset, seisWindow[b][j]);
+      seisCube[j]->endAccess();
+    }
+
+    // With a full batch, the wells are searched in parallel. Otherwise, the candidate
+    // locations of each well are.
+    int nThreadsWells = (nBatch == nThreads ? nThreads : 1);
+    int nThreadsWell  = (nBatch == nThreads ? 1 : nThreads);
+
+#pragma omp parallel for schedule(dynamic,1) num_threads(nThreadsWells)
+    for (int b = 0 ; b < nBatch ; b++) {
+      int m = first + b;
+      BlockedLogs * bl = wells_[moveWells[m]]->getBlockedLogsOrigThick();
+      bl->findOptimalWellLocation(seisWindow[b],timeSimbox_,seisCube[0]->getNzp(),reflectionMatrix,nAngles,moveWeights[m],maxShift,
+                                  iMaxOffset,jMaxOffset,interval,modelSettings->getWellMoveCoarseToFine(),nThreadsWell,
+                                  iMoves[m],jMoves[m],kMoves[m]);
+    }
+  }
+
+  LogKit::LogFormatted(LogKit::Low,"\n");
+  LogKit::LogFormatted(LogKit::Low,"  Well             Shift[ms]       DeltaI   DeltaX[m]   DeltaJ   DeltaY[m] \n");
+  LogKit::LogFormatted(LogKit::Low,"  ----------------------------------------------------------------------------------\n");
+
+  for (int m = 0 ; m < nMoveWells ; m++) {
+    w     = moveWells[m];
+    iMove = iMoves[m];
+    jMove = jMoves[m];
+    kMove = kMoves[m];
 
     deltaX = iMove*dx*cos(angle) - jMove*dy*sin(angle);
     deltaY = iMove*dx*sin(angle) + jMove*dy*cos(angle);
@@ -3777,6 +3854,7 @@ ModelGeneral::processPriorCorrelations(Background                     * backgrou
 
     double wall=0.0, cpu=0.0;
     TimeKit::getTime(wall,cpu);
+    Timings::Region region("Prior correlation");
 
     const std::string & paramCovFile = inputFiles->getParamCorrFile();
     const std::string & corrTFile    = inputFiles->getTempCorrFile();
@@ -3971,7 +4049,8 @@ ModelGeneral::processPriorCorrelations(Background                     * backgrou
                                                  nz,
                                                  nxPad,
                                                  nyPad,
-                                                 nzPad);
+                                                 nzPad,
+                                                 modelSettings->getCompactPriorCovariance() && !modelSettings->getDo4DInversion());
 
       for(int i=0; i<3; i++)
         delete [] paramCov[i];
@@ -4110,7 +4189,6 @@ ModelGeneral::estimateCorrXYFromSeismic(Surface *& corrXY,
                                         FFTGrid ** seisCube,
                                         int numberOfAngles)
 {
-  FFTGrid * transf;
   float   * grid;
 
   int n = static_cast<int>(corrXY->GetNI()*corrXY->GetNJ());
@@ -4121,18 +4199,9 @@ ModelGeneral::estimateCorrXYFromSeismic(Surface *& corrXY,
 
   for(int i=0 ; i<numberOfAngles ; i++)
   {
-    if(seisCube[i]->isFile())
-      transf = new FFTFileGrid(static_cast<FFTFileGrid *>(seisCube[i])); //move new out of loop? Copy grid instead
-    else
-      transf = new FFTGrid(seisCube[i]); //move new out of loop? Copy grid instead
-
-    transf->setAccessMode(FFTGrid::RANDOMACCESS);
-    transf->fftInPlace();
-    transf->square();
-    transf->invFFTInPlace();
-    transf->collapseAndAdd( grid ); //the result of the collapse (the result for z=0) is is added to grid
-    transf->endAccess();
-    delete transf;
+    seisCube[i]->setAccessMode(FFTGrid::READ);
+    seisCube[i]->addLateralAutoCorrelation( grid ); //the zero time lag plane of the autocorrelation is added to grid
+    seisCube[i]->endAccess();
   }
   float sill = grid[0];
   for(int i=0;i<n;i++)
@@ -89,6 +89,7 @@ ModelSettings::ModelSettings(void)
   energyThreshold_         =     0.0f;
 
   maxWellShift_            =    11.0f;
+  wellMoveCoarseToFine_    =    false;
   maxWellOffset_           =   250.0f;
 
   defaultWaveletLength_    =   200.0f;
@@ -144,6 +145,13 @@ ModelSettings::ModelSettings(void)
   otherFlag_               =        0;
   debugFlag_               =        0;
   fileGrid_                =    false;
+  memoryMappedFileGrid_    =    false;
+  compressedFileGrid_      =    false;
+  compressionMantissaBits_ =       23;
+  numberOfThreads_         =        1;
+  measureFFTPlans_         =    false;
+  compactPriorCovariance_  =    false;
+  concurrentSimulations_   =        0;
   waveletFormatManual_     =    false;
   useVerticalVariogram_    =    false;
   do4DInversion_           =    false;
@@ -122,6 +122,7 @@ public:
   float                            getEnergyThreshold(void)             const { return energyThreshold_                           ;}
   float                            getMaxWellOffset(void)               const { return maxWellOffset_                             ;}
   float                            getMaxWellShift(void)                const { return maxWellShift_                              ;}
+  bool                             getWellMoveCoarseToFine(void)        const { return wellMoveCoarseToFine_                      ;}
   float                            getDefaultWaveletLength(void)        const { return defaultWaveletLength_                      ;}
   float                            getGuardZone(void)                   const { return guard_zone_                                ;}
   float                            getSmoothLength(void)                const { return smooth_length_                             ;}
@@ -167,6 +168,13 @@ public:
   int                              getDebugFlag(void)                   const { return debugFlag_                                 ;}
   static int                       getDebugLevel(void)                        { return debugFlag_                                 ;}
   bool                             getFileGrid(void)                    const { return fileGrid_                                  ;}
+  bool                             getMemoryMappedFileGrid(void)        const { return memoryMappedFileGrid_                      ;}
+  bool                             getCompressedFileGrid(void)          const { return compressedFileGrid_                        ;}
+  int                              getCompressionMantissaBits(void)     const { return compressionMantissaBits_                   ;}
+  int                              getNumberOfThreads(void)             const { return numberOfThreads_                           ;}
+  bool                             getMeasureFFTPlans(void)             const { return measureFFTPlans_                           ;}
+  bool                             getCompactPriorCovariance(void)      const { return compactPriorCovariance_                    ;}
+  int                              getConcurrentSimulations(void)       const { return concurrentSimulations_                     ;}
   bool                             getEstimationMode(void)              const { return estimationMode_                            ;}
   bool                             getForwardModeling(void)             const { return forwardModeling_                           ;}
   bool                             getGenerateSeismicAfterInv(void)     const { return generateSeismicAfterInv_                   ;}
@@ -198,6 +206,7 @@ public:
   int                              getLogLevel(void)                    const { return logLevel_                                  ;}
   bool                             getErrorFileFlag()                   const { return ((otherFlag_ & IO::ERROR_FILE)>0)          ;}
   bool                             getTaskFileFlag()                    const { return ((otherFlag_ & IO::TASK_FILE)>0)           ;}
+  bool                             getTimingsFileFlag()                 const { return ((otherFlag_ & IO::TIMINGS)>0)             ;}
   int                              getSeed(void)                        const { return seed_                                      ;}
   bool                             getDoInversion(void)                 const;
   bool                             getDoDepthConversion(void)           const;
@@ -350,6 +359,7 @@ public:
   void setMinHorizontalRes(float minHorizontalRes)        { minHorizontalRes_         = minHorizontalRes         ;}
   void setMaxWellOffset(float maxWellOffset)              { maxWellOffset_            = maxWellOffset            ;}
   void setMaxWellShift(float maxWellShift)                { maxWellShift_             = maxWellShift             ;}
+  void setWellMoveCoarseToFine(bool coarseToFine)         { wellMoveCoarseToFine_     = coarseToFine             ;}
   void setWaveletTaperingL(float waveletTaperingL)        { waveletTaperingL_         = waveletTaperingL         ;}
   void setXPadFac(double xPadFac)                         { xPadFac_                  = xPadFac                  ;}
   void setYPadFac(double yPadFac)                         { yPadFac_                  = yPadFac                  ;}
@@ -387,6 +397,13 @@ public:
   void setOtherOutputFlag(int otherFlag)                  { otherFlag_                = otherFlag                ;}
   void setDebugFlag(int debugFlag)                        { debugFlag_                = debugFlag                ;}
   void setFileGrid(bool fileGrid)                         { fileGrid_                 = fileGrid                 ;}
+  void setMemoryMappedFileGrid(bool memoryMapped)         { memoryMappedFileGrid_     = memoryMapped             ;}
+  void setCompressedFileGrid(bool compressed)             { compressedFileGrid_       = compressed               ;}
+  void setCompressionMantissaBits(int mantissaBits)       { compressionMantissaBits_  = mantissaBits             ;}
+  void setNumberOfThreads(int nThreads)                   { numberOfThreads_          = nThreads                 ;}
+  void setMeasureFFTPlans(bool measureFFTPlans)           { measureFFTPlans_          = measureFFTPlans          ;}
+  void setCompactPriorCovariance(bool compact)            { compactPriorCovariance_   = compact                  ;}
+  void setConcurrentSimulations(int nSim)                 { concurrentSimulations_    = nSim                     ;}
   void setEstimationMode(bool estimationMode)             { estimationMode_           = estimationMode           ;}
   void setForwardModeling(bool forwardModeling)           { forwardModeling_          = forwardModeling          ;}
   void setGenerateSeismicAfterInv( bool generateSeismic)  { generateSeismicAfterInv_  = generateSeismic          ;}
@@ -660,6 +677,7 @@ private:
                                                                  ///< will be interpolated. Default 0.
   float                             maxWellOffset_;              ///< Maximum offset for moving of wells
   float                             maxWellShift_;               ///< Maximum vertical shift for moving of wells
+  bool                              wellMoveCoarseToFine_;       ///< Search a coarse set of well offsets first when moving wells
 
   float                             defaultWaveletLength_;       ///< Assumed length of a wavelet
   float                             guard_zone_;                 ///< Band outside target interval (on each side) where data is required
@@ -714,6 +732,13 @@ private:
   int                               waveletFormatFlag_;          ///< Decides wavelet output format
   int                               otherFlag_;                  ///< Decides output beyond grids and wells.
   bool                              fileGrid_;                   ///< Indicator telling if grids are to be kept on file
+  bool                              memoryMappedFileGrid_;       ///< Indicator telling if grids kept on file are accessed through a memory map
+  bool                              compressedFileGrid_;         ///< Indicator telling if grids kept on file are compressed
+  int                               compressionMantissaBits_;    ///< Mantissa bits kept in compressed grids. 23 is lossless.
+  int                               numberOfThreads_;            ///< Number of threads used in parallelised parts of the program
+  bool                              measureFFTPlans_;            ///< Use measured FFT plans, and keep the FFT wisdom on file
+  bool                              compactPriorCovariance_;     ///< Keep one shared prior correlation grid instead of six covariance grids
+  int                               concurrentSimulations_;      ///< Realisations generated together, each from its own random stream (0 = one stream for all)
   bool                              outputGridsDefault_;         ///< Indicator telling if grid output has been actively controlled
   bool                              waveletFormatManual_;        ///< True if wavelet format is decided in the model file
   bool                              useVerticalVariogram_;       ///< True if a vertical variogram is used to estimate temporal correlation
@@ -110,6 +110,7 @@ ModelTravelTimeDynamic::processRMSData(FFTGrid                 *& rms_data,
 {
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
+  Timings::Region region("Seismic data");
 
   LogKit::WriteHeader("Reading RMS travel time data");
 
@@ -2,8 +2,13 @@
 *      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
 ***************************************************************************/
 
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
 #include "src/fftgrid.h"
 #include "src/fftfilegrid.h"
+#include "src/gridwriter.h"
 #include "src/parameteroutput.h"
 #include "src/modelsettings.h"
 #include "src/simbox.h"
@@ -40,46 +45,47 @@ ParameterOutput::writeParameters(const Simbox  * simbox,
   if(kriged)
     suffix = "_Kriged"+suffix;
 
-  if((outputFlag & IO::MURHO) > 0)
-  {
-    fileName = prefix+"MuRho"+suffix;
-    computeMuRho(simbox, modelGeneral, modelSettings, alpha, beta, rho, fileGrid, fileName);
-  }
-  if((outputFlag & IO::LAMBDARHO) > 0)
-  {
-    fileName = prefix+"LambdaRho"+suffix;
-    computeLambdaRho(simbox, modelGeneral, modelSettings, alpha, beta, rho, fileGrid, fileName);
-  }
-  if((outputFlag & IO::LAMELAMBDA) > 0)
-  {
-    fileName = prefix+"LameLambda"+suffix;
-    computeLameLambda(simbox, modelGeneral, modelSettings, alpha, beta, rho, fileGrid, fileName);
-  }
-  if((outputFlag & IO::LAMEMU) > 0)
-  {
-    fileName = prefix+"LameMu"+suffix;
-    computeLameMu(simbox, modelGeneral,  modelSettings, beta, rho, fileGrid, fileName);
-  }
-  if((outputFlag & IO::POISSONRATIO) > 0)
-  {
-    fileName = prefix+"PoissonRatio"+suffix;
-    computePoissonRatio(simbox, modelGeneral, modelSettings, alpha, beta, fileGrid, fileName);
-  }
-  if((outputFlag & IO::AI) > 0)
-  {
-    fileName = prefix+"AI"+suffix;
-    computeAcousticImpedance(simbox, modelGeneral, modelSettings, alpha, rho, fileGrid, fileName);
+  // Derived attributes, in the order they are written.
+  const int    nAttributes = 8;
+  const int    flags[]     = {IO::MURHO, IO::LAMBDARHO, IO::LAMELAMBDA, IO::LAMEMU,
+                              IO::POISSONRATIO, IO::AI, IO::SI, IO::VPVSRATIO};
+  const char * names[]     = {"MuRho", "LambdaRho", "LameLambda", "LameMu",
+                              "PoissonRatio", "AI", "SI", "VpVsRatio"};
+  const char * labels[]    = {"Mu rho", "Lambda rho", "Lame lambda", "Lame mu",
+                              "Poisson ratio", "Acoustic Impedance", "Shear impedance", "Vp-Vs ratio"};
+
+  std::vector<int> attributes;
+  std::vector<int> index;
+  for(int n=0;n<nAttributes;n++) {
+    if((outputFlag & flags[n]) > 0) {
+      attributes.push_back(flags[n]);
+      index.push_back(n);
+    }
   }
-  if((outputFlag & IO::SI) > 0)
-  {
-    fileName = prefix+"SI"+suffix;
-    computeShearImpedance(simbox, modelGeneral, modelSettings, beta, rho, fileGrid, fileName);
-  }
-  if((outputFlag & IO::VPVSRATIO) > 0)
+
+  // In memory, the attributes are made in groups that fit within the number of grids
+  // allowed by ModelAVOStatic::checkAvailableMemory. File grids are streamed to disk.
+  int nSelected = static_cast<int>(attributes.size());
+  int groupSize = nSelected;
+  if(!fileGrid)
+    groupSize = std::max(1, std::min(nSelected, FFTGrid::getMaxAllowedGrids() - FFTGrid::getNumberOfGrids()));
+
+  for(int first=0;first<nSelected;first+=groupSize)
   {
-    fileName = prefix+"VpVsRatio"+suffix;
-    computeVpVsRatio(simbox, modelGeneral, modelSettings, alpha, beta, fileGrid, fileName);
+    int last = std::min(nSelected, first+groupSize);
+    if(!fileGrid)
+      GridWriter::reserve(last-first);
+    std::vector<int>       group(attributes.begin()+first, attributes.begin()+last);
+    std::vector<FFTGrid *> grids(group.size());
+    computeAttributes(group, alpha, beta, rho, grids, fileGrid, modelSettings->getNumberOfThreads());
+
+    for(int n=first;n<last;n++)
+    {
+      fileName = prefix+names[index[n]]+suffix;
+      writeToFile(simbox, modelGeneral, modelSettings, grids[n-first], fileName, labels[index[n]], false, true);
+    }
   }
+
   if((outputFlag & IO::VP) > 0)
   {
     fileName = prefix+"Vp"+suffix;
@@ -113,304 +119,128 @@ ParameterOutput::writeParameters(const Simbox  * simbox,
 }
 
 void
-ParameterOutput::computeAcousticImpedance(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                          FFTGrid * Alpha, FFTGrid * Rho ,
-                                          bool fileGrid, const std::string & fileName)
+ParameterOutput::computeAttributes(const std::vector<int> & attributes,
+                                   FFTGrid                * alpha,
+                                   FFTGrid                * beta,
+                                   FFTGrid                * rho,
+                                   std::vector<FFTGrid *> & grids,
+                                   bool                     fileGrid,
+                                   int                      nThreads)
 {
-  if(Alpha->getIsTransformed()) Alpha->invFFTInPlace();
-  if(Rho->getIsTransformed()) Rho->invFFTInPlace();
-
-  Alpha->setAccessMode(FFTGrid::READ);
-  Rho->setAccessMode(FFTGrid::READ);
-
-  FFTGrid* prImpedance;
-  prImpedance = createFFTGrid(Alpha, fileGrid);
-  prImpedance->setType(FFTGrid::PARAMETER);
-  prImpedance->createRealGrid();
-  prImpedance->setAccessMode(FFTGrid::WRITE);
-
-  int i;
-  int rSize =  prImpedance->getrsize();
-  double ijkA, ijkR, compVal;
-  for(i=0; i  <  rSize; i++)
-  {
-    ijkA = Alpha->getNextReal();
-    ijkR = Rho->getNextReal();
-    compVal = exp(ijkA + ijkR);
-    prImpedance->setNextReal(float( compVal));
+  //
+  // All requested attributes are made in one pass through alpha, beta and rho. In memory
+  // the pass is done row by row in parallel over z-slices. File grids are streamed, so
+  // that only one row of each grid is held in memory.
+  //
+  if(alpha->getIsTransformed()) alpha->invFFTInPlace();
+  if(beta->getIsTransformed())  beta->invFFTInPlace();
+  if(rho->getIsTransformed())   rho->invFFTInPlace();
+
+  int nAttributes = static_cast<int>(attributes.size());
+  for(int n=0;n<nAttributes;n++) {
+    grids[n] = createFFTGrid(alpha, fileGrid);
+    grids[n]->setType(FFTGrid::PARAMETER);
+    grids[n]->createRealGrid();
   }
 
-  Alpha->endAccess();
-  Rho->endAccess();
-
-  prImpedance->endAccess();
-  writeToFile(simbox, modelGeneral, modelSettings, prImpedance, fileName, "Acoustic Impedance");
-  delete prImpedance;
-}
-
-void
-ParameterOutput::computeShearImpedance(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                       FFTGrid * Beta, FFTGrid * Rho,
-                                       bool fileGrid, const std::string & fileName)
-{
-
-  if(Beta->getIsTransformed()) Beta->invFFTInPlace();
-  if(Rho->getIsTransformed()) Rho->invFFTInPlace();
-
-  Beta->setAccessMode(FFTGrid::READ);
-  Rho->setAccessMode(FFTGrid::READ);
-
-  FFTGrid* shImpedance;
-  shImpedance  = createFFTGrid(Beta, fileGrid);
-  shImpedance->setType(FFTGrid::PARAMETER);
-  shImpedance->createRealGrid();
-  shImpedance->setAccessMode(FFTGrid::WRITE);
-  int i;
-  int rSize =  shImpedance->getrsize();
-  double ijkB, ijkR, compVal;
-  for(i=0; i  <  rSize; i++)
-  {
-    ijkB = Beta->getNextReal();
-    ijkR = Rho->getNextReal();
-    compVal = exp(ijkB + ijkR);
-    shImpedance->setNextReal(float( compVal));
+  int rnxp = alpha->getRNxp();
+  int nyp  = alpha->getNyp();
+  int nzp  = alpha->getNzp();
+
+  if(fileGrid) {
+    alpha->setAccessMode(FFTGrid::READ);
+    beta ->setAccessMode(FFTGrid::READ);
+    rho  ->setAccessMode(FFTGrid::READ);
+    for(int n=0;n<nAttributes;n++)
+      grids[n]->setAccessMode(FFTGrid::WRITE);
+
+    std::vector<fftw_real> a(rnxp);
+    std::vector<fftw_real> b(rnxp);
+    std::vector<fftw_real> r(rnxp);
+    std::vector<fftw_real> value(rnxp);
+    for(int k=0;k<nzp;k++) {
+      for(int j=0;j<nyp;j++) {
+        for(int i=0;i<rnxp;i++) {
+          a[i] = alpha->getNextReal();
+          b[i] = beta ->getNextReal();
+          r[i] = rho  ->getNextReal();
+        }
+        for(int n=0;n<nAttributes;n++) {
+          computeAttributeRow(attributes[n], &a[0], &b[0], &r[0], &value[0], rnxp);
+          for(int i=0;i<rnxp;i++)
+            grids[n]->setNextReal(value[i]);
+        }
+      }
+    }
   }
-
-  Beta->endAccess();
-  Rho->endAccess();
-
-  shImpedance->endAccess();
-  writeToFile(simbox, modelGeneral, modelSettings, shImpedance, fileName, "Shear impedance");
-  delete shImpedance;
-}
-
-
-void
-ParameterOutput::computeVpVsRatio(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                  FFTGrid * Alpha, FFTGrid * Beta,
-                                  bool fileGrid, const std::string & fileName)
-{
-  if(Alpha->getIsTransformed()) Alpha->invFFTInPlace();
-  if(Beta->getIsTransformed())  Beta->invFFTInPlace();
-
-  Alpha->setAccessMode(FFTGrid::READ);
-  Beta->setAccessMode(FFTGrid::READ);
-
-  FFTGrid* ratioVpVs;
-  ratioVpVs = createFFTGrid(Alpha, fileGrid);
-  ratioVpVs->setType(FFTGrid::PARAMETER);
-  ratioVpVs->createRealGrid();
-  ratioVpVs->setAccessMode(FFTGrid::WRITE);
-  int i;
-  int rSize =  ratioVpVs->getrsize();
-  double ijkA, ijkB, compVal;
-  for(i=0; i  <  rSize; i++)
-  {
-    ijkA = Alpha->getNextReal();
-    ijkB = Beta->getNextReal();
-    compVal = exp(ijkA - ijkB);
-    ratioVpVs->setNextReal(float( compVal));
+  else {
+    #pragma omp parallel for num_threads(nThreads) schedule(dynamic, 1)
+    for(int k=0;k<nzp;k++) {
+      for(int j=0;j<nyp;j++) {
+        const fftw_real * a = alpha->getRealRow(j,k);
+        const fftw_real * b = beta ->getRealRow(j,k);
+        const fftw_real * r = rho  ->getRealRow(j,k);
+        for(int n=0;n<nAttributes;n++)
+          computeAttributeRow(attributes[n], a, b, r, grids[n]->getWritableRealRow(j,k), rnxp);
+      }
+    }
   }
 
-  Alpha->endAccess();
-  Beta->endAccess();
-
-  ratioVpVs->endAccess();
-  writeToFile(simbox, modelGeneral, modelSettings, ratioVpVs, fileName, "Vp-Vs ratio");
-  delete ratioVpVs;
-}
-
-void
-ParameterOutput::computePoissonRatio(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                     FFTGrid * Alpha, FFTGrid * Beta,
-                                     bool fileGrid, const std::string & fileName)
-{
-  if(Alpha->getIsTransformed()) Alpha->invFFTInPlace();
-  if(Beta->getIsTransformed()) Beta->invFFTInPlace();
-
-  Alpha->setAccessMode(FFTGrid::READ);
-  Beta->setAccessMode(FFTGrid::READ);
-
-  FFTGrid* poiRat;
-  poiRat  = createFFTGrid(Alpha, fileGrid);
-  poiRat->setType(FFTGrid::PARAMETER);
-  poiRat->createRealGrid();
-  poiRat->setAccessMode(FFTGrid::WRITE);
-
-  int i;
-  int rSize =  poiRat->getrsize();
-  double ijkA, ijkB, compVal, vRatioSq;
-  for(i=0; i  <  rSize; i++)
-  {
-    ijkA      = Alpha->getNextReal();
-    ijkB      = Beta->getNextReal();
-    vRatioSq  = exp(2*(ijkA-ijkB));
-    compVal   = 0.5*(vRatioSq - 2)/(vRatioSq - 1);
-    poiRat->setNextReal(float( compVal));
-  }
-
-  Alpha->endAccess();
-  Beta->endAccess();
-
-  poiRat->endAccess();
-  writeToFile(simbox, modelGeneral, modelSettings, poiRat, fileName, "Poisson ratio");
-  delete poiRat;
-}
-
-void
-ParameterOutput::computeLameMu(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                               FFTGrid * Beta, FFTGrid * Rho,
-                               bool fileGrid, const std::string & fileName )
-{
-  if(Beta->getIsTransformed()) Beta->invFFTInPlace();
-  if(Rho->getIsTransformed()) Rho->invFFTInPlace();
-
-  Beta->setAccessMode(FFTGrid::READ);
-  Rho->setAccessMode(FFTGrid::READ);
-
-  FFTGrid* mu;
-  mu  = createFFTGrid(Beta, fileGrid);
-  mu->setType(FFTGrid::PARAMETER);
-  mu->createRealGrid();
-  mu->setAccessMode(FFTGrid::WRITE);
-
-  int i;
-  int rSize =  mu->getrsize();
-  double ijkB, ijkR, compVal;
-  for(i=0; i  <  rSize; i++)
-  {
-    ijkB = Beta->getNextReal();
-    ijkR = Rho->getNextReal();
-    compVal = exp(ijkR+2*ijkB-13.81551); // -13.81551 in the exponent divides by 1 000 000
-    mu->setNextReal(float( compVal));
-  }
-
-  Beta->endAccess();
-  Rho->endAccess();
-  mu->endAccess();
-  writeToFile(simbox, modelGeneral, modelSettings, mu, fileName, "Lame mu");
-
-  delete mu;
-}
-
-void
-ParameterOutput::computeLameLambda(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                   FFTGrid * Alpha, FFTGrid * Beta, FFTGrid * Rho,
-                                   bool fileGrid, const std::string & fileName)
-{
-  if(Alpha->getIsTransformed()) Alpha->invFFTInPlace();
-  if(Beta->getIsTransformed()) Beta->invFFTInPlace();
-  if(Rho->getIsTransformed()) Rho->invFFTInPlace();
-
-  Alpha->setAccessMode(FFTGrid::READ);
-  Beta->setAccessMode(FFTGrid::READ);
-  Rho->setAccessMode(FFTGrid::READ);
-
-  FFTGrid* lambda;
-  lambda  = createFFTGrid(Alpha, fileGrid);
-  lambda->setType(FFTGrid::PARAMETER);
-  lambda->createRealGrid();
-  lambda->setAccessMode(FFTGrid::WRITE);
-
-  int i;
-  int rSize =  lambda->getrsize();
-  double ijkA, ijkB, ijkR, compVal;
-  for(i=0; i  <  rSize; i++)
-  {
-    ijkA = Alpha->getNextReal();
-    ijkB = Beta->getNextReal();
-    ijkR = Rho->getNextReal();
-    compVal = exp(ijkR)*(exp(2*ijkA-13.81551)-2*exp(2*ijkB-13.81551)); // -13.81551 in the exponent divides by 1 000 000
-    lambda->setNextReal(float( compVal));
-  }
-
-  Alpha->endAccess();
-  Beta->endAccess();
-  Rho->endAccess();
-
-  lambda->endAccess();
-  writeToFile(simbox, modelGeneral, modelSettings, lambda, fileName, "Lame lambda");
-
-  delete lambda;
-}
-
-void
-ParameterOutput::computeLambdaRho(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                  FFTGrid * Alpha, FFTGrid * Beta, FFTGrid * Rho,
-                                  bool fileGrid, const std::string & fileName)
-{
-  if(Alpha->getIsTransformed()) Alpha->invFFTInPlace();
-  if(Beta->getIsTransformed()) Beta->invFFTInPlace();
-  if(Rho->getIsTransformed()) Rho->invFFTInPlace();
-
-  Alpha->setAccessMode(FFTGrid::READ);
-  Beta->setAccessMode(FFTGrid::READ);
-  Rho->setAccessMode(FFTGrid::READ);
-
-  FFTGrid* lambdaRho;
-  lambdaRho  = createFFTGrid(Alpha, fileGrid);
-  lambdaRho->setType(FFTGrid::PARAMETER);
-  lambdaRho->createRealGrid();
-  lambdaRho->setAccessMode(FFTGrid::WRITE);
-
-  int i;
-  int rSize =  lambdaRho->getrsize();
-  double ijkA, ijkB, ijkR, compVal;
-  for(i=0; i  <  rSize; i++)
-  {
-    ijkA = Alpha->getNextReal();
-    ijkB = Beta->getNextReal();
-    ijkR = Rho->getNextReal();
-    compVal = exp(2.0*(ijkA +ijkR)-13.81551)-2.0*exp(2.0*(ijkB +ijkR)-13.81551); // -13.81551 in the exponent divides by 1e6=(1 000 000)
-    lambdaRho->setNextReal(float( compVal));
+  if(fileGrid) {
+    alpha->endAccess();
+    beta ->endAccess();
+    rho  ->endAccess();
+    for(int n=0;n<nAttributes;n++)
+      grids[n]->endAccess();
   }
-
-  Alpha->endAccess();
-  Beta->endAccess();
-  Rho->endAccess();
-
-  lambdaRho->endAccess();
-
-  writeToFile(simbox, modelGeneral, modelSettings, lambdaRho, fileName, "Lambda rho");
-  delete lambdaRho;
 }
 
 void
-ParameterOutput::computeMuRho(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                              FFTGrid * Alpha, FFTGrid * Beta, FFTGrid * Rho,
-                              bool fileGrid, const std::string & fileName)
+ParameterOutput::computeAttributeRow(int               attribute,
+                                     const fftw_real * alpha,
+                                     const fftw_real * beta,
+                                     const fftw_real * rho,
+                                     fftw_real       * value,
+                                     int               n)
 {
-  if(Beta->getIsTransformed()) Beta->invFFTInPlace();
-  if(Rho->getIsTransformed()) Rho->invFFTInPlace();
-
-  Beta->setAccessMode(FFTGrid::READ);
-  Rho->setAccessMode(FFTGrid::READ);
-
-  FFTGrid* muRho;
-  muRho = createFFTGrid(Alpha, fileGrid);
-  muRho->setType(FFTGrid::PARAMETER);
-  muRho->createRealGrid();
-  muRho->setAccessMode(FFTGrid::WRITE);
-
-  int i;
-  int rSize =  muRho->getrsize();
-  double ijkB, ijkR, compVal;
-  for(i=0; i  <  rSize; i++)
+  // -13.81551 in the exponent divides by 1 000 000
+  switch(attribute)
   {
-    ijkB = Beta->getNextReal();
-    ijkR = Rho->getNextReal();
-    compVal = exp(2.0*(ijkB +ijkR)-13.81551); // -13.81551 in the exponent divides by 1e6=(1 000 000)
-    muRho->setNextReal(float( compVal));
+  case IO::AI:
+    for(int i=0;i<n;i++)
+      value[i] = float(exp(double(alpha[i]) + double(rho[i])));
+    break;
+  case IO::SI:
+    for(int i=0;i<n;i++)
+      value[i] = float(exp(double(beta[i]) + double(rho[i])));
+    break;
+  case IO::VPVSRATIO:
+    for(int i=0;i<n;i++)
+      value[i] = float(exp(double(alpha[i]) - double(beta[i])));
+    break;
+  case IO::POISSONRATIO:
+    for(int i=0;i<n;i++) {
+      double vRatioSq = exp(2*(double(alpha[i]) - double(beta[i])));
+      value[i] = float(0.5*(vRatioSq - 2)/(vRatioSq - 1));
+    }
+    break;
+  case IO::LAMEMU:
+    for(int i=0;i<n;i++)
+      value[i] = float(exp(double(rho[i]) + 2*double(beta[i]) - 13.81551));
+    break;
+  case IO::LAMELAMBDA:
+    for(int i=0;i<n;i++)
+      value[i] = float(exp(double(rho[i]))*(exp(2*double(alpha[i]) - 13.81551) - 2*exp(2*double(beta[i]) - 13.81551)));
+    break;
+  case IO::MURHO:
+    for(int i=0;i<n;i++)
+      value[i] = float(exp(2.0*(double(beta[i]) + double(rho[i])) - 13.81551));
+    break;
+  case IO::LAMBDARHO:
+    for(int i=0;i<n;i++)
+      value[i] = float(exp(2.0*(double(alpha[i]) + double(rho[i])) - 13.81551) - 2.0*exp(2.0*(double(beta[i]) + double(rho[i])) - 13.81551));
+    break;
   }
-
-  Alpha->endAccess();
-  Beta->endAccess();
-  Rho->endAccess();
-
-  muRho->endAccess();
-  writeToFile(simbox, modelGeneral, modelSettings, muRho, fileName, "Mu rho");
-
-  delete muRho;
 }
 
 FFTGrid*
@@ -440,20 +270,23 @@ ParameterOutput::writeToFile(const Simbox      * simbox,
                              FFTGrid           * grid,
                              const std::string & fileName,
                              const std::string & sgriLabel,
-                             bool padding)
+                             bool padding,
+                             bool deleteGrid)
 {
   GridMapping * timeDepthMapping = modelGeneral->getTimeDepthMapping();
   GridMapping * timeCutMapping   = modelGeneral->getTimeCutMapping();
   float         seismicStartTime = 0.0; //Hack for Sebastian, was: model->getModelSettings()->getSegyOffset();
   TraceHeaderFormat *format = modelSettings->getTraceHeaderFormatOutput();
 
-  grid->writeFile(fileName,
-                  IO::PathToInversionResults(),
-                  simbox,
-                  sgriLabel,
-                  seismicStartTime,
-                  timeDepthMapping,
-                  timeCutMapping,
-                  *format,
-                  padding);
+  GridWriter::writeFile(grid,
+                        deleteGrid,
+                        fileName,
+                        IO::PathToInversionResults(),
+                        simbox,
+                        sgriLabel,
+                        seismicStartTime,
+                        timeDepthMapping,
+                        timeCutMapping,
+                        *format,
+                        padding);
 }
@@ -6,6 +6,9 @@
 #define PARAMETEROUTPUT_H
 
 #include <string>
+#include <vector>
+
+#include "fftw.h"
 
 class FFTFileGrid;
 class FFTGrid;
@@ -35,34 +38,18 @@ public:
                                FFTGrid           * grid,
                                const std::string & fileName,
                                const std::string & sgriLabel,
-                               bool padding=false);
+                               bool padding=false,
+                               bool deleteGrid=false);  // The grid is deleted when it has been written
 
 
 private:
-  static void      computeAcousticImpedance(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                            FFTGrid * Alpha, FFTGrid * Rho,
-                                            bool fileGrid, const std::string & fileName);
-  static void      computeShearImpedance(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                         FFTGrid * Beta, FFTGrid * Rho,
-                                         bool fileGrid, const std::string & fileName);
-  static void      computeVpVsRatio(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                    FFTGrid * Alpha, FFTGrid * Beta,
-                                    bool fileGrid, const std::string & fileName);
-  static void      computePoissonRatio(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                       FFTGrid * Alpha, FFTGrid * Beta,
-                                       bool fileGrid, const std::string & fileName);
-  static void      computeLameMu(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                 FFTGrid * Beta, FFTGrid * Rho,
-                                 bool fileGrid, const std::string & FileName);
-  static void      computeLameLambda(const Simbox * simbox,ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                     FFTGrid * Alpha, FFTGrid * Beta, FFTGrid * Rho,
-                                     bool fileGrid, const std::string & fileName);
-  static void      computeMuRho(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                FFTGrid * Alpha, FFTGrid * Beta, FFTGrid * Rho,
-                                bool fileGrid, const std::string & fileName);
-  static void      computeLambdaRho(const Simbox * simbox, ModelGeneral * modelGeneral, const ModelSettings * modelSettings,
-                                    FFTGrid * Alpha, FFTGrid * Beta, FFTGrid * Rho,
-                                    bool fileGrid, const std::string & fileName);
+  static void      computeAttributes(const std::vector<int> & attributes, // IO::AI, IO::SI, ...
+                                     FFTGrid * alpha, FFTGrid * beta, FFTGrid * rho,
+                                     std::vector<FFTGrid *> & grids,
+                                     bool fileGrid, int nThreads);
+  static void      computeAttributeRow(int attribute,
+                                       const fftw_real * alpha, const fftw_real * beta, const fftw_real * rho,
+                                       fftw_real * value, int n);
 
   static FFTGrid * createFFTGrid(FFTGrid * referenceGrid, bool fileGrid);
 };
@@ -41,6 +41,10 @@ public:
                              const double & s2 = 0,
                              const Simbox * const volume = 0) const = 0;
 
+  // Density grid that FindDensity interpolates trilinearly in volume, or NULL if the
+  // density is found in another way.
+  virtual FFTGrid * GetHistogram() const { return NULL; }
+
   virtual void  ResampleAndWriteDensity(const std::string & fileName,
                                         const Simbox      * origVol,
                                         Simbox            * volume,
@@ -508,6 +508,14 @@ double PosteriorElasticPDF3D::Density(const double & vp,
     return returnvalue;
 }
 
+FFTGrid * PosteriorElasticPDF3D::GetHistogram() const
+{
+  // With dimension reduction the density is not found by FindDensity's interpolation
+  if (v1_.size()>0 && v2_.size()>0)
+    return NULL;
+  return histogram_;
+}
+
 double PosteriorElasticPDF3D::FindDensity(const double & vp,
                                           const double & vs,
                                           const double & rho,
@@ -579,7 +587,8 @@ double PosteriorElasticPDF3D::FindDensity(const double & vp,
     }
 
 
-      histogram_->setAccessMode(FFTGrid::RANDOMACCESS);
+      // The histogram is kept in memory, so no access mode is needed. This keeps
+      // FindDensity safe to call from several threads.
       float value1 = std::max<float>(0,histogram_->getRealValue(j1,k1,l1));
       float value2 = std::max<float>(0,histogram_->getRealValue(j1,k1,l2));
       float value3 = std::max<float>(0,histogram_->getRealValue(j1,k2,l1));
@@ -588,7 +597,6 @@ double PosteriorElasticPDF3D::FindDensity(const double & vp,
       float value6 = std::max<float>(0,histogram_->getRealValue(j2,k1,l2));
       float value7 = std::max<float>(0,histogram_->getRealValue(j2,k2,l1));
       float value8 = std::max<float>(0,histogram_->getRealValue(j2,k2,l2));
-      histogram_->endAccess();
 
       value += (1.0f-wj)*(1.0f-wk)*(1.0f-wl)*value1;
       value += (1.0f-wj)*(1.0f-wk)*(     wl)*value2;
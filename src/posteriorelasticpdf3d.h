@@ -80,6 +80,8 @@ public:
                              const double & s2 = 0,
                              const Simbox * const volume = 0) const;
 
+  virtual FFTGrid * GetHistogram() const;
+
   //virtual void WriteAsciiFile(std::string filename) const;
 
   virtual void ResampleAndWriteDensity(const std::string & fileName,
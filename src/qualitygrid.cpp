@@ -53,9 +53,7 @@ QualityGrid::QualityGrid(const std::vector<double>   pValue,
   generateProbField(grid, wells, simbox, modelSettings);
 
   std::string fileName = "Seismic_Quality_Grid";
-  ParameterOutput::writeToFile(simbox, modelGeneral, modelSettings, grid, fileName, "");
-
-  delete grid;
+  ParameterOutput::writeToFile(simbox, modelGeneral, modelSettings, grid, fileName, "", false, true);
 }
 
 void QualityGrid::generateProbField(FFTGrid              *& grid,
@@ -22,6 +22,8 @@ SeismicParametersHolder::SeismicParametersHolder(void)
   crCovBetaRho_   = NULL;
 
   priorVar0_.resize(3,3);
+
+  compactPrior_   = false;
 }
 
 //--------------------------------------------------------------------
@@ -100,7 +102,8 @@ SeismicParametersHolder::setCorrelationParameters(float                    ** pr
                                                   const int                 & nz,
                                                   const int                 & nxPad,
                                                   const int                 & nyPad,
-                                                  const int                 & nzPad)
+                                                  const int                 & nzPad,
+                                                  bool                        compact)
 {
   priorVar0_.resize(3,3);
 
@@ -138,6 +141,11 @@ SeismicParametersHolder::setCorrelationParameters(float                    ** pr
   //tmp=priorVar0_;
   //NRLib::ComputeEigenVectors(tmp,eVals,eVec);
 
+  // The compact prior stores the correlation scaled by Var(alpha), so it needs Var(alpha) > 0.
+  compactPrior_ = compact && priorVar0_(0,0) > 0.0;
+  if(compact && !compactPrior_)
+    LogKit::LogFormatted(LogKit::Warning,"\nWARNING: The prior variance of Vp is not positive. Using the full prior covariance instead of the compact one.\n");
+
   createCorrGrids(nx, ny, nz, nxPad, nyPad, nzPad, false);
 
   initializeCorrelations(priorCorrXY,
@@ -159,20 +167,24 @@ SeismicParametersHolder::createCorrGrids(int  nx,
                                          bool fileGrid)
 {
   covAlpha_       = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,fileGrid);
+  covAlpha_       ->setType(FFTGrid::COVARIANCE);
+  covAlpha_       ->createRealGrid();
+
+  if(compactPrior_)
+    return;
+
   covBeta_        = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,fileGrid);
   covRho_         = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,fileGrid);
   crCovAlphaBeta_ = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,fileGrid);
   crCovAlphaRho_  = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,fileGrid);
   crCovBetaRho_   = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,fileGrid);
 
-  covAlpha_       ->setType(FFTGrid::COVARIANCE);
   covBeta_        ->setType(FFTGrid::COVARIANCE);
   covRho_         ->setType(FFTGrid::COVARIANCE);
   crCovAlphaBeta_ ->setType(FFTGrid::COVARIANCE);
   crCovAlphaRho_  ->setType(FFTGrid::COVARIANCE);
   crCovBetaRho_   ->setType(FFTGrid::COVARIANCE);
 
-  covAlpha_       ->createRealGrid();
   covBeta_        ->createRealGrid();
   covRho_         ->createRealGrid();
   crCovAlphaBeta_ ->createRealGrid();
@@ -194,6 +206,39 @@ SeismicParametersHolder::createFFTGrid(int nx,  int ny,  int nz,
 }
 //-------------------------------------------------------------------
 void
+SeismicParametersHolder::createPosteriorCovGrids(void)
+{
+  if(!compactPrior_ || covBeta_ != NULL)
+    return;
+
+  int nx  = covAlpha_->getNx();
+  int ny  = covAlpha_->getNy();
+  int nz  = covAlpha_->getNz();
+  int nxp = covAlpha_->getNxp();
+  int nyp = covAlpha_->getNyp();
+  int nzp = covAlpha_->getNzp();
+
+  covBeta_        = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,false);
+  covRho_         = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,false);
+  crCovAlphaBeta_ = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,false);
+  crCovAlphaRho_  = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,false);
+  crCovBetaRho_   = createFFTGrid(nx,ny,nz,nxp,nyp,nzp,false);
+
+  covBeta_        ->setType(FFTGrid::COVARIANCE);
+  covRho_         ->setType(FFTGrid::COVARIANCE);
+  crCovAlphaBeta_ ->setType(FFTGrid::COVARIANCE);
+  crCovAlphaRho_  ->setType(FFTGrid::COVARIANCE);
+  crCovBetaRho_   ->setType(FFTGrid::COVARIANCE);
+
+  // Every cell is written by the posterior computation, so the grids are left unfilled.
+  covBeta_        ->createComplexGrid();
+  covRho_         ->createComplexGrid();
+  crCovAlphaBeta_ ->createComplexGrid();
+  crCovAlphaRho_  ->createComplexGrid();
+  crCovBetaRho_   ->createComplexGrid();
+}
+//-------------------------------------------------------------------
+void
 SeismicParametersHolder::initializeCorrelations(const Surface            * priorCorrXY,
                                                 const std::vector<float> & priorCorrT,
                                                 const float              & corrGradI,
@@ -204,13 +249,19 @@ SeismicParametersHolder::initializeCorrelations(const Surface            * prior
   fftw_real * circCorrT = computeCircCorrT(priorCorrT, lowIntCut, nzp);
 
   covAlpha_      ->fillInParamCorr(priorCorrXY, circCorrT, corrGradI, corrGradJ);
+  covAlpha_      ->multiplyByScalar(static_cast<float>(priorVar0_(0,0)));
+
+  if(compactPrior_) {
+    fftw_free(circCorrT);
+    return;
+  }
+
   covBeta_       ->fillInParamCorr(priorCorrXY, circCorrT, corrGradI, corrGradJ);
   covRho_        ->fillInParamCorr(priorCorrXY, circCorrT, corrGradI, corrGradJ);
   crCovAlphaBeta_->fillInParamCorr(priorCorrXY, circCorrT, corrGradI, corrGradJ);
   crCovAlphaRho_ ->fillInParamCorr(priorCorrXY, circCorrT, corrGradI, corrGradJ);
   crCovBetaRho_  ->fillInParamCorr(priorCorrXY, circCorrT, corrGradI, corrGradJ);
 
-  covAlpha_      ->multiplyByScalar(static_cast<float>(priorVar0_(0,0)));
   covBeta_       ->multiplyByScalar(static_cast<float>(priorVar0_(1,1)));
   covRho_        ->multiplyByScalar(static_cast<float>(priorVar0_(2,2)));
   crCovAlphaBeta_->multiplyByScalar(static_cast<float>(priorVar0_(0,1)));
@@ -307,19 +358,19 @@ SeismicParametersHolder::invFFTCovGrids()
   if (covAlpha_->getIsTransformed())
     covAlpha_->invFFTInPlace();
 
-  if (covBeta_->getIsTransformed())
+  if (covBeta_ != NULL && covBeta_->getIsTransformed())
     covBeta_->invFFTInPlace();
 
-  if (covRho_->getIsTransformed())
+  if (covRho_ != NULL && covRho_->getIsTransformed())
     covRho_->invFFTInPlace();
 
-  if (crCovAlphaBeta_->getIsTransformed())
+  if (crCovAlphaBeta_ != NULL && crCovAlphaBeta_->getIsTransformed())
     crCovAlphaBeta_->invFFTInPlace();
 
-  if (crCovAlphaRho_->getIsTransformed())
+  if (crCovAlphaRho_ != NULL && crCovAlphaRho_->getIsTransformed())
     crCovAlphaRho_->invFFTInPlace();
 
-  if (crCovBetaRho_->getIsTransformed())
+  if (crCovBetaRho_ != NULL && crCovBetaRho_->getIsTransformed())
     crCovBetaRho_->invFFTInPlace();
 
   LogKit::LogFormatted(LogKit::High,"...done\n");
@@ -333,19 +384,19 @@ SeismicParametersHolder::FFTCovGrids()
   if (!covAlpha_->getIsTransformed())
     covAlpha_->fftInPlace();
 
-  if (!covBeta_->getIsTransformed())
+  if (covBeta_ != NULL && !covBeta_->getIsTransformed())
     covBeta_->fftInPlace();
 
-  if (!covRho_->getIsTransformed())
+  if (covRho_ != NULL && !covRho_->getIsTransformed())
     covRho_->fftInPlace();
 
-  if (!crCovAlphaBeta_->getIsTransformed())
+  if (crCovAlphaBeta_ != NULL && !crCovAlphaBeta_->getIsTransformed())
     crCovAlphaBeta_->fftInPlace();
 
-  if (!crCovAlphaRho_->getIsTransformed())
+  if (crCovAlphaRho_ != NULL && !crCovAlphaRho_->getIsTransformed())
     crCovAlphaRho_->fftInPlace();
 
-  if (!crCovBetaRho_->getIsTransformed())
+  if (crCovBetaRho_ != NULL && !crCovBetaRho_->getIsTransformed())
     crCovBetaRho_->fftInPlace();
 
   LogKit::LogFormatted(LogKit::High,"...done\n");
@@ -355,13 +406,10 @@ SeismicParametersHolder::FFTCovGrids()
 void
 SeismicParametersHolder::getNextParameterCovariance(fftw_complex **& parVar) const
 {
-
-  fftw_complex ii;
-  fftw_complex jj;
-  fftw_complex kk;
-  fftw_complex ij;
-  fftw_complex ik;
-  fftw_complex jk;
+  if(compactPrior_) {
+    fillCompactParameterCovariance(covAlpha_->getNextComplex(), parVar);
+    return;
+  }
 
   fftw_complex iiTmp = covAlpha_      ->getNextComplex();
   fftw_complex jjTmp = covBeta_       ->getNextComplex();
@@ -370,6 +418,49 @@ SeismicParametersHolder::getNextParameterCovariance(fftw_complex **& parVar) con
   fftw_complex ikTmp = crCovAlphaRho_ ->getNextComplex();
   fftw_complex jkTmp = crCovBetaRho_  ->getNextComplex();
 
+  fillParameterCovariance(iiTmp, jjTmp, kkTmp, ijTmp, ikTmp, jkTmp, parVar);
+}
+
+//--------------------------------------------------------------------
+void
+SeismicParametersHolder::getParameterCovariance(int               i,
+                                                int               j,
+                                                int               k,
+                                                fftw_complex   ** parVar) const
+{
+  // Cursor-free version of getNextParameterCovariance. Safe to call from several threads.
+  if(compactPrior_) {
+    fillCompactParameterCovariance(covAlpha_->getComplexRow(j, k)[i], parVar);
+    return;
+  }
+
+  fftw_complex iiTmp = covAlpha_      ->getComplexRow(j, k)[i];
+  fftw_complex jjTmp = covBeta_       ->getComplexRow(j, k)[i];
+  fftw_complex kkTmp = covRho_        ->getComplexRow(j, k)[i];
+  fftw_complex ijTmp = crCovAlphaBeta_->getComplexRow(j, k)[i];
+  fftw_complex ikTmp = crCovAlphaRho_ ->getComplexRow(j, k)[i];
+  fftw_complex jkTmp = crCovBetaRho_  ->getComplexRow(j, k)[i];
+
+  fillParameterCovariance(iiTmp, jjTmp, kkTmp, ijTmp, ikTmp, jkTmp, parVar);
+}
+
+//--------------------------------------------------------------------
+void
+SeismicParametersHolder::fillParameterCovariance(fftw_complex    iiTmp,
+                                                 fftw_complex    jjTmp,
+                                                 fftw_complex    kkTmp,
+                                                 fftw_complex    ijTmp,
+                                                 fftw_complex    ikTmp,
+                                                 fftw_complex    jkTmp,
+                                                 fftw_complex ** parVar) const
+{
+  fftw_complex ii;
+  fftw_complex jj;
+  fftw_complex kk;
+  fftw_complex ij;
+  fftw_complex ik;
+  fftw_complex jk;
+
   if(priorVar0_(0,0) != 0)
     iiTmp.re = iiTmp.re / static_cast<float>(priorVar0_(0,0));
 
@@ -426,6 +517,24 @@ SeismicParametersHolder::getNextParameterCovariance(fftw_complex **& parVar) con
   parVar[2][1].im = -jk.im;
 }
 
+//--------------------------------------------------------------------
+void
+SeismicParametersHolder::fillCompactParameterCovariance(fftw_complex    covAlphaTmp,
+                                                        fftw_complex ** parVar) const
+{
+  // Same as fillParameterCovariance when all six grids hold the correlation in covAlpha_.
+  assert(priorVar0_(0,0) > 0.0);
+  float corr = covAlphaTmp.re / static_cast<float>(priorVar0_(0,0));
+  corr = float( sqrt(corr * corr));
+
+  for(int i=0 ; i<3 ; i++) {
+    for(int j=0 ; j<3 ; j++) {
+      parVar[i][j].re = corr * static_cast<float>(priorVar0_(i,j));
+      parVar[i][j].im = 0.0;
+    }
+  }
+}
+
 //--------------------------------------------------------------------
 fftw_real *
 SeismicParametersHolder::computeCircCorrT(const std::vector<float> & priorCorrT,
@@ -58,7 +58,8 @@ public:
                                                          const int                 & nz,
                                                          const int                 & nxPad,
                                                          const int                 & nyPad,
-                                                         const int                 & nzPad);
+                                                         const int                 & nzPad,
+                                                         bool                        compact = false);
 
   void                          allocateGrids(const int nx,
                                               const int ny,
@@ -68,6 +69,14 @@ public:
                                               const int nzPad);
 
 
+  // In compact mode, only covAlpha_ is kept for the prior. The other five prior covariances
+  // have the same correlation, and are made from covAlpha_ and priorVar0_ when needed.
+  // createPosteriorCovGrids() allocates the five grids for the posterior covariances, and
+  // releaseCompactPrior() is called when the posterior covariances have been computed.
+  bool                          getIsCompactPrior(void) const           { return compactPrior_   ;}
+  void                          createPosteriorCovGrids(void);
+  void                          releaseCompactPrior(void)               { compactPrior_ = false  ;}
+
   NRLib::Matrix                 getPriorVar0(void) const;
 
   float                       * getPriorCorrTFiltered(int nz, int nzp) const;
@@ -84,6 +93,11 @@ public:
 
   void                          getNextParameterCovariance(fftw_complex **& parVar) const;
 
+  void                          getParameterCovariance(int               i,
+                                                       int               j,
+                                                       int               k,
+                                                       fftw_complex   ** parVar) const;
+
   void                          writeFilePriorCorrT(fftw_real   * priorCorrT,
                                                     const int   & nzp,
                                                     const float & dt) const;
@@ -125,6 +139,17 @@ private:
 
   float                         getOrigin(FFTGrid * grid) const;
 
+  void                          fillParameterCovariance(fftw_complex    iiTmp,
+                                                        fftw_complex    jjTmp,
+                                                        fftw_complex    kkTmp,
+                                                        fftw_complex    ijTmp,
+                                                        fftw_complex    ikTmp,
+                                                        fftw_complex    jkTmp,
+                                                        fftw_complex ** parVar) const;
+
+  void                          fillCompactParameterCovariance(fftw_complex    covAlphaTmp,
+                                                               fftw_complex ** parVar) const;
+
   void                          writeFilePostCorrT(const std::vector<float> & postCov,
                                                    const std::string        & subDir,
                                                    const std::string        & baseName) const;
@@ -141,5 +166,7 @@ private:
 
   NRLib::Matrix priorVar0_;
 
+  bool          compactPrior_;    ///< True if the prior covariance is held in covAlpha_ only
+
 };
 #endif
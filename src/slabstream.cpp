@@ -0,0 +1,505 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "nrlib/exception/exception.hpp"
+
+#include "lib/timekit.hpp"
+
+#include "src/slabstream.h"
+
+SlabReader::SlabReader()
+  : file_(NULL),
+    current_(0),
+    pos_(0),
+    pending_(false),
+    failed_(false),
+    compressed_(false),
+    bytesRead_(0.0),
+    rawBytes_(0.0),
+    codecTime_(0.0)
+{
+  size_[0] = 0;
+  size_[1] = 0;
+}
+
+SlabReader::~SlabReader()
+{
+  worker_.stop();
+  if(file_ != NULL)
+    fclose(file_);
+}
+
+void
+SlabReader::open(const std::string & fileName, size_t blockSize, bool compressed)
+{
+  fileName_   = fileName;
+  file_       = fopen(fileName.c_str(), "rb");
+  if(file_ == NULL)
+    throw NRLib::IOError("Failed to open " + fileName + " for reading.");
+  setvbuf(file_, NULL, _IONBF, 0);
+#if defined(__linux__)
+  posix_fadvise(fileno(file_), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  buffer_[0].resize(blockSize);
+  buffer_[1].resize(blockSize);
+  size_[0]    = 0;
+  size_[1]    = 0;
+  current_    = 0;
+  pos_        = 0;
+  failed_     = false;
+  compressed_ = compressed;
+  bytesRead_  = 0.0;
+  rawBytes_   = 0.0;
+  codecTime_  = 0.0;
+
+  worker_.start(readBlock, this);
+  startRead();
+}
+
+void
+SlabReader::close()
+{
+  if(pending_)
+    finishRead();
+  worker_.stop();
+  if(file_ != NULL) {
+    fclose(file_);
+    file_ = NULL;
+  }
+  buffer_[0].clear();
+  buffer_[1].clear();
+  code_.clear();
+  size_[0] = 0;
+  size_[1] = 0;
+  pos_     = 0;
+}
+
+void
+SlabReader::readAcrossBlocks(char * data, size_t nBytes)
+{
+  while(nBytes > 0) {
+    size_t n = size_[current_] - pos_;
+    if(n == 0) {
+      finishRead();
+      if(size_[current_] == 0)
+        throw NRLib::IOError("Failed to read " + fileName_ + ". The file is shorter than the grid.");
+      startRead();
+      continue;
+    }
+    if(n > nBytes)
+      n = nBytes;
+    memcpy(data, &buffer_[current_][pos_], n);
+    pos_   += n;
+    data   += n;
+    nBytes -= n;
+  }
+}
+
+void
+SlabReader::startRead()
+{
+  if(worker_.isRunning()) {
+    pending_ = true;
+    worker_.post();
+  }
+  else
+    readBlock(this);
+}
+
+void
+SlabReader::finishRead()
+{
+  if(pending_)
+    worker_.wait();
+  pending_ = false;
+  if(failed_)
+    throw NRLib::IOError("Failed to read " + fileName_ + ".");
+  current_ = 1 - current_;
+  pos_     = 0;
+}
+
+void *
+SlabReader::readBlock(void * reader)
+{
+  SlabReader * r = static_cast<SlabReader *>(reader);
+  int          b = 1 - r->current_;
+  if(r->compressed_) {
+    SlabCodec::Header header;
+    r->size_[b] = 0;
+    if(fread(&header, sizeof(header), 1, r->file_) != 1) {
+      if(ferror(r->file_) != 0)
+        r->failed_ = true;
+      return(NULL);
+    }
+    r->code_.resize(header.codeBytes + 1);
+    if(fread(&r->code_[0], 1, header.codeBytes, r->file_) != header.codeBytes) {
+      r->failed_ = true;
+      return(NULL);
+    }
+    if(r->buffer_[b].size() < header.nBytes)
+      r->buffer_[b].resize(header.nBytes);
+    double wall = 0.0;
+    double cpu  = 0.0;
+    TimeKit::getTime(wall,cpu);
+    if(SlabCodec::decode(header, &r->code_[0], &r->buffer_[b][0]) == false) {
+      r->failed_ = true;
+      return(NULL);
+    }
+    TimeKit::getTime(wall,cpu);
+    r->codecTime_ += wall;
+    r->size_[b]    = header.nBytes;
+    r->bytesRead_ += static_cast<double>(sizeof(header) + header.codeBytes);
+  }
+  else {
+    r->size_[b]    = fread(&r->buffer_[b][0], 1, r->buffer_[b].size(), r->file_);
+    if(r->size_[b] < r->buffer_[b].size() && ferror(r->file_) != 0)
+      r->failed_   = true;
+    r->bytesRead_ += static_cast<double>(r->size_[b]);
+  }
+  r->rawBytes_ += static_cast<double>(r->size_[b]);
+  return(NULL);
+}
+
+//------------------------------------------------------------------------------
+
+SlabWriter::SlabWriter()
+  : file_(NULL),
+    size_(0),
+    current_(0),
+    pos_(0),
+    pending_(false),
+    failed_(false),
+    compressed_(false),
+    mantissaBits_(SlabCodec::losslessBits_),
+    bytesWritten_(0.0),
+    rawBytes_(0.0),
+    codecTime_(0.0)
+{
+}
+
+SlabWriter::~SlabWriter()
+{
+  worker_.stop();
+  if(file_ != NULL)
+    fclose(file_);
+}
+
+void
+SlabWriter::open(const std::string & fileName, size_t blockSize, bool compressed, int mantissaBits)
+{
+  fileName_     = fileName;
+  file_         = fopen(fileName.c_str(), "wb");
+  if(file_ == NULL)
+    throw NRLib::IOError("Failed to open " + fileName + " for writing.");
+  setvbuf(file_, NULL, _IONBF, 0);
+
+  buffer_[0].resize(blockSize);
+  buffer_[1].resize(blockSize);
+  size_         = 0;
+  current_      = 0;
+  pos_          = 0;
+  failed_       = false;
+  compressed_   = compressed;
+  mantissaBits_ = mantissaBits;
+  bytesWritten_ = 0.0;
+  rawBytes_     = 0.0;
+  codecTime_    = 0.0;
+
+  worker_.start(writeBlock, this);
+}
+
+void
+SlabWriter::close()
+{
+  if(file_ == NULL)
+    return;
+  if(pos_ > 0)
+    startWrite();
+  finishWrite();
+  worker_.stop();
+
+  bool failed = (fclose(file_) != 0);
+  file_ = NULL;
+  buffer_[0].clear();
+  buffer_[1].clear();
+  code_.clear();
+  if(failed)
+    throw NRLib::IOError("Failed to write " + fileName_ + ". The disk may be full.");
+}
+
+void
+SlabWriter::writeAcrossBlocks(const char * data, size_t nBytes)
+{
+  while(nBytes > 0) {
+    size_t n = buffer_[current_].size() - pos_;
+    if(n == 0) {
+      startWrite();
+      continue;
+    }
+    if(n > nBytes)
+      n = nBytes;
+    memcpy(&buffer_[current_][pos_], data, n);
+    pos_   += n;
+    data   += n;
+    nBytes -= n;
+  }
+}
+
+void
+SlabWriter::startWrite()
+{
+  // The previous write must be done before its buffer can be filled again.
+  finishWrite();
+  size_    = pos_;
+  current_ = 1 - current_;
+  pos_     = 0;
+
+  if(worker_.isRunning()) {
+    pending_ = true;
+    worker_.post();
+  }
+  else
+    writeBlock(this);
+}
+
+void
+SlabWriter::finishWrite()
+{
+  if(pending_)
+    worker_.wait();
+  pending_ = false;
+  if(failed_)
+    throw NRLib::IOError("Failed to write " + fileName_ + ". The disk may be full.");
+}
+
+void *
+SlabWriter::writeBlock(void * writer)
+{
+  SlabWriter * w = static_cast<SlabWriter *>(writer);
+  int          b = 1 - w->current_;
+  if(w->compressed_) {
+    SlabCodec::Header header;
+    double wall = 0.0;
+    double cpu  = 0.0;
+    TimeKit::getTime(wall,cpu);
+    SlabCodec::encode(&w->buffer_[b][0], w->size_, w->mantissaBits_, header, w->code_);
+    TimeKit::getTime(wall,cpu);
+    w->codecTime_ += wall;
+    if(fwrite(&header, sizeof(header), 1, w->file_) != 1 ||
+       fwrite(&w->code_[0], 1, header.codeBytes, w->file_) != header.codeBytes)
+      w->failed_ = true;
+    else
+      w->bytesWritten_ += static_cast<double>(sizeof(header) + header.codeBytes);
+  }
+  else {
+    if(fwrite(&w->buffer_[b][0], 1, w->size_, w->file_) != w->size_)
+      w->failed_       = true;
+    else
+      w->bytesWritten_ += static_cast<double>(w->size_);
+  }
+  w->rawBytes_ += static_cast<double>(w->size_);
+  return(NULL);
+}
+
+//------------------------------------------------------------------------------
+
+SlabWorker::SlabWorker()
+  : task_(NULL),
+    arg_(NULL),
+    running_(false),
+    posted_(false),
+    stopping_(false)
+{
+#if !defined(_WIN32)
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&taskReady_, NULL);
+  pthread_cond_init(&taskDone_, NULL);
+#endif
+}
+
+SlabWorker::~SlabWorker()
+{
+  stop();
+#if !defined(_WIN32)
+  pthread_cond_destroy(&taskDone_);
+  pthread_cond_destroy(&taskReady_);
+  pthread_mutex_destroy(&mutex_);
+#endif
+}
+
+bool
+SlabWorker::start(void * (*task)(void *), void * arg)
+{
+  stop();
+  task_     = task;
+  arg_      = arg;
+  posted_   = false;
+  stopping_ = false;
+#if !defined(_WIN32)
+  running_  = (pthread_create(&thread_, NULL, work, this) == 0);
+#endif
+  return(running_);
+}
+
+void
+SlabWorker::stop()
+{
+  if(!running_)
+    return;
+#if !defined(_WIN32)
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_signal(&taskReady_);
+  pthread_mutex_unlock(&mutex_);
+  pthread_join(thread_, NULL);
+#endif
+  running_  = false;
+  stopping_ = false;
+}
+
+void
+SlabWorker::post()
+{
+#if !defined(_WIN32)
+  pthread_mutex_lock(&mutex_);
+  posted_ = true;
+  pthread_cond_signal(&taskReady_);
+  pthread_mutex_unlock(&mutex_);
+#endif
+}
+
+void
+SlabWorker::wait()
+{
+#if !defined(_WIN32)
+  pthread_mutex_lock(&mutex_);
+  while(posted_)
+    pthread_cond_wait(&taskDone_, &mutex_);
+  pthread_mutex_unlock(&mutex_);
+#endif
+}
+
+void *
+SlabWorker::work(void * worker)
+{
+#if !defined(_WIN32)
+  SlabWorker * w = static_cast<SlabWorker *>(worker);
+  pthread_mutex_lock(&w->mutex_);
+  for(;;) {
+    // A posted task is run before the thread ends, so stop never loses a block.
+    while(!w->posted_ && !w->stopping_)
+      pthread_cond_wait(&w->taskReady_, &w->mutex_);
+    if(!w->posted_)
+      break;
+    pthread_mutex_unlock(&w->mutex_);
+
+    w->task_(w->arg_);
+
+    pthread_mutex_lock(&w->mutex_);
+    w->posted_ = false;
+    pthread_cond_signal(&w->taskDone_);
+  }
+  pthread_mutex_unlock(&w->mutex_);
+#else
+  (void) worker;
+#endif
+  return(NULL);
+}
+
+//------------------------------------------------------------------------------
+
+unsigned int
+SlabCodec::roundMantissa(unsigned int value, int drop)
+{
+  // Round to nearest by adding half of the last kept bit. A carry into the exponent
+  // gives the correct rounded value, except for infinity and NaN which are left alone.
+  const unsigned int expMask = 0x7f800000u;
+  if((value & expMask) == expMask)
+    return(value);
+  unsigned int rounded = value + (1u << (drop - 1));
+  if((rounded & expMask) == expMask)
+    return(value);
+  return(rounded);
+}
+
+void
+SlabCodec::encode(const char         * data,
+                  size_t               nBytes,
+                  int                  mantissaBits,
+                  Header             & header,
+                  std::vector<char>  & code)
+{
+  size_t nValues = nBytes/sizeof(float);
+  size_t nTail   = nBytes - nValues*sizeof(float);
+  size_t nCounts = (nValues + 1)/2;
+  int    drop    = losslessBits_ - mantissaBits;
+
+  code.resize(nCounts + nValues*sizeof(float) + nTail + 1);
+  unsigned char * counts = reinterpret_cast<unsigned char *>(&code[0]);
+  unsigned char * out    = counts + nCounts;
+  memset(counts, 0, nCounts);
+
+  unsigned int prev = 0;
+  for(size_t i=0;i<nValues;i++) {
+    unsigned int value;
+    memcpy(&value, data + i*sizeof(float), sizeof(float));
+    if(drop > 0)
+      value = roundMantissa(value, drop) >> drop;
+    unsigned int diff = value ^ prev;
+    prev = value;
+    int n = 0;
+    while(diff != 0) {
+      *out++ = static_cast<unsigned char>(diff & 0xff);
+      diff >>= 8;
+      n++;
+    }
+    counts[i/2] |= static_cast<unsigned char>(n << (4*(i%2)));
+  }
+  memcpy(out, data + nValues*sizeof(float), nTail);
+  out += nTail;
+
+  header.nBytes       = static_cast<unsigned int>(nBytes);
+  header.codeBytes    = static_cast<unsigned int>(out - counts);
+  header.mantissaBits = mantissaBits;
+}
+
+bool
+SlabCodec::decode(const Header & header,
+                  const char   * code,
+                  char         * data)
+{
+  size_t nValues = header.nBytes/sizeof(float);
+  size_t nTail   = header.nBytes - nValues*sizeof(float);
+  size_t nCounts = (nValues + 1)/2;
+  int    drop    = losslessBits_ - header.mantissaBits;
+  if(drop < 0 || drop >= losslessBits_ || nCounts + nTail > header.codeBytes)
+    return(false);
+
+  const unsigned char * counts = reinterpret_cast<const unsigned char *>(code);
+  const unsigned char * in     = counts + nCounts;
+  const unsigned char * end    = counts + header.codeBytes - nTail;
+
+  unsigned int prev = 0;
+  for(size_t i=0;i<nValues;i++) {
+    int n = (counts[i/2] >> (4*(i%2))) & 0x0f;
+    if(n > 4 || in + n > end)
+      return(false);
+    unsigned int diff = 0;
+    for(int b=0;b<n;b++)
+      diff |= static_cast<unsigned int>(in[b]) << (8*b);
+    in  += n;
+    prev = diff ^ prev;
+    unsigned int value = prev << drop;
+    memcpy(data + i*sizeof(float), &value, sizeof(float));
+  }
+  if(in != end)
+    return(false);
+  memcpy(data + nValues*sizeof(float), in, nTail);
+  return(true);
+}
@@ -0,0 +1,187 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef SLABSTREAM_H
+#define SLABSTREAM_H
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+// Double-buffered sequential file access for the streaming modes of FFTFileGrid.
+// The file is read or written in blocks (typically one or more z-slabs). While the
+// caller works on one block, the next block is read, or the previous block is
+// written, by a background thread. Each open stream has one such thread, which waits
+// for the next block. Under Windows, or if the thread cannot be started when the
+// stream is opened, the blocks are read and written synchronously.
+//
+// Blocks may be compressed with SlabCodec. The compression and decompression is
+// then done by the background thread as well.
+
+// Block compression of float data. Each value is XOR-ed with the previous value in
+// the block, and only the nonzero low-order bytes of the result are stored, together
+// with a 4-bit byte count. Zero padding and smooth data give few significant bytes.
+// With less than 23 mantissa bits, values are first rounded to the given precision,
+// giving a relative error of at most 2^-(mantissaBits+1).
+class SlabCodec
+{
+public:
+  struct Header
+  {
+    unsigned int nBytes;         // Size of the uncompressed block
+    unsigned int codeBytes;      // Size of the compressed block, excluding this header
+    int          mantissaBits;
+  };
+
+  static const int losslessBits_ = 23;
+
+  static void      encode(const char * data, size_t nBytes, int mantissaBits,
+                          Header & header, std::vector<char> & code);
+  static bool      decode(const Header & header, const char * code, char * data);
+
+private:
+  static unsigned int roundMantissa(unsigned int value, int drop);
+};
+
+
+// The background thread of a SlabReader or SlabWriter. The thread runs task(arg) once
+// for each call to post, and wait returns when the last posted task is done.
+class SlabWorker
+{
+public:
+  SlabWorker();
+  ~SlabWorker();
+
+  bool             start(void * (*task)(void *), void * arg); // False if no thread was started
+  void             stop();            // Waits for the posted task and ends the thread
+  void             post();
+  void             wait();
+  bool             isRunning() const { return running_ ;}
+
+private:
+  SlabWorker(const SlabWorker &);
+  SlabWorker & operator=(const SlabWorker &);
+
+  static void    * work(void * worker);
+
+  void          * (*task_)(void *);
+  void           * arg_;
+  bool             running_;
+  bool             posted_;           // True from post until the task is done
+  bool             stopping_;
+#if !defined(_WIN32)
+  pthread_t        thread_;
+  pthread_mutex_t  mutex_;
+  pthread_cond_t   taskReady_;
+  pthread_cond_t   taskDone_;
+#endif
+};
+
+
+class SlabReader
+{
+public:
+  SlabReader();
+  ~SlabReader();
+
+  void             open(const std::string & fileName, size_t blockSize, bool compressed = false);
+  void             close();
+
+  // Copies the next nBytes of the file to data.
+  void             read(char * data, size_t nBytes) {
+                     if(pos_ + nBytes <= size_[current_]) {
+                       memcpy(data, &buffer_[current_][pos_], nBytes);
+                       pos_ += nBytes;
+                     }
+                     else
+                       readAcrossBlocks(data, nBytes);
+                   }
+
+  double           getBytesRead()  const { return bytesRead_  ;} // Bytes read from file
+  double           getRawBytes()   const { return rawBytes_   ;} // Bytes after decompression
+  double           getCodecTime()  const { return codecTime_  ;} // Wall time used in decompression
+
+private:
+  SlabReader(const SlabReader &);
+  SlabReader & operator=(const SlabReader &);
+
+  void             readAcrossBlocks(char * data, size_t nBytes);
+  void             startRead();       // Reads the next block into the idle buffer.
+  void             finishRead();      // Waits for startRead and makes that buffer current.
+
+  static void    * readBlock(void * reader);
+
+  std::string        fileName_;
+  FILE             * file_;
+  std::vector<char>  buffer_[2];
+  std::vector<char>  code_;           // Compressed block as read from file
+  size_t             size_[2];        // Number of valid bytes in each buffer
+  int                current_;        // Buffer handed out to the caller
+  size_t             pos_;            // Position in current buffer
+  bool               pending_;        // True while a read is in progress
+  bool               failed_;
+  bool               compressed_;
+  double             bytesRead_;
+  double             rawBytes_;
+  double             codecTime_;
+  SlabWorker         worker_;
+};
+
+class SlabWriter
+{
+public:
+  SlabWriter();
+  ~SlabWriter();
+
+  void             open(const std::string & fileName, size_t blockSize, bool compressed = false,
+                        int mantissaBits = SlabCodec::losslessBits_);
+  void             close();
+
+  // Appends nBytes from data to the file.
+  void             write(const char * data, size_t nBytes) {
+                     if(pos_ + nBytes <= buffer_[current_].size()) {
+                       memcpy(&buffer_[current_][pos_], data, nBytes);
+                       pos_ += nBytes;
+                     }
+                     else
+                       writeAcrossBlocks(data, nBytes);
+                   }
+
+  double           getBytesWritten() const { return bytesWritten_ ;} // Bytes written to file
+  double           getRawBytes()     const { return rawBytes_     ;} // Bytes before compression
+  double           getCodecTime()    const { return codecTime_    ;} // Wall time used in compression
+
+private:
+  SlabWriter(const SlabWriter &);
+  SlabWriter & operator=(const SlabWriter &);
+
+  void             writeAcrossBlocks(const char * data, size_t nBytes);
+  void             startWrite();      // Writes the current buffer, and hands out the other.
+  void             finishWrite();     // Waits for startWrite.
+
+  static void    * writeBlock(void * writer);
+
+  std::string        fileName_;
+  FILE             * file_;
+  std::vector<char>  buffer_[2];
+  std::vector<char>  code_;           // Compressed block to be written
+  size_t             size_;           // Number of bytes to write from the buffer being written
+  int                current_;        // Buffer being filled by the caller
+  size_t             pos_;            // Position in current buffer
+  bool               pending_;        // True while a write is in progress
+  bool               failed_;
+  bool               compressed_;
+  int                mantissaBits_;
+  double             bytesWritten_;
+  double             rawBytes_;
+  double             codecTime_;
+  SlabWorker         worker_;
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <time.h>
 #include <assert.h>
 #include <stdio.h>
+#include <algorithm>
 
 #include "lib/timekit.hpp"
 
@@ -135,6 +136,7 @@ void SpatialWellFilter::doFilteringSyntWells(std::vector<SyntWellData *>
 
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
+  Timings::Region region("Parameter filter");
 
   double ** sigmapost;
   double ** sigmapri;
@@ -307,21 +309,19 @@ void SpatialWellFilter::doFiltering(std::vector<WellData  *>        wells,
                                     int                             nAngles,
                                     const Crava                   * cravaResult,
                                     const std::vector<Grid2D *>   & noiseScale,
-                                    SeismicParametersHolder       & seismicParameters)
+                                    SeismicParametersHolder       & seismicParameters,
+                                    int                             nThreads)
 //-------------------------------------------------------------------------------
 {
   LogKit::WriteHeader("Creating spatial multi-parameter filter");
 
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
+  Timings::Region region("Parameter filter");
 
   std::vector<NRLib::Matrix> sigmaeVpRho;
 
-  double ** sigmapost;
-  double ** sigmapri;
-
   int lastn = 0;
-  int n = 0;
   int nDim = 1;
   for(int i=0;i<nAngles;i++)
     nDim *= 2;
@@ -339,118 +339,92 @@ void SpatialWellFilter::doFiltering(std::vector<WellData  *>        wells,
 
   NRLib::Matrix priorCov0 = cravaResult->getPriorVar0();
 
-  bool no_wells_filtered = true;
-
-  for(int w1=0 ; w1 < nWells ; w1++)
-  {
-    n = wells[w1]->getBlockedLogsOrigThick()->getNumberOfBlocks();
-
-    if (wells[w1]->getUseForFiltering() == true)
-    {
+  std::vector<int> filterWells;
+  for(int w1=0 ; w1 < nWells ; w1++) {
+    if (wells[w1]->getUseForFiltering() == true) {
       LogKit::LogFormatted(LogKit::Low,"\nFiltering well "+wells[w1]->getWellname());
-      no_wells_filtered = false;
-
-      sigmapost = new double * [3*n];
-      for(int i=0;i<3*n;i++)
-        sigmapost[i] = new double[3*n];
-
-      sigmapri = new double * [3*n];
-      for(int i=0;i<3*n;i++)
-        sigmapri[i] = new double[3*n];
-
-      const int *ipos = wells[w1]->getBlockedLogsOrigThick()->getIpos();
-      const int *jpos = wells[w1]->getBlockedLogsOrigThick()->getJpos();
-      const int *kpos = wells[w1]->getBlockedLogsOrigThick()->getKpos();
-
-      float regularization = Definitions::SpatialFilterRegularisationValue();
-
-      fillValuesInSigmapost(sigmapost, ipos, jpos, kpos, seismicParameters.GetCovAlpha()      , n, 0  , 0   );
-      fillValuesInSigmapost(sigmapost, ipos, jpos, kpos, seismicParameters.GetCovBeta()       , n, n  , n   );
-      fillValuesInSigmapost(sigmapost, ipos, jpos, kpos, seismicParameters.GetCovRho()        , n, 2*n, 2*n );
-      fillValuesInSigmapost(sigmapost, ipos, jpos, kpos, seismicParameters.GetCrCovAlphaBeta(), n, 0  , n   );
-      fillValuesInSigmapost(sigmapost, ipos, jpos, kpos, seismicParameters.GetCrCovAlphaRho() , n, 0  , 2*n );
-      fillValuesInSigmapost(sigmapost, ipos, jpos, kpos, seismicParameters.GetCrCovBetaRho()  , n, 2*n, n   );
-
-      for(int l1=0 ; l1 < n ; l1++) {
-        for(int l2=0 ; l2 < n ; l2++) {
-          sigmapost[l2 + n  ][l1      ] = sigmapost[l1      ][l2 + n  ];
-          sigmapost[l2 + 2*n][l1      ] = sigmapost[l1      ][l2 + 2*n];
-          sigmapost[l2 + n  ][l1 + 2*n] = sigmapost[l1 + 2*n][l2 + n  ];
-          sigmapri [l1      ][l2      ] = priorCov0(0,0)*priorSpatialCorr_[w1][l1][l2];
-          sigmapri [l1 + n  ][l2 + n  ] = priorCov0(1,1)*priorSpatialCorr_[w1][l1][l2];
-          sigmapri [l1 + 2*n][l2 + 2*n] = priorCov0(2,2)*priorSpatialCorr_[w1][l1][l2];
-          if(l1==l2)
-          {
-            sigmapost[l1      ][l2      ] += regularization*sigmapost[l1      ][l2      ]/sigmapri[l1      ][l2      ];
-            sigmapost[l1 + n  ][l2 + n  ] += regularization*sigmapost[l1 + n  ][l2 + n  ]/sigmapri[l1 + n  ][l2 + n  ];
-            sigmapost[l1 + 2*n][l2 + 2*n] += regularization*sigmapost[l1 + 2*n][l2 + 2*n]/sigmapri[l1 + 2*n][l2 + 2*n];
-            sigmapri [l1      ][l2      ] += regularization;
-            sigmapri [l1 + n  ][l2 + n  ] += regularization;
-            sigmapri [l1 + 2*n][l2 + 2*n] += regularization;
-          }
-          sigmapri[l1 + n  ][l2      ] = priorCov0(1,0)*priorSpatialCorr_[w1][l1][l2];
-          sigmapri[l2      ][l1 + n  ] = priorCov0(1,0)*priorSpatialCorr_[w1][l1][l2];
-          sigmapri[l1 + 2*n][l2      ] = priorCov0(2,0)*priorSpatialCorr_[w1][l1][l2];
-          sigmapri[l2      ][l1 + 2*n] = priorCov0(2,0)*priorSpatialCorr_[w1][l1][l2];
-          sigmapri[l1 + n  ][l2 + 2*n] = priorCov0(2,1)*priorSpatialCorr_[w1][l1][l2];
-          sigmapri[l2 + 2*n][l1 + n  ] = priorCov0(2,1)*priorSpatialCorr_[w1][l1][l2];
-        }
-      }
+      filterWells.push_back(w1);
+    }
+  }
+  int  nFiltered         = static_cast<int>(filterWells.size());
+  bool no_wells_filtered = (nFiltered == 0);
+
+  FFTGrid * covGrids[6] = {seismicParameters.GetCovAlpha(),
+                           seismicParameters.GetCovBeta(),
+                           seismicParameters.GetCovRho(),
+                           seismicParameters.GetCrCovAlphaBeta(),
+                           seismicParameters.GetCrCovAlphaRho(),
+                           seismicParameters.GetCrCovBetaRho()};
+  const int firstRow[6] = {0, 1, 2, 0, 0, 2};
+  const int firstCol[6] = {0, 1, 2, 1, 2, 1};
+
+  std::vector<NRLib::Matrix> sigmaeW(nFiltered);      // Contribution to sigmae_ from each well
+  std::vector<NRLib::Matrix> sigmaeVpRhoW(nFiltered);
+  std::string                errTxt = "";
 
-      NRLib::SymmetricMatrix Sprior(3*n);
-      NRLib::SymmetricMatrix Spost(3*n);
+  //
+  // The wells are filtered nThreads at a time. The posterior covariances of a group of wells
+  // are read from one covariance grid at a time, so that a grid held on disk is loaded once
+  // per group rather than once per well.
+  //
+  for(int first=0 ; first < nFiltered ; first += nThreads) {
+    int nGroup = std::min(nThreads, nFiltered - first);
 
-      for(int i = 0 ; i < 3*n ; i++)
-        for(int j = 0 ; j <= i ; j++)
-          Sprior(j,i) = sigmapri[j][i];
+    std::vector<NRLib::Matrix> sigmapost(nGroup);
+    for(int g=0 ; g < nGroup ; g++) {
+      int n = wells[filterWells[first + g]]->getBlockedLogsOrigThick()->getNumberOfBlocks();
+      sigmapost[g].resize(3*n, 3*n);
+    }
 
-      for(int i = 0 ; i < 3*n ; i++)
-        for(int j = 0 ; j <= i ; j++)
-          Spost(j,i) = sigmapost[j][i];
-
-      if(useVpRhoFilter == true) //Only additional
-        doVpRhoFiltering(sigmaeVpRho,
-                         sigmapri,
-                         sigmapost,
-                         n,
-                         wells[w1]->getBlockedLogsOrigThick()); //Must do before Cholesky of sigmapri.
-
-
-      //
-      // Filter = I - Sigma_post * inv(Sigma_prior)
-      //
-      NRLib::Matrix Aw;
-      NRLib::Matrix I = NRLib::IdentityMatrix(3*n);
-      NRLib::CholeskySolve(Sprior, I);
-
-      Aw = Spost * I;
-      Aw = Aw * (-1);
-      for(int i=0 ; i<3*n ; i++) {
-        Aw(i,i) += 1.0;
+    for(int c=0 ; c < 6 ; c++) {
+      covGrids[c]->setAccessMode(FFTGrid::RANDOMACCESS);
+#pragma omp parallel for num_threads(nThreads) schedule(dynamic, 1)
+      for(int g=0 ; g < nGroup ; g++) {
+        BlockedLogs * blockedLogs = wells[filterWells[first + g]]->getBlockedLogsOrigThick();
+        int n = blockedLogs->getNumberOfBlocks();
+        fillValuesInSigmapost(sigmapost[g],
+                              blockedLogs->getIpos(),
+                              blockedLogs->getJpos(),
+                              blockedLogs->getKpos(),
+                              covGrids[c],
+                              n,
+                              firstRow[c]*n,
+                              firstCol[c]*n);
       }
+      covGrids[c]->endAccess();
+    }
 
-      if(useVpRhoFilter == false) { //Save time, since below is not needed then.
-        updateSigmaE(sigmae_[0],
-                     Aw,
-                     Spost,
-                     n);
+#pragma omp parallel for num_threads(nThreads) schedule(dynamic, 1)
+    for(int g=0 ; g < nGroup ; g++) {
+      int w1 = filterWells[first + g];
+      try {
+        filterWell(sigmapost[g],
+                   priorSpatialCorr_[w1],
+                   priorCov0,
+                   useVpRhoFilter,
+                   wells[w1]->getBlockedLogsOrigThick(),
+                   sigmaeW[first + g],
+                   sigmaeVpRhoW[first + g]);
       }
-
-      calculateFilteredLogs(Aw,
-                            wells[w1]->getBlockedLogsOrigThick(),
-                            n,
-                            true);
-
-      lastn += n;
-
-      for(int i=0;i<3*n;i++)
-      {
-        delete [] sigmapost[i];
-        delete [] sigmapri[i];
+      catch (NRLib::Exception & e) {
+#pragma omp critical(spatialwellfilter_error)
+        errTxt += "Filtering of well " + wells[w1]->getWellname() + " failed: " + e.what() + "\n";
       }
-      delete [] sigmapri;
-      delete [] sigmapost;
     }
+    if (errTxt != "")
+      throw NRLib::Exception(errTxt);
+  }
+
+  for(int w=0 ; w < nFiltered ; w++) {
+    if(useVpRhoFilter == false)
+      updateSigmaE(sigmae_[0],
+                   sigmaeW[w]);
+    else
+      updateSigmaEVpRho(sigmaeVpRho,
+                        sigmaeVpRhoW[w],
+                        static_cast<int>(sigmae_.size()));
+
+    lastn += wells[filterWells[w]]->getBlockedLogsOrigThick()->getNumberOfBlocks();
   }
 
   if(no_wells_filtered == false)
@@ -472,6 +446,191 @@ void SpatialWellFilter::doFiltering(std::vector<WellData  *>        wells,
   Timings::setTimeFiltering(wall,cpu);
 }
 
+//--------------------------------------------------------------------------------
+void SpatialWellFilter::filterWell(NRLib::Matrix        &  sigmapost,
+                                   double              ** priorSpatialCorr,
+                                   const NRLib::Matrix  & priorCov0,
+                                   bool                   useVpRhoFilter,
+                                   BlockedLogs          * blockedLogs,
+                                   NRLib::Matrix        & sigmaeW,
+                                   NRLib::Matrix        & sigmaeVpRhoW)
+//--------------------------------------------------------------------------------
+{
+  int n = blockedLogs->getNumberOfBlocks();
+
+  float regularization = Definitions::SpatialFilterRegularisationValue();
+
+  for(int l1=0 ; l1 < n ; l1++) {
+    for(int l2=0 ; l2 < n ; l2++)
+      sigmapost(l2 + n, l1 + 2*n) = sigmapost(l1 + 2*n, l2 + n);
+    for(int a=0 ; a < 3 ; a++) {
+      int l = l1 + a*n;
+      sigmapost(l, l) += regularization*sigmapost(l, l)/(priorCov0(a,a)*priorSpatialCorr[l1][l1]);
+    }
+  }
+
+  NRLib::SymmetricMatrix corr(n);
+  for(int j=0 ; j < n ; j++)
+    for(int i=0 ; i <= j ; i++)
+      corr(i,j) = priorSpatialCorr[i][j];
+
+  NRLib::Vector lambda(n);
+  NRLib::Matrix U;
+  NRLib::ComputeEigenVectorsSymmetric(corr, lambda, U);
+
+  if(useVpRhoFilter == true) { //Only additional
+    std::vector<int> par(2);
+    par[0] = 0;
+    par[1] = 2;
+
+    NRLib::Vector residuals(2*n);
+    NRLib::Vector filteredVal(2*n);
+    makeResiduals(blockedLogs, n, false, residuals);
+    applyKroneckerFilter(sigmapost, U, lambda, priorCov0, par, residuals, filteredVal, sigmaeVpRhoW);
+    setFilteredLogs(filteredVal, blockedLogs, n, false);
+  }
+
+  std::vector<int> par(3);
+  par[0] = 0;
+  par[1] = 1;
+  par[2] = 2;
+
+  NRLib::Vector residuals(3*n);
+  NRLib::Vector filteredVal(3*n);
+  makeResiduals(blockedLogs, n, true, residuals);
+  applyKroneckerFilter(sigmapost, U, lambda, priorCov0, par, residuals, filteredVal, sigmaeW);
+  setFilteredLogs(filteredVal, blockedLogs, n, true);
+}
+
+//--------------------------------------------------------------------------------
+void SpatialWellFilter::applyKroneckerFilter(const NRLib::Matrix    & sigmapost,
+                                             const NRLib::Matrix    & U,
+                                             const NRLib::Vector    & lambda,
+                                             const NRLib::Matrix    & priorCov0,
+                                             const std::vector<int> & par,
+                                             const NRLib::Vector    & residuals,
+                                             NRLib::Vector          & filteredVal,
+                                             NRLib::Matrix          & sigmaeW)
+//--------------------------------------------------------------------------------
+{
+  //
+  // Filter = I - Sigma_post * inv(Sigma_prior)
+  //
+  // The prior covariance of the m parameters in par is priorCov0 x R + reg*I, where R is the
+  // spatial correlation of the well. With R = U*diag(lambda)*U^T this is block diagonal in the
+  // eigenvector basis of R, with one m x m block lambda(i)*priorCov0 + reg*I per eigenvalue:
+  //
+  //   inv(Sigma_prior) = (I x U) * diag(B_i) * (I x U)^T ,  B_i = inv(lambda(i)*priorCov0 + reg*I)
+  //
+  // With W = Sigma_post * (I x U) we then have
+  //
+  //   Filter * r         = r - W * diag(B_i) * (I x U)^T * r
+  //   Filter * Sigma_post = Sigma_post - W * diag(B_i) * W^T
+  //
+  // of which only the diagonal of each m x m block of n x n matrices is needed for sigmae.
+  //
+  int   n  = lambda.length();
+  int   m  = static_cast<int>(par.size());
+  int   mn = m*n;
+  float regularization = Definitions::SpatialFilterRegularisationValue();
+
+  std::vector<double> B(n*m*m);        // B[(i*m + a)*m + b] = B_i(a,b)
+  NRLib::SymmetricMatrix Bi(m);
+  for(int i=0 ; i < n ; i++) {
+    for(int b=0 ; b < m ; b++) {
+      for(int a=0 ; a <= b ; a++) {
+        Bi(a,b) = lambda(i)*priorCov0(par[b],par[a]);
+        if(a == b)
+          Bi(a,b) += regularization;
+      }
+    }
+    NRLib::CholeskyInvert(Bi);
+    for(int b=0 ; b < m ; b++) {
+      for(int a=0 ; a <= b ; a++) {
+        B[(i*m + a)*m + b] = Bi(a,b);
+        B[(i*m + b)*m + a] = Bi(a,b);
+      }
+    }
+  }
+
+  // Posterior covariance of the parameters in par, taken from the upper triangle of sigmapost
+  NRLib::Matrix S(mn, mn);
+  for(int b=0 ; b < m ; b++) {
+    for(int a=0 ; a < m ; a++) {
+      for(int l2=0 ; l2 < n ; l2++) {
+        int q = par[b]*n + l2;
+        for(int l1=0 ; l1 < n ; l1++) {
+          int p = par[a]*n + l1;
+          S(a*n + l1, b*n + l2) = (p <= q ? sigmapost(p, q) : sigmapost(q, p));
+        }
+      }
+    }
+  }
+
+  NRLib::Matrix W(mn, mn);
+  NRLib::Matrix Sb(mn, n);
+  for(int b=0 ; b < m ; b++) {
+    for(int l=0 ; l < n ; l++)
+      for(int p=0 ; p < mn ; p++)
+        Sb(p, l) = S(p, b*n + l);
+    NRLib::Matrix Wb = Sb * U;
+    for(int l=0 ; l < n ; l++)
+      for(int p=0 ; p < mn ; p++)
+        W(p, b*n + l) = Wb(p, l);
+  }
+
+  NRLib::Vector y(mn);
+  for(int a=0 ; a < m ; a++) {
+    for(int i=0 ; i < n ; i++) {
+      double sum = 0.0;
+      for(int l=0 ; l < n ; l++)
+        sum += U(l, i)*residuals(a*n + l);
+      y(a*n + i) = sum;
+    }
+  }
+
+  NRLib::Vector z(mn);
+  for(int i=0 ; i < n ; i++) {
+    for(int a=0 ; a < m ; a++) {
+      double sum = 0.0;
+      for(int b=0 ; b < m ; b++)
+        sum += B[(i*m + a)*m + b]*y(b*n + i);
+      z(a*n + i) = sum;
+    }
+  }
+
+  NRLib::Vector Wz = W * z;
+  for(int p=0 ; p < mn ; p++)
+    filteredVal(p) = residuals(p) - Wz(p);
+
+  NRLib::Matrix V(mn, mn);             // V = W * diag(B_i)
+  for(int i=0 ; i < n ; i++) {
+    for(int a=0 ; a < m ; a++) {
+      for(int p=0 ; p < mn ; p++) {
+        double sum = 0.0;
+        for(int b=0 ; b < m ; b++)
+          sum += W(p, b*n + i)*B[(i*m + b)*m + a];
+        V(p, a*n + i) = sum;
+      }
+    }
+  }
+
+  sigmaeW.resize(m, m);
+  NRLib::InitializeMatrix(sigmaeW, 0.0);
+  for(int a=0 ; a < m ; a++) {
+    for(int b=0 ; b <= a ; b++) {
+      for(int i=0 ; i < n ; i++) {
+        int p = a*n + i;
+        int q = b*n + i;
+        double sum = 0.0;
+        for(int k=0 ; k < mn ; k++)
+          sum += V(p, k)*W(q, k);
+        sigmaeW(a,b) += S(p, q) - sum;
+      }
+    }
+  }
+}
+
 
 void
 SpatialWellFilter::fillValuesInSigmapostSyntWell(double **sigmapost, const int *ipos, const int *jpos, const int *kpos, FFTGrid *covgrid, int n, int ni, int nj)
@@ -510,28 +669,27 @@ SpatialWellFilter::fillValuesInSigmapostSyntWell(double **sigmapost, const int *
 }
 
 void
-SpatialWellFilter::fillValuesInSigmapost(double    ** sigmapost,
-                                         const int *  ipos,
-                                         const int *  jpos,
-                                         const int *  kpos,
-                                         FFTGrid   *  covgrid,
-                                         int          n,
-                                         int          ni,
-                                         int          nj)
+SpatialWellFilter::fillValuesInSigmapost(NRLib::Matrix & sigmapost,
+                                         const int     * ipos,
+                                         const int     * jpos,
+                                         const int     * kpos,
+                                         FFTGrid       * covgrid,
+                                         int             n,
+                                         int             ni,
+                                         int             nj)
 {
-  covgrid->setAccessMode(FFTGrid::RANDOMACCESS);
-  for (int l1=0 ; l1<n ; l1++) {
-    int i1 = ipos[l1];
-    int j1 = jpos[l1];
-    int k1 = kpos[l1];
-    for (int l2=0 ; l2<n ; l2++) {
-      int i2 = ipos[l2];
-      int j2 = jpos[l2];
-      int k2 = kpos[l2];
-      sigmapost[l1+ni][l2+nj] = covgrid->getRealValueCyclic(i1-i2, j1-j2, k1-k2);
+  // The covariance grid must be in RANDOMACCESS mode.
+  for (int l2=0 ; l2<n ; l2++) {
+    int i2 = ipos[l2];
+    int j2 = jpos[l2];
+    int k2 = kpos[l2];
+    for (int l1=0 ; l1<n ; l1++) {
+      int i1 = ipos[l1];
+      int j1 = jpos[l1];
+      int k1 = kpos[l1];
+      sigmapost(l1+ni, l2+nj) = covgrid->getRealValueCyclic(i1-i2, j1-j2, k1-k2);
     }
   }
-  covgrid->endAccess();
 }
 
 void
@@ -564,22 +722,15 @@ SpatialWellFilter::updateSigmaeSynt(double ** filter, double ** postCov,  int n)
 }
 //------------------------------------------------------------------
 void SpatialWellFilter::updateSigmaE(NRLib::Matrix       & sigmae,
-                                     const NRLib::Matrix & Filter,
-                                     const NRLib::Matrix & PostCov,
-                                     int                   n)
+                                     const NRLib::Matrix & sigmaeW)
 //------------------------------------------------------------------
 {
-  NRLib::Matrix sigmaeW = Filter * PostCov;
-
-  for(int i=0 ; i < n ; i++)
-  {
-    sigmae(0,0) += sigmaeW(i      , i      );
-    sigmae(1,0) += sigmaeW(i +   n, i      );
-    sigmae(2,0) += sigmaeW(i + 2*n, i      );
-    sigmae(1,1) += sigmaeW(i +   n, i +   n);
-    sigmae(2,1) += sigmaeW(i + 2*n, i +   n);
-    sigmae(2,2) += sigmaeW(i + 2*n, i + 2*n);
-  }
+  sigmae(0,0) += sigmaeW(0,0);
+  sigmae(1,0) += sigmaeW(1,0);
+  sigmae(2,0) += sigmaeW(2,0);
+  sigmae(1,1) += sigmaeW(1,1);
+  sigmae(2,1) += sigmaeW(2,1);
+  sigmae(2,2) += sigmaeW(2,2);
   // sigmae Is normalized (1/n) in completeSigmaE, Here well by well is added.
 }
 
@@ -741,68 +892,10 @@ SpatialWellFilter::computeSigmaEAdjusted(NRLib::Matrix & sigmae,
   sigmaEAdj = T1 * T2;                             // sigmaEAdj = sqrt(sigmaETmp*sigmaE0^-1)*sigmae*sqrt(sigmaE0^-1*sigmaETmp)
 }
 
-//---------------------------------------------------------------------------------
-void SpatialWellFilter::doVpRhoFiltering(std::vector<NRLib::Matrix> &  sigmaeVpRho,
-                                         double                     ** sigmapri,
-                                         double                     ** sigmapost,
-                                         const int                     n,
-                                         BlockedLogs                *  blockedLogs)
-//---------------------------------------------------------------------------------
-{
-  int m = 2*n;
-
-  NRLib::Matrix tmp1(m,m);
-  NRLib::Matrix tmp2(m,m);
-
-  for (int j=0 ; j<n ; j++) {
-    for (int i=0 ; i<n ; i++) {
-      tmp1(i,   j  ) = sigmapri [i  ][j  ];
-      tmp1(i+n, j  ) = sigmapri [i+m][j  ];
-      tmp1(i  , j+n) = sigmapri [i  ][j+m];
-      tmp1(i+n, j+n) = sigmapri [i+m][j+m];
-
-      tmp2(i,   j  ) = sigmapost[i  ][j  ];
-      tmp2(i+n, j  ) = sigmapost[i+m][j  ];
-      tmp2(i,   j+n) = sigmapost[i  ][j+m];
-      tmp2(i+n, j+n) = sigmapost[i+m][j+m];
-    }
-  }
-
-  NRLib::SymmetricMatrix Sprior2(m);
-  NRLib::SymmetricMatrix Spost2(m);
-
-  for(int j = 0 ; j < m ; j++)
-    for(int i = 0 ; i <= j ; i++)
-      Sprior2(i,j) = tmp1(i,j);
-
-  for(int j = 0 ; j < m ; j++)
-    for(int i = 0 ; i <= j ; i++)
-      Spost2(i,j) = tmp2(i,j);
-
-  NRLib::Matrix Aw;
-  NRLib::Matrix I = NRLib::IdentityMatrix(m);
-  NRLib::CholeskySolve(Sprior2, I);
-  Aw = Spost2 * I;
-  Aw = Aw * (-1);
-  for(int i=0 ; i<m ; i++) {
-    Aw(i,i) += 1.0;
-  }
-
-  calculateFilteredLogs(Aw, blockedLogs, n, false);
-
-  updateSigmaEVpRho(sigmaeVpRho,
-                    Aw,
-                    Spost2,
-                    static_cast<int>(sigmae_.size()),
-                    n);
-}
-
 //---------------------------------------------------------------------------------
 void SpatialWellFilter::updateSigmaEVpRho(std::vector<NRLib::Matrix> & sigmaeVpRho,
-                                          const NRLib::Matrix        & Aw,
-                                          const NRLib::Matrix        & Spost,
-                                          int                          nDim,
-                                          int                          n)
+                                          const NRLib::Matrix        & sigmaeW,
+                                          int                          nDim)
 //---------------------------------------------------------------------------------
 {
   if (sigmaeVpRho.size() == 0) { // then first time alocate memory
@@ -816,17 +909,13 @@ void SpatialWellFilter::updateSigmaEVpRho(std::vector<NRLib::Matrix> & sigmaeVpR
     }
   }
 
-  NRLib::Matrix sigma = Aw * Spost;
-
   //
   // NBNB-PAL: Bug? frsteindeksen p sigmaeVpRho[0][0][0] str
   // stille hele tiden. Det er ingen n-avhengighet.
   //
-  for(int i=0 ; i < n ; i++) {
-    sigmaeVpRho[0](0,0) += sigma(i    , i    );
-    sigmaeVpRho[0](1,0) += sigma(i + n, i    );
-    sigmaeVpRho[0](1,1) += sigma(i + n, i + n);
-  }
+  sigmaeVpRho[0](0,0) += sigmaeW(0,0);
+  sigmaeVpRho[0](1,0) += sigmaeW(1,0);
+  sigmaeVpRho[0](1,1) += sigmaeW(1,1);
 }
 
 //------------------------------------------------------------------------------------
@@ -925,18 +1014,12 @@ void SpatialWellFilter::completeSigmaEVpRho(std::vector<NRLib::Matrix>  & sigmae
 }
 
 //------------------------------------------------------------------------------
-void SpatialWellFilter::calculateFilteredLogs(const NRLib::Matrix & Aw,
-                                              BlockedLogs         * blockedlogs,
-                                              int                   n,
-                                              bool                  useVs)
+void SpatialWellFilter::makeResiduals(BlockedLogs   * blockedlogs,
+                                      int             n,
+                                      bool            useVs,
+                                      NRLib::Vector & residuals)
 //------------------------------------------------------------------------------
 {
-  int nLogs = 2;
-  if(useVs == true)
-    nLogs++;
-
-  NRLib::Vector residuals(nLogs*n);
-
   int currentEnd = 0;
   const float * alpha   = blockedlogs->getAlpha();
   const float * bgAlpha = blockedlogs->getAlphaHighCutBackground();
@@ -952,8 +1035,21 @@ void SpatialWellFilter::calculateFilteredLogs(const NRLib::Matrix & Aw,
   const float * rho     = blockedlogs->getRho();
   const float * bgRho   = blockedlogs->getRhoHighCutBackground();
   MakeInterpolatedResiduals(rho, bgRho, n, currentEnd, residuals);
+}
 
-  NRLib::Vector filteredVal = Aw * residuals;
+//------------------------------------------------------------------------------
+void SpatialWellFilter::setFilteredLogs(const NRLib::Vector & filteredVal,
+                                        BlockedLogs         * blockedlogs,
+                                        int                   n,
+                                        bool                  useVs)
+//------------------------------------------------------------------------------
+{
+  const float * alpha   = blockedlogs->getAlpha();
+  const float * bgAlpha = blockedlogs->getAlphaHighCutBackground();
+  const float * beta    = blockedlogs->getBeta();
+  const float * bgBeta  = blockedlogs->getBetaHighCutBackground();
+  const float * rho     = blockedlogs->getRho();
+  const float * bgRho   = blockedlogs->getRhoHighCutBackground();
 
   float * alphaFiltered = new float[n];
   float * betaFiltered  = new float[n];
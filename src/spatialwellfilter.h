@@ -35,7 +35,8 @@ public:
                                        int                             nAngles,
                                        const Crava                   * cravaResult,
                                        const std::vector<Grid2D *>   & noiseScale,
-                                       SeismicParametersHolder       & seismicParameters);
+                                       SeismicParametersHolder       & seismicParameters,
+                                       int                             nThreads = 1);
 
   void                     doFilteringSyntWells(std::vector<SyntWellData *>              & syntWellData,
                                                 const std::vector<std::vector<double> >  & v,
@@ -56,16 +57,25 @@ public:
 
 private:
 
-  void doVpRhoFiltering(std::vector<NRLib::Matrix> &  sigmaeVpRho,
-                        double                     ** sigmapri,
-                        double                     ** sigmapost,
-                        const int                     n,
-                        BlockedLogs                 * blockedLogs);
+  void filterWell(NRLib::Matrix        &  sigmapost,
+                  double              ** priorSpatialCorr,
+                  const NRLib::Matrix  & priorCov0,
+                  bool                   useVpRhoFilter,
+                  BlockedLogs          * blockedLogs,
+                  NRLib::Matrix        & sigmaeW,
+                  NRLib::Matrix        & sigmaeVpRhoW);
+
+  void applyKroneckerFilter(const NRLib::Matrix    & sigmapost,
+                            const NRLib::Matrix    & U,
+                            const NRLib::Vector    & lambda,
+                            const NRLib::Matrix    & priorCov0,
+                            const std::vector<int> & par,
+                            const NRLib::Vector    & residuals,
+                            NRLib::Vector          & filteredVal,
+                            NRLib::Matrix          & sigmaeW);
 
   void updateSigmaE(NRLib::Matrix       & sigmae,
-                    const NRLib::Matrix & filter,
-                    const NRLib::Matrix & Spost,
-                    int                   n);
+                    const NRLib::Matrix & sigmaeW);
 
   void updateSigmaeSynt(double ** filter, double ** postCov,  int n);
 
@@ -75,10 +85,8 @@ private:
                       const std::vector<Grid2D *> & noiseScale);
 
   void updateSigmaEVpRho(std::vector<NRLib::Matrix> & sigmaeVpRho,
-                         const NRLib::Matrix        & Aw,
-                         const NRLib::Matrix        & Spost,
-                         int                          nDim,
-                         int                          n);
+                         const NRLib::Matrix        & sigmaeW,
+                         int                          nDim);
 
   void completeSigmaEVpRho(std::vector<NRLib::Matrix>  & sigmaeVpRho,
                            int                           lastn,
@@ -101,10 +109,15 @@ private:
 
   void adjustDiagSigma(NRLib::Matrix & sigmae);
 
-  void calculateFilteredLogs(const NRLib::Matrix & Aw,
-                             BlockedLogs         * blockedlogs,
-                             int                   n,
-                             bool                  useVs);
+  void makeResiduals(BlockedLogs   * blockedlogs,
+                     int             n,
+                     bool            useVs,
+                     NRLib::Vector & residuals);
+
+  void setFilteredLogs(const NRLib::Vector & filteredVal,
+                       BlockedLogs         * blockedlogs,
+                       int                   n,
+                       bool                  useVs);
 
   void MakeInterpolatedResiduals(const float   * bwLog,
                                  const float   * bwLogBG,
@@ -112,14 +125,14 @@ private:
                                  const int       offset,
                                  NRLib::Vector & residuals);
 
-  void fillValuesInSigmapost(double    ** sigmapost,
-                             const int *  ipos,
-                             const int *  jpos,
-                             const int *  kpos,
-                             FFTGrid   *  covgrid,
-                             int          n,
-                             int          ni,
-                             int          nj);
+  void fillValuesInSigmapost(NRLib::Matrix & sigmapost,
+                             const int     * ipos,
+                             const int     * jpos,
+                             const int     * kpos,
+                             FFTGrid       * covgrid,
+                             int             n,
+                             int             ni,
+                             int             nj);
 
   std::vector<NRLib::Matrix> sigmae_;
   std::vector<double **> sigmaeSynt_;
@@ -3,9 +3,13 @@
 ***************************************************************************/
 
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <time.h>
+#include <omp.h>
 
+#include "nrlib/iotools/fileio.hpp"
 #include "nrlib/iotools/stringtools.hpp"
 #include "nrlib/iotools/logkit.hpp"
 
@@ -13,6 +17,9 @@
 
 #include "src/definitions.h"
 #include "src/timings.h"
+#include "src/fftgrid.h"
+#include "src/fftfilegrid.h"
+#include "src/io.h"
 
 void
 Timings::reportAll(LogKit::MessageLevels logLevel)
@@ -50,6 +57,183 @@ Timings::reportAll(LogKit::MessageLevels logLevel)
   reportOne("Miscellaneous            ", c_rest_             , w_rest_             , c_total_, w_total_,logLevel);
   LogKit::LogFormatted(logLevel,  "---------------------------------------------------------------------\n");
   reportOne("Total                    ", c_total_            , w_total_            , c_total_, w_total_,logLevel);
+
+  if (fft_plan_hits_ + fft_plan_misses_ > 0)
+    LogKit::LogFormatted(logLevel,"\nFFT plans created: %d    FFT plans reused: %d\n", fft_plan_misses_, fft_plan_hits_);
+
+  if (fft_forward_ + fft_inverse_ > 0)
+    LogKit::LogFormatted(logLevel,"\nGrid transforms: %d forward, %d inverse\n", fft_forward_, fft_inverse_);
+
+  if (max_grids_ > 0)
+    LogKit::LogFormatted(logLevel,"\nMaximum number of grids allocated: %d (%.1f MB)\n", max_grids_, max_grid_bytes_/(1024.0*1024.0));
+
+  if (tmp_grid_bytes_read_ + tmp_grid_bytes_written_ > 0.0)
+    LogKit::LogFormatted(logLevel,"\nIntermediate disk storage: %.1f MB read, %.1f MB written, %.2f s wall time in grid load/save\n",
+                         tmp_grid_bytes_read_/(1024.0*1024.0), tmp_grid_bytes_written_/(1024.0*1024.0), w_tmp_grid_io_);
+
+  if (tmp_grid_stored_bytes_ > 0.0) {
+    LogKit::LogFormatted(logLevel,"Intermediate disk storage compression: %.1f MB stored as %.1f MB, ratio %.2f",
+                         tmp_grid_raw_bytes_/(1024.0*1024.0), tmp_grid_stored_bytes_/(1024.0*1024.0),
+                         tmp_grid_raw_bytes_/tmp_grid_stored_bytes_);
+    if (w_tmp_grid_codec_ > 0.0)
+      LogKit::LogFormatted(logLevel,", %.1f MB/s in compression and decompression",
+                           tmp_grid_raw_bytes_/(1024.0*1024.0)/w_tmp_grid_codec_);
+    LogKit::LogFormatted(logLevel,"\n");
+  }
+}
+
+bool
+Timings::startRegion(const std::string & name)
+{
+  if (omp_in_parallel())
+    return false;
+
+  int parent = -1;
+  if (openRegions_.size() > 0)
+    parent = openRegions_.back().index;
+
+  int index = -1;
+  for (size_t i = 0 ; i < regions_.size() ; i++) {
+    if (regions_[i].parent == parent && regions_[i].name == name) {
+      index = static_cast<int>(i);
+      break;
+    }
+  }
+
+  if (index < 0) {
+    RegionTiming region;
+    region.name         = name;
+    region.parent       = parent;
+    region.calls        = 0;
+    region.wall         = 0.0;
+    region.cpu          = 0.0;
+    region.ffts         = 0;
+    region.tmpGridBytes = 0.0;
+    regions_.push_back(region);
+    index = static_cast<int>(regions_.size()) - 1;
+  }
+
+  OpenRegion open;
+  open.index = index;
+  open.wall  = 0.0;
+  open.cpu   = 0.0;
+  TimeKit::getTime(open.wall, open.cpu);
+  getRegionCounters(open.ffts, open.tmpGridBytes);
+  openRegions_.push_back(open);
+
+  return true;
+}
+
+void
+Timings::endRegion(void)
+{
+  if (omp_in_parallel() || openRegions_.size() == 0)
+    return;
+
+  const OpenRegion & open   = openRegions_.back();
+  RegionTiming     & region = regions_[open.index];
+
+  double wall = open.wall;
+  double cpu  = open.cpu;
+  double tmpGridBytes;
+  int    ffts;
+  TimeKit::getTime(wall, cpu);
+  getRegionCounters(ffts, tmpGridBytes);
+
+  region.calls        += 1;
+  region.wall         += wall;
+  region.cpu          += cpu;
+  region.ffts         += ffts         - open.ffts;
+  region.tmpGridBytes += tmpGridBytes - open.tmpGridBytes;
+
+  openRegions_.pop_back();
+}
+
+void
+Timings::getRegionCounters(int & ffts, double & tmpGridBytes)
+{
+  ffts         = FFTGrid::getNumberOfFFTs() + FFTGrid::getNumberOfInvFFTs();
+  tmpGridBytes = FFTFileGrid::getTotalBytesRead() + FFTFileGrid::getTotalBytesWritten();
+}
+
+void
+Timings::writeReport(const std::string & baseName)
+{
+  // Same totals as the timings summary, so setTimeTotal must have been called.
+  double wall = w_total_;
+  double cpu  = c_total_;
+
+  std::ofstream file;
+  NRLib::OpenWrite(file, baseName + IO::SuffixJsonFiles());
+  file << std::fixed << std::setprecision(3);
+  file << "{\n"
+       << "  \"wall_time\": " << wall << ",\n"
+       << "  \"cpu_time\": "  << cpu  << ",\n"
+       << "  \"counters\": {\n"
+       << "    \"fft_forward\": "            << fft_forward_            << ",\n"
+       << "    \"fft_inverse\": "            << fft_inverse_            << ",\n"
+       << "    \"fft_plans_created\": "      << fft_plan_misses_        << ",\n"
+       << "    \"fft_plans_reused\": "       << fft_plan_hits_          << ",\n"
+       << "    \"max_grids\": "              << max_grids_              << ",\n"
+       << "    \"max_grid_bytes\": "         << max_grid_bytes_         << ",\n"
+       << "    \"tmp_grid_bytes_read\": "    << tmp_grid_bytes_read_    << ",\n"
+       << "    \"tmp_grid_bytes_written\": " << tmp_grid_bytes_written_ << ",\n"
+       << "    \"tmp_grid_io_time\": "       << w_tmp_grid_io_          << ",\n"
+       << "    \"tmp_grid_raw_bytes\": "     << tmp_grid_raw_bytes_     << ",\n"
+       << "    \"tmp_grid_stored_bytes\": "  << tmp_grid_stored_bytes_  << ",\n"
+       << "    \"tmp_grid_codec_time\": "    << w_tmp_grid_codec_       << "\n"
+       << "  },\n"
+       << "  \"regions\": [";
+  if (writeRegionJson(file, -1, "    "))
+    file << "\n  ";
+  file << "]\n}\n";
+  file.close();
+
+  NRLib::OpenWrite(file, baseName + IO::SuffixCsvFiles());
+  file << std::fixed << std::setprecision(3);
+  file << "region,calls,wall_time,cpu_time,ffts,tmp_grid_bytes\n";
+  file << "Total,1," << wall << "," << cpu << "," << fft_forward_ + fft_inverse_ << ","
+       << tmp_grid_bytes_read_ + tmp_grid_bytes_written_ << "\n";
+  writeRegionCsv(file, -1, "Total");
+  file.close();
+}
+
+bool
+Timings::writeRegionJson(std::ostream & file, int parent, const std::string & indent)
+{
+  bool written = false;
+  for (size_t i = 0 ; i < regions_.size() ; i++) {
+    const RegionTiming & region = regions_[i];
+    if (region.parent == parent) {
+      file << (written ? ",\n" : "\n") << indent
+           << "{\"name\": \""        << region.name         << "\""
+           << ", \"calls\": "          << region.calls
+           << ", \"wall_time\": "      << region.wall
+           << ", \"cpu_time\": "       << region.cpu
+           << ", \"ffts\": "           << region.ffts
+           << ", \"tmp_grid_bytes\": " << region.tmpGridBytes
+           << ", \"regions\": [";
+      if (writeRegionJson(file, static_cast<int>(i), indent + "  "))
+        file << "\n" << indent;
+      file << "]}";
+      written = true;
+    }
+  }
+  return written;
+}
+
+void
+Timings::writeRegionCsv(std::ostream & file, int parent, const std::string & path)
+{
+  for (size_t i = 0 ; i < regions_.size() ; i++) {
+    const RegionTiming & region = regions_[i];
+    if (region.parent == parent) {
+      std::string regionPath = path + "/" + region.name;
+      file << regionPath << "," << region.calls << "," << region.wall << "," << region.cpu << ","
+           << region.ffts << "," << region.tmpGridBytes << "\n";
+      writeRegionCsv(file, static_cast<int>(i), regionPath);
+    }
+  }
 }
 
 void
@@ -256,6 +440,43 @@ Timings::addToTimeKrigingSim(double& wall, double& cpu)
   c_kriging_sim_ += cpu;
 }
 
+void
+Timings::setFFTPlanCounts(int hits, int misses)
+{
+  fft_plan_hits_   = hits;
+  fft_plan_misses_ = misses;
+}
+
+void
+Timings::setFFTCounts(int forward, int inverse)
+{
+  fft_forward_     = forward;
+  fft_inverse_     = inverse;
+}
+
+void
+Timings::setGridHighWater(int nGrids, double bytes)
+{
+  max_grids_       = nGrids;
+  max_grid_bytes_  = bytes;
+}
+
+void
+Timings::setTmpGridIO(double bytesRead, double bytesWritten, double ioTime)
+{
+  tmp_grid_bytes_read_    = bytesRead;
+  tmp_grid_bytes_written_ = bytesWritten;
+  w_tmp_grid_io_          = ioTime;
+}
+
+void
+Timings::setTmpGridCompression(double rawBytes, double storedBytes, double codecTime)
+{
+  tmp_grid_raw_bytes_     = rawBytes;
+  tmp_grid_stored_bytes_  = storedBytes;
+  w_tmp_grid_codec_       = codecTime;
+}
+
 
 double Timings::w_total_             = 0.0;
 double Timings::c_total_             = 0.0;
@@ -301,3 +522,21 @@ double Timings::c_kriging_pred_      = 0.0;
 
 double Timings::w_kriging_sim_       = 0.0;
 double Timings::c_kriging_sim_       = 0.0;
+
+int    Timings::fft_plan_hits_        = 0;
+int    Timings::fft_plan_misses_      = 0;
+int    Timings::fft_forward_          = 0;
+int    Timings::fft_inverse_          = 0;
+
+int    Timings::max_grids_            = 0;
+double Timings::max_grid_bytes_       = 0.0;
+
+double Timings::tmp_grid_bytes_read_    = 0.0;
+double Timings::tmp_grid_bytes_written_ = 0.0;
+double Timings::w_tmp_grid_io_          = 0.0;
+double Timings::tmp_grid_raw_bytes_     = 0.0;
+double Timings::tmp_grid_stored_bytes_  = 0.0;
+double Timings::w_tmp_grid_codec_       = 0.0;
+
+std::vector<Timings::RegionTiming>  Timings::regions_;
+std::vector<Timings::OpenRegion>    Timings::openRegions_;
@@ -5,12 +5,39 @@
 #ifndef TIMINGS_H
 #define TIMINGS_H
 
+#include <ostream>
+#include <string>
+#include <vector>
+
 #include "src/definitions.h"
 #include "nrlib/iotools/logkit.hpp"
 
 class Timings
 {
 public:
+  //
+  // Times a named region from construction to destruction. A region opened while
+  // another is open is nested under it, and repeated regions with the same name and
+  // parent are accumulated. Regions opened inside OpenMP parallel regions are ignored.
+  //
+  class Region
+  {
+  public:
+    Region(const std::string & name) : active_(startRegion(name)) {}
+    ~Region()                         { if (active_) endRegion(); }
+
+  private:
+    Region(const Region &);
+    Region & operator=(const Region &);
+
+    bool active_;
+  };
+
+  static bool    startRegion(const std::string & name);
+  static void    endRegion(void);
+
+  static void    writeReport(const std::string & baseName);
+
   static void    reportAll(LogKit::MessageLevels logLevel);
   static void    reportTotal();
 
@@ -28,8 +55,37 @@ public:
   static void    setTimeFaciesProb(double& wall, double& cpu);
   static void    setTimeKrigingPred(double& wall, double& cpu);
   static void    addToTimeKrigingSim(double& wall, double& cpu);
+  static void    setFFTPlanCounts(int hits, int misses);
+  static void    setFFTCounts(int forward, int inverse);
+  static void    setGridHighWater(int nGrids, double bytes);
+  static void    setTmpGridIO(double bytesRead, double bytesWritten, double ioTime);
+  static void    setTmpGridCompression(double rawBytes, double storedBytes, double codecTime);
 
 private:
+  struct RegionTiming
+  {
+    std::string  name;
+    int          parent;         // Index of enclosing region, or -1
+    int          calls;
+    double       wall;
+    double       cpu;
+    int          ffts;           // Forward and inverse 3D grid transforms
+    double       tmpGridBytes;   // Bytes read and written for intermediate disk storage
+  };
+
+  struct OpenRegion
+  {
+    int          index;
+    double       wall;
+    double       cpu;
+    int          ffts;
+    double       tmpGridBytes;
+  };
+
+  static void    getRegionCounters(int & ffts, double & tmpGridBytes);
+  static bool    writeRegionJson(std::ostream & file, int parent, const std::string & indent);
+  static void    writeRegionCsv(std::ostream & file, int parent, const std::string & path);
+
   static void    reportOne(const std::string & text, double cpuThis, double wallThis,
                            double cpuTot, double wallTot, LogKit::MessageLevels logLevel);
   static void    calculateRest(void);
@@ -78,6 +134,24 @@ private:
 
   static double  w_kriging_sim_;
   static double  c_kriging_sim_;
+
+  static int     fft_plan_hits_;
+  static int     fft_plan_misses_;
+  static int     fft_forward_;
+  static int     fft_inverse_;
+
+  static int     max_grids_;
+  static double  max_grid_bytes_;
+
+  static double  tmp_grid_bytes_read_;
+  static double  tmp_grid_bytes_written_;
+  static double  w_tmp_grid_io_;
+  static double  tmp_grid_raw_bytes_;
+  static double  tmp_grid_stored_bytes_;
+  static double  w_tmp_grid_codec_;
+
+  static std::vector<RegionTiming>  regions_;       ///< In the order they were first opened
+  static std::vector<OpenRegion>    openRegions_;   ///< Stack of currently open regions
 };
 
 #endif
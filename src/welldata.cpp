@@ -25,6 +25,7 @@
 #include "src/welldata.h"
 #include "src/modelsettings.h"
 #include "src/io.h"
+#include "src/fftplancache.h"
 
 //----------------------------------------------------------------------------
 WellData::WellData(const std::string              & wellFileName,
@@ -1418,9 +1419,8 @@ WellData::applyFilter(float * log_filtered, float *log_interpolated, int n_time_
     //
     // Transform to Fourier domain
     //
-    rfftwnd_plan p1 = rfftwnd_create_plan(1, &nt, FFTW_REAL_TO_COMPLEX, FFTW_ESTIMATE | FFTW_IN_PLACE);
+    rfftwnd_plan p1 = FFTPlanCache::getPlan1D(nt, FFTW_REAL_TO_COMPLEX);
     rfftwnd_one_real_to_complex(p1, rAmp, cAmp);
-    fftwnd_destroy_plan(p1);
 
     //for (int i=0 ; i<cnt ; i++) {
     //  printf("i=%2d, cAmp.re[i]=%11.4f  cAmp.im[i]=%11.4f\n",i,cAmp[i].re,cAmp[i].im);
@@ -1457,9 +1457,8 @@ WellData::applyFilter(float * log_filtered, float *log_interpolated, int n_time_
     //
     // Backtransform to time domain
     //
-    rfftwnd_plan p2 = rfftwnd_create_plan(1, &nt, FFTW_COMPLEX_TO_REAL, FFTW_ESTIMATE | FFTW_IN_PLACE);
+    rfftwnd_plan p2 = FFTPlanCache::getPlan1D(nt, FFTW_COMPLEX_TO_REAL);
     rfftwnd_one_complex_to_real(p2, cAmp, rAmp);
-    fftwnd_destroy_plan(p2);
 
     float scale= float(1.0/nt);
     for(i=0 ; i < rnt ; i++) {
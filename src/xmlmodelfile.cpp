@@ -311,6 +311,7 @@ XmlModelFile::parseWellData(TiXmlNode * node, std::string & errTxt)
   legalCommands.push_back("maximum-merge-distance");
   legalCommands.push_back("maximum-offset");
   legalCommands.push_back("maximum-shift");
+  legalCommands.push_back("coarse-to-fine-search");
   legalCommands.push_back("well-move-data-interval");
 
   parseLogNames(root, errTxt);
@@ -342,6 +343,10 @@ XmlModelFile::parseWellData(TiXmlNode * node, std::string & errTxt)
   if(parseValue(root, "maximum-shift", value, errTxt) == true)
     modelSettings_->setMaxWellShift(value);
 
+  bool coarseToFine;
+  if(parseBool(root, "coarse-to-fine-search", coarseToFine, errTxt) == true)
+    modelSettings_->setWellMoveCoarseToFine(coarseToFine);
+
   parseWellMoveDataInterval(root, errTxt);
 
   checkForJunk(root, errTxt, legalCommands);
@@ -5290,6 +5295,7 @@ XmlModelFile::parseOtherOutput(TiXmlNode * node, std::string & errTxt)
   legalCommands.push_back("rock-physics-distributions");
   legalCommands.push_back("error-file");
   legalCommands.push_back("task-file");
+  legalCommands.push_back("timings");
 
   bool value;
   int otherFlag = 0;
@@ -5307,6 +5313,8 @@ XmlModelFile::parseOtherOutput(TiXmlNode * node, std::string & errTxt)
     otherFlag += IO::ERROR_FILE;
   if(parseBool(root, "task-file", value, errTxt) == true && value == true)
     otherFlag += IO::TASK_FILE;
+  if(parseBool(root, "timings", value, errTxt) == true && value == true)
+    otherFlag += IO::TIMINGS;
 
   modelSettings_->setOtherOutputFlag(otherFlag);
 
@@ -5327,6 +5335,13 @@ XmlModelFile::parseAdvancedSettings(TiXmlNode * node, std::string & errTxt)
   legalCommands.push_back("vp-vs-ratio");
   legalCommands.push_back("vp-vs-ratio-from-wells");
   legalCommands.push_back("use-intermediate-disk-storage");
+  legalCommands.push_back("use-memory-mapped-disk-storage");
+  legalCommands.push_back("compress-intermediate-disk-storage");
+  legalCommands.push_back("compression-mantissa-bits");
+  legalCommands.push_back("number-of-threads");
+  legalCommands.push_back("measure-fft-plans");
+  legalCommands.push_back("compact-prior-covariance");
+  legalCommands.push_back("concurrent-simulations");
   legalCommands.push_back("maximum-relative-thickness-difference");
   legalCommands.push_back("frequency-band");
   legalCommands.push_back("energy-threshold");
@@ -5366,6 +5381,46 @@ XmlModelFile::parseAdvancedSettings(TiXmlNode * node, std::string & errTxt)
   if(parseBool(root, "use-intermediate-disk-storage", fileGrid, errTxt) == true)
     modelSettings_->setFileGrid(fileGrid);
 
+  bool memoryMapped;
+  if(parseBool(root, "use-memory-mapped-disk-storage", memoryMapped, errTxt) == true)
+    modelSettings_->setMemoryMappedFileGrid(memoryMapped);
+
+  bool compressed;
+  if(parseBool(root, "compress-intermediate-disk-storage", compressed, errTxt) == true)
+    modelSettings_->setCompressedFileGrid(compressed);
+
+  int mantissaBits = 23;
+  if(parseValue(root, "compression-mantissa-bits", mantissaBits, errTxt) == true) {
+    if(mantissaBits < 1 || mantissaBits > 23)
+      errTxt += "The number of mantissa bits kept in compressed grids must be between 1 and 23.\n";
+    else
+      modelSettings_->setCompressionMantissaBits(mantissaBits);
+  }
+
+  int nThreads = 1;
+  if(parseValue(root, "number-of-threads", nThreads, errTxt) == true) {
+    if(nThreads < 1)
+      errTxt += "The number of threads must be at least one.\n";
+    else
+      modelSettings_->setNumberOfThreads(nThreads);
+  }
+
+  bool measureFFTPlans;
+  if(parseBool(root, "measure-fft-plans", measureFFTPlans, errTxt) == true)
+    modelSettings_->setMeasureFFTPlans(measureFFTPlans);
+
+  bool compactPriorCov;
+  if(parseBool(root, "compact-prior-covariance", compactPriorCov, errTxt) == true)
+    modelSettings_->setCompactPriorCovariance(compactPriorCov);
+
+  int nConcurrent = 0;
+  if(parseValue(root, "concurrent-simulations", nConcurrent, errTxt) == true) {
+    if(nConcurrent < 0)
+      errTxt += "The number of concurrent simulations cannot be negative.\n";
+    else
+      modelSettings_->setConcurrentSimulations(nConcurrent);
+  }
+
   double limit;
   if(parseValue(root,"maximum-relative-thickness-difference", limit, errTxt) == true)
     modelSettings_->setLzLimit(limit);